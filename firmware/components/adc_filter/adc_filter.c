@@ -0,0 +1,132 @@
+#include <string.h>
+#include "adc_filter.h"
+
+static bool adc_filter_config_valid(const adc_filter_config_t *config)
+{
+    if (config->median_n > ADC_FILTER_MEDIAN_MAX || (config->median_n > 1 && !(config->median_n & 1))) {
+        return false;
+    }
+    if (config->iir_shift > ADC_FILTER_IIR_SHIFT_MAX) {
+        return false;
+    }
+    if (config->decim_type == ADC_FILTER_DECIM_CIC &&
+        (config->cic_order < 1 || config->cic_order > ADC_FILTER_CIC_ORDER_MAX)) {
+        return false;
+    }
+    return config->decim_type == ADC_FILTER_DECIM_BOXCAR || config->decim_type == ADC_FILTER_DECIM_CIC;
+}
+
+bool adc_filter_init(adc_filter_t *filter, const adc_filter_config_t *config)
+{
+    if (!filter) {
+        return false;
+    }
+
+    memset(filter, 0, sizeof(*filter));
+    bool valid = config && adc_filter_config_valid(config);
+    if (valid) {
+        filter->config = *config;
+    }
+    if (filter->config.decimation == 0) {
+        filter->config.decimation = 1;
+    }
+
+    filter->cic_gain = 1;
+    if (filter->config.decim_type == ADC_FILTER_DECIM_CIC) {
+        for (int i = 0; i < filter->config.cic_order; i++) {
+            filter->cic_gain *= filter->config.decimation;
+        }
+    }
+    return valid;
+}
+
+void adc_filter_reset(adc_filter_t *filter)
+{
+    adc_filter_config_t config = filter->config;
+    adc_filter_init(filter, &config);
+}
+
+static int32_t adc_filter_median(adc_filter_t *filter, int32_t in)
+{
+    uint8_t n = filter->config.median_n;
+    filter->median_buf[filter->median_pos] = in;
+    filter->median_pos = (filter->median_pos + 1) % n;
+    if (filter->median_count < n) {
+        filter->median_count++;
+    }
+
+    // Insertion sort of at most 7 values; until the window fills, use what we have
+    int32_t sorted[ADC_FILTER_MEDIAN_MAX];
+    uint8_t count = filter->median_count;
+    for (uint8_t i = 0; i < count; i++) {
+        int32_t v = filter->median_buf[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return sorted[count / 2];
+}
+
+static int32_t adc_filter_iir(adc_filter_t *filter, int32_t in)
+{
+    int64_t x = (int64_t)in << ADC_FILTER_IIR_FRAC_BITS;
+    if (!filter->iir_primed) {
+        // Start at the first sample instead of ramping up from zero
+        filter->iir_state = x;
+        filter->iir_primed = true;
+    } else {
+        filter->iir_state += (x - filter->iir_state) >> filter->config.iir_shift;
+    }
+    return (int32_t)((filter->iir_state + (1 << (ADC_FILTER_IIR_FRAC_BITS - 1))) >> ADC_FILTER_IIR_FRAC_BITS);
+}
+
+// Round-half-away-from-zero division for the decimator outputs
+static int32_t adc_filter_div_round(int64_t num, int64_t den)
+{
+    return (int32_t)(num >= 0 ? (num + den / 2) / den : (num - den / 2) / den);
+}
+
+bool adc_filter_push(adc_filter_t *filter, int32_t in, int32_t *out)
+{
+    const adc_filter_config_t *config = &filter->config;
+    int32_t x = in;
+
+    if (config->median_n > 1) {
+        x = adc_filter_median(filter, x);
+    }
+    if (config->iir_shift > 0) {
+        x = adc_filter_iir(filter, x);
+    }
+
+    if (config->decim_type == ADC_FILTER_DECIM_CIC) {
+        uint64_t acc = (uint64_t)(int64_t)x;
+        for (int i = 0; i < config->cic_order; i++) {
+            filter->integ[i] += acc;
+            acc = filter->integ[i];
+        }
+        if (++filter->phase < config->decimation) {
+            return false;
+        }
+        filter->phase = 0;
+        for (int i = 0; i < config->cic_order; i++) {
+            uint64_t prev = filter->comb[i];
+            filter->comb[i] = acc;
+            acc -= prev;
+        }
+        // The true output is bounded, so the wrapped difference is exact
+        *out = adc_filter_div_round((int64_t)acc, filter->cic_gain);
+        return true;
+    }
+
+    filter->boxcar_sum += x;
+    if (++filter->phase < config->decimation) {
+        return false;
+    }
+    *out = adc_filter_div_round(filter->boxcar_sum, config->decimation);
+    filter->boxcar_sum = 0;
+    filter->phase = 0;
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef ADC_FILTER_H
+#define ADC_FILTER_H
+
+// Per-channel integer filter chain: median-of-N spike rejection, then a first-order IIR
+// low-pass, then boxcar or CIC decimation. No IDF dependencies so it also builds on the
+// host (see test/).
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_FILTER_MEDIAN_MAX       7   // Longest median window (odd)
+#define ADC_FILTER_CIC_ORDER_MAX    3
+#define ADC_FILTER_IIR_SHIFT_MAX    12
+#define ADC_FILTER_IIR_FRAC_BITS    8   // Extra state precision so small steps are not lost
+
+typedef enum {
+    ADC_FILTER_DECIM_BOXCAR,    // Average of each block of N inputs
+    ADC_FILTER_DECIM_CIC,       // Cascaded integrator-comb, order cic_order, unity DC gain
+} adc_filter_decim_t;
+
+typedef struct {
+    uint8_t median_n;           // 0 or 1 = off, otherwise odd up to ADC_FILTER_MEDIAN_MAX
+    uint8_t iir_shift;          // 0 = off, otherwise y += (x - y) / 2^iir_shift
+    adc_filter_decim_t decim_type;
+    uint8_t decimation;         // One output per N inputs; 0 or 1 = every input
+    uint8_t cic_order;          // 1..ADC_FILTER_CIC_ORDER_MAX, CIC only
+} adc_filter_config_t;
+
+typedef struct {
+    adc_filter_config_t config;
+    int32_t median_buf[ADC_FILTER_MEDIAN_MAX];
+    uint8_t median_pos;
+    uint8_t median_count;
+    int64_t iir_state;          // Q ADC_FILTER_IIR_FRAC_BITS
+    bool iir_primed;
+    uint64_t integ[ADC_FILTER_CIC_ORDER_MAX];  // Wrap-around arithmetic is intended
+    uint64_t comb[ADC_FILTER_CIC_ORDER_MAX];
+    int64_t boxcar_sum;
+    int64_t cic_gain;           // decimation ^ cic_order
+    uint8_t phase;
+} adc_filter_t;
+
+// Returns false (and leaves the filter passing samples through) if the config is invalid
+bool adc_filter_init(adc_filter_t *filter, const adc_filter_config_t *config);
+void adc_filter_reset(adc_filter_t *filter);
+// Feed one sample; returns true and writes *out when the decimator produces an output
+bool adc_filter_push(adc_filter_t *filter, int32_t in, int32_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_FILTER_H
@@ -1,36 +1,194 @@
+#include <string.h>
+#include <inttypes.h>
 #include "ads1115.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_attr.h"
 
 static const char *TAG = "ADS1115";
 
 #define ADS1115_TIMEOUT_MS 1000
+#define ADS1115_WAIT_MARGIN_US 50
+#define ADS1115_SELF_TEST_MUX ADS1115_MUX_SINGLE_0
 
-static esp_err_t ads1115_write_reg(ads1115_handle_t *dev, uint8_t reg, uint16_t value)
+static bool IRAM_ATTR ads1115_i2c_done_cb(i2c_master_dev_handle_t i2c_dev, const i2c_master_event_data_t *evt_data, void *arg)
+{
+    ads1115_handle_t *dev = (ads1115_handle_t *)arg;
+    BaseType_t higher_prio_woken = pdFALSE;
+    (void)i2c_dev;
+
+    if (evt_data->event != I2C_EVENT_DONE) {
+        dev->i2c_error = true;
+    }
+    xSemaphoreGiveFromISR(dev->i2c_done_sem, &higher_prio_woken);
+    return higher_prio_woken == pdTRUE;
+}
+
+// Wait for queued async transactions; a no-op for synchronous devices
+static esp_err_t ads1115_i2c_wait(ads1115_handle_t *dev, int pending)
+{
+    if (!dev->config.async) {
+        return ESP_OK;
+    }
+
+    for (int i = 0; i < pending; i++) {
+        if (xSemaphoreTake(dev->i2c_done_sem, pdMS_TO_TICKS(ADS1115_TIMEOUT_MS)) != pdTRUE) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+
+    if (dev->i2c_error) {
+        dev->i2c_error = false;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void ads1115_stats_record(ads1115_handle_t *dev, int transactions, int64_t start_us)
+{
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    dev->stats.transactions += transactions;
+    dev->stats.i2c_time_us += elapsed_us;
+    if (elapsed_us > dev->stats.max_i2c_time_us) {
+        dev->stats.max_i2c_time_us = elapsed_us;
+    }
+}
+
+// Queue a register write; buffer lives in the handle so it stays valid for async transfers
+static esp_err_t ads1115_queue_write_reg(ads1115_handle_t *dev, uint8_t reg, uint16_t value)
 {
-    uint8_t data[3];
-    data[0] = reg;
-    data[1] = (value >> 8) & 0xFF;  // MSB
-    data[2] = value & 0xFF;         // LSB
+    dev->tx_buf[0] = reg;
+    dev->tx_buf[1] = (value >> 8) & 0xFF;  // MSB
+    dev->tx_buf[2] = value & 0xFF;         // LSB
     
-    return i2c_master_transmit(dev->i2c_dev_handle, data, sizeof(data), ADS1115_TIMEOUT_MS);
+    return i2c_master_transmit(dev->i2c_dev_handle, dev->tx_buf, sizeof(dev->tx_buf), ADS1115_TIMEOUT_MS);
+}
+
+static esp_err_t ads1115_queue_read_reg(ads1115_handle_t *dev, uint8_t reg)
+{
+    dev->reg_ptr = reg;
+    return i2c_master_transmit_receive(dev->i2c_dev_handle, &dev->reg_ptr, 1,
+                                       dev->rx_buf, sizeof(dev->rx_buf), ADS1115_TIMEOUT_MS);
+}
+
+static esp_err_t ads1115_write_reg(ads1115_handle_t *dev, uint8_t reg, uint16_t value)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = ads1115_queue_write_reg(dev, reg, value);
+    if (ret == ESP_OK) {
+        ret = ads1115_i2c_wait(dev, 1);
+    }
+    ads1115_stats_record(dev, 1, start_us);
+    return ret;
 }
 
 static esp_err_t ads1115_read_reg(ads1115_handle_t *dev, uint8_t reg, uint16_t *value)
 {
-    esp_err_t ret;
-    uint8_t data[2];
-    
-    ret = i2c_master_transmit_receive(dev->i2c_dev_handle, &reg, 1, data, 2, ADS1115_TIMEOUT_MS);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = ads1115_queue_read_reg(dev, reg);
+    if (ret == ESP_OK) {
+        ret = ads1115_i2c_wait(dev, 1);
+    }
+    ads1115_stats_record(dev, 1, start_us);
     if (ret != ESP_OK) {
         return ret;
     }
     
-    *value = ((uint16_t)data[0] << 8) | data[1];
+    *value = ((uint16_t)dev->rx_buf[0] << 8) | dev->rx_buf[1];
     return ESP_OK;
 }
 
+static inline bool ads1115_rdy_active(const ads1115_handle_t *dev)
+{
+    // ALERT/RDY serves either conversion-ready or the window comparator, never both
+    return dev->config.use_alert_rdy && !dev->window.enabled;
+}
+
+static void IRAM_ATTR ads1115_alert_isr(void *arg)
+{
+    ads1115_handle_t *dev = (ads1115_handle_t *)arg;
+    BaseType_t higher_prio_woken = pdFALSE;
+
+    if (dev->window.enabled) {
+        // Comparator trip: hand straight to the owner so it can make the output safe
+        dev->window.trips++;
+        dev->window.on_trip(dev->window.arg);
+        return;
+    }
+
+    xSemaphoreGiveFromISR(dev->rdy_sem, &higher_prio_woken);
+    if (higher_prio_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static esp_err_t ads1115_setup_alert_rdy(ads1115_handle_t *dev)
+{
+    esp_err_t ret;
+
+    // Program the threshold registers so ALERT/RDY pulses at the end of each conversion
+    ret = ads1115_write_reg(dev, ADS1115_REG_LO_THRESH, ADS1115_RDY_LO_THRESH);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write Lo_thresh: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ret = ads1115_write_reg(dev, ADS1115_REG_HI_THRESH, ADS1115_RDY_HI_THRESH);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write Hi_thresh: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // ALERT/RDY is open-drain and active low
+    gpio_config_t io_cfg = {
+        .pin_bit_mask = 1ULL << dev->config.alert_gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ret = gpio_config(&io_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure ALERT/RDY GPIO: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    // In IRAM so a watchdog trip is not deferred while flash writes (the session log)
+    // disable the cache; the handler and the trip callback are IRAM as well. The ISR
+    // service may already be installed by another driver.
+    ret = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    return gpio_isr_handler_add(dev->config.alert_gpio, ads1115_alert_isr, dev);
+}
+
+// ALERT/RDY is only useful if the pin is actually wired: time one conversion against it
+// and fall back to timed waits when no edge arrives
+static void ads1115_self_test_alert_rdy(ads1115_handle_t *dev)
+{
+    int16_t raw;
+    esp_err_t ret = ads1115_read_single(dev, ADS1115_SELF_TEST_MUX, &raw);
+    if (ret == ESP_OK) {
+        return;
+    }
+    ESP_LOGW(TAG, "No ALERT/RDY edge on GPIO %d (%s); using timed waits", dev->config.alert_gpio,
+             esp_err_to_name(ret));
+    gpio_isr_handler_remove(dev->config.alert_gpio);
+    dev->config.use_alert_rdy = false;
+}
+
+static void ads1115_wait_timer_cb(void *arg)
+{
+    ads1115_handle_t *dev = (ads1115_handle_t *)arg;
+    xSemaphoreGive(dev->rdy_sem);
+}
+
 esp_err_t ads1115_init(ads1115_handle_t *dev, const ads1115_config_t *config, i2c_master_bus_handle_t bus_handle)
 {
     if (!dev || !config || !bus_handle) {
@@ -38,12 +196,14 @@ esp_err_t ads1115_init(ads1115_handle_t *dev, const ads1115_config_t *config, i2
     }
     
     dev->config = *config;
+    // Once, here: set_window() may be called from another task from now on
+    portMUX_INITIALIZE(&dev->window.lock);
     
     // Create I2C device handle
     i2c_device_config_t dev_cfg = {
         .dev_addr_length = I2C_ADDR_BIT_LEN_7,
         .device_address = config->addr,
-        .scl_speed_hz = 100000,  // 100kHz
+        .scl_speed_hz = config->scl_speed_hz ? config->scl_speed_hz : ADS1115_SCL_SPEED_DEFAULT,
     };
     
     esp_err_t ret = i2c_master_bus_add_device(bus_handle, &dev_cfg, &dev->i2c_dev_handle);
@@ -52,83 +212,443 @@ esp_err_t ads1115_init(ads1115_handle_t *dev, const ads1115_config_t *config, i2
         return ret;
     }
     
+    // Conversion completion is signalled either by the ALERT/RDY ISR or by a one-shot timer
+    dev->rdy_sem = xSemaphoreCreateBinary();
+    if (!dev->rdy_sem) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_timer_create_args_t timer_args = {
+        .callback = ads1115_wait_timer_cb,
+        .arg = dev,
+        .name = "ads1115_wait",
+    };
+    ret = esp_timer_create(&timer_args, &dev->wait_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create wait timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    if (config->async) {
+        // Transactions on this device complete through the bus ISR; the bus needs a non-zero trans_queue_depth
+        dev->i2c_done_sem = xSemaphoreCreateCounting(2, 0);
+        if (!dev->i2c_done_sem) {
+            return ESP_ERR_NO_MEM;
+        }
+        i2c_master_event_callbacks_t cbs = {
+            .on_trans_done = ads1115_i2c_done_cb,
+        };
+        ret = i2c_master_register_event_callbacks(dev->i2c_dev_handle, &cbs, dev);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register I2C callbacks: %s", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+    
+    if (config->use_alert_rdy) {
+        ret = ads1115_setup_alert_rdy(dev);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    
     dev->initialized = true;
+    if (dev->config.use_alert_rdy) {
+        ads1115_self_test_alert_rdy(dev);
+    }
     
-    ESP_LOGI(TAG, "ADS1115 initialized with address 0x%02x", config->addr);
+    ESP_LOGI(TAG, "ADS1115 initialized with address 0x%02x (%s, %s I2C)", config->addr,
+             dev->config.use_alert_rdy ? "ALERT/RDY interrupt" : "timed wait",
+             config->async ? "async" : "sync");
     
     return ESP_OK;
 }
 
-esp_err_t ads1115_read_single(ads1115_handle_t *dev, uint16_t mux, int16_t *raw_value)
+// Window thresholds in codes at one PGA. A saturated reading above the window must still
+// trip, so the upper threshold stays below full scale.
+static void ads1115_window_raw(int32_t lo_uv, int32_t hi_uv, uint16_t gain, int16_t *lo, int16_t *hi)
 {
-    if (!dev || !dev->initialized || !raw_value) {
-        return ESP_ERR_INVALID_ARG;
+    *lo = ads1115_uv_to_raw(lo_uv, gain);
+    *hi = ads1115_uv_to_raw(hi_uv, gain);
+    if (*hi == INT16_MAX) {
+        *hi = INT16_MAX - 1;
+    }
+}
+
+// Load window thresholds for the protected input from the sampling context so register
+// writes never race. Thresholds are kept in uV and re-scaled whenever the PGA changes.
+static void ads1115_apply_window(ads1115_handle_t *dev, ads1115_channel_t *ch)
+{
+    if (!dev->window.enabled || ch->mux != dev->window.mux) {
+        return;
     }
     
-    esp_err_t ret;
+    portENTER_CRITICAL(&dev->window.lock);
+    int32_t lo_uv = dev->window.lo_uv;
+    int32_t hi_uv = dev->window.hi_uv;
+    bool dirty = dev->window.dirty;
+    uint32_t gen = dev->window.gen;
+    dev->window.dirty = false;
+    portEXIT_CRITICAL(&dev->window.lock);
+    
+    // Keep the upper threshold representable so an overcurrent can always trip
+    if (ch->auto_range) {
+        int idx = ads1115_pga_index(ch->gain);
+        while (idx > 0 && hi_uv > ads1115_fsr_uv(ads1115_pga_from_index(idx)) / 10 * 9) {
+            idx--;
+        }
+        ch->gain = ads1115_pga_from_index(idx);
+    }
+    
+    // Without ALERT/RDY the reading is compared when it is read (ads1115_check_window),
+    // against the thresholds of when it was started, as the chip would
+    if (!dev->config.use_alert_rdy) {
+        ads1115_window_raw(lo_uv, hi_uv, ch->gain, &dev->window.next_lo, &dev->window.next_hi);
+        dev->window.loaded_gen = gen;
+        return;
+    }
+    if (!dirty && dev->window.loaded_gain == ch->gain) {
+        return;
+    }
+    
+    int16_t lo, hi;
+    ads1115_window_raw(lo_uv, hi_uv, ch->gain, &lo, &hi);
+    
+    esp_err_t ret = ads1115_write_reg(dev, ADS1115_REG_LO_THRESH, (uint16_t)lo);
+    if (ret == ESP_OK) {
+        ret = ads1115_write_reg(dev, ADS1115_REG_HI_THRESH, (uint16_t)hi);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to load window thresholds: %s", esp_err_to_name(ret));
+        dev->window.dirty = true;  // Retry before the next conversion
+        return;
+    }
+    dev->window.loaded_gain = ch->gain;
+    dev->window.loaded_gen = gen;
+    ESP_LOGD(TAG, "Window thresholds: lo=%d hi=%d (gain=0x%04X)", lo, hi, ch->gain);
+}
+
+// Software window for a device without ALERT/RDY: the reading of the protected input is
+// compared as it is read, against the thresholds it was started with
+static void ads1115_check_window(ads1115_handle_t *dev, int16_t raw)
+{
+    if (!dev->window.enabled || dev->config.use_alert_rdy || !dev->active_ch ||
+        dev->active_ch->mux != dev->window.mux) {
+        return;
+    }
+    
+    if (raw < dev->window.active_lo || raw > dev->window.active_hi) {
+        dev->window.trips++;
+        dev->window.on_trip(dev->window.arg);
+    }
+}
+
+// Step the PGA one range at a time to keep readings between ~40% and ~90% of full scale.
+// Narrowing doubles the reading, so 40% lands below the 90% widen point and cannot oscillate.
+static void ads1115_auto_range(ads1115_handle_t *dev, ads1115_channel_t *ch, int16_t raw)
+{
+    int32_t mag = raw < 0 ? -(int32_t)raw : raw;
+    int idx = ads1115_pga_index(ch->gain);
+    
+    if (mag > ADS1115_AUTO_RANGE_HIGH && idx > 0) {
+        idx--;
+    } else if (mag < ADS1115_AUTO_RANGE_LOW && idx < ADS1115_PGA_INDEX_MAX) {
+        // Never narrow past the point where the watchdog threshold would clip
+        if (!dev->window.enabled || ch->mux != dev->window.mux ||
+            dev->window.hi_uv <= ads1115_fsr_uv(ads1115_pga_from_index(idx + 1)) / 10 * 9) {
+            idx++;
+        }
+    }
+    ch->gain = ads1115_pga_from_index(idx);
+}
+
+static inline uint16_t ads1115_channel_rate(const ads1115_handle_t *dev, const ads1115_channel_t *ch)
+{
+    return ch->data_rate ? ch->data_rate : dev->config.data_rate;
+}
+
+static uint16_t ads1115_build_config(ads1115_handle_t *dev, const ads1115_channel_t *ch)
+{
     uint16_t config_reg;
-    uint16_t conversion_reg;
+    uint16_t comparator;
+    
+    if (dev->window.enabled && dev->config.use_alert_rdy) {
+        // Only the protected input is compared; everything else leaves ALERT/RDY idle
+        if (ch->mux == dev->window.mux) {
+            comparator = ADS1115_CMODE_WINDOW | ADS1115_CQUE_1CONV;
+        } else {
+            comparator = ADS1115_CMODE_TRAD | ADS1115_CQUE_NONE;
+        }
+    } else if (dev->config.use_alert_rdy) {
+        // Assert ALERT/RDY after every conversion in conversion-ready mode
+        comparator = ADS1115_CMODE_TRAD | ADS1115_CQUE_1CONV;
+    } else {
+        comparator = ADS1115_CMODE_TRAD | ADS1115_CQUE_NONE;
+    }
     
     // Build configuration register value
     config_reg = ADS1115_OS_SINGLE |    // Start single conversion
-                 mux |                   // Input multiplexer
-                 dev->config.gain |      // Gain setting
-                 ADS1115_CMODE_TRAD |    // Traditional comparator
+                 ch->mux |               // Input multiplexer
+                 ch->gain |              // Gain setting
+                 comparator |            // Comparator mode and queue
                  ADS1115_CPOL_ACTVLOW |  // Comparator polarity
                  ADS1115_CLAT_NONLAT |   // Non-latching comparator
-                 ADS1115_CQUE_NONE |     // Disable comparator
-                 dev->config.data_rate;  // Data rate
+                 ads1115_channel_rate(dev, ch);  // Data rate
     
-    // Write configuration to start conversion
     ESP_LOGD(TAG, "Starting conversion with config: 0x%04X (mux=0x%04X, gain=0x%04X, rate=0x%04X)", 
-             config_reg, mux, dev->config.gain, dev->config.data_rate);
+             config_reg, ch->mux, ch->gain, ads1115_channel_rate(dev, ch));
     
-    ret = ads1115_write_reg(dev, ADS1115_REG_CONFIG, config_reg);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to write config register: %s", esp_err_to_name(ret));
-        return ret;
+    // Drop any stale ready pulse so the next wait only sees this conversion
+    if (ads1115_rdy_active(dev)) {
+        xSemaphoreTake(dev->rdy_sem, 0);
     }
     
+    return config_reg;
+}
+
+// Record the conversion now in flight so its result can be tagged with the PGA it used
+static void ads1115_set_active(ads1115_handle_t *dev, ads1115_channel_t *ch)
+{
+    dev->active_ch = ch;
+    dev->active_gain = ch->gain;
+    dev->active_rate = ads1115_channel_rate(dev, ch);
+    dev->conv_start_us = esp_timer_get_time();
+    if (dev->window.enabled && ch->mux == dev->window.mux) {
+        dev->window.active_lo = dev->window.next_lo;
+        dev->window.active_hi = dev->window.next_hi;
+    }
+}
+
+// Hand out a finished result and let its channel re-range for the next pass
+static void ads1115_finish_active(ads1115_handle_t *dev, int16_t raw, uint16_t *gain)
+{
+    if (gain) {
+        *gain = dev->active_gain;
+    }
+    ads1115_check_window(dev, raw);
+    if (dev->active_ch && dev->active_ch->auto_range) {
+        ads1115_auto_range(dev, dev->active_ch, raw);
+    }
+    dev->stats.samples++;
+}
+
+#if CONFIG_ADS1115_VERIFY_CONFIG
+static void ads1115_verify_config(ads1115_handle_t *dev, uint16_t config_reg)
+{
     // Verify the write was successful by reading back
     uint16_t readback_config;
-    ret = ads1115_read_reg(dev, ADS1115_REG_CONFIG, &readback_config);
+    esp_err_t ret = ads1115_read_reg(dev, ADS1115_REG_CONFIG, &readback_config);
     if (ret == ESP_OK) {
         ESP_LOGD(TAG, "Config readback: 0x%04X (expected: 0x%04X)", readback_config, config_reg);
         if ((readback_config & ~ADS1115_OS_NOTBUSY) != (config_reg & ~ADS1115_OS_NOTBUSY)) {
             ESP_LOGW(TAG, "Config readback mismatch - I2C communication issue?");
         }
     }
+}
+#endif
+
+esp_err_t ads1115_start_conversion(ads1115_handle_t *dev, ads1115_channel_t *ch)
+{
+    if (!dev || !dev->initialized || !ch) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    ads1115_apply_window(dev, ch);
+    uint16_t config_reg = ads1115_build_config(dev, ch);
+    
+    // Write configuration to start conversion
+    esp_err_t ret = ads1115_write_reg(dev, ADS1115_REG_CONFIG, config_reg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write config register: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ads1115_set_active(dev, ch);
+    
+#if CONFIG_ADS1115_VERIFY_CONFIG
+    ads1115_verify_config(dev, config_reg);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t ads1115_wait_conversion(ads1115_handle_t *dev)
+{
+    if (!dev || !dev->initialized) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // Allow for the +/-10% internal oscillator tolerance
+    uint32_t conv_us = ads1115_conversion_time_us(dev->active_rate) * 11 / 10;
+    
+    if (ads1115_rdy_active(dev)) {
+        // Wait for the ALERT/RDY pulse
+        TickType_t timeout_ticks = pdMS_TO_TICKS(conv_us / 1000 + 1) + 1;
+        if (xSemaphoreTake(dev->rdy_sem, timeout_ticks) != pdTRUE) {
+            ESP_LOGE(TAG, "Timed out waiting for ALERT/RDY");
+            return ESP_ERR_TIMEOUT;
+        }
+        return ESP_OK;
+    }
     
-    // Wait for conversion to complete using fixed delay
-    // Calculate delay based on data rate with sufficient margin for reliability
-    uint32_t delay_ms;
-    switch (dev->config.data_rate) {
-        case ADS1115_DR_8SPS:   delay_ms = 130; break;  // ~125ms theoretical + margin
-        case ADS1115_DR_16SPS:  delay_ms = 70;  break;  // ~62.5ms theoretical + margin
-        case ADS1115_DR_32SPS:  delay_ms = 35;  break;  // ~31.25ms theoretical + margin
-        case ADS1115_DR_64SPS:  delay_ms = 20;  break;  // ~15.6ms theoretical + margin
-        case ADS1115_DR_128SPS: delay_ms = 10;  break;  // ~7.8ms theoretical + margin
-        case ADS1115_DR_250SPS: delay_ms = 5;   break;  // ~4ms theoretical + margin
-        case ADS1115_DR_475SPS: delay_ms = 3;   break;  // ~2.1ms theoretical + margin
-        case ADS1115_DR_860SPS: delay_ms = 2;   break;  // ~1.16ms theoretical + margin
-        default:                delay_ms = 10;  break;
+    // No ready signal: sleep until the conversion must be done. A one-shot esp_timer keeps
+    // sub-tick conversions (860 SPS is ~1.2 ms) from rounding down to a zero-tick delay.
+    int64_t remaining_us = dev->conv_start_us + conv_us + ADS1115_WAIT_MARGIN_US - esp_timer_get_time();
+    if (remaining_us <= 0) {
+        return ESP_OK;
     }
     
-    ESP_LOGD(TAG, "Waiting %u ms for conversion to complete", (unsigned)delay_ms);
-    vTaskDelay(pdMS_TO_TICKS(delay_ms));
+    ESP_LOGD(TAG, "Waiting %u us for conversion to complete", (unsigned)remaining_us);
+    xSemaphoreTake(dev->rdy_sem, 0);
+    esp_err_t ret = esp_timer_start_once(dev->wait_timer, remaining_us);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (xSemaphoreTake(dev->rdy_sem, pdMS_TO_TICKS(ADS1115_TIMEOUT_MS)) != pdTRUE) {
+        esp_timer_stop(dev->wait_timer);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ads1115_read_conversion(ads1115_handle_t *dev, int16_t *raw_value, uint16_t *gain)
+{
+    if (!dev || !dev->initialized || !raw_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    // Read conversion result
-    ret = ads1115_read_reg(dev, ADS1115_REG_CONVERSION, &conversion_reg);
+    uint16_t conversion_reg;
+    esp_err_t ret = ads1115_read_reg(dev, ADS1115_REG_CONVERSION, &conversion_reg);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to read conversion register: %s", esp_err_to_name(ret));
         return ret;
     }
     
     *raw_value = (int16_t)conversion_reg;
+    ads1115_finish_active(dev, *raw_value, gain);
     ESP_LOGD(TAG, "Conversion successful: raw=0x%04X (%d)", conversion_reg, *raw_value);
     return ESP_OK;
 }
 
+esp_err_t ads1115_read_and_start(ads1115_handle_t *dev, ads1115_channel_t *next, int16_t *raw_value, uint16_t *gain)
+{
+    if (!dev || !dev->initialized || !next || !raw_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    // The conversion register keeps result N until conversion N+1 finishes, so start N+1 first
+    // and read N right behind it. Async devices queue both transfers back to back.
+    ads1115_apply_window(dev, next);
+    uint16_t config_reg = ads1115_build_config(dev, next);
+    ads1115_channel_t *done_ch = dev->active_ch;
+    uint16_t done_gain = dev->active_gain;
+
+    int64_t start_us = esp_timer_get_time();
+    int pending = 0;
+    
+    esp_err_t ret = ads1115_queue_write_reg(dev, ADS1115_REG_CONFIG, config_reg);
+    if (ret == ESP_OK) {
+        pending++;
+        ret = ads1115_queue_read_reg(dev, ADS1115_REG_CONVERSION);
+        if (ret == ESP_OK) {
+            pending++;
+        }
+    }
+    
+    esp_err_t wait_ret = ads1115_i2c_wait(dev, pending);
+    ads1115_stats_record(dev, pending, start_us);
+    if (ret == ESP_OK) {
+        ret = wait_ret;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Pipelined read/start failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    *raw_value = (int16_t)(((uint16_t)dev->rx_buf[0] << 8) | dev->rx_buf[1]);
+    dev->active_ch = done_ch;
+    dev->active_gain = done_gain;
+    ads1115_finish_active(dev, *raw_value, gain);
+    ads1115_set_active(dev, next);  // Stamped after the pair completed, so the wait errs long
+    
+#if CONFIG_ADS1115_VERIFY_CONFIG
+    ads1115_verify_config(dev, config_reg);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t ads1115_read_single(ads1115_handle_t *dev, uint16_t mux, int16_t *raw_value)
+{
+    if (!dev || !dev->initialized || !raw_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    dev->single_ch.mux = mux;
+    dev->single_ch.gain = dev->config.gain;
+    dev->single_ch.auto_range = false;
+    dev->single_ch.data_rate = 0;
+    
+    esp_err_t ret = ads1115_start_conversion(dev, &dev->single_ch);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    ret = ads1115_wait_conversion(dev);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    return ads1115_read_conversion(dev, raw_value, NULL);
+}
+
+esp_err_t ads1115_enable_window(ads1115_handle_t *dev, const ads1115_window_config_t *config, int32_t lo_uv, int32_t hi_uv)
+{
+    if (!dev || !dev->initialized || !config || !config->on_trip || lo_uv >= hi_uv) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&dev->window.lock);
+    dev->window.mux = config->mux;
+    dev->window.on_trip = config->on_trip;
+    dev->window.arg = config->arg;
+    dev->window.lo_uv = lo_uv;
+    dev->window.hi_uv = hi_uv;
+    dev->window.dirty = true;
+    dev->window.gen++;
+    dev->window.enabled = true;
+    portEXIT_CRITICAL(&dev->window.lock);
+    
+    ESP_LOGI(TAG, "Window %s on mux 0x%04X: %" PRId32 "..%" PRId32 " uV",
+             dev->config.use_alert_rdy ? "comparator" : "check per reading", config->mux, lo_uv, hi_uv);
+    return ESP_OK;
+}
+
+void ads1115_set_window(ads1115_handle_t *dev, int32_t lo_uv, int32_t hi_uv)
+{
+    portENTER_CRITICAL(&dev->window.lock);
+    if (dev->window.lo_uv != lo_uv || dev->window.hi_uv != hi_uv) {
+        dev->window.lo_uv = lo_uv;
+        dev->window.hi_uv = hi_uv;
+        dev->window.dirty = true;
+        dev->window.gen++;
+    }
+    portEXIT_CRITICAL(&dev->window.lock);
+}
+
+bool ads1115_window_loaded(ads1115_handle_t *dev)
+{
+    portENTER_CRITICAL(&dev->window.lock);
+    bool loaded = !dev->window.enabled || dev->window.loaded_gen == dev->window.gen;
+    portEXIT_CRITICAL(&dev->window.lock);
+    return loaded;
+}
+
+void ads1115_get_stats(ads1115_handle_t *dev, ads1115_stats_t *stats)
+{
+    *stats = dev->stats;
+}
+
+void ads1115_reset_stats(ads1115_handle_t *dev)
+{
+    memset(&dev->stats, 0, sizeof(dev->stats));
+}
+
 esp_err_t ads1115_read_voltage(ads1115_handle_t *dev, uint16_t mux, float *voltage)
 {
     if (!voltage) {
@@ -145,20 +665,18 @@ esp_err_t ads1115_read_voltage(ads1115_handle_t *dev, uint16_t mux, float *volta
     return ESP_OK;
 }
 
-float ads1115_raw_to_voltage(int16_t raw_value, uint16_t gain)
+uint32_t ads1115_conversion_time_us(uint16_t data_rate)
 {
-    float lsb_size;
-    
-    // Determine LSB size based on gain setting
-    switch (gain) {
-        case ADS1115_PGA_6_144V: lsb_size = 0.1875f; break;  // mV per LSB
-        case ADS1115_PGA_4_096V: lsb_size = 0.125f;  break;
-        case ADS1115_PGA_2_048V: lsb_size = 0.0625f; break;
-        case ADS1115_PGA_1_024V: lsb_size = 0.03125f; break;
-        case ADS1115_PGA_0_512V: lsb_size = 0.015625f; break;
-        case ADS1115_PGA_0_256V: lsb_size = 0.0078125f; break;
-        default:                 lsb_size = 0.125f;   break;  // Default to 4.096V range
+    // Nominal conversion period (1 / data rate)
+    switch (data_rate) {
+        case ADS1115_DR_8SPS:   return 125000;
+        case ADS1115_DR_16SPS:  return 62500;
+        case ADS1115_DR_32SPS:  return 31250;
+        case ADS1115_DR_64SPS:  return 15625;
+        case ADS1115_DR_128SPS: return 7813;
+        case ADS1115_DR_250SPS: return 4000;
+        case ADS1115_DR_475SPS: return 2106;
+        case ADS1115_DR_860SPS: return 1163;
+        default:                return 7813;
     }
-    
-    return (float)raw_value * lsb_size;  // Returns voltage in mV
 }
\ No newline at end of file
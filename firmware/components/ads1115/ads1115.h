@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include "esp_err.h"
 #include "driver/i2c_master.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "ads1115_convert.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,6 +19,8 @@ extern "C" {
 #define ADS1115_I2C_ADDR_SDA        0x4A
 #define ADS1115_I2C_ADDR_SCL        0x4B
 
+#define ADS1115_SCL_SPEED_DEFAULT   100000  // Standard mode; the chip also supports 400kHz fast mode
+
 #define ADS1115_REG_CONVERSION      0x00
 #define ADS1115_REG_CONFIG          0x01
 #define ADS1115_REG_LO_THRESH       0x02
@@ -34,13 +41,9 @@ extern "C" {
 #define ADS1115_MUX_SINGLE_2        0x6000  // Single-ended AIN2
 #define ADS1115_MUX_SINGLE_3        0x7000  // Single-ended AIN3
 
-// Gain amplifier configuration
-#define ADS1115_PGA_6_144V          0x0000  // +/-6.144V range = Gain 2/3
-#define ADS1115_PGA_4_096V          0x0200  // +/-4.096V range = Gain 1 (default)
-#define ADS1115_PGA_2_048V          0x0400  // +/-2.048V range = Gain 2
-#define ADS1115_PGA_1_024V          0x0600  // +/-1.024V range = Gain 4
-#define ADS1115_PGA_0_512V          0x0800  // +/-0.512V range = Gain 8
-#define ADS1115_PGA_0_256V          0x0A00  // +/-0.256V range = Gain 16
+// Auto-ranging keeps |raw| between these bounds
+#define ADS1115_AUTO_RANGE_HIGH     29491   // ~90% of full scale: widen
+#define ADS1115_AUTO_RANGE_LOW      13107   // ~40% of full scale: narrow
 
 // Data rate
 #define ADS1115_DR_8SPS             0x0000  // 8 samples per second
@@ -70,22 +73,105 @@ extern "C" {
 #define ADS1115_CQUE_4CONV          0x0002  // Assert ALERT/RDY after four conversions
 #define ADS1115_CQUE_NONE           0x0003  // Disable the comparator and put ALERT/RDY in high state (default)
 
+// Threshold values that turn ALERT/RDY into a conversion-ready pin (Hi_thresh MSB = 1, Lo_thresh MSB = 0)
+#define ADS1115_RDY_LO_THRESH       0x0000
+#define ADS1115_RDY_HI_THRESH       0x8000
+
 typedef struct {
     uint8_t addr;
     uint16_t gain;
     uint16_t data_rate;
+    bool use_alert_rdy;         // Wait on the ALERT/RDY interrupt instead of a fixed delay; cleared
+                                // by ads1115_init() if no edge arrives on alert_gpio
+    gpio_num_t alert_gpio;      // GPIO wired to ALERT/RDY (only used when use_alert_rdy is set)
+    uint32_t scl_speed_hz;      // I2C clock, 0 for ADS1115_SCL_SPEED_DEFAULT
+    bool async;                 // Use i2c_master event callbacks (bus needs trans_queue_depth > 0)
 } ads1115_config_t;
 
+typedef struct {
+    uint32_t transactions;      // I2C transactions issued
+    uint32_t samples;           // Conversion results read
+    uint64_t i2c_time_us;       // Total time spent waiting on I2C
+    uint32_t max_i2c_time_us;   // Longest single I2C call (or pipelined pair)
+} ads1115_stats_t;
+
+// Per-input conversion settings
+typedef struct {
+    uint16_t mux;               // ADS1115_MUX_*
+    uint16_t gain;              // ADS1115_PGA_*; updated in place when auto_range is set
+    bool auto_range;            // Re-pick the PGA after every conversion of this input
+    uint16_t data_rate;         // ADS1115_DR_* for this input, 0 for the device default
+} ads1115_channel_t;
+
+// Called when the window trips: from the ALERT/RDY ISR, or from the task reading the
+// conversion on a device without ALERT/RDY. Must be IRAM-safe and work in both contexts.
+typedef void (*ads1115_trip_cb_t)(void *arg);
+
+typedef struct {
+    uint16_t mux;               // Input the window applies to, e.g. ADS1115_MUX_DIFF_0_1
+    ads1115_trip_cb_t on_trip;
+    void *arg;
+} ads1115_window_config_t;
+
 typedef struct {
     ads1115_config_t config;
     i2c_master_dev_handle_t i2c_dev_handle;
+    SemaphoreHandle_t rdy_sem;  // Given when a conversion completes (ALERT/RDY ISR or wait timer)
+    SemaphoreHandle_t i2c_done_sem;  // Given from the I2C ISR per finished async transaction
+    volatile bool i2c_error;
+    uint8_t tx_buf[3];          // Transfer buffers must outlive async transactions
+    uint8_t reg_ptr;
+    uint8_t rx_buf[2];
+    ads1115_stats_t stats;
+    ads1115_channel_t *active_ch;   // Conversion currently in flight
+    uint16_t active_gain;           // PGA that conversion was started with
+    uint16_t active_rate;           // Data rate that conversion was started with
+    int64_t conv_start_us;          // When that conversion was started
+    esp_timer_handle_t wait_timer;  // Wakes the waiter when there is no ALERT/RDY signal
+    ads1115_channel_t single_ch;    // Scratch channel for ads1115_read_single()
+    struct {
+        volatile bool enabled;
+        uint16_t mux;
+        ads1115_trip_cb_t on_trip;
+        void *arg;
+        portMUX_TYPE lock;
+        int32_t lo_uv;              // Thresholds in uV, re-scaled to the active PGA
+        int32_t hi_uv;
+        bool dirty;                 // Thresholds not yet written to the chip
+        uint32_t gen;               // Bumped by every threshold change
+        volatile uint32_t loaded_gen;   // Generation in force for conversions started since
+        int16_t next_lo, next_hi;   // Software check: codes for the conversion being started
+        int16_t active_lo, active_hi;   // and for the one in flight
+        uint16_t loaded_gain;       // PGA the chip's thresholds were computed for
+        volatile uint32_t trips;
+    } window;
     bool initialized;
 } ads1115_handle_t;
 
 esp_err_t ads1115_init(ads1115_handle_t *dev, const ads1115_config_t *config, i2c_master_bus_handle_t bus_handle);
 esp_err_t ads1115_read_single(ads1115_handle_t *dev, uint16_t mux, int16_t *raw_value);
+// Pipelined per-channel path. gain (optional) receives the PGA the returned result was taken at.
+esp_err_t ads1115_start_conversion(ads1115_handle_t *dev, ads1115_channel_t *ch);
+esp_err_t ads1115_wait_conversion(ads1115_handle_t *dev);
+esp_err_t ads1115_read_conversion(ads1115_handle_t *dev, int16_t *raw_value, uint16_t *gain);
+esp_err_t ads1115_read_and_start(ads1115_handle_t *dev, ads1115_channel_t *next, int16_t *raw_value, uint16_t *gain);
+// Hardware over/undercurrent watchdog: ALERT/RDY switches from conversion-ready to a
+// window comparator on one input. Thresholds are written by the sampling task before its
+// next conversion, so ads1115_set_window() is safe to call from any task. Without
+// ALERT/RDY each reading of the input is checked against the window as it is read.
+// The pin cannot do both jobs: once the window is on, every conversion on the device is
+// timed. The firmware arms it at boot on the only device with ALERT/RDY, so there
+// conversion-ready only serves the boot self-test.
+esp_err_t ads1115_enable_window(ads1115_handle_t *dev, const ads1115_window_config_t *config, int32_t lo_uv, int32_t hi_uv);
+void ads1115_set_window(ads1115_handle_t *dev, int32_t lo_uv, int32_t hi_uv);
+// True once the thresholds of the last ads1115_set_window() are in force: every conversion
+// of the input that finishes from then on is judged against them, in hardware or software.
+// Widen the window and wait for this before raising the current; narrow it after lowering.
+bool ads1115_window_loaded(ads1115_handle_t *dev);
+void ads1115_get_stats(ads1115_handle_t *dev, ads1115_stats_t *stats);
+void ads1115_reset_stats(ads1115_handle_t *dev);
 esp_err_t ads1115_read_voltage(ads1115_handle_t *dev, uint16_t mux, float *voltage);
-float ads1115_raw_to_voltage(int16_t raw_value, uint16_t gain);
+uint32_t ads1115_conversion_time_us(uint16_t data_rate);
 
 #ifdef __cplusplus
 }
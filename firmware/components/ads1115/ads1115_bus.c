@@ -0,0 +1,194 @@
+#include "ads1115_bus.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "ADS1115_BUS";
+
+esp_err_t ads1115_bus_add_device(ads1115_bus_t *bus, ads1115_handle_t *dev)
+{
+    if (!bus || !dev || !dev->initialized) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (bus->num_devices >= ADS1115_BUS_MAX_DEVICES) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    bus->devs[bus->num_devices++] = dev;
+    ESP_LOGI(TAG, "Added ADS1115 0x%02x (%u on bus)", dev->config.addr, (unsigned)bus->num_devices);
+    return ESP_OK;
+}
+
+static bool ads1115_bus_schedule_valid(const uint8_t *decimation, size_t num_channels)
+{
+    // At least one channel must run every scan so no scan is empty
+    for (size_t i = 0; i < num_channels; i++) {
+        if (decimation[i] <= 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ads1115_bus_sort(ads1115_bus_t *bus)
+{
+    // Stable insertion sort, highest priority first; ties keep channel order
+    for (size_t i = 0; i < bus->num_channels; i++) {
+        bus->order[i] = i;
+    }
+    for (size_t i = 1; i < bus->num_channels; i++) {
+        uint8_t idx = bus->order[i];
+        size_t j = i;
+        while (j > 0 && bus->priority[bus->order[j - 1]] < bus->priority[idx]) {
+            bus->order[j] = bus->order[j - 1];
+            j--;
+        }
+        bus->order[j] = idx;
+    }
+}
+
+esp_err_t ads1115_bus_set_channels(ads1115_bus_t *bus, const ads1115_bus_channel_t *channels, size_t num_channels)
+{
+    if (!bus || !channels || num_channels == 0 || num_channels > ADS1115_BUS_MAX_MUX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    uint8_t decimation[ADS1115_BUS_MAX_MUX];
+    for (size_t i = 0; i < num_channels; i++) {
+        decimation[i] = channels[i].decimation;
+    }
+    if (!ads1115_bus_schedule_valid(decimation, num_channels)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    for (size_t i = 0; i < num_channels; i++) {
+        for (size_t d = 0; d < ADS1115_BUS_MAX_DEVICES; d++) {
+            bus->channels[d][i] = channels[i].ch;
+        }
+        bus->decimation[i] = channels[i].decimation;
+        bus->priority[i] = channels[i].priority;
+    }
+    bus->num_channels = num_channels;
+    bus->scan_count = 0;
+    ads1115_bus_sort(bus);
+    return ESP_OK;
+}
+
+esp_err_t ads1115_bus_set_schedule(ads1115_bus_t *bus, size_t index, uint8_t decimation,
+                                   uint8_t priority, uint16_t data_rate)
+{
+    if (!bus || index >= bus->num_channels) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    uint8_t new_decimation[ADS1115_BUS_MAX_MUX];
+    for (size_t i = 0; i < bus->num_channels; i++) {
+        new_decimation[i] = bus->decimation[i];
+    }
+    new_decimation[index] = decimation;
+    if (!ads1115_bus_schedule_valid(new_decimation, bus->num_channels)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    bus->decimation[index] = decimation;
+    bus->priority[index] = priority;
+    for (size_t d = 0; d < ADS1115_BUS_MAX_DEVICES; d++) {
+        bus->channels[d][index].data_rate = data_rate;
+    }
+    ads1115_bus_sort(bus);
+    
+    ESP_LOGI(TAG, "Channel %u: every %u scans, priority %u, rate 0x%04X",
+             (unsigned)index, decimation ? decimation : 1, priority, data_rate);
+    return ESP_OK;
+}
+
+// Channel indices converted on a given scan, in priority order
+static size_t ads1115_bus_steps(const ads1115_bus_t *bus, uint32_t scan, uint8_t *steps)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < bus->num_channels; i++) {
+        uint8_t idx = bus->order[i];
+        uint8_t decimation = bus->decimation[idx];
+        if (decimation <= 1 || scan % decimation == 0) {
+            steps[n++] = idx;
+        }
+    }
+    return n;
+}
+
+esp_err_t ads1115_bus_scan(ads1115_bus_t *bus, int16_t raw[][ADS1115_BUS_MAX_MUX],
+                           uint16_t gain[][ADS1115_BUS_MAX_MUX], uint32_t updated_mask[],
+                           int64_t *timestamp_us)
+{
+    if (!bus || !raw || !gain) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (bus->num_devices == 0 || bus->num_channels == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    esp_err_t result = ESP_OK;
+    uint8_t steps[ADS1115_BUS_MAX_MUX];
+    uint8_t next_steps[ADS1115_BUS_MAX_MUX];
+    size_t num_steps = ads1115_bus_steps(bus, bus->scan_count, steps);
+    ads1115_bus_steps(bus, bus->scan_count + 1, next_steps);
+    uint32_t mask[ADS1115_BUS_MAX_DEVICES] = {0};
+    
+    // The previous scan already started this scan's first channel. If nothing is in flight yet,
+    // or the schedule changed underneath it, let the stray conversion finish and start over.
+    for (size_t d = 0; d < bus->num_devices; d++) {
+        ads1115_handle_t *dev = bus->devs[d];
+        ads1115_channel_t *first = &bus->channels[d][steps[0]];
+        if (dev->active_ch == first) {
+            continue;
+        }
+        if (dev->active_ch) {
+            ads1115_wait_conversion(dev);
+        }
+        esp_err_t ret = ads1115_start_conversion(dev, first);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start conversion on 0x%02x: %s", dev->config.addr, esp_err_to_name(ret));
+        }
+    }
+    
+    for (size_t step = 0; step < num_steps; step++) {
+        uint8_t idx = steps[step];
+        // Chain into the first channel of the next scan so the pipeline never drains
+        uint8_t next_idx = step + 1 < num_steps ? steps[step + 1] : next_steps[0];
+        
+        // Devices were started microseconds apart, so by the time the first one has been
+        // read the rest are usually already done and their waits return immediately
+        for (size_t d = 0; d < bus->num_devices; d++) {
+            ads1115_handle_t *dev = bus->devs[d];
+            ads1115_channel_t *next_ch = &bus->channels[d][next_idx];
+            int16_t value;
+            uint16_t value_gain;
+            esp_err_t ret = ads1115_wait_conversion(dev);
+            if (ret == ESP_OK) {
+                ret = ads1115_read_and_start(dev, next_ch, &value, &value_gain);
+            }
+            if (ret == ESP_OK) {
+                raw[d][idx] = value;
+                gain[d][idx] = value_gain;
+                mask[d] |= 1u << idx;
+            } else {
+                // The previous value stays, unflagged, so nothing mistakes it for a reading
+                ESP_LOGE(TAG, "Failed to read 0x%02x channel %u: %s",
+                         dev->config.addr, (unsigned)idx, esp_err_to_name(ret));
+                result = ret;
+                // Restart this device's pipeline on the next step
+                ads1115_start_conversion(dev, next_ch);
+            }
+        }
+    }
+    
+    bus->scan_count++;
+    if (updated_mask) {
+        for (size_t d = 0; d < bus->num_devices; d++) {
+            updated_mask[d] = mask[d];
+        }
+    }
+    if (timestamp_us) {
+        *timestamp_us = esp_timer_get_time();
+    }
+    return result;
+}
@@ -0,0 +1,59 @@
+#ifndef ADS1115_BUS_H
+#define ADS1115_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "ads1115.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADS1115_BUS_MAX_DEVICES     4   // One per address pin strap
+#define ADS1115_BUS_MAX_MUX         8   // Channels per device
+
+// A channel plus its place in the scan schedule
+typedef struct {
+    ads1115_channel_t ch;
+    uint8_t decimation;         // Convert on every Nth scan (0 or 1 = every scan)
+    uint8_t priority;           // Higher priorities are converted earlier within a scan
+} ads1115_bus_channel_t;
+
+// Scheduler for several ADS1115s sharing one I2C bus.
+// All devices convert the same channel in parallel, so while one device is busy on I2C
+// the others are converting; a scan costs roughly one conversion time per step
+// instead of one per device per step. Decimated channels are skipped on most scans,
+// leaving the conversion budget to the fast ones.
+typedef struct {
+    ads1115_handle_t *devs[ADS1115_BUS_MAX_DEVICES];
+    size_t num_devices;
+    // Each device keeps its own copy of the channel list so auto-ranging tracks per device
+    ads1115_channel_t channels[ADS1115_BUS_MAX_DEVICES][ADS1115_BUS_MAX_MUX];
+    uint8_t decimation[ADS1115_BUS_MAX_MUX];
+    uint8_t priority[ADS1115_BUS_MAX_MUX];
+    uint8_t order[ADS1115_BUS_MAX_MUX];     // Channel indices sorted by priority
+    size_t num_channels;
+    uint32_t scan_count;
+} ads1115_bus_t;
+
+esp_err_t ads1115_bus_add_device(ads1115_bus_t *bus, ads1115_handle_t *dev);
+esp_err_t ads1115_bus_set_channels(ads1115_bus_t *bus, const ads1115_bus_channel_t *channels, size_t num_channels);
+
+// Change one channel's schedule. Call from the scanning task between scans.
+esp_err_t ads1115_bus_set_schedule(ads1115_bus_t *bus, size_t index, uint8_t decimation,
+                                   uint8_t priority, uint16_t data_rate);
+
+// Run one scan. raw and gain are indexed [device][channel index] and only written for
+// channels read successfully this scan, which are flagged in updated_mask[device]
+// (bit = channel index). A failed read leaves the previous value and clears its bit.
+// timestamp_us is one shared completion time for all devices in the scan.
+esp_err_t ads1115_bus_scan(ads1115_bus_t *bus, int16_t raw[][ADS1115_BUS_MAX_MUX],
+                           uint16_t gain[][ADS1115_BUS_MAX_MUX], uint32_t updated_mask[],
+                           int64_t *timestamp_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADS1115_BUS_H
@@ -0,0 +1,72 @@
+#include "ads1115_convert.h"
+
+void ads1115_scale_init(ads1115_scale_t *scale, uint32_t div_num, uint32_t div_den)
+{
+    if (div_den == 0) {
+        div_num = div_den = 1;
+    }
+    for (int idx = 0; idx <= ADS1115_PGA_INDEX_MAX; idx++) {
+        // uV per LSB is FSR / 32768; in Q16 that is FSR * 2
+        int64_t q16 = (int64_t)ads1115_fsr_uv(ads1115_pga_from_index(idx)) * 2 * div_num;
+        scale->scale_q16[idx] = (int32_t)((q16 + div_den / 2) / div_den);
+    }
+}
+
+void ads1115_raw_to_uv_batch(const ads1115_scale_t *scale, const int16_t *raw, const uint16_t *gain,
+                             uint16_t gain_default, int32_t *uv, size_t n)
+{
+    if (!gain) {
+        const int64_t k = scale->scale_q16[ads1115_pga_index(gain_default)];
+        for (size_t i = 0; i < n; i++) {
+            uv[i] = (int32_t)(((int64_t)raw[i] * k + (1 << 15)) >> 16);
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        uv[i] = ads1115_scale_apply(scale, raw[i], gain[i]);
+    }
+}
+
+float ads1115_raw_to_voltage(int16_t raw_value, uint16_t gain)
+{
+    float lsb_size;
+    
+    // Determine LSB size based on gain setting
+    switch (gain) {
+        case ADS1115_PGA_6_144V: lsb_size = 0.1875f; break;  // mV per LSB
+        case ADS1115_PGA_4_096V: lsb_size = 0.125f;  break;
+        case ADS1115_PGA_2_048V: lsb_size = 0.0625f; break;
+        case ADS1115_PGA_1_024V: lsb_size = 0.03125f; break;
+        case ADS1115_PGA_0_512V: lsb_size = 0.015625f; break;
+        case ADS1115_PGA_0_256V: lsb_size = 0.0078125f; break;
+        default:                 lsb_size = 0.125f;   break;  // Default to 4.096V range
+    }
+    
+    return (float)raw_value * lsb_size;  // Returns voltage in mV
+}
+
+int32_t ads1115_fsr_uv(uint16_t gain)
+{
+    switch (gain) {
+        case ADS1115_PGA_6_144V: return 6144000;
+        case ADS1115_PGA_4_096V: return 4096000;
+        case ADS1115_PGA_2_048V: return 2048000;
+        case ADS1115_PGA_1_024V: return 1024000;
+        case ADS1115_PGA_0_512V: return 512000;
+        default:                 return 256000;  // 0x0A00-0x0E00 are all +/-0.256V
+    }
+}
+
+int32_t ads1115_raw_to_uv(int16_t raw_value, uint16_t gain)
+{
+    return (int32_t)(((int64_t)raw_value * ads1115_fsr_uv(gain)) / 32768);
+}
+
+int16_t ads1115_uv_to_raw(int32_t uv, uint16_t gain)
+{
+    int64_t raw = (int64_t)uv * 32768 / ads1115_fsr_uv(gain);
+    if (raw > INT16_MAX) return INT16_MAX;
+    if (raw < INT16_MIN) return INT16_MIN;
+    return (int16_t)raw;
+}
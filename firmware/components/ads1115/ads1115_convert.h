@@ -0,0 +1,62 @@
+#ifndef ADS1115_CONVERT_H
+#define ADS1115_CONVERT_H
+
+// Raw-to-voltage conversion. No IDF dependencies so it also builds on the host (see bench/).
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Gain amplifier configuration
+#define ADS1115_PGA_6_144V          0x0000  // +/-6.144V range = Gain 2/3
+#define ADS1115_PGA_4_096V          0x0200  // +/-4.096V range = Gain 1 (default)
+#define ADS1115_PGA_2_048V          0x0400  // +/-2.048V range = Gain 2
+#define ADS1115_PGA_1_024V          0x0600  // +/-1.024V range = Gain 4
+#define ADS1115_PGA_0_512V          0x0800  // +/-0.512V range = Gain 8
+#define ADS1115_PGA_0_256V          0x0A00  // +/-0.256V range = Gain 16
+#define ADS1115_PGA_INDEX_MAX       5       // PGA field index of the narrowest range
+
+// Board-referenced microvolts per LSB for each PGA range, Q16 fixed point, with an
+// input divider folded in. Build once per divider, then convert without floats.
+typedef struct {
+    int32_t scale_q16[ADS1115_PGA_INDEX_MAX + 1];
+} ads1115_scale_t;
+
+static inline int ads1115_pga_index(uint16_t gain)
+{
+    int idx = (gain >> 9) & 0x07;
+    return idx > ADS1115_PGA_INDEX_MAX ? ADS1115_PGA_INDEX_MAX : idx;
+}
+
+static inline uint16_t ads1115_pga_from_index(int idx)
+{
+    return (uint16_t)(idx << 9);
+}
+
+// Divider ratio is input/ADC, e.g. 49/10 for 39k over 10k. Keep it under ~35 so the
+// widest range still fits in int32 microvolts.
+void ads1115_scale_init(ads1115_scale_t *scale, uint32_t div_num, uint32_t div_den);
+
+static inline int32_t ads1115_scale_apply(const ads1115_scale_t *scale, int16_t raw_value, uint16_t gain)
+{
+    int64_t uv = (int64_t)raw_value * scale->scale_q16[ads1115_pga_index(gain)];
+    return (int32_t)((uv + (1 << 15)) >> 16);
+}
+
+// Convert n samples to microvolts. gain may be NULL when every sample uses gain_default.
+void ads1115_raw_to_uv_batch(const ads1115_scale_t *scale, const int16_t *raw, const uint16_t *gain,
+                             uint16_t gain_default, int32_t *uv, size_t n);
+
+float ads1115_raw_to_voltage(int16_t raw_value, uint16_t gain);
+int32_t ads1115_fsr_uv(uint16_t gain);
+int32_t ads1115_raw_to_uv(int16_t raw_value, uint16_t gain);
+int16_t ads1115_uv_to_raw(int32_t uv, uint16_t gain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADS1115_CONVERT_H
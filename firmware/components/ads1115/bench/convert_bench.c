@@ -0,0 +1,75 @@
+// Host benchmark: per-sample float conversion vs the fixed-point batch path.
+//
+//   cc -O2 -I.. convert_bench.c ../ads1115_convert.c -o convert_bench && ./convert_bench
+//
+// On target the float path also costs an FPU context save and pins the task to a core.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ads1115_convert.h"
+
+#define NUM_SAMPLES     4096
+#define NUM_ROUNDS      2000
+
+static int16_t raw[NUM_SAMPLES];
+static uint16_t gain[NUM_SAMPLES];
+static float out_float[NUM_SAMPLES];
+static int32_t out_uv[NUM_SAMPLES];
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// What the sampler consumers did before: float mV per sample, then the divider
+static void convert_float(float ratio)
+{
+    for (size_t i = 0; i < NUM_SAMPLES; i++) {
+        out_float[i] = ads1115_raw_to_voltage(raw[i], gain[i]) * ratio;
+    }
+}
+
+int main(void)
+{
+    ads1115_scale_t scale;
+    ads1115_scale_init(&scale, 49, 10);  // 39k/10k load divider
+    const float ratio = 49.0f / 10.0f;
+
+    srand(1);
+    for (size_t i = 0; i < NUM_SAMPLES; i++) {
+        raw[i] = (int16_t)(rand() % 65536 - 32768);
+        gain[i] = ads1115_pga_from_index(rand() % (ADS1115_PGA_INDEX_MAX + 1));
+    }
+
+    double t0 = now_s();
+    for (int r = 0; r < NUM_ROUNDS; r++) {
+        convert_float(ratio);
+        __asm__ volatile("" ::: "memory");
+    }
+    double t_float = now_s() - t0;
+
+    t0 = now_s();
+    for (int r = 0; r < NUM_ROUNDS; r++) {
+        ads1115_raw_to_uv_batch(&scale, raw, gain, 0, out_uv, NUM_SAMPLES);
+        __asm__ volatile("" ::: "memory");
+    }
+    double t_fixed = now_s() - t0;
+
+    // Accuracy against a double reference
+    double max_err_uv = 0;
+    for (size_t i = 0; i < NUM_SAMPLES; i++) {
+        double ref = (double)raw[i] * ads1115_fsr_uv(gain[i]) / 32768.0 * 49.0 / 10.0;
+        double err = out_uv[i] - ref;
+        if (err < 0) err = -err;
+        if (err > max_err_uv) max_err_uv = err;
+    }
+
+    double n = (double)NUM_SAMPLES * NUM_ROUNDS;
+    printf("float per-sample: %6.2f ns/sample\n", t_float / n * 1e9);
+    printf("fixed batch:      %6.2f ns/sample\n", t_fixed / n * 1e9);
+    printf("max error vs double: %.2f uV\n", max_err_uv);
+    return 0;
+}
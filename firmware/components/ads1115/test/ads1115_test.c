@@ -0,0 +1,422 @@
+// Host tests for the driver against simulated ADS1115s (mock/): threshold programming for
+// conversion-ready, waiting on the ALERT/RDY edge, the timeout when no edge comes, the
+// boot-time fallback to timed waits, the current watchdog's window trips, and the bus
+// scheduler's handling of a device that stops answering.
+//
+//   cc -O2 -Imock -I.. ads1115_test.c mock/ads1115_mock.c ../ads1115.c ../ads1115_bus.c ../ads1115_convert.c -o ads1115_test && ./ads1115_test
+
+#include <stdio.h>
+#include <string.h>
+#include "ads1115.h"
+#include "ads1115_bus.h"
+#include "ads1115_mock.h"
+#include "esp_timer.h"
+
+#define ALERT_GPIO  GPIO_NUM_4
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static mock_ads1115_t *setup(ads1115_handle_t *dev, bool wired, bool use_alert_rdy, bool async)
+{
+    mock_reset();
+    memset(dev, 0, sizeof(*dev));
+    mock_ads1115_t *chip = mock_ads1115_add(ADS1115_I2C_ADDR_DEFAULT, ALERT_GPIO, wired);
+    chip->input_uv[ADS1115_MUX_SINGLE_0 >> 12] = 1000000;
+    ads1115_config_t config = {
+        .addr = ADS1115_I2C_ADDR_DEFAULT,
+        .gain = ADS1115_PGA_4_096V,
+        .data_rate = ADS1115_DR_860SPS,
+        .use_alert_rdy = use_alert_rdy,
+        .alert_gpio = ALERT_GPIO,
+        .async = async,
+    };
+    CHECK(ads1115_init(dev, &config, mock_bus()) == ESP_OK);
+    return chip;
+}
+
+static void test_rdy_thresholds(void)
+{
+    ads1115_handle_t dev;
+    mock_ads1115_t *chip = setup(&dev, true, true, false);
+
+    // Hi_thresh MSB set, Lo_thresh MSB clear: ALERT/RDY pulses at the end of each conversion
+    CHECK(chip->reg[ADS1115_REG_LO_THRESH] == ADS1115_RDY_LO_THRESH);
+    CHECK(chip->reg[ADS1115_REG_HI_THRESH] == ADS1115_RDY_HI_THRESH);
+    CHECK(mock_gpio_has_handler(ALERT_GPIO));
+    // The boot self-test saw its edge and kept the interrupt path
+    CHECK(dev.config.use_alert_rdy);
+    CHECK(chip->conversions == 1 && chip->alert_edges == 1);
+    CHECK(mock_log_count('W') == 0 && mock_log_count('E') == 0);
+
+    int16_t raw;
+    CHECK(ads1115_read_single(&dev, ADS1115_MUX_SINGLE_1, &raw) == ESP_OK);
+    CHECK((chip->conv_config & 0x0003) == ADS1115_CQUE_1CONV);
+    CHECK((chip->conv_config & ADS1115_CMODE_WINDOW) == 0);
+}
+
+// A read finishes on the edge rather than after the padded worst case
+static void test_rdy_latency(void)
+{
+    const uint16_t rates[] = { ADS1115_DR_64SPS, ADS1115_DR_860SPS };
+    for (int r = 0; r < 2; r++) {
+        ads1115_handle_t rdy_dev, timed_dev;
+        int16_t raw;
+        uint32_t conv_us = ads1115_conversion_time_us(rates[r]);
+
+        setup(&rdy_dev, true, true, false);
+        rdy_dev.config.data_rate = rates[r];
+        int64_t t0 = esp_timer_get_time();
+        CHECK(ads1115_read_single(&rdy_dev, ADS1115_MUX_SINGLE_0, &raw) == ESP_OK);
+        int64_t rdy_us = esp_timer_get_time() - t0;
+        CHECK(raw == ads1115_uv_to_raw(1000000, ADS1115_PGA_4_096V));
+        CHECK(rdy_us == conv_us + 2 * MOCK_I2C_XFER_US);
+
+        setup(&timed_dev, true, false, false);
+        timed_dev.config.data_rate = rates[r];
+        t0 = esp_timer_get_time();
+        CHECK(ads1115_read_single(&timed_dev, ADS1115_MUX_SINGLE_0, &raw) == ESP_OK);
+        int64_t timed_us = esp_timer_get_time() - t0;
+        CHECK(timed_us >= conv_us * 11 / 10);
+
+        printf("%4u SPS: conversion %5u us, read on ALERT/RDY %5lld us, timed %5lld us\n",
+               rates[r] == ADS1115_DR_64SPS ? 64 : 860, (unsigned)conv_us, (long long)rdy_us, (long long)timed_us);
+    }
+}
+
+// The pin goes quiet after boot: the wait gives up after about one conversion plus a tick
+static void test_rdy_timeout(void)
+{
+    ads1115_handle_t dev;
+    mock_ads1115_t *chip = setup(&dev, true, true, false);
+    chip->alert_wired = false;
+
+    int16_t raw;
+    int errors = mock_log_count('E');
+    int64_t t0 = esp_timer_get_time();
+    CHECK(ads1115_read_single(&dev, ADS1115_MUX_SINGLE_0, &raw) == ESP_ERR_TIMEOUT);
+    int64_t waited_us = esp_timer_get_time() - t0;
+    CHECK(mock_log_count('E') == errors + 1);
+    CHECK(waited_us >= 10000 && waited_us <= 30000);
+    CHECK(chip->conversions == 2);      // The conversion itself did finish
+
+    // Nothing stale is left behind: once the pin is back the next read is good
+    chip->alert_wired = true;
+    CHECK(ads1115_read_single(&dev, ADS1115_MUX_SINGLE_0, &raw) == ESP_OK);
+    CHECK(raw == ads1115_uv_to_raw(1000000, ADS1115_PGA_4_096V));
+}
+
+// ALERT/RDY configured but not wired (the board in kicad/): boot falls back to timed waits
+static void test_self_test_fallback(void)
+{
+    ads1115_handle_t dev;
+    mock_ads1115_t *chip = setup(&dev, false, true, false);
+
+    CHECK(!dev.config.use_alert_rdy);
+    CHECK(!mock_gpio_has_handler(ALERT_GPIO));
+    CHECK(mock_log_count('W') == 1);
+
+    int16_t raw;
+    int64_t t0 = esp_timer_get_time();
+    CHECK(ads1115_read_single(&dev, ADS1115_MUX_SINGLE_0, &raw) == ESP_OK);
+    CHECK(raw == ads1115_uv_to_raw(1000000, ADS1115_PGA_4_096V));
+    CHECK(esp_timer_get_time() - t0 < 5000);
+    CHECK((chip->conv_config & 0x0003) == ADS1115_CQUE_NONE);
+}
+
+// Pipelined async path: each call returns the previous conversion and starts the next
+static void test_async_pipeline(void)
+{
+    ads1115_handle_t dev;
+    mock_ads1115_t *chip = setup(&dev, true, true, true);
+    chip->input_uv[ADS1115_MUX_SINGLE_1 >> 12] = -500000;
+
+    ads1115_channel_t ch[2] = {
+        { .mux = ADS1115_MUX_SINGLE_0, .gain = ADS1115_PGA_4_096V },
+        { .mux = ADS1115_MUX_SINGLE_1, .gain = ADS1115_PGA_4_096V },
+    };
+    CHECK(ads1115_start_conversion(&dev, &ch[0]) == ESP_OK);
+    for (int i = 1; i <= 4; i++) {
+        int16_t raw;
+        uint16_t gain;
+        CHECK(ads1115_wait_conversion(&dev) == ESP_OK);
+        CHECK(ads1115_read_and_start(&dev, &ch[i % 2], &raw, &gain) == ESP_OK);
+        int32_t expect_uv = chip->input_uv[ch[(i - 1) % 2].mux >> 12];
+        CHECK(raw == ads1115_uv_to_raw(expect_uv, ADS1115_PGA_4_096V));
+        CHECK(gain == ADS1115_PGA_4_096V);
+    }
+    CHECK(dev.stats.samples == 1 + 4);  // Including the boot self-test
+}
+
+static struct {
+    int count;
+    int64_t at_us;
+} trips;
+
+static void on_trip(void *arg)
+{
+    (void)arg;
+    trips.count++;
+    trips.at_us = esp_timer_get_time();
+}
+
+static esp_err_t convert(ads1115_handle_t *dev, ads1115_channel_t *ch, int16_t *raw)
+{
+    esp_err_t ret = ads1115_start_conversion(dev, ch);
+    if (ret == ESP_OK) {
+        ret = ads1115_wait_conversion(dev);
+    }
+    if (ret == ESP_OK) {
+        ret = ads1115_read_conversion(dev, raw, NULL);
+    }
+    return ret;
+}
+
+static void enable_window(ads1115_handle_t *dev, int32_t lo_uv, int32_t hi_uv)
+{
+    memset(&trips, 0, sizeof(trips));
+    ads1115_window_config_t window = {
+        .mux = ADS1115_MUX_DIFF_0_1,
+        .on_trip = on_trip,
+    };
+    CHECK(ads1115_enable_window(dev, &window, lo_uv, hi_uv) == ESP_OK);
+}
+
+// Thresholds land in the chip at the PGA of the protected input, and follow it
+static void test_window_thresholds(void)
+{
+    ads1115_handle_t dev;
+    mock_ads1115_t *chip = setup(&dev, true, true, false);
+    chip->input_uv[ADS1115_MUX_DIFF_0_1 >> 12] = 30000;
+    // The trip ISR must not wait out a flash write
+    CHECK(mock_gpio_isr_flags() & ESP_INTR_FLAG_IRAM);
+
+    ads1115_channel_t shunt = { .mux = ADS1115_MUX_DIFF_0_1, .gain = ADS1115_PGA_0_256V, .auto_range = true };
+    ads1115_channel_t other = { .mux = ADS1115_MUX_SINGLE_2, .gain = ADS1115_PGA_4_096V };
+    int16_t raw;
+    enable_window(&dev, 10000, 50000);
+
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK((chip->conv_config & (ADS1115_CMODE_WINDOW | 0x0003)) == (ADS1115_CMODE_WINDOW | ADS1115_CQUE_1CONV));
+    CHECK((int16_t)chip->reg[ADS1115_REG_LO_THRESH] == ads1115_uv_to_raw(10000, ADS1115_PGA_0_256V));
+    CHECK((int16_t)chip->reg[ADS1115_REG_HI_THRESH] == ads1115_uv_to_raw(50000, ADS1115_PGA_0_256V));
+
+    // Unchanged thresholds are not rewritten; other inputs leave the comparator off
+    uint32_t writes = chip->thresh_writes;
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(convert(&dev, &other, &raw) == ESP_OK);
+    CHECK((chip->conv_config & 0x0003) == ADS1115_CQUE_NONE);
+    CHECK(chip->thresh_writes == writes);
+
+    // A window past 90% of the range widens the PGA before the thresholds are loaded
+    ads1115_set_window(&dev, 10000, 300000);
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(shunt.gain == ADS1115_PGA_0_512V);
+    CHECK((int16_t)chip->reg[ADS1115_REG_HI_THRESH] == ads1115_uv_to_raw(300000, ADS1115_PGA_0_512V));
+    CHECK(trips.count == 0);
+}
+
+// Over- and undercurrent trip from the ALERT/RDY ISR as the offending conversion ends
+static void test_window_trip(void)
+{
+    ads1115_handle_t dev;
+    mock_ads1115_t *chip = setup(&dev, true, true, false);
+    int32_t *shunt_uv = &chip->input_uv[ADS1115_MUX_DIFF_0_1 >> 12];
+    ads1115_channel_t shunt = { .mux = ADS1115_MUX_DIFF_0_1, .gain = ADS1115_PGA_0_256V };
+    int16_t raw;
+    enable_window(&dev, 10000, 50000);
+
+    *shunt_uv = 30000;
+    for (int i = 0; i < 5; i++) {
+        CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    }
+    CHECK(trips.count == 0);
+
+    *shunt_uv = 80000;
+    CHECK(ads1115_start_conversion(&dev, &shunt) == ESP_OK);
+    int64_t conv_end_us = chip->conv_done_us;
+    CHECK(ads1115_wait_conversion(&dev) == ESP_OK);
+    CHECK(trips.count == 1 && trips.at_us == conv_end_us);
+    CHECK(dev.window.trips == 1);
+    CHECK(ads1115_read_conversion(&dev, &raw, NULL) == ESP_OK);
+
+    // Non-latching: the pin releases once a reading is back inside, then the floor trips
+    *shunt_uv = 30000;
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(!chip->alert_low && trips.count == 1);
+    *shunt_uv = 5000;
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(trips.count == 2);
+
+    // A reading past full scale still trips: the upper threshold stays below it
+    *shunt_uv = 30000;
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    ads1115_set_window(&dev, 10000, 1000000);
+    *shunt_uv = 2000000;
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(raw == INT16_MAX && trips.count == 3);
+}
+
+// No ALERT/RDY: the same window is checked on each reading, from the reading task
+static void test_window_software(void)
+{
+    ads1115_handle_t dev;
+    mock_ads1115_t *chip = setup(&dev, false, true, false);
+    int32_t *shunt_uv = &chip->input_uv[ADS1115_MUX_DIFF_0_1 >> 12];
+    ads1115_channel_t shunt = { .mux = ADS1115_MUX_DIFF_0_1, .gain = ADS1115_PGA_0_256V };
+    ads1115_channel_t other = { .mux = ADS1115_MUX_SINGLE_2, .gain = ADS1115_PGA_4_096V };
+    int16_t raw;
+    enable_window(&dev, 10000, 50000);
+    uint32_t writes = chip->thresh_writes;
+    uint32_t edges = chip->alert_edges;
+
+    *shunt_uv = 30000;
+    chip->input_uv[ADS1115_MUX_SINGLE_2 >> 12] = 3000000;   // Out of the window, but not protected
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(convert(&dev, &other, &raw) == ESP_OK);
+    CHECK(trips.count == 0);
+    CHECK(chip->thresh_writes == writes && chip->alert_edges == edges);
+
+    *shunt_uv = 80000;
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(trips.count == 1);
+    *shunt_uv = 5000;
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(trips.count == 2);
+
+    // The pipelined path checks the finished conversion, not the one it starts
+    *shunt_uv = 80000;
+    CHECK(ads1115_start_conversion(&dev, &shunt) == ESP_OK);
+    CHECK(ads1115_wait_conversion(&dev) == ESP_OK);
+    *shunt_uv = 30000;
+    CHECK(ads1115_read_and_start(&dev, &shunt, &raw, NULL) == ESP_OK);
+    CHECK(trips.count == 3);
+    CHECK(ads1115_wait_conversion(&dev) == ESP_OK);
+    CHECK(ads1115_read_conversion(&dev, &raw, NULL) == ESP_OK);
+    CHECK(trips.count == 3);
+}
+
+static void test_window_loaded(void)
+{
+    ads1115_handle_t dev;
+    mock_ads1115_t *chip = setup(&dev, false, true, false);
+    int32_t *shunt_uv = &chip->input_uv[ADS1115_MUX_DIFF_0_1 >> 12];
+    ads1115_channel_t shunt = { .mux = ADS1115_MUX_DIFF_0_1, .gain = ADS1115_PGA_0_256V };
+    ads1115_channel_t other = { .mux = ADS1115_MUX_SINGLE_2, .gain = ADS1115_PGA_4_096V };
+    int16_t raw;
+    enable_window(&dev, 10000, 50000);
+    *shunt_uv = 30000;
+    CHECK(!ads1115_window_loaded(&dev));
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(ads1115_window_loaded(&dev));
+
+    // A new window is pending until a shunt conversion starts with it
+    ads1115_set_window(&dev, 10000, 100000);
+    CHECK(!ads1115_window_loaded(&dev));
+    CHECK(convert(&dev, &other, &raw) == ESP_OK);
+    CHECK(!ads1115_window_loaded(&dev));
+
+    // A conversion already in flight is judged against the window it started with
+    int count = trips.count;
+    *shunt_uv = 80000;
+    CHECK(ads1115_start_conversion(&dev, &shunt) == ESP_OK);
+    CHECK(ads1115_window_loaded(&dev));
+    ads1115_set_window(&dev, 10000, 50000);
+    CHECK(ads1115_wait_conversion(&dev) == ESP_OK);
+    CHECK(ads1115_read_conversion(&dev, &raw, NULL) == ESP_OK);
+    CHECK(trips.count == count);
+    CHECK(!ads1115_window_loaded(&dev));
+    CHECK(convert(&dev, &shunt, &raw) == ESP_OK);
+    CHECK(ads1115_window_loaded(&dev));
+    CHECK(trips.count == count + 1);
+}
+
+// The DAC task moves the window as soon as it runs, which may be before enable_window()
+static void test_window_lock(void)
+{
+    ads1115_handle_t dev;
+    setup(&dev, false, false, false);
+    ads1115_set_window(&dev, 10000, 50000);
+    CHECK(ads1115_window_loaded(&dev));
+    enable_window(&dev, 10000, 50000);
+    ads1115_set_window(&dev, 10000, 60000);
+    CHECK(!ads1115_window_loaded(&dev));
+    CHECK(mock_lock_errors == 0);
+}
+
+// A device whose read fails keeps its last value and drops out of its own updated mask
+static void test_bus_failed_read(void)
+{
+    mock_reset();
+    ads1115_handle_t devs[2];
+    mock_ads1115_t *chips[2];
+    ads1115_bus_t bus = {0};
+    memset(devs, 0, sizeof(devs));
+    for (int d = 0; d < 2; d++) {
+        chips[d] = mock_ads1115_add(ADS1115_I2C_ADDR_DEFAULT + d, ALERT_GPIO, false);
+        ads1115_config_t config = {
+            .addr = ADS1115_I2C_ADDR_DEFAULT + d,
+            .gain = ADS1115_PGA_4_096V,
+            .data_rate = ADS1115_DR_860SPS,
+        };
+        CHECK(ads1115_init(&devs[d], &config, mock_bus()) == ESP_OK);
+        CHECK(ads1115_bus_add_device(&bus, &devs[d]) == ESP_OK);
+    }
+    const ads1115_bus_channel_t channels[] = {
+        { .ch = { .mux = ADS1115_MUX_SINGLE_0, .gain = ADS1115_PGA_4_096V, .data_rate = ADS1115_DR_860SPS } },
+        { .ch = { .mux = ADS1115_MUX_SINGLE_1, .gain = ADS1115_PGA_4_096V, .data_rate = ADS1115_DR_860SPS } },
+    };
+    CHECK(ads1115_bus_set_channels(&bus, channels, 2) == ESP_OK);
+
+    int16_t raw[ADS1115_BUS_MAX_DEVICES][ADS1115_BUS_MAX_MUX] = {0};
+    uint16_t gain[ADS1115_BUS_MAX_DEVICES][ADS1115_BUS_MAX_MUX] = {0};
+    uint32_t updated[ADS1115_BUS_MAX_DEVICES];
+    for (int d = 0; d < 2; d++) {
+        chips[d]->input_uv[ADS1115_MUX_SINGLE_0 >> 12] = 1000000;
+        chips[d]->input_uv[ADS1115_MUX_SINGLE_1 >> 12] = 2000000;
+    }
+    CHECK(ads1115_bus_scan(&bus, raw, gain, updated, NULL) == ESP_OK);
+    CHECK(updated[0] == 0x3 && updated[1] == 0x3);
+    CHECK(raw[1][0] == 8000 && raw[1][1] == 16000);
+
+    chips[1]->nack = true;
+    chips[1]->input_uv[ADS1115_MUX_SINGLE_0 >> 12] = 0;
+    CHECK(ads1115_bus_scan(&bus, raw, gain, updated, NULL) != ESP_OK);
+    CHECK(updated[0] == 0x3 && updated[1] == 0);
+    CHECK(raw[1][0] == 8000 && raw[1][1] == 16000);
+
+    // Back on the bus: its pipeline restarts and it reports again
+    chips[1]->nack = false;
+    for (int scan = 0; scan < 2 && updated[1] != 0x3; scan++) {
+        ads1115_bus_scan(&bus, raw, gain, updated, NULL);
+    }
+    CHECK(updated[1] == 0x3 && raw[1][0] == 0);
+}
+
+int main(void)
+{
+    test_rdy_thresholds();
+    test_rdy_latency();
+    test_rdy_timeout();
+    test_self_test_fallback();
+    test_async_pipeline();
+    test_window_thresholds();
+    test_window_trip();
+    test_window_software();
+    test_window_loaded();
+    test_window_lock();
+    test_bus_failed_read();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All ads1115 tests passed\n");
+    return 0;
+}
@@ -0,0 +1,423 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "ads1115_mock.h"
+#include "ads1115.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define MOCK_MAX_TIMERS     8
+#define MOCK_MAX_SEMS       16
+#define MOCK_TICK_US        (1000000 / configTICK_RATE_HZ)
+
+struct mock_timer {
+    void (*callback)(void *arg);
+    void *arg;
+    int64_t due_us;             // 0 when not running
+};
+
+struct mock_sem {
+    unsigned count;
+    unsigned max;
+};
+
+struct mock_i2c_dev {
+    mock_ads1115_t *chip;
+    i2c_master_callback_t on_done;
+    void *arg;
+};
+
+static struct {
+    int64_t now_us;
+    mock_ads1115_t chips[MOCK_MAX_DEVICES];
+    struct mock_i2c_dev devs[MOCK_MAX_DEVICES];
+    int num_chips;
+    int num_devs;
+    struct mock_timer timers[MOCK_MAX_TIMERS];
+    int num_timers;
+    struct mock_sem sems[MOCK_MAX_SEMS];
+    int num_sems;
+    gpio_isr_t handlers[GPIO_NUM_MAX];
+    void *handler_args[GPIO_NUM_MAX];
+    bool isr_service;
+    int isr_flags;
+    int log_counts[26];
+} mock;
+
+int mock_lock_errors;
+
+void mock_reset(void)
+{
+    memset(&mock, 0, sizeof(mock));
+    mock.now_us = 1000;
+    mock_lock_errors = 0;
+}
+
+i2c_master_bus_handle_t mock_bus(void)
+{
+    // The bus itself carries no state; any non-NULL handle will do
+    return (i2c_master_bus_handle_t)&mock;
+}
+
+mock_ads1115_t *mock_ads1115_add(uint8_t addr, gpio_num_t alert_gpio, bool alert_wired)
+{
+    mock_ads1115_t *chip = &mock.chips[mock.num_chips++];
+    chip->addr = addr;
+    chip->alert_gpio = alert_gpio;
+    chip->alert_wired = alert_wired;
+    chip->reg[ADS1115_REG_CONFIG] = 0x8583;     // Power-on defaults
+    chip->reg[ADS1115_REG_LO_THRESH] = 0x8000;
+    chip->reg[ADS1115_REG_HI_THRESH] = 0x7FFF;
+    return chip;
+}
+
+bool mock_gpio_has_handler(gpio_num_t gpio)
+{
+    return mock.handlers[gpio] != NULL;
+}
+
+int mock_gpio_isr_flags(void)
+{
+    return mock.isr_flags;
+}
+
+int mock_log_count(char level)
+{
+    return mock.log_counts[level - 'A'];
+}
+
+void mock_log(char level, const char *tag, const char *fmt, ...)
+{
+    mock.log_counts[level - 'A']++;
+    if (level == 'I') {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    printf("  [%c %s] ", level, tag);
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:                return "ESP_OK";
+    case ESP_FAIL:              return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+    default:                    return "UNKNOWN";
+    }
+}
+
+// --- Simulated ADS1115 ---
+
+static void mock_alert_edge(mock_ads1115_t *chip)
+{
+    chip->alert_edges++;
+    if (chip->alert_wired && mock.handlers[chip->alert_gpio]) {
+        mock.handlers[chip->alert_gpio](mock.handler_args[chip->alert_gpio]);
+    }
+}
+
+// End of a single-shot conversion: latch the result, then run the comparator on it
+static void mock_conversion_done(mock_ads1115_t *chip)
+{
+    uint16_t config = chip->conv_config;
+    int16_t raw = ads1115_uv_to_raw(chip->input_uv[(config >> 12) & 0x07], config & 0x0E00);
+    chip->reg[ADS1115_REG_CONVERSION] = (uint16_t)raw;
+    chip->reg[ADS1115_REG_CONFIG] |= ADS1115_OS_NOTBUSY;
+    chip->conv_done_us = 0;
+    chip->conversions++;
+
+    if ((config & 0x0003) == ADS1115_CQUE_NONE) {
+        chip->alert_low = false;
+        return;
+    }
+    int16_t lo = (int16_t)chip->reg[ADS1115_REG_LO_THRESH];
+    int16_t hi = (int16_t)chip->reg[ADS1115_REG_HI_THRESH];
+    if ((chip->reg[ADS1115_REG_HI_THRESH] & 0x8000) && !(chip->reg[ADS1115_REG_LO_THRESH] & 0x8000)) {
+        // Conversion-ready: an ~8 us pulse at the end of every conversion
+        mock_alert_edge(chip);
+        return;
+    }
+    bool assert;
+    if (config & ADS1115_CMODE_WINDOW) {
+        assert = raw > hi || raw < lo;
+    } else {
+        assert = raw > hi || (chip->alert_low && raw >= lo);
+    }
+    if (assert && !chip->alert_low) {
+        chip->alert_low = true;
+        mock_alert_edge(chip);
+    } else if (!assert && !(config & ADS1115_CLAT_LATCH)) {
+        chip->alert_low = false;
+    }
+}
+
+// Run conversions and timers that are due, in time order, up to `until_us`
+static void mock_run_until(int64_t until_us)
+{
+    while (1) {
+        int64_t next = until_us + 1;
+        mock_ads1115_t *chip = NULL;
+        struct mock_timer *timer = NULL;
+        for (int i = 0; i < mock.num_chips; i++) {
+            if (mock.chips[i].conv_done_us && mock.chips[i].conv_done_us < next) {
+                next = mock.chips[i].conv_done_us;
+                chip = &mock.chips[i];
+                timer = NULL;
+            }
+        }
+        for (int i = 0; i < mock.num_timers; i++) {
+            if (mock.timers[i].due_us && mock.timers[i].due_us < next) {
+                next = mock.timers[i].due_us;
+                timer = &mock.timers[i];
+                chip = NULL;
+            }
+        }
+        if (!chip && !timer) {
+            break;
+        }
+        if (next > mock.now_us) {
+            mock.now_us = next;
+        }
+        if (chip) {
+            mock_conversion_done(chip);
+        } else {
+            timer->due_us = 0;
+            timer->callback(timer->arg);
+        }
+    }
+    if (until_us > mock.now_us) {
+        mock.now_us = until_us;
+    }
+}
+
+void mock_advance_us(int64_t us)
+{
+    mock_run_until(mock.now_us + us);
+}
+
+static void mock_chip_write(mock_ads1115_t *chip, uint8_t reg, uint16_t value)
+{
+    if (reg > ADS1115_REG_HI_THRESH) {
+        return;
+    }
+    chip->reg[reg] = value;
+    if (reg == ADS1115_REG_LO_THRESH || reg == ADS1115_REG_HI_THRESH) {
+        chip->thresh_writes++;
+    } else if (reg == ADS1115_REG_CONFIG && (value & ADS1115_OS_SINGLE)) {
+        chip->reg[reg] &= ~ADS1115_OS_NOTBUSY;
+        chip->conv_config = value;
+        chip->conv_done_us = mock.now_us + ads1115_conversion_time_us(value & 0x00E0);
+    }
+}
+
+// --- driver/i2c_master.h ---
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus, const i2c_device_config_t *config,
+                                    i2c_master_dev_handle_t *out)
+{
+    (void)bus;
+    for (int i = 0; i < mock.num_chips; i++) {
+        if (mock.chips[i].addr == config->device_address) {
+            struct mock_i2c_dev *dev = &mock.devs[mock.num_devs++];
+            dev->chip = &mock.chips[i];
+            *out = dev;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t i2c_master_register_event_callbacks(i2c_master_dev_handle_t dev, const i2c_master_event_callbacks_t *cbs,
+                                              void *arg)
+{
+    dev->on_done = cbs->on_trans_done;
+    dev->arg = arg;
+    return ESP_OK;
+}
+
+// Async devices finish from the "bus ISR" straight away; the result is the same as sync
+static esp_err_t mock_i2c_finish(i2c_master_dev_handle_t dev)
+{
+    esp_err_t ret = dev->chip->nack ? ESP_FAIL : ESP_OK;
+    if (dev->on_done) {
+        i2c_master_event_data_t evt = { .event = ret == ESP_OK ? I2C_EVENT_DONE : I2C_EVENT_NACK };
+        dev->on_done(dev, &evt, dev->arg);
+        return ESP_OK;
+    }
+    return ret;
+}
+
+// A transfer takes effect when it completes
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t dev, const uint8_t *buf, size_t len, int timeout_ms)
+{
+    (void)timeout_ms;
+    mock_advance_us(MOCK_I2C_XFER_US);
+    if (!dev->chip->nack && len == 3) {
+        mock_chip_write(dev->chip, buf[0], (uint16_t)(buf[1] << 8 | buf[2]));
+    }
+    return mock_i2c_finish(dev);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t dev, const uint8_t *tx, size_t tx_len,
+                                      uint8_t *rx, size_t rx_len, int timeout_ms)
+{
+    (void)timeout_ms;
+    mock_advance_us(MOCK_I2C_XFER_US);
+    if (!dev->chip->nack && tx_len == 1 && rx_len == 2 && tx[0] <= ADS1115_REG_HI_THRESH) {
+        uint16_t value = dev->chip->reg[tx[0]];
+        rx[0] = value >> 8;
+        rx[1] = value & 0xFF;
+    }
+    return mock_i2c_finish(dev);
+}
+
+// --- driver/gpio.h ---
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    if (mock.isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    mock.isr_service = true;
+    mock.isr_flags = intr_alloc_flags;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *arg)
+{
+    if (!mock.isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    mock.handlers[gpio] = handler;
+    mock.handler_args[gpio] = arg;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio)
+{
+    mock.handlers[gpio] = NULL;
+    return ESP_OK;
+}
+
+// --- esp_timer.h ---
+
+int64_t esp_timer_get_time(void)
+{
+    return mock.now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (mock.num_timers == MOCK_MAX_TIMERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    struct mock_timer *timer = &mock.timers[mock.num_timers++];
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    *out = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->due_us) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->due_us = mock.now_us + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->due_us) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->due_us = 0;
+    return ESP_OK;
+}
+
+// --- freertos ---
+
+static SemaphoreHandle_t mock_sem_new(unsigned max, unsigned initial)
+{
+    if (mock.num_sems == MOCK_MAX_SEMS) {
+        return NULL;
+    }
+    struct mock_sem *sem = &mock.sems[mock.num_sems++];
+    sem->max = max;
+    sem->count = initial;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return mock_sem_new(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(unsigned max, unsigned initial)
+{
+    return mock_sem_new(max, initial);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    int64_t deadline_us = ticks == portMAX_DELAY ? INT64_MAX / 2 : mock.now_us + (int64_t)ticks * MOCK_TICK_US;
+    while (sem->count == 0) {
+        // Step to the next conversion or timer; nothing else can give the semaphore
+        int64_t next = deadline_us;
+        for (int i = 0; i < mock.num_chips; i++) {
+            if (mock.chips[i].conv_done_us && mock.chips[i].conv_done_us < next) {
+                next = mock.chips[i].conv_done_us;
+            }
+        }
+        for (int i = 0; i < mock.num_timers; i++) {
+            if (mock.timers[i].due_us && mock.timers[i].due_us < next) {
+                next = mock.timers[i].due_us;
+            }
+        }
+        mock_run_until(next);
+        if (next >= deadline_us && sem->count == 0) {
+            return pdFALSE;
+        }
+    }
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->count == sem->max) {
+        return pdFALSE;
+    }
+    sem->count++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *higher_prio_woken)
+{
+    if (higher_prio_woken) {
+        *higher_prio_woken = pdTRUE;
+    }
+    return xSemaphoreGive(sem);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    mock_advance_us((int64_t)ticks * MOCK_TICK_US);
+}
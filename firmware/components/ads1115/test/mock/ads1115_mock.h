@@ -0,0 +1,40 @@
+#ifndef ADS1115_MOCK_H
+#define ADS1115_MOCK_H
+
+// Host stand-ins for the IDF I2C master, GPIO ISR, esp_timer and semaphore APIs the driver
+// uses, around simulated ADS1115s on a virtual clock. Time only moves inside I2C transfers
+// and blocking waits, so tests are deterministic: a wait runs conversions and timers
+// forward in order until it is satisfied or times out.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/gpio.h"
+#include "driver/i2c_master.h"
+
+#define MOCK_I2C_XFER_US    100     // One register access at 400 kHz, about
+#define MOCK_MAX_DEVICES    4
+
+typedef struct {
+    uint8_t addr;
+    int32_t input_uv[8];        // What each mux setting (config bits 14:12) sees
+    gpio_num_t alert_gpio;
+    bool alert_wired;           // ALERT/RDY reaches alert_gpio
+    bool nack;                  // Fail every transfer
+    uint16_t reg[4];            // Conversion, config, Lo_thresh, Hi_thresh
+    bool alert_low;             // ALERT/RDY pin state (active low)
+    int64_t conv_done_us;       // End of the conversion in flight, 0 when idle
+    uint16_t conv_config;       // Config it was started with
+    uint32_t conversions;
+    uint32_t thresh_writes;
+    uint32_t alert_edges;       // Falling edges driven onto the pin
+} mock_ads1115_t;
+
+void mock_reset(void);
+i2c_master_bus_handle_t mock_bus(void);
+mock_ads1115_t *mock_ads1115_add(uint8_t addr, gpio_num_t alert_gpio, bool alert_wired);
+void mock_advance_us(int64_t us);
+bool mock_gpio_has_handler(gpio_num_t gpio);
+int mock_gpio_isr_flags(void);
+int mock_log_count(char level);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef MOCK_ESP_ATTR_H
+#define MOCK_ESP_ATTR_H
+
+#define IRAM_ATTR
+
+#endif
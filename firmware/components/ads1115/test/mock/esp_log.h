@@ -0,0 +1,12 @@
+#ifndef MOCK_ESP_LOG_H
+#define MOCK_ESP_LOG_H
+
+// Errors and warnings are counted so tests can check that a path was (or was not) taken
+void mock_log(char level, const char *tag, const char *fmt, ...);
+
+#define ESP_LOGE(tag, fmt, ...) mock_log('E', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) mock_log('W', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) mock_log('I', tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+
+#endif
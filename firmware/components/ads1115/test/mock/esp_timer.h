@@ -0,0 +1,21 @@
+#ifndef MOCK_ESP_TIMER_H
+#define MOCK_ESP_TIMER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct mock_timer *esp_timer_handle_t;
+
+typedef struct {
+    void (*callback)(void *arg);
+    void *arg;
+    const char *name;
+} esp_timer_create_args_t;
+
+// Virtual clock: advanced by I2C transfers and blocking waits (see ads1115_mock.c)
+int64_t esp_timer_get_time(void);
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+
+#endif
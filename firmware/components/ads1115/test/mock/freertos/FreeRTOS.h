@@ -0,0 +1,67 @@
+#ifndef MOCK_FREERTOS_H
+#define MOCK_FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define configTICK_RATE_HZ      100     // IDF default
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+#define portMAX_DELAY           UINT32_MAX
+
+// Single-threaded host: critical sections have nothing to exclude, but the lock state is
+// tracked as IDF's spinlock does. A zeroed lock is neither free nor owned, which on the
+// target spins with interrupts masked; here it counts in mock_lock_errors.
+#define MOCK_SPINLOCK_FREE  0xB33FFFFF
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+extern int mock_lock_errors;
+
+static inline void mock_lock_enter(portMUX_TYPE *mux)
+{
+    if (mux->owner != MOCK_SPINLOCK_FREE && mux->owner != 0) {
+        mux->count++;       // Recursive entry on the same core
+        return;
+    }
+    if (mux->owner != MOCK_SPINLOCK_FREE) {
+        mock_lock_errors++;
+    }
+    mux->owner = 1;
+    mux->count = 1;
+}
+
+static inline void mock_lock_exit(portMUX_TYPE *mux)
+{
+    if (mux->owner == MOCK_SPINLOCK_FREE || mux->count == 0) {
+        mock_lock_errors++;
+    } else if (--mux->count == 0) {
+        mux->owner = MOCK_SPINLOCK_FREE;
+    }
+}
+
+static inline void mock_lock_init(portMUX_TYPE *mux)
+{
+    if (mux->owner != MOCK_SPINLOCK_FREE && mux->owner != 0) {
+        mock_lock_errors++;     // Re-initialised while held
+    }
+    mux->owner = MOCK_SPINLOCK_FREE;
+    mux->count = 0;
+}
+
+#define portMUX_INITIALIZER_UNLOCKED    {MOCK_SPINLOCK_FREE, 0}
+#define portMUX_INITIALIZE(mux)         mock_lock_init(mux)
+#define portENTER_CRITICAL(mux)         mock_lock_enter(mux)
+#define portEXIT_CRITICAL(mux)          mock_lock_exit(mux)
+#define portENTER_CRITICAL_ISR(mux)     mock_lock_enter(mux)
+#define portEXIT_CRITICAL_ISR(mux)      mock_lock_exit(mux)
+#define portYIELD_FROM_ISR()            do {} while (0)
+
+#endif
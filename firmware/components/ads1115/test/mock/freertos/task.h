@@ -0,0 +1,8 @@
+#ifndef MOCK_FREERTOS_TASK_H
+#define MOCK_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
+
+#endif
@@ -0,0 +1,3 @@
+#ifndef MOCK_SDKCONFIG_H
+#define MOCK_SDKCONFIG_H
+#endif
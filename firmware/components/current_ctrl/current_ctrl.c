@@ -0,0 +1,86 @@
+#include <string.h>
+#include "current_ctrl.h"
+
+static int32_t clamp32(int64_t v, int32_t lo, int32_t hi)
+{
+    return v < lo ? lo : v > hi ? hi : (int32_t)v;
+}
+
+bool current_ctrl_init(current_ctrl_t *ctrl, const current_ctrl_config_t *config)
+{
+    if (!ctrl || !config || config->kp_q16 < 0 || config->ki_q16 < 0 || config->ff_gain_q16 < 0 ||
+        config->trim_ratio_q16 < 0 || config->trim_floor_q8 < 0 || config->slew_q8 <= 0 || config->out_min_q8 > config->out_max_q8 ||
+        config->ff_offset_q8 < config->out_min_q8 || config->ff_offset_q8 > config->out_max_q8) {
+        return false;
+    }
+    memset(ctrl, 0, sizeof(*ctrl));
+    ctrl->config = *config;
+    current_ctrl_reset(ctrl);
+    return true;
+}
+
+void current_ctrl_reset(current_ctrl_t *ctrl)
+{
+    ctrl->integ_q8 = 0;
+    ctrl->out_q8 = ctrl->config.out_min_q8;
+    ctrl->limited = false;
+    ctrl->missed = 0;
+}
+
+void current_ctrl_hold(current_ctrl_t *ctrl, int32_t out_q8)
+{
+    ctrl->integ_q8 = 0;
+    ctrl->out_q8 = clamp32(out_q8, ctrl->config.out_min_q8, ctrl->config.out_max_q8);
+    ctrl->missed = 0;
+}
+
+int32_t current_ctrl_step(current_ctrl_t *ctrl, int32_t setpoint_ua, int32_t measured_ua)
+{
+    const current_ctrl_config_t *c = &ctrl->config;
+    if (setpoint_ua <= 0) {
+        current_ctrl_reset(ctrl);
+        return ctrl->out_q8;
+    }
+    ctrl->missed = 0;
+    // Nothing flows below the offset, so starting there skips dead steps without a current jump
+    if (ctrl->out_q8 < c->ff_offset_q8) {
+        ctrl->out_q8 = c->ff_offset_q8;
+    }
+
+    int32_t err = setpoint_ua - measured_ua;
+    int64_t span = ((int64_t)setpoint_ua * c->ff_gain_q16) >> 16;
+    int64_t ff = c->ff_offset_q8 + span;
+    int64_t p = ((int64_t)err * c->kp_q16) >> 16;
+    int32_t trim_max = clamp32(c->trim_floor_q8 + ((span * c->trim_ratio_q16) >> 16), 0, INT32_MAX);
+    int32_t integ = clamp32(ctrl->integ_q8 + (((int64_t)err * c->ki_q16) >> 16), -trim_max, trim_max);
+    int64_t want = ff + p + integ;
+
+    int32_t lo = ctrl->out_q8 - c->slew_q8 > c->out_min_q8 ? ctrl->out_q8 - c->slew_q8 : c->out_min_q8;
+    int32_t hi = ctrl->out_q8 + c->slew_q8 < c->out_max_q8 ? ctrl->out_q8 + c->slew_q8 : c->out_max_q8;
+    int32_t out = clamp32(want, lo, hi);
+
+    // Conditional integration: hold the integral while a limit stops the output following it
+    ctrl->limited = out != want;
+    if (!ctrl->limited || (want > out) != (err > 0)) {
+        ctrl->integ_q8 = integ;
+    }
+    ctrl->out_q8 = out;
+    return out;
+}
+
+int32_t current_ctrl_step_missing(current_ctrl_t *ctrl, int32_t setpoint_ua)
+{
+    if (setpoint_ua <= 0) {
+        current_ctrl_reset(ctrl);
+        return ctrl->out_q8;
+    }
+    if (ctrl->missed < UINT32_MAX) {
+        ctrl->missed++;
+    }
+    return ctrl->out_q8;
+}
+
+bool current_ctrl_sensor_lost(const current_ctrl_t *ctrl)
+{
+    return ctrl->config.max_missed && ctrl->missed >= ctrl->config.max_missed;
+}
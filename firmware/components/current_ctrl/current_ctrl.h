@@ -0,0 +1,61 @@
+#ifndef CURRENT_CTRL_H
+#define CURRENT_CTRL_H
+
+// Fixed-point PI current regulator: feedforward from the nominal DAC transfer, plus a
+// proportional term and a bounded integral trim that absorb gain error and load changes.
+// The output is a drive level, higher for more current, in Q8 DAC steps. No IDF
+// dependencies so it also builds on the host (see test/).
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CURRENT_CTRL_OUT_FRAC_BITS  8
+
+typedef struct {
+    int32_t kp_q16;         // Output (Q8) per uA of error, Q16
+    int32_t ki_q16;         // Output (Q8) per uA of error per step, Q16
+    int32_t ff_offset_q8;   // Nominal drive at 0 uA; below this no current flows
+    int32_t ff_gain_q16;    // Nominal drive (Q8) per uA, Q16
+    // Integral correction limit either way (anti-windup): a fraction of the feedforward
+    // span above the offset, since gain error scales with the setpoint, plus a floor
+    int32_t trim_ratio_q16;
+    int32_t trim_floor_q8;
+    int32_t slew_q8;        // Largest output change per step
+    int32_t out_min_q8;
+    int32_t out_max_q8;
+    uint32_t max_missed;    // Periods in a row without a reading before the sensor counts as lost; 0 never
+} current_ctrl_config_t;
+
+typedef struct {
+    current_ctrl_config_t config;
+    int32_t integ_q8;
+    int32_t out_q8;
+    bool limited;           // Last output was clamped by the slew or range limits
+    uint32_t missed;        // Periods in a row without a reading
+} current_ctrl_t;
+
+// False for a config with non-positive gains or limits out of order
+bool current_ctrl_init(current_ctrl_t *ctrl, const current_ctrl_config_t *config);
+// Output back to out_min, integral cleared
+void current_ctrl_reset(current_ctrl_t *ctrl);
+// Carry on from an output set by other means (bumpless switch from open loop)
+void current_ctrl_hold(current_ctrl_t *ctrl, int32_t out_q8);
+// One control period. A setpoint of 0 or less turns the output off at once, without
+// slew limiting. Returns the new output.
+int32_t current_ctrl_step(current_ctrl_t *ctrl, int32_t setpoint_ua, int32_t measured_ua);
+// A control period without a fresh reading: the output and integral hold, since acting
+// on an old or missing value would wind the loop up. A setpoint of 0 or less still turns
+// the output off. Returns the output.
+int32_t current_ctrl_step_missing(current_ctrl_t *ctrl, int32_t setpoint_ua);
+// True once max_missed periods in a row had no reading; the caller must force the output safe
+bool current_ctrl_sensor_lost(const current_ctrl_t *ctrl);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CURRENT_CTRL_H
@@ -0,0 +1,280 @@
+// Host tests for the current regulator against a simulated current source driving an
+// electrode: series resistance, then the double layer as a resistor and capacitor in
+// parallel, all behind a compliance limit.
+//
+//   cc -O2 -I.. current_ctrl_test.c ../current_ctrl.c -o current_ctrl_test && ./current_ctrl_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "current_ctrl.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// Same transfer and tuning as main.c: I = 2.48 mA * (1 - V_dac / 2.5 V), DAC 0-3.3 V
+#define MAX_UA              2480
+#define CODE_OFF_Q8         ((int32_t)((255 - 255LL * 2500 / 3300) << 8))
+#define UA_PER_CODE         (2480.0 * 3300 / (255 * 2500))
+
+static const current_ctrl_config_t board_config = {
+    .kp_q16 = 3 << 16,
+    .ki_q16 = 10 << 16,
+    .ff_offset_q8 = CODE_OFF_Q8,
+    .ff_gain_q16 = (int32_t)((255LL * 2500 << 24) / (2480LL * 3300)),
+    .trim_ratio_q16 = 65536 * 3 / 10,
+    .trim_floor_q8 = 8 << 8,
+    .slew_q8 = 8 << 8,
+    .out_min_q8 = 0,
+    .out_max_q8 = 255 << 8,
+    .max_missed = 20,
+};
+
+#define SIM_DT_US           50
+#define CTRL_PERIOD_US      5000
+#define SCAN_PERIOD_US      3500    // Shunt conversion per sampler scan
+
+typedef struct {
+    double gain;            // Actual / nominal source current
+    double tau_s;           // Output stage lag
+    double rs_ohm;          // Electrode series resistance
+    double rp_ohm;          // Double layer
+    double cp_f;
+    double compliance_v;
+    double current_ua;
+    double vc;              // Double layer voltage
+    double measured_ua;     // Last shunt reading, held between scans
+    uint32_t noise;
+} plant_t;
+
+static void plant_init(plant_t *p, double gain, double compliance_v)
+{
+    *p = (plant_t){
+        .gain = gain, .tau_s = 0.0005, .rs_ohm = 1000, .rp_ohm = 5000, .cp_f = 20e-6,
+        .compliance_v = compliance_v, .noise = 12345,
+    };
+}
+
+static void plant_step(plant_t *p, int32_t drive_q8)
+{
+    double nominal = (drive_q8 - CODE_OFF_Q8) / 256.0 * UA_PER_CODE;
+    double cmd = nominal > 0 ? nominal * p->gain : 0;
+    // The source runs out of headroom once the electrode needs more than the compliance
+    double max_ua = (p->compliance_v - p->vc) / p->rs_ohm * 1e6;
+    if (cmd > max_ua) {
+        cmd = max_ua > 0 ? max_ua : 0;
+    }
+    double dt = SIM_DT_US * 1e-6;
+    p->current_ua += (cmd - p->current_ua) * dt / (p->tau_s + dt);
+    p->vc += (p->current_ua * 1e-6 - p->vc / p->rp_ohm) / p->cp_f * dt;
+}
+
+static int32_t plant_measure(plant_t *p)
+{
+    p->noise = p->noise * 1103515245 + 12345;
+    return (int32_t)(p->current_ua + (int)((p->noise >> 16) % 7) - 3);
+}
+
+// Run for duration_ms at a fixed setpoint; returns the extremes of the current after settle_ms
+typedef struct {
+    double min_ua;
+    double max_ua;
+    int32_t max_slew_q8;
+    int32_t settle_ms;      // First time the current stayed within 2% to the end, -1 if never
+} run_result_t;
+
+static run_result_t run(current_ctrl_t *ctrl, plant_t *p, int32_t setpoint_ua, int duration_ms, int settle_ms)
+{
+    run_result_t r = { .min_ua = 1e9, .max_ua = -1e9, .settle_ms = -1 };
+    int32_t drive = ctrl->out_q8;
+    int32_t measured = plant_measure(p);
+    double band = setpoint_ua * 0.02 + 5;
+
+    for (int t_us = 0; t_us < duration_ms * 1000; t_us += SIM_DT_US) {
+        if (t_us % SCAN_PERIOD_US == 0) {
+            measured = plant_measure(p);
+        }
+        if (t_us % CTRL_PERIOD_US == 0) {
+            int32_t prev = drive < CODE_OFF_Q8 ? CODE_OFF_Q8 : drive;     // Off jumps to the offset
+            drive = current_ctrl_step(ctrl, setpoint_ua, measured);
+            int32_t slew = abs(drive - prev);
+            if (slew > r.max_slew_q8) {
+                r.max_slew_q8 = slew;
+            }
+        }
+        plant_step(p, drive);
+
+        bool inside = p->current_ua > setpoint_ua - band && p->current_ua < setpoint_ua + band;
+        if (!inside) {
+            r.settle_ms = -1;
+        } else if (r.settle_ms < 0) {
+            r.settle_ms = t_us / 1000;
+        }
+        if (t_us >= settle_ms * 1000) {
+            r.min_ua = p->current_ua < r.min_ua ? p->current_ua : r.min_ua;
+            r.max_ua = p->current_ua > r.max_ua ? p->current_ua : r.max_ua;
+        }
+    }
+    return r;
+}
+
+static void test_tracks_despite_gain_error(void)
+{
+    const double gains[] = { 0.8, 1.0, 1.25 };
+    for (int g = 0; g < 3; g++) {
+        current_ctrl_t ctrl;
+        plant_t p;
+        CHECK(current_ctrl_init(&ctrl, &board_config));
+        plant_init(&p, gains[g], 30.0);
+
+        // Ramp the setpoint in the way the firmware does, then hold
+        for (int ua = 100; ua <= 1800; ua += 100) {
+            run(&ctrl, &p, ua, 50, 0);
+        }
+        run_result_t r = run(&ctrl, &p, 1800, 500, 100);
+        printf("gain %.2f: 1800 uA held at %.0f-%.0f uA\n", gains[g], r.min_ua, r.max_ua);
+        CHECK(r.min_ua > 1782 && r.max_ua < 1818);
+
+        // A step down: settles within tens of ms, limited by the slew rate
+        r = run(&ctrl, &p, 1500, 500, 100);
+        printf("gain %.2f: 1800 -> 1500 uA settled in %d ms\n", gains[g], r.settle_ms);
+        CHECK(r.settle_ms >= 0 && r.settle_ms < 100);
+        CHECK(r.min_ua > 1485 && r.max_ua < 1515);
+        CHECK(r.max_slew_q8 <= board_config.slew_q8);
+    }
+}
+
+static void test_step_overshoot(void)
+{
+    current_ctrl_t ctrl;
+    plant_t p;
+    CHECK(current_ctrl_init(&ctrl, &board_config));
+    plant_init(&p, 1.2, 30.0);
+
+    // An unramped step from off with the source 20% hot: the feedforward alone would
+    // land on 1200 uA; the loop catches it on the way up and pulls it back
+    run_result_t r = run(&ctrl, &p, 1000, 1000, 0);
+    printf("0 -> 1000 uA step: settled in %d ms, peak %.0f uA\n", r.settle_ms, r.max_ua);
+    CHECK(r.settle_ms >= 0 && r.settle_ms < 100);
+    CHECK(r.max_ua < 1150);
+    CHECK(r.max_slew_q8 <= board_config.slew_q8);
+}
+
+static void test_anti_windup(void)
+{
+    current_ctrl_t ctrl;
+    plant_t p;
+    CHECK(current_ctrl_init(&ctrl, &board_config));
+    // 6 V of compliance: about 1 mA into 6k at steady state
+    plant_init(&p, 1.0, 6.0);
+
+    run_result_t r = run(&ctrl, &p, 1800, 2000, 1000);
+    CHECK(r.max_ua < 1200);
+    CHECK(ctrl.integ_q8 > 0);
+
+    // Once the target is reachable again the trim has little to unwind
+    r = run(&ctrl, &p, 500, 1000, 300);
+    printf("windup: 1800 (out of compliance) -> 500 uA settled in %d ms\n", r.settle_ms);
+    CHECK(r.settle_ms >= 0 && r.settle_ms < 150);
+    CHECK(r.min_ua > 485 && r.max_ua < 515);
+}
+
+static void test_off_is_immediate(void)
+{
+    current_ctrl_t ctrl;
+    CHECK(current_ctrl_init(&ctrl, &board_config));
+    for (int i = 0; i < 100; i++) {
+        current_ctrl_step(&ctrl, 2000, 1000);
+    }
+    CHECK(ctrl.out_q8 > board_config.ff_offset_q8);
+    CHECK(current_ctrl_step(&ctrl, 0, 2000) == board_config.out_min_q8);
+    CHECK(ctrl.integ_q8 == 0);
+
+    // Output never leaves its range, whatever the measurement says
+    for (int i = 0; i < 1000; i++) {
+        int32_t out = current_ctrl_step(&ctrl, 2480, -100000);
+        CHECK(out >= board_config.out_min_q8 && out <= board_config.out_max_q8);
+    }
+}
+
+static void test_sensor_loss(void)
+{
+    current_ctrl_t ctrl;
+    plant_t p;
+    CHECK(current_ctrl_init(&ctrl, &board_config));
+    plant_init(&p, 1.0, 30.0);
+    run(&ctrl, &p, 1000, 500, 0);
+    int32_t held = ctrl.out_q8;
+    int32_t integ = ctrl.integ_q8;
+
+    // The shunt stops converting: the output holds where it was instead of chasing a
+    // dead reading up to the trim limit, and the loss is reported after max_missed periods
+    for (uint32_t i = 1; i <= board_config.max_missed; i++) {
+        CHECK(!current_ctrl_sensor_lost(&ctrl));
+        CHECK(current_ctrl_step_missing(&ctrl, 1000) == held);
+        for (int t_us = 0; t_us < CTRL_PERIOD_US; t_us += SIM_DT_US) {
+            plant_step(&p, held);
+        }
+    }
+    CHECK(current_ctrl_sensor_lost(&ctrl));
+    CHECK(ctrl.integ_q8 == integ);
+    CHECK(p.current_ua > 980 && p.current_ua < 1020);
+
+    // A gap shorter than the limit is forgotten by the next reading
+    current_ctrl_hold(&ctrl, held);
+    for (uint32_t i = 1; i < board_config.max_missed; i++) {
+        current_ctrl_step_missing(&ctrl, 1000);
+    }
+    current_ctrl_step(&ctrl, 1000, plant_measure(&p));
+    current_ctrl_step_missing(&ctrl, 1000);
+    CHECK(!current_ctrl_sensor_lost(&ctrl));
+
+    // Off needs no reading
+    CHECK(current_ctrl_step_missing(&ctrl, 0) == board_config.out_min_q8);
+    CHECK(!current_ctrl_sensor_lost(&ctrl));
+
+    // 0 disables the check
+    current_ctrl_config_t config = board_config;
+    config.max_missed = 0;
+    CHECK(current_ctrl_init(&ctrl, &config));
+    for (int i = 0; i < 1000; i++) {
+        current_ctrl_step_missing(&ctrl, 1000);
+    }
+    CHECK(!current_ctrl_sensor_lost(&ctrl));
+}
+
+static void test_invalid_config(void)
+{
+    current_ctrl_t ctrl;
+    current_ctrl_config_t config = board_config;
+    config.slew_q8 = 0;
+    CHECK(!current_ctrl_init(&ctrl, &config));
+    config = board_config;
+    config.out_min_q8 = config.out_max_q8 + 1;
+    CHECK(!current_ctrl_init(&ctrl, &config));
+    config = board_config;
+    config.ki_q16 = -1;
+    CHECK(!current_ctrl_init(&ctrl, &config));
+}
+
+int main(void)
+{
+    test_tracks_despite_gain_error();
+    test_step_overshoot();
+    test_anti_windup();
+    test_off_is_immediate();
+    test_sensor_loss();
+    test_invalid_config();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All current control tests passed\n");
+    return 0;
+}
@@ -0,0 +1,294 @@
+#include <string.h>
+#include <inttypes.h>
+#include "fault_adc.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "FAULT_ADC";
+
+#define FAULT_ADC_ATTEN             ADC_ATTEN_DB_12
+#define FAULT_ADC_NOMINAL_FS_MV     3100    // Used if eFuse calibration is missing
+#define FAULT_ADC_STATS_INTERVAL_US (10 * 1000 * 1000)
+
+typedef struct {
+    adc_continuous_handle_t handle;
+    fault_adc_config_t config;
+    uint32_t uv_per_code_q8;        // Calibrated slope, Q8 uV per code
+    volatile int32_t hi_codes;
+    volatile int32_t slope_codes;   // 0 = slope check off
+    volatile bool armed;
+    // ISR-only detector state
+    uint32_t run;
+    int32_t prev_mean;
+    bool have_prev;
+    // Shared with readers under lock
+    portMUX_TYPE lock;
+    fault_adc_stats_t stats;
+    int32_t max_drop_codes;
+    int32_t max_rise_codes;
+    esp_timer_handle_t stats_timer;
+    bool started;
+} fault_adc_t;
+
+static fault_adc_t fault_adc = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .hi_codes = INT32_MAX,
+};
+
+// Runs once per DMA frame in ISR context. The frame alternates pos/neg samples; each pair
+// gives one shunt drop in codes. Level trips need debounce_pairs consecutive pairs over
+// the limit; slope trips compare the mean drop of this frame with the previous one.
+static bool IRAM_ATTR fault_adc_on_frame(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata,
+                                         void *user_data)
+{
+    fault_adc_t *f = &fault_adc;
+    const int32_t hi = f->hi_codes;
+    const int32_t slope_limit = f->slope_codes;
+    int32_t pos = -1;
+    int32_t sum = 0;
+    int32_t max_drop = INT32_MIN;
+    uint32_t pairs = 0, over = 0, near_misses = 0;
+    bool level_trip = false, slope_trip = false;
+
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= edata->size; i += SOC_ADC_DIGI_RESULT_BYTES) {
+        // ESP32 DMA output is TYPE1: 4-bit channel, 12-bit data
+        const adc_digi_output_data_t *p = (const adc_digi_output_data_t *)&edata->conv_frame_buffer[i];
+        uint32_t ch = p->type1.channel;
+        int32_t data = p->type1.data;
+        if (ch == f->config.pos_channel) {
+            pos = data;
+            continue;
+        }
+        if (ch != f->config.neg_channel || pos < 0) {
+            continue;
+        }
+
+        int32_t drop = pos - data;
+        pos = -1;
+        pairs++;
+        sum += drop;
+        if (drop > max_drop) {
+            max_drop = drop;
+        }
+        if (drop > hi) {
+            over++;
+            if (++f->run >= f->config.debounce_pairs) {
+                level_trip = true;
+            }
+        } else {
+            if (f->run > 0 && f->run < f->config.debounce_pairs) {
+                near_misses++;
+            }
+            f->run = 0;
+        }
+    }
+    if (pairs == 0) {
+        return false;
+    }
+
+    int32_t mean = sum / (int32_t)pairs;
+    int32_t rise = f->have_prev ? mean - f->prev_mean : 0;
+    f->prev_mean = mean;
+    f->have_prev = true;
+    if (slope_limit > 0 && rise > slope_limit) {
+        slope_trip = true;
+    }
+
+    bool trip = false;
+    portENTER_CRITICAL_ISR(&f->lock);
+    f->stats.frames++;
+    f->stats.over_pairs += over;
+    f->stats.near_misses += near_misses;
+    if (max_drop > f->max_drop_codes) {
+        f->max_drop_codes = max_drop;
+    }
+    if (rise > f->max_rise_codes) {
+        f->max_rise_codes = rise;
+    }
+    if (f->armed && (level_trip || slope_trip)) {
+        f->armed = false;
+        f->stats.level_trips += level_trip;
+        f->stats.slope_trips += slope_trip;
+        trip = true;
+    }
+    portEXIT_CRITICAL_ISR(&f->lock);
+
+    if (trip && f->config.on_trip) {
+        f->config.on_trip(f->config.arg);
+    }
+    return false;
+}
+
+static int32_t fault_adc_uv_to_codes(int32_t uv)
+{
+    return (int32_t)(((int64_t)uv * 256) / fault_adc.uv_per_code_q8);
+}
+
+static int32_t fault_adc_codes_to_uv(int32_t codes)
+{
+    return (int32_t)(((int64_t)codes * fault_adc.uv_per_code_q8) / 256);
+}
+
+static void fault_adc_calibrate(void)
+{
+    int lo_mv = 0, hi_mv = FAULT_ADC_NOMINAL_FS_MV;
+    adc_cali_handle_t cali;
+    adc_cali_line_fitting_config_t cali_config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = FAULT_ADC_ATTEN,
+        .bitwidth = ADC_BITWIDTH_12,
+    };
+
+    // Only the slope matters: the detector works on differences, so the offset cancels
+    if (adc_cali_create_scheme_line_fitting(&cali_config, &cali) == ESP_OK) {
+        adc_cali_raw_to_voltage(cali, 0, &lo_mv);
+        adc_cali_raw_to_voltage(cali, 4095, &hi_mv);
+        adc_cali_delete_scheme_line_fitting(cali);
+    } else {
+        ESP_LOGW(TAG, "No ADC calibration, using nominal %d mV full scale", FAULT_ADC_NOMINAL_FS_MV);
+    }
+    fault_adc.uv_per_code_q8 = (uint32_t)((int64_t)(hi_mv - lo_mv) * 1000 * 256 / 4095);
+}
+
+static void fault_adc_stats_cb(void *arg)
+{
+    fault_adc_stats_t stats;
+    fault_adc_get_stats(&stats);
+    if (stats.frames == 0) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "%" PRIu32 " frames, %" PRIu32 " pairs over, %" PRIu32 " near misses, trips %" PRIu32 " level / %" PRIu32
+             " slope, max drop %" PRId32 " uV, max rise %" PRId32 " uV",
+             stats.frames, stats.over_pairs, stats.near_misses, stats.level_trips, stats.slope_trips,
+             stats.max_drop_uv, stats.max_slope_uv);
+    fault_adc_reset_stats();
+}
+
+esp_err_t fault_adc_start(const fault_adc_config_t *config)
+{
+    if (!config || fault_adc.started || config->frame_pairs == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    fault_adc.config = *config;
+    if (fault_adc.config.debounce_pairs == 0) {
+        fault_adc.config.debounce_pairs = 1;
+    }
+    fault_adc_calibrate();
+    fault_adc_reset_stats();
+
+    uint32_t frame_bytes = config->frame_pairs * 2 * SOC_ADC_DIGI_RESULT_BYTES;
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = frame_bytes * 4,
+        .conv_frame_size = frame_bytes,
+        .flags.flush_pool = true,   // Frames are consumed in the ISR; nobody reads the pool
+    };
+    esp_err_t ret = adc_continuous_new_handle(&handle_config, &fault_adc.handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create continuous ADC handle: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    adc_digi_pattern_config_t pattern[2] = {
+        {
+            .atten = FAULT_ADC_ATTEN,
+            .channel = config->pos_channel,
+            .unit = ADC_UNIT_1,
+            .bit_width = ADC_BITWIDTH_12,
+        },
+        {
+            .atten = FAULT_ADC_ATTEN,
+            .channel = config->neg_channel,
+            .unit = ADC_UNIT_1,
+            .bit_width = ADC_BITWIDTH_12,
+        },
+    };
+    adc_continuous_config_t adc_config = {
+        .pattern_num = 2,
+        .adc_pattern = pattern,
+        .sample_freq_hz = config->sample_freq_hz,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    adc_continuous_evt_cbs_t cbs = {
+        .on_conv_done = fault_adc_on_frame,
+    };
+
+    ret = adc_continuous_config(fault_adc.handle, &adc_config);
+    if (ret == ESP_OK) {
+        ret = adc_continuous_register_event_callbacks(fault_adc.handle, &cbs, NULL);
+    }
+    if (ret == ESP_OK) {
+        ret = adc_continuous_start(fault_adc.handle);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start continuous ADC: %s", esp_err_to_name(ret));
+        adc_continuous_deinit(fault_adc.handle);
+        return ret;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = fault_adc_stats_cb,
+        .name = "fault_adc_stats",
+    };
+    if (esp_timer_create(&timer_args, &fault_adc.stats_timer) == ESP_OK) {
+        esp_timer_start_periodic(fault_adc.stats_timer, FAULT_ADC_STATS_INTERVAL_US);
+    }
+
+    fault_adc.started = true;
+    fault_adc.armed = true;
+    ESP_LOGI(TAG, "Fault ADC running: %" PRIu32 " Hz, %" PRIu32 " pairs/frame (%" PRIu32 " us), %" PRIu32 " uV/code",
+             config->sample_freq_hz, config->frame_pairs,
+             (uint32_t)((uint64_t)config->frame_pairs * 2 * 1000000 / config->sample_freq_hz),
+             fault_adc.uv_per_code_q8 / 256);
+    return ESP_OK;
+}
+
+void fault_adc_set_limits(int32_t hi_uv, int32_t slope_uv)
+{
+    if (!fault_adc.started) {
+        return;
+    }
+
+    fault_adc.hi_codes = fault_adc_uv_to_codes(hi_uv);
+    fault_adc.slope_codes = slope_uv > 0 ? fault_adc_uv_to_codes(slope_uv) : 0;
+}
+
+void fault_adc_rearm(void)
+{
+    if (!fault_adc.started) {
+        return;
+    }
+
+    portENTER_CRITICAL(&fault_adc.lock);
+    fault_adc.run = 0;
+    fault_adc.have_prev = false;
+    fault_adc.armed = true;
+    portEXIT_CRITICAL(&fault_adc.lock);
+}
+
+void fault_adc_get_stats(fault_adc_stats_t *stats)
+{
+    portENTER_CRITICAL(&fault_adc.lock);
+    *stats = fault_adc.stats;
+    int32_t max_drop = fault_adc.max_drop_codes;
+    int32_t max_rise = fault_adc.max_rise_codes;
+    portEXIT_CRITICAL(&fault_adc.lock);
+
+    stats->max_drop_uv = stats->frames ? fault_adc_codes_to_uv(max_drop) : 0;
+    stats->max_slope_uv = stats->frames ? fault_adc_codes_to_uv(max_rise) : 0;
+}
+
+void fault_adc_reset_stats(void)
+{
+    portENTER_CRITICAL(&fault_adc.lock);
+    memset(&fault_adc.stats, 0, sizeof(fault_adc.stats));
+    fault_adc.max_drop_codes = INT32_MIN;
+    fault_adc.max_rise_codes = INT32_MIN;
+    portEXIT_CRITICAL(&fault_adc.lock);
+}
@@ -0,0 +1,49 @@
+#ifndef FAULT_ADC_H
+#define FAULT_ADC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_adc/adc_continuous.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called from the ADC DMA ISR; must be IRAM-safe
+typedef void (*fault_adc_trip_cb_t)(void *arg);
+
+typedef struct {
+    adc_channel_t pos_channel;      // ADC1 channel on the high side of the shunt
+    adc_channel_t neg_channel;      // ADC1 channel on the low side of the shunt
+    uint32_t sample_freq_hz;        // Both channels combined
+    uint32_t frame_pairs;           // Sample pairs per DMA frame (detection granularity)
+    uint8_t debounce_pairs;         // Consecutive over-threshold pairs before a level trip
+    fault_adc_trip_cb_t on_trip;
+    void *arg;
+} fault_adc_config_t;
+
+typedef struct {
+    uint32_t frames;                // DMA frames analysed
+    uint32_t over_pairs;            // Pairs above the level threshold
+    uint32_t near_misses;           // Runs above the threshold that ended before debounce
+    uint32_t level_trips;
+    uint32_t slope_trips;
+    int32_t max_drop_uv;            // Largest single-pair shunt drop seen
+    int32_t max_slope_uv;           // Largest frame-to-frame rise in mean drop
+} fault_adc_stats_t;
+
+esp_err_t fault_adc_start(const fault_adc_config_t *config);
+// Shunt drop thresholds in ADC-referenced microvolts (same scale as the ADS1115 window).
+// slope_uv is the largest allowed rise in mean drop between consecutive frames; 0 disables.
+void fault_adc_set_limits(int32_t hi_uv, int32_t slope_uv);
+// Re-arm after a trip; the detector stays quiet until then
+void fault_adc_rearm(void);
+void fault_adc_get_stats(fault_adc_stats_t *stats);
+void fault_adc_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FAULT_ADC_H
@@ -0,0 +1,84 @@
+#include <string.h>
+#include "ota_patch.h"
+
+#define OTA_PATCH_COPY_CHUNK    256     // Stack buffer for base reads
+
+static uint32_t ota_patch_be32(const uint8_t *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+static size_t ota_patch_header_len(uint8_t op)
+{
+    return op == OTA_PATCH_OP_COPY ? 9 : op == OTA_PATCH_OP_INSERT ? 5 : 0;
+}
+
+static bool ota_patch_copy(ota_patch_t *patch, uint32_t offset, uint32_t len)
+{
+    if (offset > patch->io.base_size || len > patch->io.base_size - offset) {
+        return false;
+    }
+    uint8_t buf[OTA_PATCH_COPY_CHUNK];
+    while (len > 0) {
+        uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+        if (!patch->io.read_base(patch->io.ctx, offset, buf, n) || !patch->io.write(patch->io.ctx, buf, n)) {
+            return false;
+        }
+        offset += n;
+        len -= n;
+        patch->written += n;
+    }
+    return true;
+}
+
+void ota_patch_init(ota_patch_t *patch, const ota_patch_io_t *io)
+{
+    memset(patch, 0, sizeof(*patch));
+    patch->io = *io;
+}
+
+bool ota_patch_feed(ota_patch_t *patch, const uint8_t *data, size_t len)
+{
+    while (len > 0 && !patch->failed) {
+        if (patch->insert_left > 0) {
+            uint32_t n = len < patch->insert_left ? len : patch->insert_left;
+            if (!patch->io.write(patch->io.ctx, data, n)) {
+                patch->failed = true;
+                break;
+            }
+            patch->insert_left -= n;
+            patch->written += n;
+            data += n;
+            len -= n;
+            continue;
+        }
+
+        // Gather the op header, which may be split across inputs
+        if (patch->header_len == 0 && ota_patch_header_len(data[0]) == 0) {
+            patch->failed = true;
+            break;
+        }
+        size_t need = ota_patch_header_len(patch->header_len ? patch->header[0] : data[0]) - patch->header_len;
+        size_t n = len < need ? len : need;
+        memcpy(&patch->header[patch->header_len], data, n);
+        patch->header_len += n;
+        data += n;
+        len -= n;
+        if (n < need) {
+            break;
+        }
+
+        if (patch->header[0] == OTA_PATCH_OP_COPY) {
+            patch->failed = !ota_patch_copy(patch, ota_patch_be32(&patch->header[1]), ota_patch_be32(&patch->header[5]));
+        } else {
+            patch->insert_left = ota_patch_be32(&patch->header[1]);
+        }
+        patch->header_len = 0;
+    }
+    return !patch->failed;
+}
+
+bool ota_patch_complete(const ota_patch_t *patch)
+{
+    return !patch->failed && patch->header_len == 0 && patch->insert_left == 0;
+}
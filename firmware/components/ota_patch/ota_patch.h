@@ -0,0 +1,48 @@
+#ifndef OTA_PATCH_H
+#define OTA_PATCH_H
+
+// Streaming decoder for delta firmware images: the new image is rebuilt from ranges of
+// the running image and literal bytes. Input arrives in pieces of any size (as inflated
+// from the transfer); output goes straight to the write callback. No IDF dependencies so
+// it also builds on the host (see test/). Produced by tools/ota_image.py.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Ops, big endian:
+#define OTA_PATCH_OP_COPY       0x01    // [base offset u32][length u32]: bytes of the running image
+#define OTA_PATCH_OP_INSERT     0x02    // [length u32][bytes]: literal bytes
+#define OTA_PATCH_OP_MAX_HEADER 9
+
+typedef struct {
+    bool (*read_base)(void *ctx, uint32_t offset, void *buf, size_t len);
+    bool (*write)(void *ctx, const void *buf, size_t len);
+    void *ctx;
+    uint32_t base_size;         // COPY ranges must lie inside the base image
+} ota_patch_io_t;
+
+typedef struct {
+    ota_patch_io_t io;
+    uint8_t header[OTA_PATCH_OP_MAX_HEADER];
+    uint8_t header_len;
+    uint32_t insert_left;       // Literal bytes still to pass through
+    uint32_t written;
+    bool failed;
+} ota_patch_t;
+
+void ota_patch_init(ota_patch_t *patch, const ota_patch_io_t *io);
+// False on a malformed op or a callback failure; the patch stays failed
+bool ota_patch_feed(ota_patch_t *patch, const uint8_t *data, size_t len);
+// True if the input ended on an op boundary
+bool ota_patch_complete(const ota_patch_t *patch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_PATCH_H
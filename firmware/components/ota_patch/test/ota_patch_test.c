@@ -0,0 +1,129 @@
+// Host tests for the delta decoder: ops split at every possible point, bad ranges and ops.
+//
+//   cc -O2 -Wall -Wextra -I.. ota_patch_test.c ../ota_patch.c -o ota_patch_test && ./ota_patch_test
+
+#include <stdio.h>
+#include <string.h>
+#include "ota_patch.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static uint8_t base[1024];
+static uint8_t out[2048];
+static size_t out_len;
+
+static bool read_base(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    (void)ctx;
+    memcpy(buf, &base[offset], len);
+    return true;
+}
+
+static bool write_out(void *ctx, const void *buf, size_t len)
+{
+    (void)ctx;
+    if (out_len + len > sizeof(out)) {
+        return false;
+    }
+    memcpy(&out[out_len], buf, len);
+    out_len += len;
+    return true;
+}
+
+static const ota_patch_io_t io = {
+    .read_base = read_base, .write = write_out, .base_size = sizeof(base),
+};
+
+// COPY 600 bytes from 100, INSERT "NEW", COPY 10 bytes from 1014 (end of base)
+static const uint8_t patch_ops[] = {
+    OTA_PATCH_OP_COPY, 0, 0, 0, 100, 0, 0, 0x02, 0x58,
+    OTA_PATCH_OP_INSERT, 0, 0, 0, 3, 'N', 'E', 'W',
+    OTA_PATCH_OP_COPY, 0, 0, 0x03, 0xF6, 0, 0, 0, 10,
+};
+
+static void check_output(void)
+{
+    CHECK(out_len == 613);
+    CHECK(memcmp(out, &base[100], 600) == 0);
+    CHECK(memcmp(&out[600], "NEW", 3) == 0);
+    CHECK(memcmp(&out[603], &base[1014], 10) == 0);
+}
+
+static void test_whole_and_split(void)
+{
+    ota_patch_t patch;
+    ota_patch_init(&patch, &io);
+    out_len = 0;
+    CHECK(ota_patch_feed(&patch, patch_ops, sizeof(patch_ops)));
+    CHECK(ota_patch_complete(&patch));
+    CHECK(patch.written == 613);
+    check_output();
+
+    // Every split point, and one byte at a time
+    for (size_t split = 1; split < sizeof(patch_ops); split++) {
+        ota_patch_init(&patch, &io);
+        out_len = 0;
+        CHECK(ota_patch_feed(&patch, patch_ops, split));
+        CHECK(!ota_patch_complete(&patch) || split == 9 || split == 17);
+        CHECK(ota_patch_feed(&patch, &patch_ops[split], sizeof(patch_ops) - split));
+        CHECK(ota_patch_complete(&patch));
+        check_output();
+    }
+    ota_patch_init(&patch, &io);
+    out_len = 0;
+    for (size_t i = 0; i < sizeof(patch_ops); i++) {
+        CHECK(ota_patch_feed(&patch, &patch_ops[i], 1));
+    }
+    CHECK(ota_patch_complete(&patch));
+    check_output();
+}
+
+static void test_rejects(void)
+{
+    ota_patch_t patch;
+
+    // Copy past the end of the base image
+    const uint8_t past_end[] = { OTA_PATCH_OP_COPY, 0, 0, 0x03, 0xF6, 0, 0, 0, 11 };
+    ota_patch_init(&patch, &io);
+    CHECK(!ota_patch_feed(&patch, past_end, sizeof(past_end)));
+    CHECK(!ota_patch_complete(&patch));
+
+    // Offset overflow must not wrap into range
+    const uint8_t wrap[] = { OTA_PATCH_OP_COPY, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 2 };
+    ota_patch_init(&patch, &io);
+    CHECK(!ota_patch_feed(&patch, wrap, sizeof(wrap)));
+
+    // Unknown op; the patch stays failed
+    const uint8_t unknown[] = { 0x07, 0, 0 };
+    ota_patch_init(&patch, &io);
+    CHECK(!ota_patch_feed(&patch, unknown, sizeof(unknown)));
+    CHECK(!ota_patch_feed(&patch, patch_ops, sizeof(patch_ops)));
+
+    // Truncated insert
+    ota_patch_init(&patch, &io);
+    CHECK(ota_patch_feed(&patch, &patch_ops[9], 6));
+    CHECK(!ota_patch_complete(&patch));
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(base); i++) {
+        base[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    test_whole_and_split();
+    test_rejects();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All patch tests passed\n");
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include <string.h>
+#include "session_log.h"
+
+#define SESSION_LOG_CHUNK   64      // Stack buffer for scans and CRC checks
+
+static uint32_t session_log_sector_addr(const session_log_t *log, uint32_t seq)
+{
+    return (seq % log->num_sectors) * SESSION_LOG_SECTOR_SIZE;
+}
+
+static void session_log_put_be32(uint8_t *out, uint32_t v)
+{
+    out[0] = v >> 24;
+    out[1] = v >> 16;
+    out[2] = v >> 8;
+    out[3] = v;
+}
+
+static uint32_t session_log_get_be32(const uint8_t *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+uint16_t session_log_crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+    // CRC-16/CCITT-FALSE; start with 0xFFFF
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static bool session_log_header_valid(session_log_t *log, uint32_t seq)
+{
+    uint8_t hdr[SESSION_LOG_SECTOR_HEADER];
+    if (!log->flash.read(log->flash.ctx, session_log_sector_addr(log, seq), hdr, sizeof(hdr))) {
+        return false;
+    }
+    return session_log_get_be32(hdr) == SESSION_LOG_MAGIC && session_log_get_be32(&hdr[4]) == seq;
+}
+
+// True if [addr, addr + len) reads as erased flash
+static bool session_log_is_erased(session_log_t *log, uint32_t addr, uint32_t len)
+{
+    uint8_t buf[SESSION_LOG_CHUNK];
+    while (len > 0) {
+        uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+        if (!log->flash.read(log->flash.ctx, addr, buf, n)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (buf[i] != 0xFF) {
+                return false;
+            }
+        }
+        addr += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+static bool session_log_new_sector(session_log_t *log, uint32_t seq)
+{
+    uint32_t addr = session_log_sector_addr(log, seq);
+    if (log->erased_ahead > 0) {
+        log->erased_ahead--;
+    } else if (!log->flash.erase_sector(log->flash.ctx, addr)) {
+        return false;
+    }
+
+    uint8_t hdr[SESSION_LOG_SECTOR_HEADER];
+    session_log_put_be32(hdr, SESSION_LOG_MAGIC);
+    session_log_put_be32(&hdr[4], seq);
+    if (!log->flash.write(log->flash.ctx, addr, hdr, sizeof(hdr))) {
+        return false;
+    }
+    log->head_seq = seq;
+    log->head_pos = 0;
+    return true;
+}
+
+// Walk the head sector's records to the first free byte. Anything that does not check out
+// closes the sector: the data before it stays readable, new records go to the next sector.
+static void session_log_find_end(session_log_t *log)
+{
+    uint32_t base = session_log_sector_addr(log, log->head_seq) + SESSION_LOG_SECTOR_HEADER;
+    uint32_t pos = 0;
+
+    while (pos + SESSION_LOG_RECORD_HEADER <= SESSION_LOG_SECTOR_DATA) {
+        uint8_t hdr[SESSION_LOG_RECORD_HEADER];
+        if (!log->flash.read(log->flash.ctx, base + pos, hdr, sizeof(hdr))) {
+            break;
+        }
+        if (hdr[0] == SESSION_LOG_PAD) {
+            // The header is written last, so a record torn mid-payload leaves programmed
+            // bytes behind an erased header; those cannot be written over
+            if (session_log_is_erased(log, base + pos, SESSION_LOG_SECTOR_DATA - pos)) {
+                log->head_pos = pos;
+                return;
+            }
+            break;
+        }
+
+        uint32_t len = ((uint32_t)hdr[1] << 8) | hdr[2];
+        if (pos + SESSION_LOG_RECORD_HEADER + len > SESSION_LOG_SECTOR_DATA) {
+            break;
+        }
+        uint16_t crc = session_log_crc16(0xFFFF, hdr, 3);
+        uint8_t buf[SESSION_LOG_CHUNK];
+        uint32_t addr = base + pos + SESSION_LOG_RECORD_HEADER;
+        bool ok = true;
+        for (uint32_t left = len; left > 0 && ok;) {
+            uint32_t n = left < sizeof(buf) ? left : sizeof(buf);
+            ok = log->flash.read(log->flash.ctx, addr, buf, n);
+            crc = session_log_crc16(crc, buf, n);
+            addr += n;
+            left -= n;
+        }
+        if (!ok || crc != (((uint16_t)hdr[3] << 8) | hdr[4])) {
+            break;
+        }
+        pos += SESSION_LOG_RECORD_HEADER + len;
+    }
+    log->head_pos = SESSION_LOG_SECTOR_DATA;
+}
+
+bool session_log_mount(session_log_t *log, const session_log_flash_t *flash)
+{
+    memset(log, 0, sizeof(*log));
+    log->flash = *flash;
+    log->num_sectors = flash->size / SESSION_LOG_SECTOR_SIZE;
+    if (log->num_sectors < 3) {
+        return false;
+    }
+
+    // Newest sector: the highest sequence whose header matches its slot in the ring
+    bool found = false;
+    for (uint32_t i = 0; i < log->num_sectors; i++) {
+        uint8_t hdr[SESSION_LOG_SECTOR_HEADER];
+        if (!flash->read(flash->ctx, i * SESSION_LOG_SECTOR_SIZE, hdr, sizeof(hdr))) {
+            return false;
+        }
+        uint32_t seq = session_log_get_be32(&hdr[4]);
+        if (session_log_get_be32(hdr) != SESSION_LOG_MAGIC || seq % log->num_sectors != i) {
+            continue;
+        }
+        if (!found || seq > log->head_seq) {
+            log->head_seq = seq;
+            found = true;
+        }
+    }
+    if (!found) {
+        // New log; a factory-blank first sector needs no erase either
+        log->erased_ahead = session_log_is_erased(log, 0, SESSION_LOG_SECTOR_SIZE) ? 1 : 0;
+        if (!session_log_new_sector(log, 0)) {
+            return false;
+        }
+    } else {
+        session_log_find_end(log);
+    }
+
+    // Sectors after the head that are still blank need no erase before use
+    while (log->erased_ahead < log->num_sectors - 2) {
+        uint32_t seq = log->head_seq + log->erased_ahead + 1;
+        if (!session_log_is_erased(log, session_log_sector_addr(log, seq), SESSION_LOG_SECTOR_SIZE)) {
+            break;
+        }
+        log->erased_ahead++;
+    }
+
+    // Oldest: walk back while the sectors still carry their own sequence numbers
+    log->tail_seq = log->head_seq;
+    while (log->tail_seq > 0 && log->head_seq - log->tail_seq < log->num_sectors - 1 - log->erased_ahead &&
+           session_log_header_valid(log, log->tail_seq - 1)) {
+        log->tail_seq--;
+    }
+    return true;
+}
+
+bool session_log_append(session_log_t *log, uint8_t type, const uint8_t *data, size_t len)
+{
+    if (len > SESSION_LOG_MAX_RECORD || type == SESSION_LOG_PAD) {
+        return false;
+    }
+    if (log->head_pos + SESSION_LOG_RECORD_HEADER + len > SESSION_LOG_SECTOR_DATA) {
+        if (!session_log_new_sector(log, log->head_seq + 1)) {
+            return false;
+        }
+    }
+
+    uint8_t hdr[SESSION_LOG_RECORD_HEADER] = { type, len >> 8, len & 0xFF };
+    uint16_t crc = session_log_crc16(session_log_crc16(0xFFFF, hdr, 3), data, len);
+    hdr[3] = crc >> 8;
+    hdr[4] = crc & 0xFF;
+
+    uint32_t addr = session_log_sector_addr(log, log->head_seq) + SESSION_LOG_SECTOR_HEADER + log->head_pos;
+    // Payload first: until the header lands the record reads as free space
+    if ((len > 0 && !log->flash.write(log->flash.ctx, addr + SESSION_LOG_RECORD_HEADER, data, len)) ||
+        !log->flash.write(log->flash.ctx, addr, hdr, sizeof(hdr))) {
+        log->head_pos = SESSION_LOG_SECTOR_DATA;
+        return false;
+    }
+    log->head_pos += SESSION_LOG_RECORD_HEADER + len;
+    return true;
+}
+
+bool session_log_erase_ahead(session_log_t *log, uint32_t target)
+{
+    if (target > log->num_sectors - 2) {
+        target = log->num_sectors - 2;
+    }
+    if (log->erased_ahead >= target) {
+        return false;
+    }
+    uint32_t seq = log->head_seq + log->erased_ahead + 1;
+    if (!log->flash.erase_sector(log->flash.ctx, session_log_sector_addr(log, seq))) {
+        return false;
+    }
+    log->erased_ahead++;
+    return true;
+}
+
+// Oldest sequence still on flash: the ring holds the head, the sectors erased ahead of it
+// and whatever is left of the laps before
+static uint32_t session_log_tail(const session_log_t *log)
+{
+    uint32_t ring = log->erased_ahead + 1;
+    if (log->head_seq + ring > log->num_sectors) {
+        uint32_t oldest = log->head_seq + ring - log->num_sectors;
+        return log->tail_seq > oldest ? log->tail_seq : oldest;
+    }
+    return log->tail_seq;
+}
+
+uint32_t session_log_start(const session_log_t *log)
+{
+    return session_log_tail(log) * SESSION_LOG_SECTOR_DATA;
+}
+
+uint32_t session_log_end(const session_log_t *log)
+{
+    return log->head_seq * SESSION_LOG_SECTOR_DATA + log->head_pos;
+}
+
+size_t session_log_read(session_log_t *log, uint32_t offset, uint8_t *buf, size_t cap)
+{
+    uint32_t seq = offset / SESSION_LOG_SECTOR_DATA;
+    uint32_t pos = offset % SESSION_LOG_SECTOR_DATA;
+    if (seq < session_log_tail(log) || seq > log->head_seq) {
+        return 0;
+    }
+    uint32_t limit = seq == log->head_seq ? log->head_pos : SESSION_LOG_SECTOR_DATA;
+    if (pos >= limit) {
+        return 0;
+    }
+    size_t n = limit - pos < cap ? limit - pos : cap;
+
+    if (!session_log_header_valid(log, seq)) {
+        // Lost to a torn sector start; reads as an empty sector
+        memset(buf, SESSION_LOG_PAD, n);
+        return n;
+    }
+    uint32_t addr = session_log_sector_addr(log, seq) + SESSION_LOG_SECTOR_HEADER + pos;
+    return log->flash.read(log->flash.ctx, addr, buf, n) ? n : 0;
+}
+
+bool session_log_clear(session_log_t *log)
+{
+    // Zero the magic of every sector in use (no erase needed to clear bits) so a remount
+    // does not find them, then carry on in a fresh sector
+    static const uint8_t zero[4] = { 0 };
+    for (uint32_t seq = session_log_tail(log); seq <= log->head_seq; seq++) {
+        if (!log->flash.write(log->flash.ctx, session_log_sector_addr(log, seq), zero, sizeof(zero))) {
+            return false;
+        }
+    }
+    if (!session_log_new_sector(log, log->head_seq + 1)) {
+        return false;
+    }
+    log->tail_seq = log->head_seq;
+    return true;
+}
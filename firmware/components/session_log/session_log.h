@@ -0,0 +1,76 @@
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+// Append-only record log in a ring of flash sectors. Sector n of the ring holds sequence
+// numbers n, n + N, n + 2N, ... so a byte's place in the log (its offset) never changes
+// while it is on flash, and downloads can resume across reconnects and reboots. Every
+// sector is erased once per lap, so wear is spread evenly. No IDF dependencies so it
+// also builds on the host (see test/); the flash itself is behind session_log_flash_t.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SESSION_LOG_SECTOR_SIZE     4096
+#define SESSION_LOG_SECTOR_HEADER   8       // Magic, sector sequence number
+#define SESSION_LOG_SECTOR_DATA     (SESSION_LOG_SECTOR_SIZE - SESSION_LOG_SECTOR_HEADER)
+#define SESSION_LOG_RECORD_HEADER   5       // Type, length (BE), CRC-16 of type, length and payload (BE)
+#define SESSION_LOG_MAX_RECORD      (SESSION_LOG_SECTOR_DATA - SESSION_LOG_RECORD_HEADER)
+#define SESSION_LOG_MAGIC           0x544C4731  // "TLG1"
+
+// Record types. Erased flash reads as SESSION_LOG_PAD: the rest of the sector is unused.
+#define SESSION_LOG_PAD             0xFF
+
+typedef struct {
+    bool (*read)(void *ctx, uint32_t addr, void *buf, size_t len);
+    bool (*write)(void *ctx, uint32_t addr, const void *buf, size_t len);
+    bool (*erase_sector)(void *ctx, uint32_t addr);
+    void *ctx;
+    uint32_t size;                  // Bytes, a multiple of the sector size, at least 3 sectors
+} session_log_flash_t;
+
+typedef struct {
+    session_log_flash_t flash;
+    uint32_t num_sectors;
+    uint32_t tail_seq;              // Oldest sector with data, before ring wrap-around
+    uint32_t head_seq;              // Sector being written
+    uint32_t head_pos;              // Write position in its data area
+    uint32_t erased_ahead;          // Sectors after the head already erased for the next laps
+} session_log_t;
+
+// Find the newest sector and the end of its records. A torn record (power lost mid-write)
+// closes its sector; the next append starts a new one. An empty flash starts a new log.
+bool session_log_mount(session_log_t *log, const session_log_flash_t *flash);
+
+// Append one record, starting a new sector if it does not fit in this one. False on flash
+// errors or len > SESSION_LOG_MAX_RECORD.
+bool session_log_append(session_log_t *log, uint8_t type, const uint8_t *data, size_t len);
+
+// Erase one more sector ahead of the head, up to `target` sectors ahead, so appends do not
+// wait on an erase. The oldest data goes a little early. False if nothing was left to do.
+bool session_log_erase_ahead(session_log_t *log, uint32_t target);
+
+// Oldest and one-past-newest offsets. Offsets are sequence * SESSION_LOG_SECTOR_DATA +
+// position, so the data of one sector is contiguous and sectors follow each other.
+uint32_t session_log_start(const session_log_t *log);
+uint32_t session_log_end(const session_log_t *log);
+
+// Copy up to `cap` bytes from `offset`, stopping at the end of the sector or of the log.
+// Unused sector space reads as SESSION_LOG_PAD. Returns the byte count, 0 at the end or
+// if offset is older than session_log_start().
+size_t session_log_read(session_log_t *log, uint32_t offset, uint8_t *buf, size_t cap);
+
+// Drop everything; the log continues at a new sector so old offsets are not reused
+bool session_log_clear(session_log_t *log);
+
+uint16_t session_log_crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SESSION_LOG_H
@@ -0,0 +1,32 @@
+#include "session_log_partition.h"
+
+static bool session_log_partition_read(void *ctx, uint32_t addr, void *buf, size_t len)
+{
+    return esp_partition_read(ctx, addr, buf, len) == ESP_OK;
+}
+
+static bool session_log_partition_write(void *ctx, uint32_t addr, const void *buf, size_t len)
+{
+    return esp_partition_write(ctx, addr, buf, len) == ESP_OK;
+}
+
+static bool session_log_partition_erase(void *ctx, uint32_t addr)
+{
+    return esp_partition_erase_range(ctx, addr, SESSION_LOG_SECTOR_SIZE) == ESP_OK;
+}
+
+esp_err_t session_log_partition_flash(const esp_partition_t *part, session_log_flash_t *flash)
+{
+    if (part == NULL || part->type != ESP_PARTITION_TYPE_DATA ||
+        part->erase_size != SESSION_LOG_SECTOR_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *flash = (session_log_flash_t){
+        .read = session_log_partition_read,
+        .write = session_log_partition_write,
+        .erase_sector = session_log_partition_erase,
+        .ctx = (void *)part,
+        .size = part->size - part->size % SESSION_LOG_SECTOR_SIZE,
+    };
+    return ESP_OK;
+}
@@ -0,0 +1,21 @@
+#ifndef SESSION_LOG_PARTITION_H
+#define SESSION_LOG_PARTITION_H
+
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "session_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Flash operations on a data partition. Writes and erases stall code running from flash
+// on both cores for their duration (an erase is tens of milliseconds); erase ahead with
+// session_log_erase_ahead() while nothing time-critical is running.
+esp_err_t session_log_partition_flash(const esp_partition_t *part, session_log_flash_t *flash);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SESSION_LOG_PARTITION_H
@@ -0,0 +1,273 @@
+// Host tests for the flash ring against a RAM flash with NOR semantics (writes only clear
+// bits, erase sets a sector to 0xFF).
+//
+//   cc -O2 -I.. session_log_test.c ../session_log.c -o session_log_test && ./session_log_test
+
+#include <stdio.h>
+#include <string.h>
+#include "session_log.h"
+
+#define TEST_SECTORS    6
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+typedef struct {
+    uint8_t mem[TEST_SECTORS * SESSION_LOG_SECTOR_SIZE];
+    int erases[TEST_SECTORS];
+    int write_budget;           // Bytes left before simulated power loss, -1 = unlimited
+} ram_flash_t;
+
+static bool ram_read(void *ctx, uint32_t addr, void *buf, size_t len)
+{
+    ram_flash_t *f = ctx;
+    memcpy(buf, &f->mem[addr], len);
+    return true;
+}
+
+static bool ram_write(void *ctx, uint32_t addr, const void *buf, size_t len)
+{
+    ram_flash_t *f = ctx;
+    const uint8_t *in = buf;
+    for (size_t i = 0; i < len; i++) {
+        if (f->write_budget == 0) {
+            return false;
+        }
+        if (f->write_budget > 0) {
+            f->write_budget--;
+        }
+        f->mem[addr + i] &= in[i];
+    }
+    return true;
+}
+
+static bool ram_erase(void *ctx, uint32_t addr)
+{
+    ram_flash_t *f = ctx;
+    memset(&f->mem[addr], 0xFF, SESSION_LOG_SECTOR_SIZE);
+    f->erases[addr / SESSION_LOG_SECTOR_SIZE]++;
+    return true;
+}
+
+static ram_flash_t ram;
+
+static session_log_flash_t ram_flash_init(void)
+{
+    memset(ram.mem, 0xFF, sizeof(ram.mem));
+    memset(ram.erases, 0, sizeof(ram.erases));
+    ram.write_budget = -1;
+    return (session_log_flash_t){
+        .read = ram_read, .write = ram_write, .erase_sector = ram_erase,
+        .ctx = &ram, .size = sizeof(ram.mem),
+    };
+}
+
+// Walks records from `offset` the way a downloading client does, checking each payload
+// carries its own index; returns the number of records found and the first index
+static int walk_records(session_log_t *log, uint32_t offset, int *first)
+{
+    static uint8_t buf[TEST_SECTORS * SESSION_LOG_SECTOR_DATA];
+    size_t len = 0, n;
+    while ((n = session_log_read(log, offset + len, &buf[len], 100)) > 0) {
+        len += n;
+    }
+
+    int count = 0;
+    size_t pos = 0;
+    while (pos + SESSION_LOG_RECORD_HEADER <= len) {
+        size_t sector_left = SESSION_LOG_SECTOR_DATA - (offset + pos) % SESSION_LOG_SECTOR_DATA;
+        const uint8_t *r = &buf[pos];
+        size_t rlen = ((size_t)r[1] << 8) | r[2];
+        if (r[0] == SESSION_LOG_PAD || pos + SESSION_LOG_RECORD_HEADER + rlen > len) {
+            pos += sector_left;
+            continue;
+        }
+        uint16_t crc = session_log_crc16(session_log_crc16(0xFFFF, r, 3), &r[5], rlen);
+        CHECK(crc == (((uint16_t)r[3] << 8) | r[4]));
+        int index;
+        memcpy(&index, &r[5], sizeof(index));
+        if (count == 0) {
+            *first = index;
+        } else {
+            CHECK(index == *first + count);
+        }
+        count++;
+        pos += SESSION_LOG_RECORD_HEADER + rlen;
+    }
+    return count;
+}
+
+static bool append_index(session_log_t *log, int index, size_t len)
+{
+    uint8_t payload[200];
+    memset(payload, index & 0xFF, sizeof(payload));
+    memcpy(payload, &index, sizeof(index));
+    return session_log_append(log, 0x01, payload, len);
+}
+
+static void test_append_and_remount(void)
+{
+    session_log_flash_t flash = ram_flash_init();
+    session_log_t log;
+    CHECK(session_log_mount(&log, &flash));
+    CHECK(session_log_start(&log) == 0);
+    CHECK(session_log_end(&log) == 0);
+
+    for (int i = 0; i < 100; i++) {
+        CHECK(append_index(&log, i, 100));
+    }
+    uint32_t end = session_log_end(&log);
+    CHECK(end > 2 * SESSION_LOG_SECTOR_DATA);
+
+    // Same offsets after a reboot
+    session_log_t again;
+    CHECK(session_log_mount(&again, &flash));
+    CHECK(session_log_end(&again) == end);
+    CHECK(session_log_start(&again) == 0);
+    int first = -1;
+    CHECK(walk_records(&again, 0, &first) == 100);
+    CHECK(first == 0);
+
+    CHECK(append_index(&again, 100, 10));
+    CHECK(session_log_end(&again) == end + SESSION_LOG_RECORD_HEADER + 10);
+}
+
+static void test_wraparound_wear(void)
+{
+    session_log_flash_t flash = ram_flash_init();
+    session_log_t log;
+    CHECK(session_log_mount(&log, &flash));
+
+    int n = 0;
+    for (; n < 2000; n++) {
+        CHECK(append_index(&log, n, 120));
+    }
+    uint32_t start = session_log_start(&log);
+    CHECK(start > 0);
+    CHECK(session_log_end(&log) - start <= TEST_SECTORS * SESSION_LOG_SECTOR_DATA);
+
+    // Oldest surviving records are still contiguous up to the newest
+    int first = -1;
+    int count = walk_records(&log, start, &first);
+    CHECK(first + count == n);
+    CHECK(count > 100);
+
+    // Overwritten data is gone
+    uint8_t b;
+    CHECK(session_log_read(&log, start - 1, &b, 1) == 0);
+
+    // Every sector erased the same number of times, give or take one lap
+    for (int i = 1; i < TEST_SECTORS; i++) {
+        CHECK(ram.erases[i] - ram.erases[0] <= 1 && ram.erases[0] - ram.erases[i] <= 1);
+    }
+
+    session_log_t again;
+    CHECK(session_log_mount(&again, &flash));
+    CHECK(session_log_start(&again) == start);
+    CHECK(session_log_end(&again) == session_log_end(&log));
+}
+
+static void test_torn_record(void)
+{
+    session_log_flash_t flash = ram_flash_init();
+    session_log_t log;
+    CHECK(session_log_mount(&log, &flash));
+    CHECK(append_index(&log, 0, 50));
+    CHECK(append_index(&log, 1, 50));
+
+    // Power lost halfway through the payload: header never written
+    ram.write_budget = 30;
+    CHECK(!append_index(&log, 2, 50));
+    ram.write_budget = -1;
+
+    session_log_t again;
+    CHECK(session_log_mount(&again, &flash));
+    CHECK(session_log_end(&again) == SESSION_LOG_SECTOR_DATA);  // Sector closed
+    CHECK(append_index(&again, 2, 50));
+    CHECK(session_log_end(&again) == SESSION_LOG_SECTOR_DATA + SESSION_LOG_RECORD_HEADER + 50);
+
+    int first = -1;
+    CHECK(walk_records(&again, 0, &first) == 3);
+    CHECK(first == 0);
+
+    // Corrupt payload behind a valid header also closes the sector, keeping what came before
+    ram.mem[SESSION_LOG_SECTOR_SIZE + SESSION_LOG_SECTOR_HEADER + SESSION_LOG_RECORD_HEADER + 8] = 0;
+    CHECK(session_log_mount(&again, &flash));
+    CHECK(session_log_end(&again) == 2 * SESSION_LOG_SECTOR_DATA);
+}
+
+static void test_erase_ahead_and_clear(void)
+{
+    session_log_flash_t flash = ram_flash_init();
+    session_log_t log;
+    CHECK(session_log_mount(&log, &flash));
+    // A blank flash is already erased ahead
+    CHECK(log.erased_ahead == TEST_SECTORS - 2);
+
+    for (int i = 0; i < 300; i++) {
+        CHECK(append_index(&log, i, 120));
+    }
+    int erases = 0;
+    while (session_log_erase_ahead(&log, 2)) {
+        erases++;
+    }
+    CHECK(log.erased_ahead == 2);
+    CHECK(session_log_end(&log) - session_log_start(&log) <= (TEST_SECTORS - 2) * SESSION_LOG_SECTOR_DATA);
+
+    // Appends use the erased sectors without erasing again
+    int before[TEST_SECTORS];
+    memcpy(before, ram.erases, sizeof(before));
+    for (int i = 0; i < 40; i++) {
+        CHECK(append_index(&log, 300 + i, 120));
+    }
+    CHECK(memcmp(before, ram.erases, sizeof(before)) == 0);
+
+    session_log_t again;
+    CHECK(session_log_mount(&again, &flash));
+    CHECK(again.erased_ahead == log.erased_ahead);
+    CHECK(session_log_start(&again) == session_log_start(&log));
+
+    uint32_t end = session_log_end(&again);
+    CHECK(session_log_clear(&again));
+    CHECK(session_log_start(&again) >= end);
+    CHECK(session_log_end(&again) == session_log_start(&again));
+    CHECK(session_log_mount(&log, &flash));
+    CHECK(session_log_start(&log) == session_log_start(&again));
+    CHECK(session_log_end(&log) == session_log_start(&again));
+}
+
+static void test_invalid(void)
+{
+    session_log_flash_t flash = ram_flash_init();
+    session_log_t log;
+    CHECK(session_log_mount(&log, &flash));
+    static uint8_t big[SESSION_LOG_MAX_RECORD + 1];
+    CHECK(!session_log_append(&log, 0x01, big, sizeof(big)));
+    CHECK(session_log_append(&log, 0x01, big, SESSION_LOG_MAX_RECORD));
+    CHECK(!session_log_append(&log, SESSION_LOG_PAD, big, 1));
+
+    flash.size = 2 * SESSION_LOG_SECTOR_SIZE;
+    CHECK(!session_log_mount(&log, &flash));
+}
+
+int main(void)
+{
+    test_append_and_remount();
+    test_wraparound_wear();
+    test_torn_record();
+    test_erase_ahead_and_clear();
+    test_invalid();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All session log tests passed\n");
+    return 0;
+}
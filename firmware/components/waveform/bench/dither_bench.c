@@ -0,0 +1,120 @@
+// Host benchmark: sigma-delta dithered DC output against plain rounding, through a
+// simulated first-order output filter, plus the fill cost per sample.
+//
+//   cc -O2 -I.. dither_bench.c ../waveform.c -lm -o dither_bench && ./dither_bench
+//
+// The filter is taken as Rdac1 (1k) into C1 (1 uF), a 1 ms time constant; the DAC as
+// ideal steps of the nominal transfer. Host timings only rank the options: the ESP32 runs
+// the fill loop roughly an order of magnitude slower.
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include "waveform.h"
+
+#define UA_PER_CODE     (2480.0 * 3300 / (255 * 2500))
+#define FILTER_TAU_S    1e-3
+#define SETTLE_S        20e-3
+#define MEASURE_S       20e-3
+#define BASE_STEP       128     // Mid-range; the sweep covers one DAC step above it
+#define CHUNK           128     // Samples per DMA buffer, as waveform_dac.c
+#define NUM_ROUNDS      20000
+#define FILL_RUNS       9       // Best of, alternating the two, so host noise skews neither
+
+static const uint32_t rates_hz[] = { 20000, 50000, 100000, 200000 };
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    double worst_mean_ua;       // Filtered mean against the requested level
+    double worst_dev_ua;        // Filtered output's furthest excursion from it
+    double worst_ripple_ua;     // Peak to peak after settling
+} sweep_t;
+
+// Every 1/256 of the step above BASE_STEP, from a fresh start each time
+static sweep_t sweep(uint32_t rate_hz, bool sigma_delta)
+{
+    sweep_t r = {0};
+    waveform_config_t config = { .shape = WAVEFORM_LEVEL, .sample_rate_hz = rate_hz, .sigma_delta = sigma_delta };
+    double alpha = 1 - exp(-1.0 / (rate_hz * FILTER_TAU_S));
+    int settle = (int)(SETTLE_S * rate_hz);
+    int measure = (int)(MEASURE_S * rate_hz);
+    uint8_t out[CHUNK];
+
+    for (int frac = 0; frac < 256; frac++) {
+        waveform_t wave;
+        waveform_init(&wave, &config);
+        int32_t level_q8 = (BASE_STEP << 8) + frac;
+        waveform_set_level(&wave, level_q8);
+        double target = level_q8 / 256.0 * UA_PER_CODE;
+        double y = BASE_STEP * UA_PER_CODE;
+        double lo = 1e9, hi = -1e9, sum = 0;
+        for (int n = 0; n < settle + measure; n += CHUNK) {
+            waveform_fill(&wave, out, CHUNK);
+            for (int i = 0; i < CHUNK; i++) {
+                y += ((255 - out[i]) * UA_PER_CODE - y) * alpha;
+                if (n + i >= settle) {
+                    lo = y < lo ? y : lo;
+                    hi = y > hi ? y : hi;
+                    sum += y;
+                }
+            }
+        }
+        int count = (settle + measure + CHUNK - 1) / CHUNK * CHUNK - settle;
+        double mean_err = fabs(sum / count - target);
+        double dev = fmax(hi - target, target - lo);
+        r.worst_mean_ua = fmax(r.worst_mean_ua, mean_err);
+        r.worst_dev_ua = fmax(r.worst_dev_ua, dev);
+        r.worst_ripple_ua = fmax(r.worst_ripple_ua, hi - lo);
+    }
+    return r;
+}
+
+static double fill_ns_per_sample(bool sigma_delta)
+{
+    waveform_config_t config = { .shape = WAVEFORM_LEVEL, .sample_rate_hz = 100000, .sigma_delta = sigma_delta };
+    waveform_t wave;
+    waveform_init(&wave, &config);
+    waveform_set_level(&wave, (BASE_STEP << 8) + 77);
+    uint8_t out[CHUNK];
+
+    double t0 = now_s();
+    for (int r = 0; r < NUM_ROUNDS; r++) {
+        waveform_fill(&wave, out, CHUNK);
+        __asm__ volatile("" ::: "memory");
+    }
+    return (now_s() - t0) / ((double)NUM_ROUNDS * CHUNK) * 1e9;
+}
+
+int main(void)
+{
+    printf("DAC step %.2f uA, 12 bits of 2480 uA = %.2f uA\n\n", UA_PER_CODE, 2480.0 / 4096);
+
+    sweep_t plain = sweep(100000, false);
+    printf("rounding:            mean error %5.2f uA, deviation %5.2f uA, ripple %5.2f uA p-p, %.1f bits\n",
+           plain.worst_mean_ua, plain.worst_dev_ua, plain.worst_ripple_ua, log2(2480 / (2 * plain.worst_dev_ua)));
+    for (size_t i = 0; i < sizeof(rates_hz) / sizeof(rates_hz[0]); i++) {
+        sweep_t sd = sweep(rates_hz[i], true);
+        printf("sigma-delta %3u kHz: mean error %5.2f uA, deviation %5.2f uA, ripple %5.2f uA p-p, %.1f bits\n",
+               (unsigned)(rates_hz[i] / 1000), sd.worst_mean_ua, sd.worst_dev_ua, sd.worst_ripple_ua,
+               log2(2480 / (2 * sd.worst_dev_ua)));
+    }
+
+    double ns_plain = INFINITY, ns_sd = INFINITY;
+    for (int run = 0; run < FILL_RUNS; run++) {
+        ns_plain = fmin(ns_plain, fill_ns_per_sample(false));
+        ns_sd = fmin(ns_sd, fill_ns_per_sample(true));
+    }
+    printf("\nfill, rounding:    %5.2f ns/sample\n", ns_plain);
+    printf("fill, sigma-delta: %5.2f ns/sample (%+.0f%%)\n", ns_sd, 100 * (ns_sd / ns_plain - 1));
+    for (size_t i = 0; i < sizeof(rates_hz) / sizeof(rates_hz[0]); i++) {
+        printf("  at %3u kHz: %.3f%% of a host core, one ISR every %.2f ms\n", (unsigned)(rates_hz[i] / 1000),
+               ns_sd * rates_hz[i] / 1e7, CHUNK * 1e3 / rates_hz[i]);
+    }
+    return 0;
+}
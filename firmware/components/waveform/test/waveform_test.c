@@ -0,0 +1,249 @@
+// Host tests for the waveform generator: sine frequency and levels, noise bounds and
+// bandwidth, gain scaling, sigma-delta levels and config checks, all through the board's
+// DAC transfer.
+//
+//   cc -O2 -I.. waveform_test.c ../waveform.c -lm -o waveform_test && ./waveform_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "waveform.h"
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// Same transfer as main.c: I = 2.48 mA * (1 - V_dac / 2.5 V), DAC 0-3.3 V
+#define DRIVE_OFF_Q8        ((int32_t)((255 - 255LL * 2500 / 3300) << 8))
+#define DRIVE_GAIN_Q16      ((int32_t)((255LL * 2500 << 24) / (2480LL * 3300)))
+#define UA_PER_CODE         (2480.0 * 3300 / (255 * 2500))
+#define SAMPLE_RATE_HZ      20000
+
+static double code_to_ua(uint8_t code)
+{
+    double ua = 2480 - code * UA_PER_CODE;
+    return ua < 0 ? 0 : ua;
+}
+
+static waveform_config_t make_config(waveform_shape_t shape, uint32_t freq_dhz, int32_t amplitude_ua, int32_t offset_ua)
+{
+    waveform_config_t config = {
+        .shape = shape,
+        .freq_dhz = freq_dhz,
+        .amplitude_ua = amplitude_ua,
+        .offset_ua = offset_ua,
+        .sample_rate_hz = SAMPLE_RATE_HZ,
+        .drive_offset_q8 = DRIVE_OFF_Q8,
+        .drive_gain_q16 = DRIVE_GAIN_Q16,
+    };
+    return config;
+}
+
+// One second of output in DMA-sized chunks, as the ISR would fill it
+static void fill_second(waveform_t *wave, uint8_t *out)
+{
+    for (int i = 0; i < SAMPLE_RATE_HZ; i += 128) {
+        waveform_fill(wave, &out[i], i + 128 <= SAMPLE_RATE_HZ ? 128 : SAMPLE_RATE_HZ - i);
+    }
+}
+
+static int rising_crossings(const uint8_t *codes, int n, double level_ua)
+{
+    int crossings = 0;
+    for (int i = 1; i < n; i++) {
+        if (code_to_ua(codes[i - 1]) < level_ua && code_to_ua(codes[i]) >= level_ua) {
+            crossings++;
+        }
+    }
+    return crossings;
+}
+
+static void test_sine(void)
+{
+    static uint8_t out[SAMPLE_RATE_HZ];
+    static const uint32_t freqs_dhz[] = { 100, 405, 12345, 50000 };
+    for (size_t f = 0; f < sizeof(freqs_dhz) / sizeof(freqs_dhz[0]); f++) {
+        waveform_t wave;
+        waveform_config_t config = make_config(WAVEFORM_SINE, freqs_dhz[f], 500, 1000);
+        CHECK(waveform_init(&wave, &config));
+        waveform_set_gain(&wave, WAVEFORM_GAIN_ONE);
+        fill_second(&wave, out);
+
+        double lo = 1e9, hi = 0, sum = 0;
+        for (int i = 0; i < SAMPLE_RATE_HZ; i++) {
+            double ua = code_to_ua(out[i]);
+            lo = ua < lo ? ua : lo;
+            hi = ua > hi ? ua : hi;
+            sum += ua;
+        }
+        // Level crossings count periods; the mean and peaks are good to a DAC step or two
+        int periods = rising_crossings(out, SAMPLE_RATE_HZ, 1000);
+        double expect = freqs_dhz[f] / 10.0;
+        CHECK(abs(periods - (int)expect) <= 1);
+        CHECK(sum / SAMPLE_RATE_HZ > 1000 - UA_PER_CODE && sum / SAMPLE_RATE_HZ < 1000 + UA_PER_CODE);
+        if (freqs_dhz[f] <= 12345) {
+            CHECK(hi > 1500 - 2 * UA_PER_CODE && hi < 1500 + UA_PER_CODE);
+            CHECK(lo > 500 - UA_PER_CODE && lo < 500 + 2 * UA_PER_CODE);
+        }
+        printf("sine %.1f Hz: %d periods in 1 s, %.0f-%.0f uA, mean %.0f uA\n",
+               expect, periods, lo, hi, sum / SAMPLE_RATE_HZ);
+    }
+}
+
+static void test_sine_phase_continuity(void)
+{
+    // Chunk boundaries must not show: same samples whatever the fill length
+    waveform_t a, b;
+    waveform_config_t config = make_config(WAVEFORM_SINE, 1234, 800, 1200);
+    CHECK(waveform_init(&a, &config));
+    CHECK(waveform_init(&b, &config));
+    waveform_set_gain(&a, WAVEFORM_GAIN_ONE);
+    waveform_set_gain(&b, WAVEFORM_GAIN_ONE);
+    uint8_t whole[1000], parts[1000];
+    waveform_fill(&a, whole, sizeof(whole));
+    for (int i = 0; i < 1000; i += 37) {
+        waveform_fill(&b, &parts[i], i + 37 <= 1000 ? 37 : 1000 - i);
+    }
+    int mismatches = 0;
+    for (int i = 0; i < 1000; i++) {
+        mismatches += whole[i] != parts[i];
+    }
+    CHECK(mismatches == 0);
+}
+
+static void test_noise(void)
+{
+    static uint8_t out[SAMPLE_RATE_HZ];
+    waveform_t wave;
+    // 100 Hz bandwidth: a new value every 100 samples
+    waveform_config_t config = make_config(WAVEFORM_NOISE, 1000, 400, 1000);
+    CHECK(waveform_init(&wave, &config));
+    waveform_set_gain(&wave, WAVEFORM_GAIN_ONE);
+    fill_second(&wave, out);
+
+    double lo = 1e9, hi = 0, sum = 0;
+    int changes = 0;
+    for (int i = 0; i < SAMPLE_RATE_HZ; i++) {
+        double ua = code_to_ua(out[i]);
+        lo = ua < lo ? ua : lo;
+        hi = ua > hi ? ua : hi;
+        sum += ua;
+        if (i > 0 && out[i] != out[i - 1]) {
+            changes++;
+            CHECK(i % 100 == 0);
+        }
+    }
+    double mean = sum / SAMPLE_RATE_HZ;
+    CHECK(lo >= 600 - UA_PER_CODE && hi <= 1400 + UA_PER_CODE);
+    CHECK(lo < 650 && hi > 1350);   // 200 draws reach close to both bounds
+    CHECK(mean > 950 && mean < 1050);
+    CHECK(changes > 180 && changes <= 200);
+    printf("noise 100 Hz: %.0f-%.0f uA, mean %.0f uA, %d changes in 1 s\n", lo, hi, mean, changes);
+}
+
+static void test_gain(void)
+{
+    uint8_t out[256];
+    waveform_t wave;
+    waveform_config_t config = make_config(WAVEFORM_SINE, 100, 1000, 1000);
+    CHECK(waveform_init(&wave, &config));
+
+    // Gain 0 (the start of a ramp) holds the zero-current code
+    waveform_fill(&wave, out, sizeof(out));
+    for (size_t i = 0; i < sizeof(out); i++) {
+        CHECK(code_to_ua(out[i]) < UA_PER_CODE);
+    }
+
+    waveform_set_gain(&wave, WAVEFORM_GAIN_ONE / 2);
+    waveform_fill(&wave, out, sizeof(out));
+    double hi = 0;
+    for (size_t i = 0; i < sizeof(out); i++) {
+        double ua = code_to_ua(out[i]);
+        hi = ua > hi ? ua : hi;
+        CHECK(ua <= 1000 + UA_PER_CODE);
+    }
+    CHECK(hi > 1000 - 2 * UA_PER_CODE);
+
+    waveform_set_gain(&wave, 3 * WAVEFORM_GAIN_ONE);
+    CHECK(wave.gain_q16 == WAVEFORM_GAIN_ONE);
+}
+
+static void test_sigma_delta_level(void)
+{
+    // Every fraction of a step comes out exact on average, using only the two nearest codes
+    uint8_t out[256];
+    waveform_config_t config = make_config(WAVEFORM_LEVEL, 0, 0, 0);
+    config.sigma_delta = true;
+    int worst_q8 = 0;
+    for (int32_t level_q8 = (100 << 8); level_q8 < (101 << 8); level_q8 += 7) {
+        waveform_t wave;
+        CHECK(waveform_init(&wave, &config));
+        waveform_set_level(&wave, level_q8);
+        waveform_fill(&wave, out, sizeof(out));
+        int32_t sum_q8 = 0;
+        for (size_t i = 0; i < sizeof(out); i++) {
+            int32_t step = 255 - out[i];
+            CHECK(step == 100 || step == 101);
+            sum_q8 += step << 8;
+        }
+        int err_q8 = abs(sum_q8 / (int32_t)sizeof(out) - level_q8);
+        worst_q8 = err_q8 > worst_q8 ? err_q8 : worst_q8;
+    }
+    CHECK(worst_q8 <= 1);
+
+    // Without it the same levels round to one code
+    waveform_t wave;
+    config.sigma_delta = false;
+    CHECK(waveform_init(&wave, &config));
+    waveform_set_level(&wave, (100 << 8) + 100);
+    waveform_fill(&wave, out, sizeof(out));
+    CHECK(out[0] == 155 && out[255] == 155);
+
+    // Out-of-range levels clamp to the DAC range
+    waveform_set_level(&wave, 300 << 8);
+    waveform_fill(&wave, out, 1);
+    CHECK(out[0] == 0);
+    waveform_set_level(&wave, -1);
+    waveform_fill(&wave, out, 1);
+    CHECK(out[0] == 255);
+}
+
+static void test_invalid_config(void)
+{
+    waveform_t wave;
+    waveform_config_t config = make_config(WAVEFORM_SINE, 100, 600, 500);
+    CHECK(!waveform_init(&wave, &config));          // Would need negative current
+    config = make_config(WAVEFORM_SINE, 0, 100, 500);
+    CHECK(!waveform_init(&wave, &config));
+    config = make_config(WAVEFORM_SINE, 50001, 100, 500);
+    CHECK(!waveform_init(&wave, &config));          // Above a quarter of the sample rate
+    config = make_config(WAVEFORM_NOISE, 100001, 100, 500);
+    CHECK(!waveform_init(&wave, &config));
+    config = make_config(WAVEFORM_NOISE, 100000, 100, 500);
+    CHECK(waveform_init(&wave, &config));
+    config = make_config(WAVEFORM_SINE, 100, 1000, 2000);
+    CHECK(!waveform_init(&wave, &config));          // Peak beyond the DAC range
+    config = make_config(4, 100, 100, 500);
+    CHECK(!waveform_init(&wave, &config));
+}
+
+int main(void)
+{
+    test_sine();
+    test_sine_phase_continuity();
+    test_noise();
+    test_gain();
+    test_sigma_delta_level();
+    test_invalid_config();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All waveform tests passed\n");
+    return 0;
+}
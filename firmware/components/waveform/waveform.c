@@ -0,0 +1,123 @@
+#include <math.h>
+#include <string.h>
+#include "waveform.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#define WAVEFORM_IRAM IRAM_ATTR
+#else
+#define WAVEFORM_IRAM
+#endif
+
+#define WAVEFORM_RNG_SEED   0x2545F491u
+
+static uint16_t waveform_drive_above(const waveform_config_t *config, double current_ua)
+{
+    return (uint16_t)lround(current_ua * config->drive_gain_q16 / 65536.0);
+}
+
+bool waveform_init(waveform_t *wave, const waveform_config_t *config)
+{
+    if (!wave || !config || config->sample_rate_hz == 0) {
+        return false;
+    }
+    if (config->shape == WAVEFORM_LEVEL) {
+        memset(wave, 0, sizeof(*wave));
+        wave->shape = WAVEFORM_LEVEL;
+        wave->sigma_delta = config->sigma_delta;
+        return true;
+    }
+    if (config->freq_dhz == 0 || config->amplitude_ua < 0 || config->amplitude_ua > config->offset_ua ||
+        config->drive_gain_q16 < 0 || config->drive_offset_q8 < 0) {
+        return false;
+    }
+    uint64_t rate_dhz = (uint64_t)config->sample_rate_hz * 10;
+    if (config->shape == WAVEFORM_SINE) {
+        if ((uint64_t)config->freq_dhz * 4 > rate_dhz) {
+            return false;
+        }
+    } else if (config->shape == WAVEFORM_NOISE) {
+        if ((uint64_t)config->freq_dhz * 2 > rate_dhz) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    // The peak has to fit the table entries and round to a DAC code
+    int64_t peak_q8 = (int64_t)(config->offset_ua + config->amplitude_ua) * config->drive_gain_q16 >> 16;
+    if (peak_q8 > UINT16_MAX || (config->drive_offset_q8 + peak_q8 + 128) >> 8 > 255) {
+        return false;
+    }
+
+    memset(wave, 0, sizeof(*wave));
+    wave->shape = config->shape;
+    wave->sigma_delta = config->sigma_delta;
+    wave->drive_offset_q8 = config->drive_offset_q8;
+    for (int i = 0; i < WAVEFORM_TABLE_LEN; i++) {
+        double current_ua;
+        if (config->shape == WAVEFORM_SINE) {
+            current_ua = config->offset_ua + config->amplitude_ua * sin(2 * M_PI * i / WAVEFORM_TABLE_LEN);
+        } else {
+            // Evenly spread over offset +- amplitude, both ends included
+            current_ua = config->offset_ua - config->amplitude_ua +
+                         2.0 * config->amplitude_ua * i / (WAVEFORM_TABLE_LEN - 1);
+        }
+        wave->table[i] = waveform_drive_above(config, current_ua);
+    }
+    wave->phase_inc = (uint32_t)(((uint64_t)config->freq_dhz << 32) / rate_dhz);
+    // A new value every half period of the bandwidth
+    uint64_t hold = rate_dhz / ((uint64_t)config->freq_dhz * 2);
+    wave->hold = hold ? (uint32_t)hold : 1;
+    wave->rng = WAVEFORM_RNG_SEED;
+    wave->gain_q16 = 0;
+    return true;
+}
+
+void waveform_set_gain(waveform_t *wave, uint32_t gain_q16)
+{
+    wave->gain_q16 = gain_q16 > WAVEFORM_GAIN_ONE ? WAVEFORM_GAIN_ONE : gain_q16;
+}
+
+void waveform_set_level(waveform_t *wave, int32_t drive_q8)
+{
+    wave->level_q8 = drive_q8 < 0 ? 0 : drive_q8 > (255 << 8) ? (255 << 8) : drive_q8;
+}
+
+void WAVEFORM_IRAM waveform_fill(waveform_t *wave, uint8_t *out, size_t len)
+{
+    const uint32_t gain = wave->gain_q16;
+    const int32_t level = wave->level_q8;
+    for (size_t i = 0; i < len; i++) {
+        int32_t drive = level;
+        if (wave->shape == WAVEFORM_SINE) {
+            uint32_t above = wave->table[wave->phase >> (32 - WAVEFORM_TABLE_BITS)];
+            wave->phase += wave->phase_inc;
+            drive = wave->drive_offset_q8 + (int32_t)((above * gain) >> 16);
+        } else if (wave->shape == WAVEFORM_NOISE) {
+            if (wave->held == 0) {
+                uint32_t x = wave->rng;
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                wave->rng = x;
+                wave->value = wave->table[x >> (32 - WAVEFORM_TABLE_BITS)];
+                wave->held = wave->hold;
+            }
+            wave->held--;
+            drive = wave->drive_offset_q8 + (int32_t)(((uint32_t)wave->value * gain) >> 16);
+        }
+
+        int32_t step;
+        if (wave->sigma_delta) {
+            // Nearest code to the drive plus the error so far; what it misses carries over
+            drive += wave->error_q8;
+            step = (drive + 128) >> 8;
+            step = step > 255 ? 255 : step;
+            wave->error_q8 = drive - (step << 8);
+        } else {
+            step = (drive + 128) >> 8;
+            step = step > 255 ? 255 : step;
+        }
+        out[i] = (uint8_t)(255 - step);
+    }
+}
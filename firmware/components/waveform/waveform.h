@@ -0,0 +1,74 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+// Table-driven stimulation waveforms for DAC DMA output. A sine is a phase accumulator
+// into a one-period table; noise holds a uniformly distributed table entry, picked by a
+// xorshift generator, for as many samples as its bandwidth allows. Tables are built in
+// DAC codes through the same drive mapping as current_ctrl's feedforward, so the fill
+// loop is a lookup and one multiply per sample. A level is a single drive value with a
+// fractional part, for dithering the DC output. Optionally a first-order sigma-delta
+// quantiser picks the codes, carrying each sample's rounding error into the next, so the
+// average over a few samples resolves 1/256 of a DAC step. No IDF dependencies outside
+// waveform_dac.c, so the generator also builds on the host (see test/).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WAVEFORM_TABLE_BITS     8
+#define WAVEFORM_TABLE_LEN      (1 << WAVEFORM_TABLE_BITS)
+#define WAVEFORM_GAIN_ONE       (1 << 16)
+
+typedef enum {
+    WAVEFORM_SINE = 1,
+    WAVEFORM_NOISE = 2,
+    WAVEFORM_LEVEL = 3,         // waveform_set_level(); frequency, amplitude and offset unused
+} waveform_shape_t;
+
+typedef struct {
+    waveform_shape_t shape;
+    uint32_t freq_dhz;          // Sine frequency, or noise bandwidth, in 0.1 Hz
+    int32_t amplitude_ua;       // Peak deviation from the offset
+    int32_t offset_ua;          // At least the amplitude: the output stage is unipolar
+    uint32_t sample_rate_hz;
+    int32_t drive_offset_q8;    // Drive at 0 uA, as current_ctrl_config_t
+    int32_t drive_gain_q16;     // Drive (Q8) per uA, Q16
+    bool sigma_delta;           // Otherwise each sample rounds to the nearest code
+} waveform_config_t;
+
+typedef struct {
+    uint16_t table[WAVEFORM_TABLE_LEN];     // Drive above drive_offset_q8, Q8
+    int32_t drive_offset_q8;
+    waveform_shape_t shape;
+    uint32_t phase;
+    uint32_t phase_inc;         // Sine: table index in the top bits
+    uint32_t hold;              // Noise: samples per value
+    uint32_t held;
+    uint32_t rng;
+    uint16_t value;
+    bool sigma_delta;
+    int32_t error_q8;           // Sigma-delta: rounding error carried to the next sample
+    volatile uint32_t gain_q16; // Scales the whole output about zero current
+    volatile int32_t level_q8;  // WAVEFORM_LEVEL drive
+} waveform_t;
+
+// False for an unknown shape, a zero rate or frequency, a sine above a quarter of the
+// sample rate, noise above half of it, or an amplitude above the offset. Starts at gain 0
+// (level 0 for WAVEFORM_LEVEL).
+bool waveform_init(waveform_t *wave, const waveform_config_t *config);
+// Ramps the output in and out; takes effect from the next sample. Up to WAVEFORM_GAIN_ONE.
+void waveform_set_gain(waveform_t *wave, uint32_t gain_q16);
+// WAVEFORM_LEVEL output in drive units (255 - code), Q8; takes effect from the next sample
+void waveform_set_level(waveform_t *wave, int32_t drive_q8);
+// Next `len` DAC codes. Called from the DMA ISR (in IRAM on the target).
+void waveform_fill(waveform_t *wave, uint8_t *out, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WAVEFORM_H
@@ -0,0 +1,125 @@
+#include <inttypes.h>
+#include "waveform_dac.h"
+#include "driver/dac_continuous.h"
+#include "hal/dac_ll.h"
+#include "soc/soc_caps.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "WAVEFORM";
+
+// The ESP32 DMA carries each 8-bit sample in a 16-bit slot
+#if SOC_DAC_DMA_16BIT_ALIGN
+#define WAVEFORM_DAC_SAMPLE_BYTES   2
+#else
+#define WAVEFORM_DAC_SAMPLE_BYTES   1
+#endif
+#define WAVEFORM_DAC_SAMPLES        (WAVEFORM_DAC_BUF_SIZE / WAVEFORM_DAC_SAMPLE_BYTES)
+#define WAVEFORM_DAC_PRIME_MS       100
+
+typedef struct {
+    dac_continuous_handle_t handle;
+    dac_channel_t chan;
+    uint8_t idle_code;
+    waveform_t *wave;
+    volatile uint32_t fills;
+    uint8_t samples[WAVEFORM_DAC_SAMPLES];  // ISR scratch
+} waveform_dac_t;
+
+static waveform_dac_t wdac;
+
+// One drained buffer: the next block of the waveform goes straight back into it
+static bool IRAM_ATTR waveform_dac_on_done(dac_continuous_handle_t handle, const dac_event_data_t *event, void *user_data)
+{
+    size_t len = event->buf_size / WAVEFORM_DAC_SAMPLE_BYTES;
+    if (len > WAVEFORM_DAC_SAMPLES) {
+        len = WAVEFORM_DAC_SAMPLES;
+    }
+    waveform_fill(wdac.wave, wdac.samples, len);
+    dac_continuous_write_asynchronously(handle, event->buf, event->buf_size, wdac.samples, len, NULL);
+    wdac.fills++;
+    return false;
+}
+
+// Pad on the register value (idle_code) or on the DMA stream
+static void waveform_dac_route_dma(bool dma)
+{
+    if (!dma) {
+        dac_ll_update_output_value(wdac.chan, wdac.idle_code);
+    }
+    dac_ll_digi_enable_dma(dma);
+}
+
+esp_err_t waveform_dac_start(dac_channel_t chan, uint32_t sample_rate_hz, uint8_t idle_code, waveform_t *wave)
+{
+    ESP_RETURN_ON_FALSE(!wdac.handle, ESP_ERR_INVALID_STATE, TAG, "already running");
+    wdac.chan = chan;
+    wdac.idle_code = idle_code;
+    wdac.wave = wave;
+    wdac.fills = 0;
+
+    const dac_continuous_config_t config = {
+        .chan_mask = chan == DAC_CHAN_0 ? DAC_CHANNEL_MASK_CH0 : DAC_CHANNEL_MASK_CH1,
+        .desc_num = WAVEFORM_DAC_DESC_NUM,
+        .buf_size = WAVEFORM_DAC_BUF_SIZE,
+        .freq_hz = sample_rate_hz,
+        .offset = 0,
+        .clk_src = DAC_DIGI_CLK_SRC_DEFAULT,
+        .chan_mode = DAC_CHANNEL_MODE_SIMUL,
+    };
+    const dac_event_callbacks_t callbacks = {
+        .on_convert_done = waveform_dac_on_done,
+    };
+    ESP_RETURN_ON_ERROR(dac_continuous_new_channels(&config, &wdac.handle), TAG, "channel");
+    esp_err_t ret = dac_continuous_register_event_callback(wdac.handle, &callbacks, NULL);
+    if (ret == ESP_OK) {
+        ret = dac_continuous_enable(wdac.handle);
+    }
+    if (ret != ESP_OK) {
+        dac_continuous_del_channels(wdac.handle);
+        wdac.handle = NULL;
+        return ret;
+    }
+
+    // The driver starts on zeroed buffers, and code 0 may be a long way from idle (on
+    // this board it is full current): hold the pad until the ISR has refilled them all
+    waveform_dac_route_dma(false);
+    ret = dac_continuous_start_async_writing(wdac.handle);
+    waveform_dac_route_dma(false);
+    for (int ms = 0; ret == ESP_OK && wdac.fills < WAVEFORM_DAC_DESC_NUM; ms++) {
+        if (ms >= WAVEFORM_DAC_PRIME_MS) {
+            ret = ESP_ERR_TIMEOUT;
+            break;
+        }
+        vTaskDelay(1);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "DMA start failed: %s", esp_err_to_name(ret));
+        waveform_dac_stop();
+        return ret;
+    }
+    waveform_dac_route_dma(true);
+    ESP_LOGI(TAG, "Waveform output at %" PRIu32 " Hz", sample_rate_hz);
+    return ESP_OK;
+}
+
+void waveform_dac_stop(void)
+{
+    if (!wdac.handle) {
+        return;
+    }
+    waveform_dac_route_dma(false);
+    dac_continuous_stop_async_writing(wdac.handle);
+    dac_continuous_disable(wdac.handle);
+    dac_continuous_del_channels(wdac.handle);
+    wdac.handle = NULL;
+    wdac.wave = NULL;
+}
+
+bool waveform_dac_running(void)
+{
+    return wdac.handle != NULL;
+}
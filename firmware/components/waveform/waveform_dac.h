@@ -0,0 +1,33 @@
+#ifndef WAVEFORM_DAC_H
+#define WAVEFORM_DAC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/dac_oneshot.h"
+#include "waveform.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Plays a waveform on one DAC channel through the continuous (DMA) driver: the DMA ISR
+// refills each buffer as it drains, so the sample clock is the hardware's and the CPU
+// only runs one short fill per buffer. On the ESP32 the DAC DMA is I2S0, the same as
+// the ADC continuous driver, so it cannot run alongside the fast fault channel.
+
+#define WAVEFORM_DAC_DESC_NUM   4
+#define WAVEFORM_DAC_BUF_SIZE   256     // Bytes per DMA buffer
+
+// The channel must not be held by the oneshot driver. Until every DMA buffer holds the
+// waveform the pad stays on idle_code, which it is set to first. `wave` is read from
+// the ISR until waveform_dac_stop() returns.
+esp_err_t waveform_dac_start(dac_channel_t chan, uint32_t sample_rate_hz, uint8_t idle_code, waveform_t *wave);
+// Back to idle_code at once, then release the channel. Safe to call when not running.
+void waveform_dac_stop(void);
+bool waveform_dac_running(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WAVEFORM_DAC_H
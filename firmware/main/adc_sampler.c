@@ -0,0 +1,419 @@
+#include <stdatomic.h>
+#include <inttypes.h>
+#include "adc_sampler.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+static const char *TAG = "ADC_SAMPLER";
+
+_Static_assert(ADC_SAMPLER_NUM_CHANNELS <= ADS1115_BUS_MAX_MUX, "Too many channels per device");
+_Static_assert((ADC_SAMPLER_RING_SIZE & (ADC_SAMPLER_RING_SIZE - 1)) == 0, "Ring size must be a power of two");
+
+// Current sensing runs every scan at the top data rate; load bottom and battery are decimated
+static const ads1115_bus_channel_t channels[ADC_SAMPLER_NUM_CHANNELS] = {
+    [ADC_CH_A0] = {
+        .ch = { .mux = ADS1115_MUX_SINGLE_0, .gain = ADC_SAMPLER_SINGLE_GAIN, .data_rate = ADS1115_DR_860SPS },
+        .decimation = 1, .priority = 2,
+    },
+    [ADC_CH_A1] = {
+        .ch = { .mux = ADS1115_MUX_SINGLE_1, .gain = ADC_SAMPLER_SINGLE_GAIN, .data_rate = ADS1115_DR_860SPS },
+        .decimation = 1, .priority = 2,
+    },
+    [ADC_CH_A2] = {
+        .ch = { .mux = ADS1115_MUX_SINGLE_2, .gain = ADC_SAMPLER_SINGLE_GAIN, .data_rate = ADS1115_DR_860SPS },
+        .decimation = 4, .priority = 1,
+    },
+    [ADC_CH_A3] = {
+        .ch = { .mux = ADS1115_MUX_SINGLE_3, .gain = ADC_SAMPLER_SINGLE_GAIN, .data_rate = ADS1115_DR_128SPS },
+        .decimation = 64, .priority = 0,
+    },
+    // Shunt drop measured directly so the common-mode voltage does not eat the range
+    [ADC_CH_SHUNT] = {
+        .ch = { .mux = ADS1115_MUX_DIFF_0_1, .gain = ADC_SAMPLER_SHUNT_GAIN, .auto_range = true,
+                .data_rate = ADS1115_DR_860SPS },
+        .decimation = 1, .priority = 3,
+    },
+};
+
+// Per-channel raw-to-uV scales with the board divider folded in
+static ads1115_scale_t channel_scale[ADC_SAMPLER_NUM_CHANNELS];
+// ADC-referenced raw-to-uV for the filters, which work at the ADC input
+static ads1115_scale_t adc_scale;
+
+// Reported values: A0/A1 and the shunt are oversampled at 860 SPS and decimated 32x
+// (~9 Hz out); A2 is already decimated by the scheduler; the battery only needs smoothing.
+static adc_filter_config_t filter_config[ADC_SAMPLER_NUM_CHANNELS] = {
+    [ADC_CH_A0] = { .median_n = 3, .decim_type = ADC_FILTER_DECIM_CIC, .decimation = 32, .cic_order = 2 },
+    [ADC_CH_A1] = { .median_n = 3, .decim_type = ADC_FILTER_DECIM_CIC, .decimation = 32, .cic_order = 2 },
+    [ADC_CH_A2] = { .median_n = 3, .decim_type = ADC_FILTER_DECIM_BOXCAR, .decimation = 8 },
+    [ADC_CH_A3] = { .iir_shift = 3, .decim_type = ADC_FILTER_DECIM_BOXCAR, .decimation = 1 },
+    [ADC_CH_SHUNT] = { .median_n = 3, .iir_shift = 1, .decim_type = ADC_FILTER_DECIM_CIC, .decimation = 32, .cic_order = 2 },
+};
+
+static adc_filter_t filters[ADS1115_BUS_MAX_DEVICES][ADC_SAMPLER_NUM_CHANNELS];
+
+// Schedule and filter changes are applied by the sampler task between scans, one
+// adc_sampler_changes_t at a time
+#define ADC_SAMPLER_CHANGES_QUEUE_LEN   4
+static QueueHandle_t cmd_queue;
+
+// Latest filtered values, re-encoded as raw codes. Written once per filter output, so a
+// short critical section is cheaper than a second ring.
+static adc_frame_t filtered_frame;
+static bool filtered_valid;
+static portMUX_TYPE filtered_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Single-producer ring: the sampler task writes a slot, then publishes it by bumping head.
+// Readers copy the newest slot and retry if the producer lapped them during the copy; head
+// doubles as the sequence count of a seqlock, with fences around the unsynchronised copy.
+static adc_frame_t ring[ADC_SAMPLER_RING_SIZE];
+static atomic_uint_fast32_t ring_head = 0;  // Number of frames published so far
+
+static ads1115_bus_t *sampler_bus;
+
+#define ADC_SAMPLER_STATS_INTERVAL_US (10 * 1000 * 1000)
+
+static void adc_sampler_log_stats(void)
+{
+    for (size_t d = 0; d < sampler_bus->num_devices; d++) {
+        ads1115_handle_t *dev = sampler_bus->devs[d];
+        ads1115_stats_t stats;
+        ads1115_get_stats(dev, &stats);
+        if (stats.samples == 0) {
+            continue;
+        }
+
+        ESP_LOGI(TAG, "0x%02x I2C: %.2f transactions/sample, %" PRIu32 " us/sample avg, %" PRIu32 " us max",
+                 dev->config.addr, (double)stats.transactions / stats.samples,
+                 (uint32_t)(stats.i2c_time_us / stats.samples), stats.max_i2c_time_us);
+        ads1115_reset_stats(dev);
+    }
+}
+
+static void adc_sampler_apply_cmd(const adc_sampler_cmd_t *cmd)
+{
+    switch (cmd->type) {
+    case ADC_SAMPLER_CMD_SCHEDULE:
+        if (ads1115_bus_set_schedule(sampler_bus, cmd->channel, cmd->schedule.decimation,
+                                     cmd->schedule.priority, cmd->schedule.data_rate) != ESP_OK) {
+            ESP_LOGW(TAG, "Rejected schedule for channel %u", cmd->channel);
+        }
+        break;
+    case ADC_SAMPLER_CMD_FILTER:
+        filter_config[cmd->channel] = cmd->filter;
+        for (size_t d = 0; d < ADS1115_BUS_MAX_DEVICES; d++) {
+            adc_filter_init(&filters[d][cmd->channel], &cmd->filter);
+        }
+        ESP_LOGI(TAG, "Channel %u filter: median %u, IIR 1/%u, %s x%u",
+                 cmd->channel, cmd->filter.median_n, 1u << cmd->filter.iir_shift,
+                 cmd->filter.decim_type == ADC_FILTER_DECIM_CIC ? "CIC" : "boxcar", cmd->filter.decimation);
+        break;
+    }
+}
+
+// Encode a filtered value back into a raw code so readers see the same format as a scan.
+// Auto-ranged channels get the narrowest PGA the value fits in.
+static void adc_sampler_encode(int ch, int32_t uv, int16_t *raw, uint16_t *gain)
+{
+    uint16_t g = channels[ch].ch.gain;
+    if (channels[ch].ch.auto_range) {
+        int32_t mag = uv < 0 ? -uv : uv;
+        int idx = ADS1115_PGA_INDEX_MAX;
+        while (idx > 0 && mag > ads1115_fsr_uv(ads1115_pga_from_index(idx)) / 10 * 9) {
+            idx--;
+        }
+        g = ads1115_pga_from_index(idx);
+    }
+    *raw = ads1115_uv_to_raw(uv, g);
+    *gain = g;
+}
+
+static void adc_sampler_filter_scan(const adc_frame_t *frame)
+{
+    static adc_frame_t next;
+    int32_t uv[ADC_SAMPLER_MAX_CHANNELS];
+    uint32_t out_mask = 0;
+
+    // Fixed-point multiply per channel; repeated channels are converted too, which is
+    // cheaper than branching per channel
+    ads1115_raw_to_uv_batch(&adc_scale, frame->raw, frame->gain, 0, uv, frame->num_channels);
+    for (size_t i = 0; i < frame->num_channels; i++) {
+        if (!(frame->updated_mask & (1u << i))) {
+            continue;
+        }
+        size_t d = i / ADC_SAMPLER_NUM_CHANNELS;
+        int ch = i % ADC_SAMPLER_NUM_CHANNELS;
+        int32_t out;
+        if (adc_filter_push(&filters[d][ch], uv[i], &out)) {
+            adc_sampler_encode(ch, out, &next.raw[i], &next.gain[i]);
+            out_mask |= 1u << i;
+        }
+    }
+    if (!out_mask) {
+        return;
+    }
+
+    next.seq++;
+    next.timestamp_us = frame->timestamp_us;
+    next.num_channels = frame->num_channels;
+    next.updated_mask = out_mask;
+    portENTER_CRITICAL(&filtered_lock);
+    filtered_frame = next;
+    filtered_valid = true;
+    portEXIT_CRITICAL(&filtered_lock);
+}
+
+static void adc_sampler_task(void *args)
+{
+    int64_t last_stats_us = esp_timer_get_time();
+    // Decimated channels keep their last value between conversions
+    int16_t raw[ADS1115_BUS_MAX_DEVICES][ADS1115_BUS_MAX_MUX] = {0};
+    uint16_t gain[ADS1115_BUS_MAX_DEVICES][ADS1115_BUS_MAX_MUX] = {0};
+
+    while (1) {
+        uint32_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+        adc_frame_t *slot = &ring[head & (ADC_SAMPLER_RING_SIZE - 1)];
+        int64_t timestamp_us;
+        uint32_t updated[ADS1115_BUS_MAX_DEVICES];
+        adc_sampler_changes_t changes;
+
+        while (xQueueReceive(cmd_queue, &changes, 0) == pdTRUE) {
+            for (int i = 0; i < changes.count; i++) {
+                adc_sampler_apply_cmd(&changes.cmd[i]);
+            }
+        }
+
+        // Errors are logged by the scheduler; failed channels keep their last value and
+        // are left out of updated_mask, so filters and the current loop skip them
+        ads1115_bus_scan(sampler_bus, raw, gain, updated, &timestamp_us);
+
+        // Seqlock writer: the head that retires this slot's old frame is visible before
+        // any of the new contents
+        atomic_thread_fence(memory_order_release);
+        slot->seq = head;
+        slot->timestamp_us = timestamp_us;
+        slot->num_channels = sampler_bus->num_devices * ADC_SAMPLER_NUM_CHANNELS;
+        slot->updated_mask = 0;
+        for (size_t d = 0; d < sampler_bus->num_devices; d++) {
+            for (int ch = 0; ch < ADC_SAMPLER_NUM_CHANNELS; ch++) {
+                slot->raw[d * ADC_SAMPLER_NUM_CHANNELS + ch] = raw[d][ch];
+                slot->gain[d * ADC_SAMPLER_NUM_CHANNELS + ch] = gain[d][ch];
+            }
+            slot->updated_mask |= updated[d] << (d * ADC_SAMPLER_NUM_CHANNELS);
+        }
+        atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+
+        adc_sampler_filter_scan(slot);
+
+        if (timestamp_us - last_stats_us >= ADC_SAMPLER_STATS_INTERVAL_US) {
+            adc_sampler_log_stats();
+            last_stats_us = timestamp_us;
+        }
+    }
+}
+
+esp_err_t adc_sampler_start(ads1115_bus_t *bus)
+{
+    if (!bus || bus->num_devices == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret = ads1115_bus_set_channels(bus, channels, ADC_SAMPLER_NUM_CHANNELS);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ads1115_scale_init(&adc_scale, 1, 1);
+    for (int ch = 0; ch < ADC_SAMPLER_NUM_CHANNELS; ch++) {
+        if (ch == ADC_CH_A3) {
+            ads1115_scale_init(&channel_scale[ch], ADC_SAMPLER_BATT_DIV_NUM, ADC_SAMPLER_BATT_DIV_DEN);
+        } else {
+            ads1115_scale_init(&channel_scale[ch], ADC_SAMPLER_LOAD_DIV_NUM, ADC_SAMPLER_LOAD_DIV_DEN);
+        }
+    }
+
+    for (size_t d = 0; d < ADS1115_BUS_MAX_DEVICES; d++) {
+        for (int ch = 0; ch < ADC_SAMPLER_NUM_CHANNELS; ch++) {
+            adc_filter_init(&filters[d][ch], &filter_config[ch]);
+        }
+    }
+
+    cmd_queue = xQueueCreate(ADC_SAMPLER_CHANGES_QUEUE_LEN, sizeof(adc_sampler_changes_t));
+    if (!cmd_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    sampler_bus = bus;
+    // Runs below the DAC task; every conversion blocks on I2C and ALERT/RDY so lower tasks still run
+    if (xTaskCreate(adc_sampler_task, "adc_sampler_task", 4096, NULL, 4, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "ADC sampler started");
+    return ESP_OK;
+}
+
+// Slot for a change of this kind to this channel: the earlier one if any, else a new one
+static adc_sampler_cmd_t *adc_sampler_changes_slot(adc_sampler_changes_t *changes, adc_sampler_cmd_type_t type,
+                                                   uint8_t channel)
+{
+    for (int i = 0; i < changes->count; i++) {
+        if (changes->cmd[i].type == type && changes->cmd[i].channel == channel) {
+            return &changes->cmd[i];
+        }
+    }
+    return &changes->cmd[changes->count++];
+}
+
+esp_err_t adc_sampler_changes_add_schedule(adc_sampler_changes_t *changes, uint8_t channel, uint8_t decimation,
+                                           uint8_t priority, uint16_t data_rate)
+{
+    if (!changes || channel >= ADC_SAMPLER_NUM_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *adc_sampler_changes_slot(changes, ADC_SAMPLER_CMD_SCHEDULE, channel) = (adc_sampler_cmd_t){
+        .type = ADC_SAMPLER_CMD_SCHEDULE,
+        .channel = channel,
+        .schedule = {
+            .decimation = decimation,
+            .priority = priority,
+            .data_rate = data_rate,
+        },
+    };
+    return ESP_OK;
+}
+
+esp_err_t adc_sampler_changes_add_filter(adc_sampler_changes_t *changes, uint8_t channel,
+                                         const adc_filter_config_t *config)
+{
+    if (!changes || channel >= ADC_SAMPLER_NUM_CHANNELS || !config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Validate here so the caller gets the error, not the sampler log
+    adc_filter_t probe;
+    if (!adc_filter_init(&probe, config)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *adc_sampler_changes_slot(changes, ADC_SAMPLER_CMD_FILTER, channel) = (adc_sampler_cmd_t){
+        .type = ADC_SAMPLER_CMD_FILTER,
+        .channel = channel,
+        .filter = *config,
+    };
+    return ESP_OK;
+}
+
+esp_err_t adc_sampler_apply_changes(const adc_sampler_changes_t *changes)
+{
+    if (!cmd_queue || !changes) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (changes->count == 0) {
+        return ESP_OK;
+    }
+    return xQueueSend(cmd_queue, changes, 0) == pdTRUE ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t adc_sampler_set_schedule(uint8_t channel, uint8_t decimation, uint8_t priority, uint16_t data_rate)
+{
+    adc_sampler_changes_t changes = {0};
+    esp_err_t ret = adc_sampler_changes_add_schedule(&changes, channel, decimation, priority, data_rate);
+    return ret == ESP_OK ? adc_sampler_apply_changes(&changes) : ret;
+}
+
+esp_err_t adc_sampler_set_filter(uint8_t channel, const adc_filter_config_t *config)
+{
+    adc_sampler_changes_t changes = {0};
+    esp_err_t ret = adc_sampler_changes_add_filter(&changes, channel, config);
+    return ret == ESP_OK ? adc_sampler_apply_changes(&changes) : ret;
+}
+
+bool adc_sampler_get_filtered(adc_frame_t *frame)
+{
+    if (!frame) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&filtered_lock);
+    bool valid = filtered_valid;
+    if (valid) {
+        *frame = filtered_frame;
+    }
+    portEXIT_CRITICAL(&filtered_lock);
+    return valid;
+}
+
+bool adc_sampler_get_latest(adc_frame_t *frame)
+{
+    if (!frame) {
+        return false;
+    }
+
+    while (1) {
+        uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+        if (head == 0) {
+            return false;  // Nothing sampled yet
+        }
+
+        *frame = ring[(head - 1) & (ADC_SAMPLER_RING_SIZE - 1)];
+
+        // The slot is only rewritten once the producer has published RING_SIZE - 1 newer
+        // frames. The fence keeps the copy's plain reads from moving past the re-check.
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t now = atomic_load_explicit(&ring_head, memory_order_relaxed);
+        if (now - head < ADC_SAMPLER_RING_SIZE - 1) {
+            return true;
+        }
+    }
+}
+
+bool adc_sampler_read_next(uint32_t *seq, adc_frame_t *frame, uint32_t *dropped)
+{
+    if (!seq || !frame) {
+        return false;
+    }
+
+    while (1) {
+        uint32_t head = atomic_load_explicit(&ring_head, memory_order_acquire);
+        if ((int32_t)(head - *seq) <= 0) {
+            return false;  // Caught up
+        }
+
+        // Oldest frame that is guaranteed not to be rewritten during the copy
+        uint32_t oldest = head - (ADC_SAMPLER_RING_SIZE - 1);
+        if ((int32_t)(oldest - *seq) > 0 && head >= ADC_SAMPLER_RING_SIZE - 1) {
+            if (dropped) {
+                *dropped += oldest - *seq;
+            }
+            *seq = oldest;
+        }
+
+        *frame = ring[*seq & (ADC_SAMPLER_RING_SIZE - 1)];
+
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t now = atomic_load_explicit(&ring_head, memory_order_relaxed);
+        if (now - *seq < ADC_SAMPLER_RING_SIZE) {
+            (*seq)++;
+            return true;
+        }
+    }
+}
+
+void adc_sampler_frame_to_uv(const adc_frame_t *frame, int32_t *uv)
+{
+    if (!frame || !uv) {
+        return;
+    }
+
+    // Frames hold whole devices; each channel position has its own divider
+    for (size_t base = 0; base + ADC_SAMPLER_NUM_CHANNELS <= frame->num_channels; base += ADC_SAMPLER_NUM_CHANNELS) {
+        for (int ch = 0; ch < ADC_SAMPLER_NUM_CHANNELS; ch++) {
+            uv[base + ch] = ads1115_scale_apply(&channel_scale[ch], frame->raw[base + ch], frame->gain[base + ch]);
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ads1115.h"
+#include "ads1115_bus.h"
+#include "adc_filter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Channels scanned on every ADS1115, in frame order
+enum {
+    ADC_CH_A0,
+    ADC_CH_A1,
+    ADC_CH_A2,
+    ADC_CH_A3,
+    ADC_CH_SHUNT,       // A0 - A1 differential, window-compared for current protection
+    ADC_SAMPLER_NUM_CHANNELS
+};
+
+#define ADC_SAMPLER_SINGLE_GAIN     ADS1115_PGA_4_096V  // Node voltages are at most ~3 V after the dividers
+#define ADC_SAMPLER_SHUNT_GAIN      ADS1115_PGA_0_256V  // Starting range; the shunt channel auto-ranges
+
+// Input dividers (input/ADC): 39k/10k on the load nodes, 100k/100k on the battery
+#define ADC_SAMPLER_LOAD_DIV_NUM    49
+#define ADC_SAMPLER_LOAD_DIV_DEN    10
+#define ADC_SAMPLER_BATT_DIV_NUM    2
+#define ADC_SAMPLER_BATT_DIV_DEN    1
+
+#define ADC_SAMPLER_MAX_CHANNELS    (ADC_SAMPLER_NUM_CHANNELS * ADS1115_BUS_MAX_DEVICES)
+#define ADC_SAMPLER_RING_SIZE       64  // Must be a power of two; ~200 ms of scans for batching readers
+#define ADC_SAMPLER_CHANGES_MAX     (ADC_SAMPLER_NUM_CHANNELS * 2)  // A schedule and a filter per channel
+
+// One complete scan of all channels on all devices
+typedef struct {
+    uint32_t seq;                               // Frame counter, incremented per scan
+    int64_t timestamp_us;                       // esp_timer time when the scan completed
+    uint8_t num_channels;                       // ADC_SAMPLER_NUM_CHANNELS per device on the bus
+    uint32_t updated_mask;                      // Channels read in this scan; others (not due, or failed) repeat older values
+    int16_t raw[ADC_SAMPLER_MAX_CHANNELS];      // Raw codes, device 0 channels first, then device 1, ...
+    uint16_t gain[ADC_SAMPLER_MAX_CHANNELS];    // ADS1115_PGA_* each raw code was taken at
+} adc_frame_t;
+
+typedef enum {
+    ADC_SAMPLER_CMD_SCHEDULE,
+    ADC_SAMPLER_CMD_FILTER,
+} adc_sampler_cmd_type_t;
+
+typedef struct {
+    adc_sampler_cmd_type_t type;
+    uint8_t channel;
+    union {
+        struct {
+            uint8_t decimation;
+            uint8_t priority;
+            uint16_t data_rate;
+        } schedule;
+        adc_filter_config_t filter;
+    };
+} adc_sampler_cmd_t;
+
+// Schedule and filter changes that take effect together, between the same two scans.
+// Zero-initialise, add to it, then queue it with adc_sampler_apply_changes().
+typedef struct {
+    uint8_t count;
+    adc_sampler_cmd_t cmd[ADC_SAMPLER_CHANGES_MAX];
+} adc_sampler_changes_t;
+
+esp_err_t adc_sampler_start(ads1115_bus_t *bus);
+bool adc_sampler_get_latest(adc_frame_t *frame);
+// Stream reader: copy frame *seq (or the oldest still buffered if the ring lapped the
+// reader, adding the skipped count to *dropped) and advance *seq. False when caught up.
+bool adc_sampler_read_next(uint32_t *seq, adc_frame_t *frame, uint32_t *dropped);
+// Latest filtered values in the same raw-code format. updated_mask marks the channels
+// whose filter produced an output in that update; the rest hold their previous output.
+bool adc_sampler_get_filtered(adc_frame_t *frame);
+// Board-referenced microvolts (before the dividers) for every channel in the frame.
+// Fixed point only, safe to call per frame from any task.
+void adc_sampler_frame_to_uv(const adc_frame_t *frame, int32_t *uv);
+
+// Queue a new rate/priority for one channel (applies to all devices at the next scan).
+// decimation: convert every Nth scan; data_rate: ADS1115_DR_*, 0 for the device default.
+esp_err_t adc_sampler_set_schedule(uint8_t channel, uint8_t decimation, uint8_t priority, uint16_t data_rate);
+// Replace one channel's filter chain (all devices); state restarts from empty.
+esp_err_t adc_sampler_set_filter(uint8_t channel, const adc_filter_config_t *config);
+
+// Add one change to a set, with the same checks as the calls above. A later change of the
+// same kind to the same channel replaces the earlier one, so the set never overflows.
+esp_err_t adc_sampler_changes_add_schedule(adc_sampler_changes_t *changes, uint8_t channel, uint8_t decimation,
+                                           uint8_t priority, uint16_t data_rate);
+esp_err_t adc_sampler_changes_add_filter(adc_sampler_changes_t *changes, uint8_t channel,
+                                         const adc_filter_config_t *config);
+// Queue the whole set, or nothing: ESP_ERR_NO_MEM when the sampler queue is full
+esp_err_t adc_sampler_apply_changes(const adc_sampler_changes_t *changes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADC_SAMPLER_H
@@ -0,0 +1,83 @@
+#include <string.h>
+#include "adv_status.h"
+#include "ble_transport.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "ADV_STATUS";
+
+#define ADV_STATUS_PERIOD_MS    1000
+
+_Static_assert(ADV_STATUS_LEN <= BLE_TRANSPORT_MAX_MFG_LEN, "Status does not fit the advertisement");
+
+static TaskHandle_t adv_status_task_handle;
+
+static uint16_t adv_status_u16(int64_t v)
+{
+    return v < 0 ? 0 : v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
+
+size_t adv_status_encode(const adv_status_t *status, uint8_t *out)
+{
+    uint16_t elapsed = adv_status_u16(status->elapsed_s);
+    uint16_t current = adv_status_u16(status->current_ua);
+    uint16_t battery = adv_status_u16(status->battery_mv);
+
+    // Company ID is little endian like every Bluetooth field; the rest is big endian like the GATT values
+    out[0] = ADV_STATUS_COMPANY_ID & 0xFF;
+    out[1] = ADV_STATUS_COMPANY_ID >> 8;
+    out[2] = ADV_STATUS_VERSION;
+    out[3] = status->state;
+    out[4] = elapsed >> 8;
+    out[5] = elapsed & 0xFF;
+    out[6] = current >> 8;
+    out[7] = current & 0xFF;
+    out[8] = battery >> 8;
+    out[9] = battery & 0xFF;
+    out[10] = status->faults;
+    out[11] = status->connections;
+    return ADV_STATUS_LEN;
+}
+
+static void adv_status_task(void *args)
+{
+    adv_status_read_t read = (adv_status_read_t)args;
+    uint8_t last[ADV_STATUS_LEN] = {0};
+    bool sent = false;
+
+    while (1) {
+        adv_status_t status;
+        uint8_t payload[ADV_STATUS_LEN];
+        read(&status);
+        adv_status_encode(&status, payload);
+
+        // Each change is one HCI command; unchanged payloads cost nothing
+        if (!sent || memcmp(payload, last, sizeof(payload)) != 0) {
+            esp_err_t ret = ble_transport_set_mfg_data(payload, sizeof(payload));
+            if (ret == ESP_OK) {
+                memcpy(last, payload, sizeof(payload));
+                sent = true;
+            } else {
+                ESP_LOGW(TAG, "Advertising status update failed: %s", esp_err_to_name(ret));
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ADV_STATUS_PERIOD_MS));
+    }
+}
+
+esp_err_t adv_status_start(adv_status_read_t read)
+{
+    // Lowest of the app tasks: the advertisement can lag a scan interval without harm
+    if (xTaskCreate(adv_status_task, "adv_status_task", 3072, read, 2, &adv_status_task_handle) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void adv_status_changed(void)
+{
+    if (adv_status_task_handle) {
+        xTaskNotifyGive(adv_status_task_handle);
+    }
+}
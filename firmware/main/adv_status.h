@@ -0,0 +1,49 @@
+#ifndef ADV_STATUS_H
+#define ADV_STATUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Device status carried in the manufacturer-specific advertising data, so a scan shows
+// every nearby device's state without connecting (format in README)
+#define ADV_STATUS_COMPANY_ID   0xFFFF  // Bluetooth SIG ID for internal use; no ID is assigned
+#define ADV_STATUS_VERSION      1
+#define ADV_STATUS_LEN          12      // Including the company ID
+
+typedef enum {
+    ADV_STATUS_IDLE = 0,        // DAC disabled
+    ADV_STATUS_RAMPING,         // DAC enabled and moving toward its target
+    ADV_STATUS_STIMULATING,     // DAC enabled at its target
+    ADV_STATUS_FAULT,           // Forced safe by a current watchdog until re-enabled
+} adv_status_state_t;
+
+typedef struct {
+    adv_status_state_t state;
+    uint32_t elapsed_s;         // Since the DAC was enabled, 0 when idle
+    int32_t current_ua;         // Latest filtered shunt current
+    int32_t battery_mv;
+    uint8_t faults;             // Latched fault flags, as in the command status
+    uint8_t connections;
+} adv_status_t;
+
+typedef void (*adv_status_read_t)(adv_status_t *status);
+
+// Refresh the advertising payload from `read` every second, and early on adv_status_changed().
+// The advertisement is only updated when the encoded payload changes.
+esp_err_t adv_status_start(adv_status_read_t read);
+// Wake the refresh after a state change; task context only
+void adv_status_changed(void);
+
+// Returns ADV_STATUS_LEN
+size_t adv_status_encode(const adv_status_t *status, uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ADV_STATUS_H
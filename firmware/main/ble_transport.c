@@ -0,0 +1,99 @@
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include "ble_transport.h"
+#include "ble_transport_priv.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "BLE";
+
+#if CONFIG_BT_NIMBLE_ENABLED
+#define BLE_TRANSPORT_HOST "NimBLE"
+#else
+#define BLE_TRANSPORT_HOST "Bluedroid"
+#endif
+
+// Manufacturer data is set from app tasks and read by the host task when advertising
+static portMUX_TYPE mfg_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t mfg_data[BLE_TRANSPORT_MAX_MFG_LEN];
+static size_t mfg_len;
+
+esp_err_t ble_transport_set_mfg_data(const uint8_t *data, size_t len)
+{
+    if (len > BLE_TRANSPORT_MAX_MFG_LEN || (len > 0 && len < 2)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    portENTER_CRITICAL(&mfg_lock);
+    memcpy(mfg_data, data, len);
+    mfg_len = len;
+    portEXIT_CRITICAL(&mfg_lock);
+    ble_transport_adv_data_changed();
+    return ESP_OK;
+}
+
+size_t ble_transport_get_mfg_data(uint8_t *out)
+{
+    portENTER_CRITICAL(&mfg_lock);
+    size_t len = mfg_len;
+    memcpy(out, mfg_data, len);
+    portEXIT_CRITICAL(&mfg_lock);
+    return len;
+}
+
+bool ble_transport_gatt_db_changed(void)
+{
+    nvs_handle_t nvs;
+    uint32_t stored = 0;
+    esp_err_t ret = nvs_open("ble", NVS_READONLY, &nvs);
+    if (ret == ESP_OK) {
+        nvs_get_u32(nvs, "gatt_db", &stored);
+        nvs_close(nvs);
+    } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "GATT database version unavailable: %s", esp_err_to_name(ret));
+        return true;  // Clients re-discover needlessly rather than keep a stale cache
+    }
+    bool changed = stored != BLE_TRANSPORT_GATT_DB_VERSION;
+    if (changed) {
+        ESP_LOGI(TAG, "GATT database version %" PRIu32 " -> %d", stored, BLE_TRANSPORT_GATT_DB_VERSION);
+    }
+    return changed;
+}
+
+void ble_transport_gatt_db_commit(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open("ble", NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(nvs, "gatt_db", BLE_TRANSPORT_GATT_DB_VERSION);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "GATT database version not stored: %s", esp_err_to_name(ret));
+    }
+}
+
+void ble_transport_log_heap(const char *stage)
+{
+    ESP_LOGI(TAG, "%s: %s, free internal heap %u bytes (min %u)", BLE_TRANSPORT_HOST, stage,
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+             (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+}
+
+void ble_transport_log_first_adv(void)
+{
+    static bool logged;
+    if (logged) {
+        return;
+    }
+    logged = true;
+    ESP_LOGI(TAG, "%s: first advertisement %" PRId64 " ms after boot", BLE_TRANSPORT_HOST,
+             esp_timer_get_time() / 1000);
+}
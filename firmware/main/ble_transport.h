@@ -0,0 +1,82 @@
+#ifndef BLE_TRANSPORT_H
+#define BLE_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// GATT server behind one small interface so the app does not depend on the host stack.
+// The backend (NimBLE or Bluedroid) follows the Bluetooth host chosen in menuconfig.
+
+#define BLE_TRANSPORT_DEVICE_NAME       "tDCS"
+#define BLE_TRANSPORT_SERVICE_UUID      0x00FF
+#define BLE_TRANSPORT_LOCAL_MTU         500
+#define BLE_TRANSPORT_ATT_HEADER_LEN    3       // Opcode + handle in every notification
+#define BLE_TRANSPORT_MAX_VALUE_LEN     (BLE_TRANSPORT_LOCAL_MTU - BLE_TRANSPORT_ATT_HEADER_LEN)
+#define BLE_TRANSPORT_MAX_CONNS         3       // ESP32 controller default; keep the host config in step
+// Bump whenever services or characteristics change: bonded clients cache the attribute
+// table and are sent Service Changed when the version differs from the last boot's
+#define BLE_TRANSPORT_GATT_DB_VERSION   3
+// What is left of the 31-byte advertisement after flags, name and connection interval range
+#define BLE_TRANSPORT_MAX_MFG_LEN       14
+
+typedef enum {
+    BLE_CHAR_CONTROL,       // 0xFF01: read ADC record, single-value writes (encrypted)
+    BLE_CHAR_TELEMETRY,     // 0xFF02: notify
+    BLE_CHAR_COMMAND,       // 0xFF03: command batches (encrypted), status notify/read
+    BLE_CHAR_LOG,           // 0xFF04: session log download requests, data notify
+    BLE_CHAR_OTA,           // 0xFF05: firmware update requests and data (encrypted), progress notify
+    BLE_CHAR_COUNT,
+} ble_char_t;
+
+// Called from the host stack's task; keep them short. `conn` is a slot index below
+// BLE_TRANSPORT_MAX_CONNS, stable for the life of the connection.
+typedef struct {
+    void (*on_connect)(uint8_t conn);
+    void (*on_disconnect)(uint8_t conn);
+    void (*on_mtu)(uint8_t conn, uint16_t mtu);
+    void (*on_congest)(uint8_t conn, bool congested);
+    void (*on_subscribe)(uint8_t conn, ble_char_t ch, bool notify);
+    size_t (*on_read)(uint8_t conn, ble_char_t ch, uint8_t *out, size_t cap);   // Returns the value length
+    // ESP_ERR_NOT_ALLOWED rejects the write with "write not permitted"
+    esp_err_t (*on_write)(uint8_t conn, ble_char_t ch, const uint8_t *data, size_t len);
+} ble_transport_callbacks_t;
+
+// Bring up the controller and host, register the service and start advertising.
+// Advertising continues until every connection slot is taken. Clients are asked to bond
+// (Just Works); bonds live in NVS, which must be initialised first. Writes that drive the
+// output or the firmware need an encrypted link: the stack answers "insufficient
+// encryption" before they reach on_write, which makes the client pair. When a bonded client's
+// link times out, a short burst of directed advertising toward it precedes the undirected
+// advertising so it can reconnect without waiting on a scan.
+esp_err_t ble_transport_start(const ble_transport_callbacks_t *callbacks);
+
+// Manufacturer-specific advertising data, company ID first (little endian). Takes effect
+// on the live advertisement; callable from any task, before or after start.
+esp_err_t ble_transport_set_mfg_data(const uint8_t *data, size_t len);
+
+// Notify one client. ESP_ERR_NO_MEM means the stack's buffers are full;
+// on_congest(conn, false) follows once they drain.
+esp_err_t ble_transport_notify(uint8_t conn, ble_char_t ch, const uint8_t *data, size_t len);
+
+// Link parameter requests for one connection; results are logged by the backend.
+// Intervals in 1.25 ms units, timeout in 10 ms units. ESP_ERR_INVALID_STATE if the
+// connection has gone, which can happen while a caller on another task is mid-update.
+esp_err_t ble_transport_set_conn_params(uint8_t conn, uint16_t min_int, uint16_t max_int, uint16_t latency, uint16_t timeout);
+esp_err_t ble_transport_set_data_len(uint8_t conn, uint16_t tx_octets);
+// ESP_ERR_NOT_SUPPORTED on controllers without 2M PHY (the original ESP32 is Bluetooth 4.2)
+esp_err_t ble_transport_set_phy(uint8_t conn, bool prefer_2m);
+// True once the link is encrypted with keys from a bond (fresh or stored); false for a
+// connection that has gone
+bool ble_transport_is_bonded(uint8_t conn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_TRANSPORT_H
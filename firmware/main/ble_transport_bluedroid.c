@@ -0,0 +1,777 @@
+#include "sdkconfig.h"
+
+#if CONFIG_BT_BLUEDROID_ENABLED
+
+#include <stdlib.h>
+#include <string.h>
+#include "ble_transport.h"
+#include "ble_transport_priv.h"
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "esp_bt_defs.h"
+#include "esp_bt_main.h"
+#include "esp_gatt_common_api.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#define GATTS_TAG "tDCS"
+
+static void gatts_profile_a_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+
+#define GATTS_CHAR_UUID_TEST_A      0xFF01
+#define GATTS_CHAR_UUID_TELEMETRY   0xFF02
+#define GATTS_CHAR_UUID_COMMAND     0xFF03
+#define GATTS_CHAR_UUID_LOG         0xFF04
+#define GATTS_CHAR_UUID_OTA         0xFF05
+#define GATTS_NUM_HANDLE_TEST_A     16
+
+#define GATTS_DEMO_CHAR_VAL_LEN_MAX 0x40
+
+static uint8_t char1_str[] = {0x11,0x22,0x33};
+static esp_gatt_char_prop_t a_property = 0;
+
+static esp_attr_value_t gatts_demo_char1_val =
+{
+    .attr_max_len = GATTS_DEMO_CHAR_VAL_LEN_MAX,
+    .attr_len     = sizeof(char1_str),
+    .attr_value   = char1_str,
+};
+
+// CCCDs are answered here rather than by the stack, which keeps one value for all
+// connections; subscription state is per connection
+static uint8_t cccd_val[2] = {0x00, 0x00};
+static esp_attr_value_t cccd_attr = {
+    .attr_max_len = sizeof(cccd_val),
+    .attr_len     = sizeof(cccd_val),
+    .attr_value   = cccd_val,
+};
+static esp_attr_control_t auto_rsp_control = {
+    .auto_rsp = ESP_GATT_AUTO_RSP,
+};
+
+// adv_active covers a pending start too, so a data update never starts advertising twice
+static volatile bool adv_ready;     // GATT app registered; advertising data may be configured
+static bool adv_active;
+
+// Manufacturer data is filled in per configuration (see config_adv_data)
+static const esp_ble_adv_data_t adv_data = {
+    .set_scan_rsp = false,
+    .include_name = true,
+    .include_txpower = false,
+    .min_interval = 0x0006,
+    .max_interval = 0x0010,
+    .appearance = 0x00,
+    .manufacturer_len = 0,
+    .p_manufacturer_data = NULL,
+    .service_data_len = 0,
+    .p_service_data = NULL,
+    .service_uuid_len = 0,
+    .p_service_uuid = NULL,
+    .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
+};
+
+static esp_ble_adv_params_t adv_params = {
+    .adv_int_min        = 0x20,
+    .adv_int_max        = 0x40,
+    .adv_type           = ADV_TYPE_IND,
+    .own_addr_type      = BLE_ADDR_TYPE_PUBLIC,
+    //.peer_addr            =
+    //.peer_addr_type       =
+    .channel_map        = ADV_CHNL_ALL,
+    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+};
+
+#define PROFILE_NUM 1
+#define PROFILE_A_APP_ID 0
+
+struct gatts_profile_inst {
+    esp_gatts_cb_t gatts_cb;
+    uint16_t gatts_if;
+    uint16_t app_id;
+    uint16_t conn_id;
+    uint16_t service_handle;
+    esp_gatt_srvc_id_t service_id;
+    uint16_t char_handle;
+    esp_bt_uuid_t char_uuid;
+    esp_gatt_perm_t perm;
+    esp_gatt_char_prop_t property;
+    uint16_t descr_handle;
+    esp_bt_uuid_t descr_uuid;
+    uint16_t telemetry_handle;
+    uint16_t telemetry_cccd_handle;
+    uint16_t command_handle;
+    uint16_t command_cccd_handle;
+    uint16_t log_handle;
+    uint16_t log_cccd_handle;
+    uint16_t ota_handle;
+    uint16_t ota_cccd_handle;
+};
+
+typedef struct {
+    bool in_use;
+    bool bonded;
+    uint16_t conn_id;
+    esp_bd_addr_t remote_bda;
+    esp_ble_addr_type_t addr_type;
+    bool notify[BLE_CHAR_COUNT];
+} ble_conn_t;
+
+static ble_conn_t conns[BLE_TRANSPORT_MAX_CONNS];
+
+// Bonded client whose link just timed out; advertising is directed at it until it
+// reconnects or directed_timer fires. Bluedroid does not report the controller's own
+// 1.28 s timeout, so the timer stops the burst and ADV_STOP_COMPLETE goes undirected.
+static volatile bool directed_pending;
+static esp_bd_addr_t directed_peer;
+static esp_ble_addr_type_t directed_peer_type;
+static esp_timer_handle_t directed_timer;
+
+// Bonded clients still owed Service Changed. Bluedroid keeps this in RAM only, so the
+// list lives in NVS until each one has been sent it; a client away for the boot that
+// changed the database is told whenever it next connects. Sized for the default
+// CONFIG_BT_SMP_MAX_BONDS (15).
+#define SERVICE_CHANGE_MAX_PEERS 16
+static esp_bd_addr_t service_change_pending[SERVICE_CHANGE_MAX_PEERS];
+static size_t service_change_pending_count;
+
+/* One gatt-based profile one app_id and one gatts_if, this array will store the gatts_if returned by ESP_GATTS_REG_EVT */
+static struct gatts_profile_inst gl_profile_tab[PROFILE_NUM] = {
+    [PROFILE_A_APP_ID] = {
+        .gatts_cb = gatts_profile_a_event_handler,
+        .gatts_if = ESP_GATT_IF_NONE,       /* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
+    },
+};
+
+static const ble_transport_callbacks_t *callbacks;
+
+static void start_advertising(void);
+static int bda_to_slot(const esp_bd_addr_t bda);
+static void send_service_change(int slot);
+
+static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event) {
+    case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
+        // Status updates change the data of a running advertisement; only the first starts it
+        start_advertising();
+        break;
+    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+        if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+            adv_active = false;
+            ESP_LOGE(GATTS_TAG, "Advertising start failed");
+        } else {
+            ble_transport_log_first_adv();
+        }
+        break;
+    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+        if (param->adv_stop_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(GATTS_TAG, "Advertising stop failed");
+        } else {
+            // Stops only happen around a directed burst: start it, or go back to undirected
+            adv_active = false;
+            start_advertising();
+        }
+        break;
+    case ESP_GAP_BLE_SEC_REQ_EVT:
+        esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+        break;
+    case ESP_GAP_BLE_AUTH_CMPL_EVT: {
+        int slot = bda_to_slot(param->ble_security.auth_cmpl.bd_addr);
+        bool bonded = param->ble_security.auth_cmpl.success &&
+                      (param->ble_security.auth_cmpl.auth_mode & ESP_LE_AUTH_BOND);
+        ESP_LOGI(GATTS_TAG, "Encryption: %s, bonded %d", param->ble_security.auth_cmpl.success ?
+                 "ok" : "failed", bonded);
+        if (slot >= 0 && bonded) {
+            conns[slot].bonded = true;
+            send_service_change(slot);
+        }
+        break;
+    }
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+        ESP_LOGI(GATTS_TAG, "Conn params: status %d, interval %.2f ms, latency %u, timeout %u ms",
+                 param->update_conn_params.status, param->update_conn_params.conn_int * 1.25,
+                 param->update_conn_params.latency, param->update_conn_params.timeout * 10);
+        break;
+    case ESP_GAP_BLE_SET_PKT_LENGTH_COMPLETE_EVT:
+        ESP_LOGI(GATTS_TAG, "Data length: status %d, tx %u, rx %u", param->pkt_data_length_cmpl.status,
+                 param->pkt_data_length_cmpl.params.tx_len, param->pkt_data_length_cmpl.params.rx_len);
+        break;
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    case ESP_GAP_BLE_PHY_UPDATE_COMPLETE_EVT:
+        ESP_LOGI(GATTS_TAG, "PHY: status %d, tx %u, rx %u", param->phy_update.status,
+                 param->phy_update.tx_phy, param->phy_update.rx_phy);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+static int conn_id_to_slot(uint16_t conn_id)
+{
+    for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+        if (conns[i].in_use && conns[i].conn_id == conn_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int conn_count(void)
+{
+    int n = 0;
+    for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+        n += conns[i].in_use;
+    }
+    return n;
+}
+
+static int bda_to_slot(const esp_bd_addr_t bda)
+{
+    for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+        if (conns[i].in_use && memcmp(conns[i].remote_bda, bda, sizeof(esp_bd_addr_t)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void start_advertising(void)
+{
+    // Advertising stops on every connection; keep it up while slots are free
+    if (adv_active || conn_count() >= BLE_TRANSPORT_MAX_CONNS) {
+        return;
+    }
+    adv_active = true;
+    if (directed_pending) {
+        esp_ble_adv_params_t params = adv_params;
+        params.adv_type = ADV_TYPE_DIRECT_IND_HIGH;
+        memcpy(params.peer_addr, directed_peer, sizeof(esp_bd_addr_t));
+        params.peer_addr_type = directed_peer_type;
+        esp_timer_start_once(directed_timer, BLE_TRANSPORT_DIRECTED_ADV_MS * 1000);
+        esp_ble_gap_start_advertising(&params);
+        ESP_LOGI(GATTS_TAG, "Directed advertising to last bonded peer");
+        return;
+    }
+    esp_ble_gap_start_advertising(&adv_params);
+}
+
+static void directed_adv_timeout(void *arg)
+{
+    if (directed_pending) {
+        directed_pending = false;
+        esp_ble_gap_stop_advertising();
+    }
+}
+
+static esp_err_t service_change_save(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open("ble", NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_blob(nvs, "sc_pending", service_change_pending,
+                           service_change_pending_count * sizeof(esp_bd_addr_t));
+        if (ret == ESP_OK) {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(GATTS_TAG, "Service Changed list not saved: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static int service_change_find(const esp_bd_addr_t bda)
+{
+    for (size_t i = 0; i < service_change_pending_count; i++) {
+        if (memcmp(service_change_pending[i], bda, sizeof(esp_bd_addr_t)) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Load the clients still owed Service Changed, less any no longer bonded, and add every
+// bond if the database has changed. The new version is stored only once the list is.
+static void service_change_init(void)
+{
+    esp_bd_addr_t stored[SERVICE_CHANGE_MAX_PEERS];
+    size_t len = sizeof(stored);
+    nvs_handle_t nvs;
+    if (nvs_open("ble", NVS_READONLY, &nvs) == ESP_OK) {
+        if (nvs_get_blob(nvs, "sc_pending", stored, &len) != ESP_OK) {
+            len = 0;
+        }
+        nvs_close(nvs);
+    } else {
+        len = 0;  // Nothing stored yet
+    }
+    bool changed = ble_transport_gatt_db_changed();
+
+    int num = esp_ble_get_bond_device_num();
+    esp_ble_bond_dev_t *bonds = num > 0 ? calloc(num, sizeof(*bonds)) : NULL;
+    if (!bonds || esp_ble_get_bond_device_list(&num, bonds) != ESP_OK) {
+        num = 0;
+    }
+    service_change_pending_count = 0;
+    for (int i = 0; i < num && service_change_pending_count < SERVICE_CHANGE_MAX_PEERS; i++) {
+        bool owed = changed;
+        for (size_t j = 0; !owed && j < len / sizeof(esp_bd_addr_t); j++) {
+            owed = memcmp(stored[j], bonds[i].bd_addr, sizeof(esp_bd_addr_t)) == 0;
+        }
+        if (owed) {
+            memcpy(service_change_pending[service_change_pending_count++], bonds[i].bd_addr,
+                   sizeof(esp_bd_addr_t));
+        }
+    }
+    if (num > SERVICE_CHANGE_MAX_PEERS) {
+        ESP_LOGW(GATTS_TAG, "%d bonds, Service Changed tracked for %d", num, SERVICE_CHANGE_MAX_PEERS);
+    }
+    free(bonds);
+
+    if (changed || service_change_pending_count * sizeof(esp_bd_addr_t) != len) {
+        if (service_change_save() == ESP_OK && changed) {
+            ble_transport_gatt_db_commit();
+        }
+    }
+    if (service_change_pending_count) {
+        ESP_LOGI(GATTS_TAG, "Service Changed pending for %u bonded clients",
+                 (unsigned)service_change_pending_count);
+    }
+}
+
+static void send_service_change(int slot)
+{
+    int i = service_change_find(conns[slot].remote_bda);
+    if (i < 0) {
+        return;
+    }
+    // The whole table may have moved, so the client drops its cache and rediscovers
+    esp_err_t ret = esp_ble_gatts_send_service_change_indication(gl_profile_tab[PROFILE_A_APP_ID].gatts_if,
+                                                                 conns[slot].remote_bda);
+    if (ret != ESP_OK) {
+        ESP_LOGW(GATTS_TAG, "Service Changed not sent: %s", esp_err_to_name(ret));
+        return;  // Still pending: tried again on the next connection
+    }
+    memcpy(service_change_pending[i], service_change_pending[--service_change_pending_count],
+           sizeof(esp_bd_addr_t));
+    service_change_save();
+}
+
+static void config_adv_data(void)
+{
+    // The stack copies the manufacturer data before this returns
+    uint8_t mfg[BLE_TRANSPORT_MAX_MFG_LEN];
+    esp_ble_adv_data_t data = adv_data;
+    data.manufacturer_len = ble_transport_get_mfg_data(mfg);
+    data.p_manufacturer_data = data.manufacturer_len ? mfg : NULL;
+    esp_err_t ret = esp_ble_gap_config_adv_data(&data);
+    if (ret != ESP_OK) {
+        ESP_LOGW(GATTS_TAG, "Advertising data update failed: %s", esp_err_to_name(ret));
+    }
+}
+
+void ble_transport_adv_data_changed(void)
+{
+    if (adv_ready) {
+        config_adv_data();
+    }
+}
+
+static int cccd_to_char(uint16_t handle)
+{
+    if (handle == gl_profile_tab[PROFILE_A_APP_ID].telemetry_cccd_handle) {
+        return BLE_CHAR_TELEMETRY;
+    } else if (handle == gl_profile_tab[PROFILE_A_APP_ID].command_cccd_handle) {
+        return BLE_CHAR_COMMAND;
+    } else if (handle == gl_profile_tab[PROFILE_A_APP_ID].log_cccd_handle) {
+        return BLE_CHAR_LOG;
+    } else if (handle == gl_profile_tab[PROFILE_A_APP_ID].ota_cccd_handle) {
+        return BLE_CHAR_OTA;
+    }
+    return -1;
+}
+
+static int handle_to_char(uint16_t handle)
+{
+    struct gatts_profile_inst *profile = &gl_profile_tab[PROFILE_A_APP_ID];
+    if (handle == profile->char_handle) {
+        return BLE_CHAR_CONTROL;
+    } else if (handle == profile->telemetry_handle) {
+        return BLE_CHAR_TELEMETRY;
+    } else if (handle == profile->command_handle) {
+        return BLE_CHAR_COMMAND;
+    } else if (handle == profile->log_handle) {
+        return BLE_CHAR_LOG;
+    } else if (handle == profile->ota_handle) {
+        return BLE_CHAR_OTA;
+    }
+    return -1;
+}
+
+static void gatts_profile_a_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
+    switch (event) {
+    case ESP_GATTS_REG_EVT:
+        gl_profile_tab[PROFILE_A_APP_ID].service_id.is_primary = true;
+        gl_profile_tab[PROFILE_A_APP_ID].service_id.id.inst_id = 0x00;
+        gl_profile_tab[PROFILE_A_APP_ID].service_id.id.uuid.len = ESP_UUID_LEN_16;
+        gl_profile_tab[PROFILE_A_APP_ID].service_id.id.uuid.uuid.uuid16 = BLE_TRANSPORT_SERVICE_UUID;
+
+        esp_ble_gap_set_device_name(BLE_TRANSPORT_DEVICE_NAME);
+        adv_ready = true;
+        config_adv_data();
+        esp_ble_gatts_create_service(gatts_if, &gl_profile_tab[PROFILE_A_APP_ID].service_id, GATTS_NUM_HANDLE_TEST_A);
+        break;
+    case ESP_GATTS_READ_EVT: {
+        int slot = conn_id_to_slot(param->read.conn_id);
+        int cccd = cccd_to_char(param->read.handle);
+        int ch = handle_to_char(param->read.handle);
+        esp_gatt_rsp_t rsp;
+        memset(&rsp, 0, sizeof(esp_gatt_rsp_t));
+        rsp.attr_value.handle = param->read.handle;
+        if (slot < 0) {
+            break;
+        } else if (cccd >= 0) {
+            rsp.attr_value.value[0] = conns[slot].notify[cccd];
+            rsp.attr_value.len = 2;
+        } else if (ch >= 0 && callbacks->on_read) {
+            rsp.attr_value.len = callbacks->on_read(slot, ch, rsp.attr_value.value, BLE_TRANSPORT_MAX_VALUE_LEN);
+        } else {
+            break;
+        }
+
+        esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id,
+                                    ESP_GATT_OK, &rsp);
+        break;
+    }
+    case ESP_GATTS_WRITE_EVT: {
+        int slot = conn_id_to_slot(param->write.conn_id);
+        int cccd = cccd_to_char(param->write.handle);
+        int ch = handle_to_char(param->write.handle);
+        esp_gatt_status_t status = ESP_GATT_OK;
+        if (slot < 0) {
+            status = ESP_GATT_ERROR;
+        } else if (cccd >= 0) {
+            if (param->write.len == 2) {
+                conns[slot].notify[cccd] = param->write.value[0] & 0x01;
+                callbacks->on_subscribe(slot, cccd, conns[slot].notify[cccd]);
+            }
+        } else if (ch >= 0) {
+            if (callbacks->on_write(slot, ch, param->write.value, param->write.len) == ESP_ERR_NOT_ALLOWED) {
+                status = ESP_GATT_WRITE_NOT_PERMIT;
+            }
+        }
+        if (param->write.need_rsp) {
+            esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, NULL);
+        }
+        break;
+    }
+    case ESP_GATTS_CREATE_EVT:
+        gl_profile_tab[PROFILE_A_APP_ID].service_handle = param->create.service_handle;
+        gl_profile_tab[PROFILE_A_APP_ID].char_uuid.len = ESP_UUID_LEN_16;
+        gl_profile_tab[PROFILE_A_APP_ID].char_uuid.uuid.uuid16 = GATTS_CHAR_UUID_TEST_A;
+        esp_ble_gatts_start_service(gl_profile_tab[PROFILE_A_APP_ID].service_handle);
+        a_property = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE;
+        esp_ble_gatts_add_char(gl_profile_tab[PROFILE_A_APP_ID].service_handle,
+                              &gl_profile_tab[PROFILE_A_APP_ID].char_uuid,
+                              ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE_ENCRYPTED,
+                              a_property,
+                              &gatts_demo_char1_val, NULL);
+        break;
+    case ESP_GATTS_ADD_CHAR_EVT:
+        if (param->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_TEST_A) {
+            gl_profile_tab[PROFILE_A_APP_ID].char_handle = param->add_char.attr_handle;
+
+            esp_bt_uuid_t telemetry_uuid = {
+                .len = ESP_UUID_LEN_16,
+                .uuid.uuid16 = GATTS_CHAR_UUID_TELEMETRY,
+            };
+            esp_ble_gatts_add_char(gl_profile_tab[PROFILE_A_APP_ID].service_handle, &telemetry_uuid,
+                                   ESP_GATT_PERM_READ, ESP_GATT_CHAR_PROP_BIT_NOTIFY,
+                                   NULL, &auto_rsp_control);
+        } else if (param->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_TELEMETRY) {
+            gl_profile_tab[PROFILE_A_APP_ID].telemetry_handle = param->add_char.attr_handle;
+
+            esp_bt_uuid_t cccd_uuid = {
+                .len = ESP_UUID_LEN_16,
+                .uuid.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG,
+            };
+            esp_ble_gatts_add_char_descr(gl_profile_tab[PROFILE_A_APP_ID].service_handle, &cccd_uuid,
+                                         ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                                         &cccd_attr, NULL);
+        } else if (param->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_COMMAND ||
+                   param->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_LOG ||
+                   param->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_OTA) {
+            if (param->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_COMMAND) {
+                gl_profile_tab[PROFILE_A_APP_ID].command_handle = param->add_char.attr_handle;
+            } else if (param->add_char.char_uuid.uuid.uuid16 == GATTS_CHAR_UUID_LOG) {
+                gl_profile_tab[PROFILE_A_APP_ID].log_handle = param->add_char.attr_handle;
+            } else {
+                gl_profile_tab[PROFILE_A_APP_ID].ota_handle = param->add_char.attr_handle;
+            }
+
+            esp_bt_uuid_t cccd_uuid = {
+                .len = ESP_UUID_LEN_16,
+                .uuid.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG,
+            };
+            esp_ble_gatts_add_char_descr(gl_profile_tab[PROFILE_A_APP_ID].service_handle, &cccd_uuid,
+                                         ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
+                                         &cccd_attr, NULL);
+        }
+        break;
+    case ESP_GATTS_ADD_CHAR_DESCR_EVT:
+        // Characteristics are added one after another, so CCCDs arrive in table order
+        if (!gl_profile_tab[PROFILE_A_APP_ID].telemetry_cccd_handle) {
+            gl_profile_tab[PROFILE_A_APP_ID].telemetry_cccd_handle = param->add_char_descr.attr_handle;
+
+            // Batched commands: write without response, status notified back
+            esp_bt_uuid_t command_uuid = {
+                .len = ESP_UUID_LEN_16,
+                .uuid.uuid16 = GATTS_CHAR_UUID_COMMAND,
+            };
+            esp_ble_gatts_add_char(gl_profile_tab[PROFILE_A_APP_ID].service_handle, &command_uuid,
+                                   ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE_ENCRYPTED,
+                                   ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE |
+                                   ESP_GATT_CHAR_PROP_BIT_WRITE_NR | ESP_GATT_CHAR_PROP_BIT_NOTIFY,
+                                   NULL, NULL);
+        } else if (!gl_profile_tab[PROFILE_A_APP_ID].command_cccd_handle) {
+            gl_profile_tab[PROFILE_A_APP_ID].command_cccd_handle = param->add_char_descr.attr_handle;
+
+            // Session log download: requests written, data notified back
+            esp_bt_uuid_t log_uuid = {
+                .len = ESP_UUID_LEN_16,
+                .uuid.uuid16 = GATTS_CHAR_UUID_LOG,
+            };
+            esp_ble_gatts_add_char(gl_profile_tab[PROFILE_A_APP_ID].service_handle, &log_uuid,
+                                   ESP_GATT_PERM_WRITE,
+                                   ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR |
+                                   ESP_GATT_CHAR_PROP_BIT_NOTIFY,
+                                   NULL, NULL);
+        } else if (!gl_profile_tab[PROFILE_A_APP_ID].log_cccd_handle) {
+            gl_profile_tab[PROFILE_A_APP_ID].log_cccd_handle = param->add_char_descr.attr_handle;
+
+            // Firmware update: requests and image data written, progress notified back
+            esp_bt_uuid_t ota_uuid = {
+                .len = ESP_UUID_LEN_16,
+                .uuid.uuid16 = GATTS_CHAR_UUID_OTA,
+            };
+            esp_ble_gatts_add_char(gl_profile_tab[PROFILE_A_APP_ID].service_handle, &ota_uuid,
+                                   ESP_GATT_PERM_WRITE_ENCRYPTED,
+                                   ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR |
+                                   ESP_GATT_CHAR_PROP_BIT_NOTIFY,
+                                   NULL, NULL);
+        } else {
+            gl_profile_tab[PROFILE_A_APP_ID].ota_cccd_handle = param->add_char_descr.attr_handle;
+        }
+        break;
+    case ESP_GATTS_CONNECT_EVT: {
+        int slot = -1;
+        for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+            if (!conns[i].in_use) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            esp_ble_gatts_close(gatts_if, param->connect.conn_id);
+            break;
+        }
+        // Subscriptions start off on every connection, bonded or not: the CCCDs are kept
+        // here, not by the stack, and are not persisted. Bonded clients must write them
+        // again after reconnecting, as the app does on every connect.
+        memset(&conns[slot], 0, sizeof(conns[slot]));
+        conns[slot].in_use = true;
+        conns[slot].conn_id = param->connect.conn_id;
+        memcpy(conns[slot].remote_bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+        conns[slot].addr_type = param->connect.ble_addr_type;
+        callbacks->on_connect(slot);
+        // Pair and bond on first contact; a bonded client just re-encrypts with its stored keys
+        esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_NO_MITM);
+        directed_pending = false;
+        esp_timer_stop(directed_timer);
+        adv_active = false;
+        start_advertising();
+        break;
+    }
+    case ESP_GATTS_MTU_EVT: {
+        int slot = conn_id_to_slot(param->mtu.conn_id);
+        if (slot >= 0) {
+            callbacks->on_mtu(slot, param->mtu.mtu);
+        }
+        break;
+    }
+    case ESP_GATTS_CONGEST_EVT: {
+        int slot = conn_id_to_slot(param->congest.conn_id);
+        if (slot >= 0) {
+            callbacks->on_congest(slot, param->congest.congested);
+        }
+        break;
+    }
+    case ESP_GATTS_DISCONNECT_EVT: {
+        int slot = conn_id_to_slot(param->disconnect.conn_id);
+        if (slot < 0) {
+            break;
+        }
+        conns[slot].in_use = false;
+        callbacks->on_disconnect(slot);
+        // A bonded client that lost the link, rather than closed it, is likely trying to come
+        // straight back. Its address is still current that soon after.
+        if (conns[slot].bonded && param->disconnect.reason == ESP_GATT_CONN_TIMEOUT) {
+            directed_pending = true;
+            memcpy(directed_peer, conns[slot].remote_bda, sizeof(esp_bd_addr_t));
+            directed_peer_type = conns[slot].addr_type;
+            if (adv_active) {
+                esp_ble_gap_stop_advertising();  // ADV_STOP_COMPLETE starts the directed burst
+                break;
+            }
+        }
+        start_advertising();
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    if (event == ESP_GATTS_REG_EVT) {
+        if (param->reg.status == ESP_GATT_OK) {
+            gl_profile_tab[param->reg.app_id].gatts_if = gatts_if;
+        } else {
+            return;
+        }
+    }
+
+    for (int idx = 0; idx < PROFILE_NUM; idx++) {
+        if (gatts_if == ESP_GATT_IF_NONE || gatts_if == gl_profile_tab[idx].gatts_if) {
+            if (gl_profile_tab[idx].gatts_cb) {
+                gl_profile_tab[idx].gatts_cb(event, gatts_if, param);
+            }
+        }
+    }
+}
+
+esp_err_t ble_transport_start(const ble_transport_callbacks_t *cb)
+{
+    esp_err_t ret;
+
+    callbacks = cb;
+    ble_transport_log_heap("before init");
+
+    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    ret = esp_bt_controller_init(&bt_cfg);
+    if (ret) {
+        ESP_LOGE(GATTS_TAG, "%s initialize controller failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (ret) {
+        ESP_LOGE(GATTS_TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_init();
+    if (ret) {
+        ESP_LOGE(GATTS_TAG, "%s init bluetooth failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+    ret = esp_bluedroid_enable();
+    if (ret) {
+        ESP_LOGE(GATTS_TAG, "%s enable bluetooth failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+
+    // Just Works bonding (no display or keyboard), LE Secure Connections. Bonded clients
+    // keep their attribute cache between connections and re-encrypt without pairing.
+    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_BOND;
+    esp_ble_io_cap_t iocap = ESP_IO_CAP_NONE;
+    uint8_t key_size = 16;
+    uint8_t key_mask = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+    esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(auth_req));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(iocap));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(key_size));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &key_mask, sizeof(key_mask));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &key_mask, sizeof(key_mask));
+    service_change_init();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = directed_adv_timeout,
+        .name = "directed_adv",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &directed_timer));
+
+    ESP_ERROR_CHECK(esp_ble_gatts_register_callback(gatts_event_handler));
+    ESP_ERROR_CHECK(esp_ble_gap_register_callback(gap_event_handler));
+    ESP_ERROR_CHECK(esp_ble_gatts_app_register(PROFILE_A_APP_ID));
+    esp_ble_gatt_set_local_mtu(BLE_TRANSPORT_LOCAL_MTU);
+
+    ble_transport_log_heap("after init");
+    return ESP_OK;
+}
+
+esp_err_t ble_transport_notify(uint8_t conn, ble_char_t ch, const uint8_t *data, size_t len)
+{
+    struct gatts_profile_inst *profile = &gl_profile_tab[PROFILE_A_APP_ID];
+    uint16_t handle = ch == BLE_CHAR_TELEMETRY ? profile->telemetry_handle :
+                      ch == BLE_CHAR_COMMAND ? profile->command_handle :
+                      ch == BLE_CHAR_LOG ? profile->log_handle :
+                      ch == BLE_CHAR_OTA ? profile->ota_handle : profile->char_handle;
+
+    if (conn >= BLE_TRANSPORT_MAX_CONNS || !conns[conn].in_use) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Bluedroid queues notifications internally and reports congestion by event
+    return esp_ble_gatts_send_indicate(profile->gatts_if, conns[conn].conn_id, handle,
+                                       len, (uint8_t *)data, false);
+}
+
+esp_err_t ble_transport_set_conn_params(uint8_t conn, uint16_t min_int, uint16_t max_int, uint16_t latency, uint16_t timeout)
+{
+    if (conn >= BLE_TRANSPORT_MAX_CONNS || !conns[conn].in_use) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_ble_conn_update_params_t params = {
+        .min_int = min_int,
+        .max_int = max_int,
+        .latency = latency,
+        .timeout = timeout,
+    };
+    memcpy(params.bda, conns[conn].remote_bda, sizeof(esp_bd_addr_t));
+    return esp_ble_gap_update_conn_params(&params);
+}
+
+esp_err_t ble_transport_set_data_len(uint8_t conn, uint16_t tx_octets)
+{
+    if (conn >= BLE_TRANSPORT_MAX_CONNS || !conns[conn].in_use) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_ble_gap_set_pkt_data_len(conns[conn].remote_bda, tx_octets);
+}
+
+esp_err_t ble_transport_set_phy(uint8_t conn, bool prefer_2m)
+{
+    if (conn >= BLE_TRANSPORT_MAX_CONNS || !conns[conn].in_use) {
+        return ESP_ERR_INVALID_STATE;
+    }
+#if CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    uint8_t phy = prefer_2m ? ESP_BLE_GAP_PHY_2M_PREF_MASK : ESP_BLE_GAP_PHY_1M_PREF_MASK;
+    return esp_ble_gap_set_preferred_phy(conns[conn].remote_bda, 0, phy, phy,
+                                         ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#else
+    return ESP_ERR_NOT_SUPPORTED;  // The original ESP32 controller is Bluetooth 4.2: 1M PHY only
+#endif
+}
+
+bool ble_transport_is_bonded(uint8_t conn)
+{
+    return conn < BLE_TRANSPORT_MAX_CONNS && conns[conn].in_use && conns[conn].bonded;
+}
+
+#endif // CONFIG_BT_BLUEDROID_ENABLED
@@ -0,0 +1,487 @@
+#include "sdkconfig.h"
+
+#if CONFIG_BT_NIMBLE_ENABLED
+
+#include <string.h>
+#include "ble_transport.h"
+#include "ble_transport_priv.h"
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+
+static const char *TAG = "tDCS";
+
+#define GATTS_CHAR_UUID_CONTROL     0xFF01
+#define GATTS_CHAR_UUID_TELEMETRY   0xFF02
+#define GATTS_CHAR_UUID_COMMAND     0xFF03
+#define GATTS_CHAR_UUID_LOG         0xFF04
+#define GATTS_CHAR_UUID_OTA         0xFF05
+
+// Advertising matches the Bluedroid build: 20-40 ms, 7.5-20 ms slave interval range
+#define ADV_ITVL_MIN                0x20
+#define ADV_ITVL_MAX                0x40
+#define ADV_SLAVE_ITVL_MIN          0x0006
+#define ADV_SLAVE_ITVL_MAX          0x0010
+
+static const ble_transport_callbacks_t *callbacks;
+static uint8_t own_addr_type;
+static uint16_t char_handles[BLE_CHAR_COUNT];
+
+typedef struct {
+    volatile uint16_t handle;       // BLE_HS_CONN_HANDLE_NONE when the slot is free
+    volatile bool congested;
+} ble_conn_t;
+
+static ble_conn_t conns[BLE_TRANSPORT_MAX_CONNS];
+
+// Bonded client whose link just timed out; the next advertisement is directed at it.
+// Host task only.
+static bool directed_pending;
+static ble_addr_t directed_peer;
+static bool gatt_db_changed;
+
+void ble_store_config_init(void);   // NimBLE NVS bond store; no public header
+
+static int gatt_access(uint16_t conn, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
+static int gap_event(struct ble_gap_event *event, void *arg);
+
+static const struct ble_gatt_svc_def gatt_services[] = {
+    {
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = BLE_UUID16_DECLARE(BLE_TRANSPORT_SERVICE_UUID),
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_CONTROL),
+                .access_cb = gatt_access,
+                .arg = (void *)BLE_CHAR_CONTROL,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_ENC,
+                .val_handle = &char_handles[BLE_CHAR_CONTROL],
+            },
+            {
+                // The host adds the CCCD for notify characteristics
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_TELEMETRY),
+                .access_cb = gatt_access,
+                .arg = (void *)BLE_CHAR_TELEMETRY,
+                .flags = BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &char_handles[BLE_CHAR_TELEMETRY],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_COMMAND),
+                .access_cb = gatt_access,
+                .arg = (void *)BLE_CHAR_COMMAND,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP |
+                         BLE_GATT_CHR_F_WRITE_ENC | BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &char_handles[BLE_CHAR_COMMAND],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_LOG),
+                .access_cb = gatt_access,
+                .arg = (void *)BLE_CHAR_LOG,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP | BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &char_handles[BLE_CHAR_LOG],
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATTS_CHAR_UUID_OTA),
+                .access_cb = gatt_access,
+                .arg = (void *)BLE_CHAR_OTA,
+                .flags = BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP | BLE_GATT_CHR_F_WRITE_ENC |
+                         BLE_GATT_CHR_F_NOTIFY,
+                .val_handle = &char_handles[BLE_CHAR_OTA],
+            },
+            {0},
+        },
+    },
+    {0},
+};
+
+static int conn_to_slot(uint16_t handle)
+{
+    for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+        if (conns[i].handle == handle) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int gatt_access(uint16_t conn, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    ble_char_t ch = (ble_char_t)(uintptr_t)arg;
+    uint8_t buf[BLE_TRANSPORT_MAX_VALUE_LEN];
+    int slot = conn_to_slot(conn);
+    if (slot < 0) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    switch (ctxt->op) {
+    case BLE_GATT_ACCESS_OP_READ_CHR: {
+        size_t len = callbacks->on_read ? callbacks->on_read(slot, ch, buf, sizeof(buf)) : 0;
+        return os_mbuf_append(ctxt->om, buf, len) == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    }
+    case BLE_GATT_ACCESS_OP_WRITE_CHR: {
+        uint16_t len;
+        if (ble_hs_mbuf_to_flat(ctxt->om, buf, sizeof(buf), &len) != 0) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        if (callbacks->on_write(slot, ch, buf, len) == ESP_ERR_NOT_ALLOWED) {
+            return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
+        }
+        return 0;
+    }
+    default:
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+static int handle_to_char(uint16_t handle)
+{
+    for (int ch = 0; ch < BLE_CHAR_COUNT; ch++) {
+        if (char_handles[ch] == handle) {
+            return ch;
+        }
+    }
+    return -1;
+}
+
+static volatile bool synced;
+
+static int set_adv_fields(void)
+{
+    uint8_t mfg[BLE_TRANSPORT_MAX_MFG_LEN];
+    const char *name = ble_svc_gap_device_name();
+    struct ble_hs_adv_fields fields = {
+        .flags = BLE_HS_ADV_F_DISC_GEN | BLE_HS_ADV_F_BREDR_UNSUP,
+        .name = (uint8_t *)name,
+        .name_len = strlen(name),
+        .name_is_complete = 1,
+        .slave_itvl_range = (uint8_t[]){
+            ADV_SLAVE_ITVL_MIN & 0xFF, ADV_SLAVE_ITVL_MIN >> 8,
+            ADV_SLAVE_ITVL_MAX & 0xFF, ADV_SLAVE_ITVL_MAX >> 8,
+        },
+        .mfg_data = mfg,
+        .mfg_data_len = ble_transport_get_mfg_data(mfg),
+    };
+    return ble_gap_adv_set_fields(&fields);
+}
+
+void ble_transport_adv_data_changed(void)
+{
+    // Replaces the data of a running advertisement; otherwise the next advertise() picks it up
+    if (synced && ble_gap_adv_active()) {
+        int rc = set_adv_fields();
+        if (rc != 0) {
+            ESP_LOGW(TAG, "Advertising data update failed: %d", rc);
+        }
+    }
+}
+
+static void advertise(void)
+{
+    // Advertising stops on every connection; keep it up while slots are free
+    if (ble_gap_adv_active() || conn_to_slot(BLE_HS_CONN_HANDLE_NONE) < 0) {
+        return;
+    }
+
+    int rc;
+    if (directed_pending) {
+        // High duty cycle: the controller gives up after 1.28 s and ADV_COMPLETE brings
+        // back undirected advertising
+        directed_pending = false;
+        struct ble_gap_adv_params params = {
+            .conn_mode = BLE_GAP_CONN_MODE_DIR,
+            .high_duty_cycle = 1,
+        };
+        rc = ble_gap_adv_start(own_addr_type, &directed_peer, BLE_HS_FOREVER, &params, gap_event, NULL);
+        if (rc == 0) {
+            ESP_LOGI(TAG, "Directed advertising to last bonded peer");
+            return;
+        }
+        ESP_LOGW(TAG, "Directed advertising failed: %d", rc);
+    }
+
+    rc = set_adv_fields();
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Advertising data failed: %d", rc);
+        return;
+    }
+
+    struct ble_gap_adv_params params = {
+        .conn_mode = BLE_GAP_CONN_MODE_UND,
+        .disc_mode = BLE_GAP_DISC_MODE_GEN,
+        .itvl_min = ADV_ITVL_MIN,
+        .itvl_max = ADV_ITVL_MAX,
+    };
+    rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER, &params, gap_event, NULL);
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Advertising start failed: %d", rc);
+        return;
+    }
+    ble_transport_log_first_adv();
+}
+
+static int gap_event(struct ble_gap_event *event, void *arg)
+{
+    struct ble_gap_conn_desc desc;
+    int slot;
+
+    switch (event->type) {
+    case BLE_GAP_EVENT_CONNECT:
+        slot = conn_to_slot(BLE_HS_CONN_HANDLE_NONE);
+        if (event->connect.status == 0 && slot < 0) {
+            ble_gap_terminate(event->connect.conn_handle, BLE_ERR_CONN_LIMIT);
+        } else if (event->connect.status == 0) {
+            conns[slot].congested = false;
+            conns[slot].handle = event->connect.conn_handle;
+            callbacks->on_connect(slot);
+            // Pair and bond on first contact; a bonded client just re-encrypts with its stored keys
+            int rc = ble_gap_security_initiate(event->connect.conn_handle);
+            if (rc != 0) {
+                ESP_LOGW(TAG, "Security request failed: %d", rc);
+            }
+        }
+        advertise();
+        break;
+    case BLE_GAP_EVENT_DISCONNECT:
+        // The host forgets a plain client's subscriptions here. A bonded client's CCCDs are
+        // kept in its store (NVS with CONFIG_BT_NIMBLE_NVS_PERSIST) and restored, with
+        // SUBSCRIBE events, once it re-encrypts on the next connection.
+        slot = conn_to_slot(event->disconnect.conn.conn_handle);
+        if (slot >= 0) {
+            conns[slot].handle = BLE_HS_CONN_HANDLE_NONE;
+            callbacks->on_disconnect(slot);
+        }
+        // A bonded client that lost the link, rather than closed it, is likely trying to
+        // come straight back. Its last over-the-air address is still current that soon after.
+        if (slot >= 0 && event->disconnect.conn.sec_state.bonded &&
+            event->disconnect.reason == BLE_HS_HCI_ERR(BLE_ERR_CONN_SPVN_TMO)) {
+            directed_pending = true;
+            directed_peer = event->disconnect.conn.peer_ota_addr;
+            if (ble_gap_adv_active()) {
+                ble_gap_adv_stop();
+            }
+        }
+        advertise();
+        break;
+    case BLE_GAP_EVENT_ENC_CHANGE:
+        if (ble_gap_conn_find(event->enc_change.conn_handle, &desc) == 0) {
+            ESP_LOGI(TAG, "Encryption: status %d, bonded %d", event->enc_change.status, desc.sec_state.bonded);
+        }
+        break;
+    case BLE_GAP_EVENT_REPEAT_PAIRING:
+        // The client lost its keys (e.g. "forget device"); drop ours and pair again
+        if (ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc) == 0) {
+            ble_store_util_delete_peer(&desc.peer_id_addr);
+        }
+        return BLE_GAP_REPEAT_PAIRING_RETRY;
+    case BLE_GAP_EVENT_ADV_COMPLETE:
+        advertise();
+        break;
+    case BLE_GAP_EVENT_SUBSCRIBE: {
+        int ch = handle_to_char(event->subscribe.attr_handle);
+        slot = conn_to_slot(event->subscribe.conn_handle);
+        if (ch >= 0 && slot >= 0) {
+            callbacks->on_subscribe(slot, ch, event->subscribe.cur_notify);
+        }
+        break;
+    }
+    case BLE_GAP_EVENT_MTU:
+        slot = conn_to_slot(event->mtu.conn_handle);
+        if (slot >= 0) {
+            callbacks->on_mtu(slot, event->mtu.value);
+        }
+        break;
+    case BLE_GAP_EVENT_NOTIFY_TX:
+        // A notification left the host, so mbufs are free again; the pool is shared,
+        // so this clears congestion on every connection
+        for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+            if (conns[i].congested) {
+                conns[i].congested = false;
+                callbacks->on_congest(i, false);
+            }
+        }
+        break;
+    case BLE_GAP_EVENT_CONN_UPDATE:
+        if (ble_gap_conn_find(event->conn_update.conn_handle, &desc) == 0) {
+            ESP_LOGI(TAG, "Conn params: status %d, interval %.2f ms, latency %u, timeout %u ms",
+                     event->conn_update.status, desc.conn_itvl * 1.25,
+                     desc.conn_latency, desc.supervision_timeout * 10);
+        }
+        break;
+#if CONFIG_BT_NIMBLE_50_FEATURE_SUPPORT
+    case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE:
+        ESP_LOGI(TAG, "PHY: status %d, tx %u, rx %u", event->phy_updated.status,
+                 event->phy_updated.tx_phy, event->phy_updated.rx_phy);
+        break;
+#endif
+    default:
+        break;
+    }
+    return 0;
+}
+
+static void on_sync(void)
+{
+    int rc = ble_hs_util_ensure_addr(0);
+    if (rc == 0) {
+        rc = ble_hs_id_infer_auto(0, &own_addr_type);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "No usable address: %d", rc);
+        return;
+    }
+    synced = true;
+    if (gatt_db_changed) {
+        // The host marks this pending in each bonded client's stored CCCD (persisted with
+        // CONFIG_BT_NIMBLE_NVS_PERSIST) and indicates it when the client next connects, so
+        // its attribute cache gets dropped; only then is the new version stored
+        gatt_db_changed = false;
+        ble_svc_gatt_changed(0x0001, 0xFFFF);
+        ble_transport_gatt_db_commit();
+    }
+    advertise();
+}
+
+static void on_reset(int reason)
+{
+    synced = false;
+    ESP_LOGE(TAG, "Host reset, reason %d", reason);
+}
+
+static void host_task(void *param)
+{
+    nimble_port_run();  // Returns only after nimble_port_stop()
+    nimble_port_freertos_deinit();
+}
+
+esp_err_t ble_transport_start(const ble_transport_callbacks_t *cb)
+{
+    callbacks = cb;
+    for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+        conns[i].handle = BLE_HS_CONN_HANDLE_NONE;
+    }
+    ble_transport_log_heap("before init");
+
+    // BLE only: hand the Classic BT controller memory back to the heap
+    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+
+    esp_err_t ret = nimble_port_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "%s init NimBLE failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+    ble_hs_cfg.store_status_cb = ble_store_util_status_rr;
+
+    // Just Works bonding (no display or keyboard), LE Secure Connections. Bonded clients
+    // keep their attribute cache between connections and re-encrypt without pairing.
+    ble_hs_cfg.sm_io_cap = BLE_HS_IO_NO_INPUT_OUTPUT;
+    ble_hs_cfg.sm_bonding = 1;
+    ble_hs_cfg.sm_mitm = 0;
+    ble_hs_cfg.sm_sc = 1;
+    ble_hs_cfg.sm_our_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+    ble_hs_cfg.sm_their_key_dist = BLE_SM_PAIR_KEY_DIST_ENC | BLE_SM_PAIR_KEY_DIST_ID;
+
+    ble_svc_gap_init();
+    ble_svc_gatt_init();
+    int rc = ble_gatts_count_cfg(gatt_services);
+    if (rc == 0) {
+        rc = ble_gatts_add_svcs(gatt_services);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "%s GATT service registration failed: %d", __func__, rc);
+        return ESP_FAIL;
+    }
+    ble_svc_gap_device_name_set(BLE_TRANSPORT_DEVICE_NAME);
+    ble_att_set_preferred_mtu(BLE_TRANSPORT_LOCAL_MTU);
+    ble_store_config_init();
+    gatt_db_changed = ble_transport_gatt_db_changed();
+
+    nimble_port_freertos_init(host_task);
+    ble_transport_log_heap("after init");
+    return ESP_OK;
+}
+
+// Handle of a connection slot, BLE_HS_CONN_HANDLE_NONE if out of range or free. Read once:
+// app tasks call in while the host task may be tearing the connection down.
+static uint16_t slot_handle(uint8_t conn)
+{
+    return conn < BLE_TRANSPORT_MAX_CONNS ? conns[conn].handle : BLE_HS_CONN_HANDLE_NONE;
+}
+
+esp_err_t ble_transport_notify(uint8_t conn, ble_char_t ch, const uint8_t *data, size_t len)
+{
+    uint16_t handle = slot_handle(conn);
+    if (handle == BLE_HS_CONN_HANDLE_NONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // NimBLE has no congestion event: running out of mbufs is the signal
+    struct os_mbuf *om = ble_hs_mbuf_from_flat(data, len);
+    int rc = om ? ble_gatts_notify_custom(handle, char_handles[ch], om) : BLE_HS_ENOMEM;
+    if (rc == BLE_HS_ENOMEM) {
+        if (!conns[conn].congested) {
+            conns[conn].congested = true;
+            callbacks->on_congest(conn, true);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t ble_transport_set_conn_params(uint8_t conn, uint16_t min_int, uint16_t max_int, uint16_t latency, uint16_t timeout)
+{
+    uint16_t handle = slot_handle(conn);
+    if (handle == BLE_HS_CONN_HANDLE_NONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    struct ble_gap_upd_params params = {
+        .itvl_min = min_int,
+        .itvl_max = max_int,
+        .latency = latency,
+        .supervision_timeout = timeout,
+    };
+    return ble_gap_update_params(handle, &params) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t ble_transport_set_data_len(uint8_t conn, uint16_t tx_octets)
+{
+    uint16_t handle = slot_handle(conn);
+    if (handle == BLE_HS_CONN_HANDLE_NONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Max time for tx_octets on the 1M PHY: (payload + 14 bytes overhead) * 8 us
+    uint16_t tx_time = (tx_octets + 14) * 8;
+    return ble_gap_set_data_len(handle, tx_octets, tx_time) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t ble_transport_set_phy(uint8_t conn, bool prefer_2m)
+{
+    uint16_t handle = slot_handle(conn);
+    if (handle == BLE_HS_CONN_HANDLE_NONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+#if CONFIG_BT_NIMBLE_50_FEATURE_SUPPORT
+    uint8_t phy = prefer_2m ? BLE_GAP_LE_PHY_2M_MASK : BLE_GAP_LE_PHY_1M_MASK;
+    return ble_gap_set_prefered_le_phy(handle, phy, phy, BLE_GAP_LE_PHY_CODED_ANY) == 0 ?
+           ESP_OK : ESP_FAIL;
+#else
+    return ESP_ERR_NOT_SUPPORTED;  // The original ESP32 controller is Bluetooth 4.2: 1M PHY only
+#endif
+}
+
+bool ble_transport_is_bonded(uint8_t conn)
+{
+    uint16_t handle = slot_handle(conn);
+    struct ble_gap_conn_desc desc;
+    return handle != BLE_HS_CONN_HANDLE_NONE && ble_gap_conn_find(handle, &desc) == 0 &&
+           desc.sec_state.encrypted && desc.sec_state.bonded;
+}
+
+#endif // CONFIG_BT_NIMBLE_ENABLED
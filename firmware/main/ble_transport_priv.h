@@ -0,0 +1,30 @@
+#ifndef BLE_TRANSPORT_PRIV_H
+#define BLE_TRANSPORT_PRIV_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Shared by the backends: advertising payload, and footprint and startup reporting
+// to compare host stacks
+
+// Copy of the manufacturer data last set; returns its length (0 if none)
+size_t ble_transport_get_mfg_data(uint8_t *out);
+// Implemented by each backend: push new advertising data to the live advertisement
+void ble_transport_adv_data_changed(void);
+
+// Compare BLE_TRANSPORT_GATT_DB_VERSION with the one stored in NVS. True if bonded
+// clients must be sent Service Changed.
+bool ble_transport_gatt_db_changed(void);
+// Store BLE_TRANSPORT_GATT_DB_VERSION. Call only once the Service Changed owed to every
+// bonded client is itself persisted, or a client away this boot is never told.
+void ble_transport_gatt_db_commit(void);
+// Directed advertising lasts at most 1.28 s in the controller (high duty cycle)
+#define BLE_TRANSPORT_DIRECTED_ADV_MS   1280
+
+// Log free internal heap, tagged with the startup stage
+void ble_transport_log_heap(const char *stage);
+// Log time since boot on the first advertisement only
+void ble_transport_log_first_adv(void);
+
+#endif // BLE_TRANSPORT_PRIV_H
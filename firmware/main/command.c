@@ -0,0 +1,71 @@
+#include "command.h"
+
+static int command_value_len(uint8_t type)
+{
+    switch (type) {
+    case COMMAND_ENABLE:
+    case COMMAND_DISABLE:
+    case COMMAND_CLAIM_CONTROL:
+    case COMMAND_RELEASE_CONTROL:
+    case COMMAND_STOP_SESSION:
+        return 0;
+    case COMMAND_SET_DAC:
+    case COMMAND_SET_DITHER:
+        return 1;
+    case COMMAND_SET_RAMP:
+    case COMMAND_SET_TELEMETRY_INTERVAL:
+    case COMMAND_SET_CURRENT:
+        return 2;
+    case COMMAND_SET_SCHEDULE:
+        return 4;
+    case COMMAND_SET_FILTER:
+    case COMMAND_START_SESSION:
+        return 6;
+    case COMMAND_SET_WAVEFORM:
+        return 7;
+    default:
+        return -1;
+    }
+}
+
+command_status_t command_parse(const uint8_t *data, size_t len, command_batch_t *batch, uint8_t *bad_index)
+{
+    *bad_index = COMMAND_NO_INDEX;
+    if (len < 1) {
+        return COMMAND_STATUS_MALFORMED;
+    }
+
+    batch->seq = data[0];
+    batch->count = 0;
+
+    // A bare sequence number is a valid no-op: the status echo doubles as a ping
+    size_t pos = 1;
+    while (pos < len) {
+        if (batch->count == COMMAND_MAX_TLVS || len - pos < 2) {
+            return COMMAND_STATUS_MALFORMED;
+        }
+
+        command_tlv_t *tlv = &batch->tlv[batch->count];
+        tlv->type = data[pos];
+        tlv->len = data[pos + 1];
+        tlv->value = &data[pos + 2];
+        if (len - pos - 2 < tlv->len) {
+            *bad_index = batch->count;
+            return COMMAND_STATUS_MALFORMED;
+        }
+
+        int expected = command_value_len(tlv->type);
+        if (expected < 0) {
+            *bad_index = batch->count;
+            return COMMAND_STATUS_UNKNOWN_TYPE;
+        }
+        if (tlv->len != expected) {
+            *bad_index = batch->count;
+            return COMMAND_STATUS_BAD_LENGTH;
+        }
+
+        pos += 2 + tlv->len;
+        batch->count++;
+    }
+    return COMMAND_STATUS_OK;
+}
@@ -0,0 +1,64 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Command characteristic packet: [seq, then (type, len, value[len]) entries]. The whole
+// batch is validated before any of it is applied.
+#define COMMAND_MAX_TLVS        16
+#define COMMAND_STATUS_LEN      4   // [seq, status, failing entry index or 0xFF, fault flags]
+#define COMMAND_NO_INDEX        0xFF
+
+typedef enum {
+    COMMAND_ENABLE                  = 0x01,   // len 0: enable the DAC, clears a watchdog trip
+    COMMAND_DISABLE                 = 0x02,   // len 0: DAC safe
+    COMMAND_SET_DAC                 = 0x03,   // len 1: DAC code (0 = max current, 255 = min)
+    COMMAND_SET_RAMP                = 0x04,   // len 2: ramp time in ms for DAC changes, BE
+    COMMAND_SET_TELEMETRY_INTERVAL  = 0x05,   // len 2: notification interval in ms, BE
+    COMMAND_SET_SCHEDULE            = 0x06,   // len 4: as the 4-byte write
+    COMMAND_SET_FILTER              = 0x07,   // len 6: as the 6-byte write
+    COMMAND_CLAIM_CONTROL           = 0x08,   // len 0: become the controller if nobody is
+    COMMAND_RELEASE_CONTROL         = 0x09,   // len 0: give up control, back to observer
+    COMMAND_SET_CURRENT             = 0x0A,   // len 2: closed-loop target in uA, BE
+    COMMAND_START_SESSION           = 0x0B,   // len 6: target uA, ramp ms, duration s, all BE
+    COMMAND_STOP_SESSION            = 0x0C,   // len 0: ramp the session down now
+    COMMAND_SET_WAVEFORM            = 0x0D,   // len 7: shape, frequency 0.1 Hz, amplitude uA, offset uA, BE
+    COMMAND_SET_DITHER              = 0x0E,   // len 1: 1 dithers the DC output, 0 plain codes
+} command_type_t;
+
+typedef enum {
+    COMMAND_STATUS_OK = 0,
+    COMMAND_STATUS_MALFORMED,       // Empty packet, truncated entry or too many entries
+    COMMAND_STATUS_UNKNOWN_TYPE,
+    COMMAND_STATUS_BAD_LENGTH,
+    COMMAND_STATUS_INVALID_VALUE,
+    COMMAND_STATUS_BUSY,            // Sampler queue full or update running; nothing applied
+    COMMAND_STATUS_NOT_CONTROLLER,  // Sender is an observer; only claim/release are allowed
+} command_status_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t len;
+    const uint8_t *value;           // Points into the written packet
+} command_tlv_t;
+
+typedef struct {
+    uint8_t seq;
+    uint8_t count;
+    command_tlv_t tlv[COMMAND_MAX_TLVS];
+} command_batch_t;
+
+// Split a packet into entries and check each entry's type and length. On failure
+// *bad_index is the offending entry (COMMAND_NO_INDEX if the packet itself is bad).
+command_status_t command_parse(const uint8_t *data, size_t len, command_batch_t *batch, uint8_t *bad_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_H
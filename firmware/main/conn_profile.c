@@ -0,0 +1,115 @@
+#include "conn_profile.h"
+#include "ble_transport.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "CONN_PROFILE";
+
+typedef struct {
+    uint16_t min_int;       // 1.25 ms units
+    uint16_t max_int;
+    uint16_t latency;       // Connection events the peripheral may skip
+    uint16_t timeout;       // 10 ms units
+    uint16_t tx_octets;     // LE Data Length Extension, 27-251
+    bool prefer_2m;
+    const char *name;
+} conn_profile_params_t;
+
+static const conn_profile_params_t profiles[] = {
+    // 100-200 ms, skip up to 4 events: ~1 s worst-case command latency when idle
+    [CONN_PROFILE_IDLE] = {
+        .min_int = 80, .max_int = 160, .latency = 4, .timeout = 600,
+        .tx_octets = 27, .prefer_2m = false, .name = "idle",
+    },
+    // 7.5-15 ms (iOS settles on 15 ms), no latency
+    [CONN_PROFILE_ACTIVE] = {
+        .min_int = 6, .max_int = 12, .latency = 0, .timeout = 200,
+        .tx_octets = 251, .prefer_2m = true, .name = "active",
+    },
+};
+
+static struct {
+    portMUX_TYPE lock;
+    uint32_t connected;         // Bit n = transport connection slot n
+    conn_profile_t requested;
+    uint32_t holders;           // conn_profile_hold_t bits
+} link = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .requested = CONN_PROFILE_IDLE,
+};
+
+static void conn_profile_apply(uint8_t conn, conn_profile_t profile)
+{
+    const conn_profile_params_t *p = &profiles[profile];
+
+    esp_err_t ret = ble_transport_set_conn_params(conn, p->min_int, p->max_int, p->latency, p->timeout);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Conn params request failed: %s", esp_err_to_name(ret));
+    }
+
+    ret = ble_transport_set_data_len(conn, p->tx_octets);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Data length request failed: %s", esp_err_to_name(ret));
+    }
+
+    ret = ble_transport_set_phy(conn, p->prefer_2m);
+    if (ret != ESP_OK && ret != ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGW(TAG, "PHY request failed: %s", esp_err_to_name(ret));
+    }
+
+    ESP_LOGI(TAG, "Requested %s profile on connection %u", p->name, conn);
+}
+
+// Call with link.lock held
+static conn_profile_t conn_profile_effective(void)
+{
+    return link.holders ? CONN_PROFILE_ACTIVE : link.requested;
+}
+
+void conn_profile_connected(uint8_t conn)
+{
+    portENTER_CRITICAL(&link.lock);
+    link.connected |= 1u << conn;
+    conn_profile_t profile = conn_profile_effective();
+    portEXIT_CRITICAL(&link.lock);
+
+    // Keep whatever the device state asked for before this client connected
+    conn_profile_apply(conn, profile);
+}
+
+void conn_profile_disconnected(uint8_t conn)
+{
+    portENTER_CRITICAL(&link.lock);
+    link.connected &= ~(1u << conn);
+    portEXIT_CRITICAL(&link.lock);
+}
+
+static void conn_profile_update(const conn_profile_t *requested, uint32_t hold_set, uint32_t hold_clear)
+{
+    portENTER_CRITICAL(&link.lock);
+    conn_profile_t before = conn_profile_effective();
+    if (requested) {
+        link.requested = *requested;
+    }
+    link.holders = (link.holders | hold_set) & ~hold_clear;
+    conn_profile_t profile = conn_profile_effective();
+    uint32_t apply = profile != before ? link.connected : 0;
+    portEXIT_CRITICAL(&link.lock);
+
+    // Every client gets the same profile: observers stream the same telemetry
+    for (uint8_t conn = 0; apply; conn++, apply >>= 1) {
+        if (apply & 1) {
+            conn_profile_apply(conn, profile);
+        }
+    }
+}
+
+void conn_profile_set(conn_profile_t profile)
+{
+    conn_profile_update(&profile, 0, 0);
+}
+
+void conn_profile_hold_active(conn_profile_hold_t holder, bool hold)
+{
+    conn_profile_update(NULL, hold ? holder : 0, hold ? 0 : holder);
+}
@@ -0,0 +1,33 @@
+#ifndef CONN_PROFILE_H
+#define CONN_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CONN_PROFILE_IDLE,      // Long interval with peripheral latency: low power between sessions
+    CONN_PROFILE_ACTIVE,    // Short interval, 2M PHY, 251-byte PDUs: telemetry and command latency
+} conn_profile_t;
+
+// Link lifecycle, from the transport connect/disconnect callbacks
+void conn_profile_connected(uint8_t conn);
+void conn_profile_disconnected(uint8_t conn);
+// Request a profile on every connection; no-op if it is already requested
+void conn_profile_set(conn_profile_t profile);
+// Bulk transfers hold the active profile whatever the device state asks for
+typedef enum {
+    CONN_PROFILE_HOLD_LOG = 1 << 0,     // Session log download
+    CONN_PROFILE_HOLD_OTA = 1 << 1,     // Firmware update
+} conn_profile_hold_t;
+
+void conn_profile_hold_active(conn_profile_hold_t holder, bool hold);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONN_PROFILE_H
@@ -0,0 +1,231 @@
+#include <string.h>
+#include <inttypes.h>
+#include "datalog.h"
+#include "session_log.h"
+#include "session_log_partition.h"
+#include "telemetry.h"
+#include "adc_sampler.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "DATALOG";
+
+#define DATALOG_PARTITION_LABEL     "datalog"
+#define DATALOG_PARTITION_SUBTYPE   0x40    // First custom data subtype, see partitions.csv
+#define DATALOG_FRAME_MS            100     // Filter outputs come at ~9 Hz with the default schedule
+#define DATALOG_FLUSH_US            (5 * 1000 * 1000)   // Most frames a power loss can take
+#define DATALOG_BATCH_LEN           512
+#define DATALOG_ERASE_AHEAD         64      // 256 KB, about 40 minutes of frames
+#define DATALOG_QUEUE_LEN           16
+#define DATALOG_CHANNEL_MASK        ((1u << ADC_SAMPLER_NUM_CHANNELS) - 1)
+#define DATALOG_CLEAR               0       // Queue message asking for a log erase
+
+typedef struct {
+    uint8_t event;              // datalog_event_t, or DATALOG_CLEAR
+    uint8_t len;
+    int64_t timestamp_us;
+    uint8_t args[DATALOG_EVENT_MAX_ARGS];
+} datalog_msg_t;
+
+static struct {
+    bool mounted;
+    session_log_t log;          // Under lock: the task appends, transfers read
+    SemaphoreHandle_t lock;
+    QueueHandle_t queue;
+    portMUX_TYPE range_lock;
+    uint32_t start;             // Copy of the log range for readers that must not block
+    uint32_t end;
+} datalog = {
+    .range_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+// Call with datalog.lock held
+static void datalog_update_range(void)
+{
+    uint32_t start = session_log_start(&datalog.log);
+    uint32_t end = session_log_end(&datalog.log);
+    portENTER_CRITICAL(&datalog.range_lock);
+    datalog.start = start;
+    datalog.end = end;
+    portEXIT_CRITICAL(&datalog.range_lock);
+}
+
+static void datalog_append(uint8_t type, const uint8_t *data, size_t len)
+{
+    xSemaphoreTake(datalog.lock, portMAX_DELAY);
+    bool ok = session_log_append(&datalog.log, type, data, len);
+    datalog_update_range();
+    xSemaphoreGive(datalog.lock);
+    if (!ok) {
+        ESP_LOGW(TAG, "Append of %u bytes failed", (unsigned)len);
+    }
+}
+
+static void datalog_flush(telemetry_encoder_t *enc, uint8_t *batch)
+{
+    size_t len = telemetry_encoder_finish(enc);
+    if (len > 0) {
+        datalog_append(DATALOG_RECORD_FRAMES, batch, len);
+    }
+    telemetry_encoder_begin(enc, batch, DATALOG_BATCH_LEN, DATALOG_CHANNEL_MASK);
+}
+
+static void datalog_write_event(const datalog_msg_t *msg)
+{
+    uint8_t rec[1 + 8 + DATALOG_EVENT_MAX_ARGS];
+    rec[0] = msg->event;
+    for (int i = 0; i < 8; i++) {
+        rec[1 + i] = (uint64_t)msg->timestamp_us >> (56 - 8 * i);
+    }
+    memcpy(&rec[9], msg->args, msg->len);
+    datalog_append(DATALOG_RECORD_EVENT, rec, 9 + msg->len);
+}
+
+static void datalog_task(void *args)
+{
+    static uint8_t batch[DATALOG_BATCH_LEN];
+    telemetry_encoder_t enc;
+    bool recording = false;
+    bool have_seq = false;
+    uint32_t last_seq = 0;
+    int64_t batch_start_us = 0;
+
+    telemetry_encoder_begin(&enc, batch, sizeof(batch), DATALOG_CHANNEL_MASK);
+    while (1) {
+        datalog_msg_t msg;
+        if (xQueueReceive(datalog.queue, &msg, pdMS_TO_TICKS(DATALOG_FRAME_MS)) == pdTRUE) {
+            // Frames so far go first so records stay in time order
+            datalog_flush(&enc, batch);
+            if (msg.event == DATALOG_CLEAR) {
+                xSemaphoreTake(datalog.lock, portMAX_DELAY);
+                bool ok = session_log_clear(&datalog.log);
+                datalog_update_range();
+                xSemaphoreGive(datalog.lock);
+                ESP_LOGI(TAG, "Log cleared%s", ok ? "" : " with flash errors");
+                msg.event = DATALOG_EVENT_CLEARED;
+                msg.len = 0;
+            }
+            datalog_write_event(&msg);
+            if (msg.event == DATALOG_EVENT_ENABLE) {
+                recording = true;
+                have_seq = false;
+            } else if (msg.event == DATALOG_EVENT_DISABLE || msg.event == DATALOG_EVENT_FAULT) {
+                recording = false;
+            }
+        }
+
+        if (!recording) {
+            // Erase ahead between sessions: an erase stalls everything running from flash
+            xSemaphoreTake(datalog.lock, portMAX_DELAY);
+            if (session_log_erase_ahead(&datalog.log, DATALOG_ERASE_AHEAD)) {
+                datalog_update_range();
+            }
+            xSemaphoreGive(datalog.lock);
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        adc_frame_t frame;
+        if (adc_sampler_get_filtered(&frame) && (!have_seq || frame.seq != last_seq)) {
+            // Every channel in every frame: the latest output of each filter
+            frame.updated_mask = DATALOG_CHANNEL_MASK;
+            if (!telemetry_encoder_add(&enc, &frame)) {
+                datalog_flush(&enc, batch);
+                telemetry_encoder_add(&enc, &frame);
+            }
+            if (enc.count == 1) {
+                batch_start_us = now;
+            }
+            last_seq = frame.seq;
+            have_seq = true;
+        }
+        if (enc.count > 0 && now - batch_start_us >= DATALOG_FLUSH_US) {
+            datalog_flush(&enc, batch);
+        }
+    }
+}
+
+esp_err_t datalog_start(void)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           DATALOG_PARTITION_SUBTYPE,
+                                                           DATALOG_PARTITION_LABEL);
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    session_log_flash_t flash;
+    ESP_RETURN_ON_ERROR(session_log_partition_flash(part, &flash), TAG, "Unusable log partition");
+    if (!session_log_mount(&datalog.log, &flash)) {
+        ESP_LOGE(TAG, "Log mount failed");
+        return ESP_FAIL;
+    }
+
+    datalog.lock = xSemaphoreCreateMutex();
+    datalog.queue = xQueueCreate(DATALOG_QUEUE_LEN, sizeof(datalog_msg_t));
+    if (!datalog.lock || !datalog.queue) {
+        return ESP_ERR_NO_MEM;
+    }
+    datalog_update_range();
+    datalog.mounted = true;
+    ESP_LOGI(TAG, "%" PRIu32 " bytes logged, offsets %" PRIu32 "-%" PRIu32 " (%" PRIu32 " KB partition)",
+             datalog.end - datalog.start, datalog.start, datalog.end, part->size / 1024);
+
+    // With adv_status, below telemetry: flash writes are not time-critical
+    if (xTaskCreate(datalog_task, "datalog_task", 4096, NULL, 2, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void datalog_event(datalog_event_t event, const uint8_t *args, size_t len)
+{
+    if (!datalog.mounted) {
+        return;
+    }
+    datalog_msg_t msg = {
+        .event = event,
+        .len = len < DATALOG_EVENT_MAX_ARGS ? len : DATALOG_EVENT_MAX_ARGS,
+        .timestamp_us = esp_timer_get_time(),
+    };
+    if (msg.len > 0) {
+        memcpy(msg.args, args, msg.len);
+    }
+    if (xQueueSend(datalog.queue, &msg, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Event %d dropped, queue full", event);
+    }
+}
+
+void datalog_range(uint32_t *start, uint32_t *end)
+{
+    portENTER_CRITICAL(&datalog.range_lock);
+    *start = datalog.start;
+    *end = datalog.end;
+    portEXIT_CRITICAL(&datalog.range_lock);
+}
+
+size_t datalog_read(uint32_t offset, uint8_t *buf, size_t cap)
+{
+    if (!datalog.mounted) {
+        return 0;
+    }
+    xSemaphoreTake(datalog.lock, portMAX_DELAY);
+    size_t n = session_log_read(&datalog.log, offset, buf, cap);
+    xSemaphoreGive(datalog.lock);
+    return n;
+}
+
+void datalog_clear(void)
+{
+    if (!datalog.mounted) {
+        return;
+    }
+    datalog_msg_t msg = { .event = DATALOG_CLEAR, .timestamp_us = esp_timer_get_time() };
+    if (xQueueSend(datalog.queue, &msg, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Clear dropped, queue full");
+    }
+}
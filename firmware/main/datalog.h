@@ -0,0 +1,50 @@
+#ifndef DATALOG_H
+#define DATALOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Session recording on the "datalog" partition (session_log ring, record formats in
+// README): events as they happen, filtered frames while the DAC is enabled
+#define DATALOG_RECORD_FRAMES       0x01    // One telemetry packet (same format as notifications)
+#define DATALOG_RECORD_EVENT        0x02    // Event code, timestamp (us, BE), arguments
+#define DATALOG_EVENT_MAX_ARGS      8
+
+typedef enum {
+    DATALOG_EVENT_BOOT = 1,     // [reset reason]
+    DATALOG_EVENT_ENABLE,       // [target code, ramp ms u16]; frames are recorded from here
+    DATALOG_EVENT_DISABLE,      // []; frames stop
+    DATALOG_EVENT_TARGET,       // [target code]
+    DATALOG_EVENT_FAULT,        // [fault flags]; frames stop
+    DATALOG_EVENT_CLEARED,      // []; first record after a log erase
+    DATALOG_EVENT_TARGET_CURRENT,   // [target uA u16]; closed-loop target, also right after enable
+    DATALOG_EVENT_SESSION,      // [target uA u16, ramp ms u16, duration s u16]; session started
+    DATALOG_EVENT_SESSION_END,  // [session_end_t]
+    DATALOG_EVENT_WAVEFORM,     // [shape, frequency 0.1 Hz u16, amplitude uA u16, offset uA u16]
+} datalog_event_t;
+
+// Mount the partition and start the recording task. ESP_ERR_NOT_FOUND without the
+// partition; the rest of the API is then a no-op.
+esp_err_t datalog_start(void);
+
+// Queue an event with its timestamp; any task, never blocks
+void datalog_event(datalog_event_t event, const uint8_t *args, size_t len);
+
+// Oldest and one-past-newest log offsets. Never blocks.
+void datalog_range(uint32_t *start, uint32_t *end);
+// Copy log bytes from `offset`, at most to the end of its sector. 0 at the end of the
+// log or below datalog_range()'s start.
+size_t datalog_read(uint32_t offset, uint8_t *buf, size_t cap);
+// Drop the whole log; done by the recording task, so this returns before it completes
+void datalog_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DATALOG_H
@@ -0,0 +1,272 @@
+#include <inttypes.h>
+#include "log_transfer.h"
+#include "datalog.h"
+#include "conn_profile.h"
+#include "ble_transport.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "LOG_TRANSFER";
+
+#define LOG_TRANSFER_MTU_DEFAULT    23
+#define LOG_TRANSFER_DATA_HEADER    5
+#define LOG_TRANSFER_POLL_MS        20      // Retry after a full notification queue
+#define LOG_TRANSFER_STALL_US       (10 * 1000 * 1000)
+#define NO_TRANSFER                 -1
+
+static struct {
+    portMUX_TYPE lock;
+    TaskHandle_t task;
+    uint16_t mtu[BLE_TRANSPORT_MAX_CONNS];
+    bool notify[BLE_TRANSPORT_MAX_CONNS];
+    bool congested[BLE_TRANSPORT_MAX_CONNS];
+    int conn;                   // Connection downloading, or NO_TRANSFER
+    uint32_t gen;               // Bumped when the transfer is replaced or stopped
+    uint32_t next;              // Next offset to send
+    uint32_t acked;
+    uint32_t window;
+    int64_t activity_us;        // Last request or notification
+} xfer = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .conn = NO_TRANSFER,
+};
+
+static void log_transfer_put_be32(uint8_t *out, uint32_t v)
+{
+    out[0] = v >> 24;
+    out[1] = v >> 16;
+    out[2] = v >> 8;
+    out[3] = v;
+}
+
+static uint32_t log_transfer_get_be32(const uint8_t *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+static void log_transfer_wake(void)
+{
+    if (xfer.task) {
+        xTaskNotifyGive(xfer.task);
+    }
+}
+
+static void log_transfer_reply(uint8_t conn, const uint8_t *buf, size_t len)
+{
+    if (xfer.notify[conn]) {
+        ble_transport_notify(conn, BLE_CHAR_LOG, buf, len);
+    }
+}
+
+static void log_transfer_error(uint8_t conn, log_transfer_error_t error)
+{
+    uint8_t buf[2] = { LOG_TRANSFER_ERROR, error };
+    log_transfer_reply(conn, buf, sizeof(buf));
+}
+
+// Stop the transfer if `conn` owns it (any connection for NO_TRANSFER)
+static void log_transfer_stop(int conn)
+{
+    portENTER_CRITICAL(&xfer.lock);
+    if (xfer.conn != NO_TRANSFER && (conn == NO_TRANSFER || xfer.conn == conn)) {
+        xfer.conn = NO_TRANSFER;
+        xfer.gen++;
+    }
+    portEXIT_CRITICAL(&xfer.lock);
+    log_transfer_wake();
+}
+
+// Send one notification if the window and the link allow it. True if one went out.
+static bool log_transfer_step(uint8_t *buf)
+{
+    portENTER_CRITICAL(&xfer.lock);
+    int conn = xfer.conn;
+    uint32_t gen = xfer.gen;
+    uint32_t next = xfer.next;
+    uint32_t in_flight = xfer.next - xfer.acked;
+    uint32_t window = xfer.window;
+    bool ready = conn != NO_TRANSFER && xfer.notify[conn] && !xfer.congested[conn];
+    size_t cap = conn != NO_TRANSFER ? xfer.mtu[conn] - BLE_TRANSPORT_ATT_HEADER_LEN - LOG_TRANSFER_DATA_HEADER : 0;
+    portEXIT_CRITICAL(&xfer.lock);
+
+    if (!ready || (window && in_flight >= window)) {
+        return false;
+    }
+    if (window && window - in_flight < cap) {
+        cap = window - in_flight;
+    }
+
+    // Data overwritten since the request (or before it) is skipped; the offset in each
+    // DATA notification tells the client where the log really resumes
+    uint32_t start, end;
+    datalog_range(&start, &end);
+    if (next < start) {
+        next = start;
+    }
+    size_t n = next < end ? datalog_read(next, &buf[LOG_TRANSFER_DATA_HEADER], cap) : 0;
+    if (n == 0) {
+        buf[0] = LOG_TRANSFER_END;
+        log_transfer_put_be32(&buf[1], next);
+        if (ble_transport_notify(conn, BLE_CHAR_LOG, buf, 5) == ESP_ERR_NO_MEM) {
+            return false;
+        }
+        portENTER_CRITICAL(&xfer.lock);
+        if (xfer.gen == gen) {
+            xfer.conn = NO_TRANSFER;
+            xfer.gen++;
+        }
+        portEXIT_CRITICAL(&xfer.lock);
+        ESP_LOGI(TAG, "Connection %d caught up at offset %" PRIu32, conn, next);
+        return false;
+    }
+
+    buf[0] = LOG_TRANSFER_DATA;
+    log_transfer_put_be32(&buf[1], next);
+    esp_err_t ret = ble_transport_notify(conn, BLE_CHAR_LOG, buf, LOG_TRANSFER_DATA_HEADER + n);
+    if (ret == ESP_ERR_NO_MEM) {
+        return false;  // Again once the stack's buffers drain
+    }
+
+    portENTER_CRITICAL(&xfer.lock);
+    if (xfer.gen == gen) {
+        if (ret == ESP_OK) {
+            if (xfer.acked < next) {
+                xfer.acked = next;
+            }
+            xfer.next = next + n;
+            xfer.activity_us = esp_timer_get_time();
+        } else {
+            xfer.conn = NO_TRANSFER;
+            xfer.gen++;
+        }
+    }
+    portEXIT_CRITICAL(&xfer.lock);
+    return ret == ESP_OK;
+}
+
+static void log_transfer_task(void *args)
+{
+    uint8_t buf[BLE_TRANSPORT_MAX_VALUE_LEN];
+    bool holding = false;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, holding ? pdMS_TO_TICKS(LOG_TRANSFER_POLL_MS) : portMAX_DELAY);
+        while (log_transfer_step(buf)) {
+        }
+
+        portENTER_CRITICAL(&xfer.lock);
+        int conn = xfer.conn;
+        bool stalled = conn != NO_TRANSFER && esp_timer_get_time() - xfer.activity_us > LOG_TRANSFER_STALL_US;
+        portEXIT_CRITICAL(&xfer.lock);
+        if (stalled) {
+            ESP_LOGW(TAG, "Connection %d stalled, transfer stopped", conn);
+            log_transfer_stop(conn);
+            log_transfer_error(conn, LOG_TRANSFER_ERR_STALLED);
+            conn = NO_TRANSFER;
+        }
+
+        // Short connection interval and 2M PHY for the length of the download
+        bool active = conn != NO_TRANSFER;
+        if (active != holding) {
+            conn_profile_hold_active(CONN_PROFILE_HOLD_LOG, active);
+            holding = active;
+        }
+    }
+}
+
+esp_err_t log_transfer_start(void)
+{
+    // With telemetry's priority below it: live data first, the download takes what is left
+    if (xTaskCreate(log_transfer_task, "log_transfer_task", 3072, NULL, 2, &xfer.task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void log_transfer_connect(uint8_t conn)
+{
+    xfer.mtu[conn] = LOG_TRANSFER_MTU_DEFAULT;
+    xfer.notify[conn] = false;
+    xfer.congested[conn] = false;
+}
+
+void log_transfer_disconnect(uint8_t conn)
+{
+    xfer.notify[conn] = false;
+    log_transfer_stop(conn);
+}
+
+void log_transfer_set_mtu(uint8_t conn, uint16_t mtu)
+{
+    xfer.mtu[conn] = mtu < LOG_TRANSFER_MTU_DEFAULT ? LOG_TRANSFER_MTU_DEFAULT : mtu;
+}
+
+void log_transfer_set_notify(uint8_t conn, bool enabled)
+{
+    xfer.notify[conn] = enabled;
+    log_transfer_wake();
+}
+
+void log_transfer_set_congested(uint8_t conn, bool congested)
+{
+    xfer.congested[conn] = congested;
+    if (!congested) {
+        log_transfer_wake();
+    }
+}
+
+esp_err_t log_transfer_write(uint8_t conn, const uint8_t *data, size_t len, bool controller)
+{
+    uint8_t op = len > 0 ? data[0] : 0;
+
+    if (op == LOG_TRANSFER_INFO && len == 1) {
+        uint8_t buf[9] = { LOG_TRANSFER_RANGE };
+        uint32_t start, end;
+        datalog_range(&start, &end);
+        log_transfer_put_be32(&buf[1], start);
+        log_transfer_put_be32(&buf[5], end);
+        log_transfer_reply(conn, buf, sizeof(buf));
+    } else if (op == LOG_TRANSFER_READ && len == 9) {
+        portENTER_CRITICAL(&xfer.lock);
+        bool busy = xfer.conn != NO_TRANSFER && xfer.conn != conn;
+        if (!busy) {
+            // A new read from the same connection restarts at the new offset
+            xfer.conn = conn;
+            xfer.gen++;
+            xfer.next = log_transfer_get_be32(&data[1]);
+            xfer.acked = xfer.next;
+            xfer.window = log_transfer_get_be32(&data[5]);
+            xfer.activity_us = esp_timer_get_time();
+        }
+        portEXIT_CRITICAL(&xfer.lock);
+        if (busy) {
+            log_transfer_error(conn, LOG_TRANSFER_ERR_BUSY);
+        } else {
+            ESP_LOGI(TAG, "Connection %u reading from offset %" PRIu32, conn, log_transfer_get_be32(&data[1]));
+            log_transfer_wake();
+        }
+    } else if (op == LOG_TRANSFER_ACK && len == 5) {
+        uint32_t offset = log_transfer_get_be32(&data[1]);
+        portENTER_CRITICAL(&xfer.lock);
+        if (xfer.conn == conn && offset > xfer.acked && offset <= xfer.next) {
+            xfer.acked = offset;
+            xfer.activity_us = esp_timer_get_time();
+        }
+        portEXIT_CRITICAL(&xfer.lock);
+        log_transfer_wake();
+    } else if (op == LOG_TRANSFER_STOP && len == 1) {
+        log_transfer_stop(conn);
+    } else if (op == LOG_TRANSFER_ERASE && len == 1) {
+        if (!controller) {
+            ESP_LOGW(TAG, "Log erase from observer %u rejected", conn);
+            return ESP_ERR_NOT_ALLOWED;
+        }
+        log_transfer_stop(NO_TRANSFER);
+        datalog_clear();
+    } else {
+        log_transfer_error(conn, LOG_TRANSFER_ERR_MALFORMED);
+    }
+    return ESP_OK;
+}
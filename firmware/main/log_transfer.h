@@ -0,0 +1,51 @@
+#ifndef LOG_TRANSFER_H
+#define LOG_TRANSFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Session log download on the log characteristic (protocol in README). One transfer at a
+// time; the client paces it with a byte window and acknowledgements, and resumes after a
+// disconnect by reading again from the last offset it has.
+
+// Requests, written by the client
+#define LOG_TRANSFER_INFO       0x01    // -> LOG_TRANSFER_RANGE
+#define LOG_TRANSFER_READ       0x02    // [offset u32][window u32, 0 = unpaced]
+#define LOG_TRANSFER_ACK        0x03    // [offset u32]: everything before it received
+#define LOG_TRANSFER_STOP       0x04
+#define LOG_TRANSFER_ERASE      0x05    // Controller only
+
+// Notifications
+#define LOG_TRANSFER_RANGE      0x81    // [oldest offset u32][end offset u32]
+#define LOG_TRANSFER_DATA       0x82    // [offset u32][log bytes]
+#define LOG_TRANSFER_END        0x83    // [offset u32]: caught up with the log
+#define LOG_TRANSFER_ERROR      0x84    // [log_transfer_error_t]
+
+typedef enum {
+    LOG_TRANSFER_ERR_MALFORMED = 1,
+    LOG_TRANSFER_ERR_BUSY,              // Another connection is downloading
+    LOG_TRANSFER_ERR_STALLED,           // No acknowledgement in time; read again to resume
+} log_transfer_error_t;
+
+esp_err_t log_transfer_start(void);
+
+// From the BLE transport callbacks
+void log_transfer_connect(uint8_t conn);
+void log_transfer_disconnect(uint8_t conn);
+void log_transfer_set_mtu(uint8_t conn, uint16_t mtu);
+void log_transfer_set_notify(uint8_t conn, bool enabled);
+void log_transfer_set_congested(uint8_t conn, bool congested);
+// ESP_ERR_NOT_ALLOWED for an erase from a connection that is not the controller
+esp_err_t log_transfer_write(uint8_t conn, const uint8_t *data, size_t len, bool controller);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOG_TRANSFER_H
@@ -4,9 +4,26 @@
 #include "freertos/task.h"
 #include "soc/dac_channel.h"
 #include "driver/dac_oneshot.h"
+#include "hal/dac_ll.h"
 #include "driver/i2c_master.h"
 #include "ads1115.h"
+#include "adc_sampler.h"
+#include "fault_adc.h"
+#include "telemetry.h"
+#include "conn_profile.h"
+#include "command.h"
+#include "ble_transport.h"
+#include "adv_status.h"
+#include "datalog.h"
+#include "log_transfer.h"
+#include "ota_update.h"
+#include "current_ctrl.h"
+#include "session.h"
+#include "waveform.h"
+#include "waveform_dac.h"
+#include "esp_timer.h"
 #include "esp_check.h"
+#include "esp_attr.h"
 
 
 #include <stdio.h>
@@ -16,146 +33,746 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
-#include "esp_bt.h"
-
-#include "esp_gap_ble_api.h"
-#include "esp_gatts_api.h"
-#include "esp_bt_defs.h"
-#include "esp_bt_main.h"
-#include "esp_bt_device.h"
-#include "esp_gatt_common_api.h"
 
 #include "sdkconfig.h"
 
 #define I2C_MASTER_SCL_IO 22
 #define I2C_MASTER_SDA_IO 21
 #define I2C_MASTER_NUM I2C_NUM_0
+#define ADS1115_ALERT_GPIO GPIO_NUM_4
+
+// Shunt sensing: A0/A1 sit on either side of the shunt, both behind 39k/10k dividers
+#define SHUNT_R_OHMS 327
+#define SHUNT_DIV_NUM ADC_SAMPLER_LOAD_DIV_DEN     // ADC/shunt: the load divider sits in front
+#define SHUNT_DIV_DEN ADC_SAMPLER_LOAD_DIV_NUM
+
+// Current watchdog window around the target (DAC code or closed-loop setpoint), generous enough for load variation
+#define CURRENT_WINDOW_MARGIN_UA 100
+#define CURRENT_UNDER_MIN_UA 200  // Undercurrent check only above this target
+#define CURRENT_WINDOW_LOAD_MS 250  // Longest wait for a wider window before the output goes up
+
+#define FAULT_CURRENT_WINDOW (1 << 0)
+#define FAULT_FAST_ADC       (1 << 1)
+#define FAULT_SENSOR         (1 << 2)
+
+// Internal ADC fault channel: AIN0/AIN1 nodes jumpered to GPIO 36/39. Its readings are
+// noisier than the ADS1115, so it gets extra margin and acts on gross faults only.
+#define FAULT_ADC_POS_CHANNEL ADC_CHANNEL_0  // GPIO 36
+#define FAULT_ADC_NEG_CHANNEL ADC_CHANNEL_3  // GPIO 39
+#define FAULT_ADC_MARGIN_UA   250
+#define FAULT_ADC_SLOPE_UA    500            // Max rise in mean current between DMA frames
+#define FAULT_ADC_DEBOUNCE    3              // Consecutive over-limit sample pairs
 
 #define GATTS_TAG "tDCS"
 static const char *TAG = "tDCS";
 
-static void gatts_profile_a_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param);
+// Command status per connection, echoed to the sender after every batch
+static bool command_notify[BLE_TRANSPORT_MAX_CONNS];
+static uint8_t command_status[BLE_TRANSPORT_MAX_CONNS][COMMAND_STATUS_LEN];
 
-#define GATTS_SERVICE_UUID_TEST_A   0x00FF
-#define GATTS_CHAR_UUID_TEST_A      0xFF01
-#define GATTS_DESCR_UUID_TEST_A     0x3333
-#define GATTS_NUM_HANDLE_TEST_A     4
+// One connection at a time may change stimulation; the rest observe. The first
+// connection takes control, and it is released on disconnect. Host task only.
+#define NO_CONTROLLER -1
+static int controller_conn = NO_CONTROLLER;
+static volatile uint8_t ble_connections;
 
-#define DEVICE_NAME "tDCS"
-
-#define GATTS_DEMO_CHAR_VAL_LEN_MAX 0x40
+static ads1115_handle_t ads1115_devs[ADS1115_BUS_MAX_DEVICES];
+static ads1115_bus_t ads1115_bus;
+static i2c_master_bus_handle_t i2c_bus_handle;
+static uint8_t dac_out_val = 0;
+static volatile bool dac_enabled = false;
+static volatile uint32_t fault_flags = 0;
 
-static uint8_t char1_str[] = {0x11,0x22,0x33};
-static esp_gatt_char_prop_t a_property = 0;
+// The DAC task moves dac_out_val toward dac_target_val over dac_ramp_ms. Commands
+// update the set under dac_lock so the task never sees half of a batch.
+#define DAC_RAMP_MAX_MS  60000
+#define DAC_RAMP_STEP_MS 20
+static portMUX_TYPE dac_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t dac_target_val = 0;
+static uint8_t dac_ramp_from = 0;
+// Closed-loop current mode: the ramp moves the setpoint and the PI loop finds the code
+static bool dac_closed_loop = false;
+static uint16_t dac_target_ua = 0;
+static uint16_t dac_ramp_from_ua = 0;
+static uint16_t dac_setpoint_ua = 0;
+static bool dac_ctrl_tick = false;
+static uint16_t dac_ramp_ms = 0;
+static int64_t dac_ramp_start_us = 0;
+static int64_t dac_enabled_us = 0;     // When the DAC was last enabled, for the session clock
+static int64_t dac_command_us = 0;     // Oldest command the DAC task has not written yet, 0 if none
+static TaskHandle_t dac_task_handle;
 
-static esp_attr_value_t gatts_demo_char1_val =
-{
-    .attr_max_len = GATTS_DEMO_CHAR_VAL_LEN_MAX,
-    .attr_len     = sizeof(char1_str),
-    .attr_value   = char1_str,
+// Current watchdog window last handed to the ADS1115 and the fast fault channel
+typedef struct {
+    int32_t lo_uv;          // INT32_MIN: no undercurrent check
+    int32_t hi_ua;
+} current_window_t;
+static current_window_t current_window = {    // DAC task only
+    .lo_uv = INT32_MIN,
+    .hi_ua = CURRENT_WINDOW_MARGIN_UA,
 };
 
-static uint8_t adv_config_done = 0;
-
-static esp_ble_adv_data_t adv_data = {
-    .set_scan_rsp = false,
-    .include_name = true,
-    .include_txpower = false,
-    .min_interval = 0x0006,
-    .max_interval = 0x0010,
-    .appearance = 0x00,
-    .manufacturer_len = 0,
-    .p_manufacturer_data = NULL,
-    .service_data_len = 0,
-    .p_service_data = NULL,
-    .service_uuid_len = 0,
-    .p_service_uuid = NULL,
-    .flag = (ESP_BLE_ADV_FLAG_GEN_DISC | ESP_BLE_ADV_FLAG_BREDR_NOT_SPT),
+// Closed loop: a PI step on the latest raw shunt reading every DAC_CTRL_PERIOD_US (the
+// shunt converts every ~3.5 ms scan). Periods without a new reading hold the output;
+// after DAC_CTRL_MAX_MISSED of them in a row the output is forced safe (FAULT_SENSOR). The controller works in drive units, 255 - code,
+// with the nominal transfer below as feedforward. Tuned against the simulated electrode
+// in components/current_ctrl/test; keep the two in step.
+#define DAC_CURRENT_MAX_UA  2480
+#define DAC_CTRL_PERIOD_US  5000
+#define DAC_CTRL_MAX_MISSED 20          // 100 ms, so a shunt schedule slower than that trips it
+#define DAC_DRIVE_OFF_Q8    ((int32_t)((255 - 255LL * 2500 / 3300) << 8))  // Drive at 2.5 V: no current
+static const current_ctrl_config_t dac_ctrl_config = {
+    .kp_q16 = 3 << 16,
+    .ki_q16 = 10 << 16,
+    .ff_offset_q8 = DAC_DRIVE_OFF_Q8,
+    .ff_gain_q16 = (int32_t)((255LL * 2500 << 24) / (2480LL * 3300)),
+    .trim_ratio_q16 = 65536 * 3 / 10,   // +-30% source gain error
+    .trim_floor_q8 = 8 << 8,
+    .slew_q8 = 8 << 8,                  // About 100 uA per period
+    .out_min_q8 = 0,
+    .out_max_q8 = 255 << 8,
+    .max_missed = DAC_CTRL_MAX_MISSED,
 };
+static current_ctrl_t dac_ctrl;         // DAC task only
+static esp_timer_handle_t dac_ctrl_timer;
 
-static esp_ble_adv_params_t adv_params = {
-    .adv_int_min        = 0x20,
-    .adv_int_max        = 0x40,
-    .adv_type           = ADV_TYPE_IND,
-    .own_addr_type      = BLE_ADDR_TYPE_PUBLIC,
-    //.peer_addr            =
-    //.peer_addr_type       =
-    .channel_map        = ADV_CHNL_ALL,
-    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
-};
+// Waveform mode (tACS/tRNS): the DAC DMA plays a sine or noise table instead of the
+// oneshot level, open loop through the nominal transfer. The whole waveform ramps in
+// from zero current when it starts; later changes take effect at once.
+#define DAC_WAVE_SAMPLE_RATE_HZ 20000
+#define DAC_WAVE_MAX_DHZ        50000   // 5 kHz: four samples per sine period
+typedef struct {
+    uint8_t shape;          // 0 DC (code or current target), else waveform_shape_t
+    uint16_t freq_dhz;
+    uint16_t amplitude_ua;
+    uint16_t offset_ua;
+} dac_wave_t;
+static dac_wave_t dac_wave;
+static uint32_t dac_wave_gen;           // Bumped on every change so the task rebuilds the tables
+static int64_t dac_wave_start_us;
+static waveform_t dac_waveform;         // DAC task; read by the DMA ISR while playing
+static uint32_t dac_wave_gain_q16;      // DAC task only, for the current window
 
-#define PROFILE_NUM 1
-#define PROFILE_A_APP_ID 0
-
-struct gatts_profile_inst {
-    esp_gatts_cb_t gatts_cb;
-    uint16_t gatts_if;
-    uint16_t app_id;
-    uint16_t conn_id;
-    uint16_t service_handle;
-    esp_gatt_srvc_id_t service_id;
-    uint16_t char_handle;
-    esp_bt_uuid_t char_uuid;
-    esp_gatt_perm_t perm;
-    esp_gatt_char_prop_t property;
-    uint16_t descr_handle;
-    esp_bt_uuid_t descr_uuid;
-};
+// Dithering: with no waveform, the same DMA path plays the DC level at 50 kHz through a
+// sigma-delta quantiser, and the output filter averages the code toggling down to about
+// 12-bit current steps (components/waveform/bench). Worth it in closed loop, where the PI
+// output has 8 fractional bits; an open-loop code plays as a constant.
+#define DAC_DITHER_RATE_HZ      50000
+static bool dac_dither;
 
-/* One gatt-based profile one app_id and one gatts_if, this array will store the gatts_if returned by ESP_GATTS_REG_EVT */
-static struct gatts_profile_inst gl_profile_tab[PROFILE_NUM] = {
-    [PROFILE_A_APP_ID] = {
-        .gatts_cb = gatts_profile_a_event_handler,
-        .gatts_if = ESP_GATT_IF_NONE,       /* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
-    },
-};
+// What the DMA plays instead of the oneshot driver
+typedef enum {
+    DAC_DMA_OFF,
+    DAC_DMA_WAVE,
+    DAC_DMA_DITHER,
+} dac_dma_mode_t;
 
-static ads1115_handle_t ads1115_dev;
-static i2c_master_bus_handle_t i2c_bus_handle;
-static uint8_t dac_out_val = 0;
-static bool dac_enabled = false;
+// DAC changes from one command batch, applied in a single critical section
+typedef struct {
+    int8_t enable;          // -1 unchanged, 0 disable, 1 enable
+    bool set_target;
+    uint8_t target;
+    bool set_ramp;
+    uint16_t ramp_ms;
+    bool set_current;       // Closed loop from here; a DAC code goes back to open loop
+    uint16_t current_ua;
+    bool set_wave;          // Takes over from the DC level until a code or current target
+    dac_wave_t wave;
+    bool set_dither;
+    bool dither;
+} dac_request_t;
 
 // IMPORTANT: Circuit has INVERSE relationship between DAC voltage and output current
 // DAC 0 (0V) = Maximum current (~2.48mA)
 // DAC 255 (3.3V) = Minimal current (~0.007mA)
 // For safety: when disabled, DAC should be set to 255 (high voltage = low current)
 
-static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+// Mirrors BLEService._currentToDAC() in the app: I = 2.48 mA * (1 - V_dac / 2.5 V)
+static uint32_t dac_code_to_current_ua(uint8_t code)
 {
-    switch (event) {
-    case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
-        adv_config_done = 1;
-        if (adv_config_done) {
-            esp_ble_gap_start_advertising(&adv_params);
-        }
-        break;
-    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
-        if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
-            ESP_LOGE(GATTS_TAG, "Advertising start failed");
-        }
-        break;
-    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
-        if (param->adv_stop_cmpl.status != ESP_BT_STATUS_SUCCESS) {
-            ESP_LOGE(GATTS_TAG, "Advertising stop failed");
+    uint32_t drop_ua = (uint32_t)code * 2480 * 3300 / (255 * 2500);
+    return drop_ua >= 2480 ? 0 : 2480 - drop_ua;
+}
+
+static void dac_apply(const dac_request_t *req)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (req->enable == 1) {
+        fault_adc_rearm();
+    }
+
+    portENTER_CRITICAL(&dac_lock);
+    if (req->enable == 1) {
+        fault_flags = 0;  // Explicit re-enable acknowledges a watchdog trip
+    }
+    if (req->set_ramp) {
+        dac_ramp_ms = req->ramp_ms;
+    }
+    bool was_enabled = dac_enabled;
+    bool enabled = req->enable < 0 ? was_enabled : req->enable;
+    bool closed_loop = req->set_current || (dac_closed_loop && !req->set_target);
+    uint8_t target = req->set_target ? req->target : dac_target_val;
+    uint16_t target_ua = req->set_current ? req->current_ua : dac_target_ua;
+    dac_wave_t wave = req->set_wave ? req->wave :
+                      req->set_target || req->set_current ? (dac_wave_t){0} : dac_wave;
+    bool wave_changed = memcmp(&wave, &dac_wave, sizeof(wave)) != 0;
+    bool target_changed = closed_loop != dac_closed_loop || wave_changed ||
+                          (closed_loop ? target_ua != dac_target_ua : target != dac_target_val);
+    uint16_t ramp_ms = dac_ramp_ms;
+    if (enabled && (!was_enabled || target_changed)) {
+        // Ramp from wherever the output is now; from minimum current when just enabled
+        dac_ramp_from = was_enabled ? dac_out_val : 255;
+        dac_ramp_from_ua = !was_enabled ? 0 : dac_closed_loop ? dac_setpoint_ua : dac_code_to_current_ua(dac_out_val);
+        dac_ramp_start_us = now;
+        if (!was_enabled) {
+            dac_out_val = 255;
+            dac_setpoint_ua = 0;
+            dac_enabled_us = now;
         }
-        break;
-    default:
-        break;
     }
+    if (enabled && wave.shape && (!was_enabled || !dac_wave.shape)) {
+        dac_wave_start_us = now;
+    }
+    if (wave_changed) {
+        dac_wave = wave;
+        dac_wave_gen++;
+    }
+    if (req->set_dither) {
+        dac_dither = req->dither;
+    }
+    dac_target_val = target;
+    dac_target_ua = target_ua;
+    dac_closed_loop = closed_loop;
+    dac_enabled = enabled;
+    if (!dac_command_us) {
+        dac_command_us = now;
+    }
+    portEXIT_CRITICAL(&dac_lock);
+
+    if (req->enable >= 0) {
+        conn_profile_set(enabled ? CONN_PROFILE_ACTIVE : CONN_PROFILE_IDLE);
+        ESP_LOGI(GATTS_TAG, "DAC %s", enabled ? "ENABLED" : "DISABLED");
+    }
+    if (enabled != was_enabled) {
+        uint8_t args[3] = { closed_loop || wave.shape ? 255 : target, ramp_ms >> 8, ramp_ms & 0xFF };
+        datalog_event(enabled ? DATALOG_EVENT_ENABLE : DATALOG_EVENT_DISABLE, args, enabled ? sizeof(args) : 0);
+    }
+    if (enabled && wave.shape && (!was_enabled || wave_changed)) {
+        uint8_t args[7] = { wave.shape, wave.freq_dhz >> 8, wave.freq_dhz & 0xFF, wave.amplitude_ua >> 8,
+                            wave.amplitude_ua & 0xFF, wave.offset_ua >> 8, wave.offset_ua & 0xFF };
+        datalog_event(DATALOG_EVENT_WAVEFORM, args, sizeof(args));
+    } else if (enabled && closed_loop && (!was_enabled || target_changed)) {
+        uint8_t args[2] = { target_ua >> 8, target_ua & 0xFF };
+        datalog_event(DATALOG_EVENT_TARGET_CURRENT, args, sizeof(args));
+    } else if (enabled && was_enabled && target_changed) {
+        datalog_event(DATALOG_EVENT_TARGET, &target, 1);
+    }
+    if (dac_task_handle) {
+        xTaskNotifyGive(dac_task_handle);
+    }
+    adv_status_changed();
+}
+
+// Client DAC changes. A running session gives way to an explicit disable, a DAC code or a
+// waveform; a new current target becomes the session's hold target and it carries on.
+static void dac_apply_client(const dac_request_t *req)
+{
+    if (req->enable == 0 || req->set_target || req->set_wave) {
+        session_end(SESSION_END_OVERRIDDEN);
+    } else if (req->set_current) {
+        session_set_target(req->current_ua);
+    }
+    dac_apply(req);
 }
 
 static void handle_dac_write(uint8_t value) {
+    dac_request_t req = {.enable = -1};
     if (value == 254) {
-        dac_enabled = true;
-        ESP_LOGI(GATTS_TAG, "DAC ENABLED");
+        if (ota_update_in_progress()) {
+            ESP_LOGW(GATTS_TAG, "Enable ignored during firmware update");
+            return;
+        }
+        req.enable = 1;
     } else if (value == 253) {
-        dac_enabled = false;
-        ESP_LOGI(GATTS_TAG, "DAC DISABLED");
+        req.enable = 0;
     } else {
-        dac_out_val = value;
+        req.set_target = true;
+        req.target = value;
+    }
+    dac_apply_client(&req);
+}
+
+// Output code for this instant of the current ramp; call with dac_lock held
+static uint8_t dac_ramp_value(int64_t now_us)
+{
+    int64_t span_us = (int64_t)dac_ramp_ms * 1000;
+    int64_t elapsed_us = now_us - dac_ramp_start_us;
+    if (elapsed_us >= span_us) {
+        return dac_target_val;
+    }
+    int32_t delta = (int32_t)dac_target_val - dac_ramp_from;
+    return (uint8_t)(dac_ramp_from + delta * elapsed_us / span_us);
+}
+
+// Closed-loop setpoint for this instant of the current ramp; call with dac_lock held
+static uint16_t dac_setpoint_value(int64_t now_us)
+{
+    int64_t span_us = (int64_t)dac_ramp_ms * 1000;
+    int64_t elapsed_us = now_us - dac_ramp_start_us;
+    if (elapsed_us >= span_us) {
+        return dac_target_ua;
+    }
+    int32_t delta = (int32_t)dac_target_ua - dac_ramp_from_ua;
+    return (uint16_t)(dac_ramp_from_ua + delta * elapsed_us / span_us);
+}
+
+// Waveform gain for this instant of its ramp-in; call with dac_lock held
+static uint32_t dac_wave_gain_value(int64_t now_us)
+{
+    int64_t span_us = (int64_t)dac_ramp_ms * 1000;
+    int64_t elapsed_us = now_us - dac_wave_start_us;
+    if (elapsed_us >= span_us) {
+        return WAVEFORM_GAIN_ONE;
+    }
+    return (uint32_t)(WAVEFORM_GAIN_ONE * elapsed_us / span_us);
+}
+
+static uint8_t dac_drive_to_code(int32_t drive_q8)
+{
+    int32_t code = 255 - ((drive_q8 + 128) >> 8);
+    return code < 0 ? 0 : code > 255 ? 255 : code;
+}
+
+// Shunt current of device 0 in a frame. The sampler's board-referenced scale for the
+// shunt channel undoes the divider, so this is the voltage across the shunt itself.
+static int32_t frame_current_ua(const adc_frame_t *frame)
+{
+    int32_t uv[ADC_SAMPLER_MAX_CHANNELS];
+    adc_sampler_frame_to_uv(frame, uv);
+    return uv[ADC_CH_SHUNT] / SHUNT_R_OHMS;
+}
+
+static void dac_ctrl_timer_cb(void *arg)
+{
+    portENTER_CRITICAL(&dac_lock);
+    dac_ctrl_tick = true;
+    portEXIT_CRITICAL(&dac_lock);
+    xTaskNotifyGive(dac_task_handle);
+}
+
+static int32_t shunt_current_to_uv(int32_t current_ua)
+{
+    // uA * ohm = uV across the shunt, then scaled by the divider in front of the ADC
+    return current_ua * SHUNT_R_OHMS * SHUNT_DIV_NUM / SHUNT_DIV_DEN;
+}
+
+// Nominal current for a drive level, the inverse of the PI loop's feedforward
+static int32_t dac_drive_to_current_ua(int32_t drive_q8)
+{
+    int64_t above_q8 = drive_q8 - dac_ctrl_config.ff_offset_q8;
+    return above_q8 <= 0 ? 0 : (int32_t)((above_q8 << 16) / dac_ctrl_config.ff_gain_q16);
+}
+
+// Window for the output about to be written. It covers both ends of a ramp so the steps
+// in between never trip it. In closed loop the ceiling follows the setpoint, which only
+// commands move, but the floor follows the PI's slew-limited drive: after a step the
+// setpoint can be a long way ahead of the current.
+static current_window_t current_window_for(int32_t drive_q8)
+{
+    int32_t out_ua = 0, end_ua = 0, floor_ua = 0;
+    if (dac_enabled && dac_closed_loop) {
+        out_ua = dac_setpoint_ua;
+        end_ua = dac_target_ua;
+        int32_t drive_ua = dac_drive_to_current_ua(drive_q8);
+        floor_ua = drive_ua < end_ua ? drive_ua : end_ua;
+    } else if (dac_enabled) {
+        out_ua = (int32_t)dac_code_to_current_ua(dac_out_val);
+        end_ua = (int32_t)dac_code_to_current_ua(dac_target_val);
+        floor_ua = out_ua < end_ua ? out_ua : end_ua;
+    }
+    int32_t target_ua = out_ua > end_ua ? out_ua : end_ua;
+    if (dac_enabled && dac_wave.shape) {
+        // Both peaks of the waveform; no floor until it has ramped in
+        target_ua = dac_wave.offset_ua + dac_wave.amplitude_ua;
+        floor_ua = dac_wave_gain_q16 < WAVEFORM_GAIN_ONE ? 0 : dac_wave.offset_ua - dac_wave.amplitude_ua;
+    }
+    current_window_t window = {
+        .lo_uv = floor_ua >= CURRENT_UNDER_MIN_UA ? shunt_current_to_uv(floor_ua / 2) : INT32_MIN,
+        .hi_ua = target_ua + target_ua / 4 + CURRENT_WINDOW_MARGIN_UA,
+    };
+    return window;
+}
+
+static void current_window_set(const current_window_t *window)
+{
+    current_window = *window;
+    ads1115_set_window(&ads1115_devs[0], window->lo_uv, shunt_current_to_uv(window->hi_ua));
+    fault_adc_set_limits(shunt_current_to_uv(window->hi_ua + FAULT_ADC_MARGIN_UA),
+                         shunt_current_to_uv(FAULT_ADC_SLOPE_UA));
+}
+
+// Before the output changes: the union of the window in force and the next one. The
+// sampler loads thresholds before its next shunt conversion, and one already in flight is
+// judged against the old ones, so wait until the wider window is in force.
+static void current_window_widen(const current_window_t *next)
+{
+    current_window_t wide = current_window;
+    wide.lo_uv = next->lo_uv < wide.lo_uv ? next->lo_uv : wide.lo_uv;
+    wide.hi_ua = next->hi_ua > wide.hi_ua ? next->hi_ua : wide.hi_ua;
+    if (wide.lo_uv == current_window.lo_uv && wide.hi_ua == current_window.hi_ua) {
+        return;
+    }
+    current_window_set(&wide);
+    for (int ms = 0; !ads1115_window_loaded(&ads1115_devs[0]); ms += portTICK_PERIOD_MS) {
+        if (ms >= CURRENT_WINDOW_LOAD_MS) {
+            ESP_LOGW(TAG, "Current window not loaded after %d ms", ms);
+            break;
+        }
+        vTaskDelay(1);
+    }
+}
+
+static void IRAM_ATTR force_dac_safe(uint32_t fault)
+{
+    // Force minimum current straight through the HAL; the oneshot driver is not ISR-safe.
+    // A playing waveform is cut off the pad as well; the DAC task stops its DMA.
+    dac_ll_update_output_value(DAC_CHAN_0, 255);
+    dac_ll_digi_enable_dma(false);
+    portENTER_CRITICAL_ISR(&dac_lock);
+    dac_enabled = false;
+    fault_flags |= fault;
+    portEXIT_CRITICAL_ISR(&dac_lock);
+
+    // The DAC task sleeps until something changes; it reports the fault and resets the window
+    if (!dac_task_handle) {
+        return;
+    }
+    if (!xPortInIsrContext()) {
+        // Software window check on a board without ALERT/RDY: the sampler task trips
+        xTaskNotifyGive(dac_task_handle);
+        return;
+    }
+    BaseType_t higher_prio_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(dac_task_handle, &higher_prio_woken);
+    if (higher_prio_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void IRAM_ATTR current_window_trip(void *arg)
+{
+    force_dac_safe(FAULT_CURRENT_WINDOW);
+}
+
+#if CONFIG_FAULT_ADC_ENABLE
+static void IRAM_ATTR fast_adc_trip(void *arg)
+{
+    force_dac_safe(FAULT_FAST_ADC);
+}
+#endif
+
+// 4-byte write: [channel, decimation, priority, data rate index 0-7 (8..860 SPS)]
+static void handle_schedule_write(const uint8_t *value) {
+    uint16_t data_rate = (uint16_t)(value[3] & 0x07) << 5;
+    esp_err_t ret = adc_sampler_set_schedule(value[0], value[1], value[2], data_rate);
+    if (ret != ESP_OK) {
+        ESP_LOGW(GATTS_TAG, "Schedule write rejected: %s", esp_err_to_name(ret));
+    }
+}
+
+// 6-byte write: [channel, median N, IIR shift, decimator (0 boxcar, 1 CIC), decimation, CIC order]
+static adc_filter_config_t filter_config_from_bytes(const uint8_t *value)
+{
+    adc_filter_config_t config = {
+        .median_n = value[1],
+        .iir_shift = value[2],
+        .decim_type = value[3] ? ADC_FILTER_DECIM_CIC : ADC_FILTER_DECIM_BOXCAR,
+        .decimation = value[4],
+        .cic_order = value[5],
+    };
+    return config;
+}
+
+static void handle_filter_write(const uint8_t *value) {
+    adc_filter_config_t config = filter_config_from_bytes(value);
+    esp_err_t ret = adc_sampler_set_filter(value[0], &config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(GATTS_TAG, "Filter write rejected: %s", esp_err_to_name(ret));
+    }
+}
+
+// Semantic checks for one entry; the parser has already checked type and length
+static command_status_t command_check(const command_tlv_t *tlv)
+{
+    const uint8_t *v = tlv->value;
+    switch (tlv->type) {
+    case COMMAND_SET_RAMP:
+        return ((v[0] << 8) | v[1]) <= DAC_RAMP_MAX_MS ? COMMAND_STATUS_OK : COMMAND_STATUS_INVALID_VALUE;
+    case COMMAND_SET_CURRENT:
+        return ((v[0] << 8) | v[1]) <= DAC_CURRENT_MAX_UA ? COMMAND_STATUS_OK : COMMAND_STATUS_INVALID_VALUE;
+    case COMMAND_START_SESSION: {
+        uint32_t target = (v[0] << 8) | v[1];
+        uint32_t ramp = (v[2] << 8) | v[3];
+        uint32_t duration_ms = ((v[4] << 8) | v[5]) * 1000;
+        // Both ramps fit inside the duration
+        return target <= DAC_CURRENT_MAX_UA && ramp <= DAC_RAMP_MAX_MS && duration_ms > 0 && 2 * ramp <= duration_ms ?
+               COMMAND_STATUS_OK : COMMAND_STATUS_INVALID_VALUE;
+    }
+    case COMMAND_SET_WAVEFORM: {
+        if (v[0] == 0) {
+            return COMMAND_STATUS_OK;
+        }
+#if CONFIG_FAULT_ADC_ENABLE
+        // The fast fault channel holds I2S0, which the DAC DMA needs on the ESP32
+        return COMMAND_STATUS_INVALID_VALUE;
+#else
+        uint32_t freq_dhz = (v[1] << 8) | v[2];
+        uint32_t amplitude = (v[3] << 8) | v[4];
+        uint32_t offset = (v[5] << 8) | v[6];
+        // The output stage only sources current, so the waveform rides on the offset
+        return v[0] <= WAVEFORM_NOISE && freq_dhz > 0 && freq_dhz <= DAC_WAVE_MAX_DHZ &&
+               amplitude <= offset && offset + amplitude <= DAC_CURRENT_MAX_UA ?
+               COMMAND_STATUS_OK : COMMAND_STATUS_INVALID_VALUE;
+#endif
+    }
+    case COMMAND_SET_DITHER:
+#if CONFIG_FAULT_ADC_ENABLE
+        return v[0] == 0 ? COMMAND_STATUS_OK : COMMAND_STATUS_INVALID_VALUE;
+#else
+        return v[0] <= 1 ? COMMAND_STATUS_OK : COMMAND_STATUS_INVALID_VALUE;
+#endif
+    case COMMAND_SET_SCHEDULE:
+        return v[0] < ADC_SAMPLER_NUM_CHANNELS && v[3] <= 7 ? COMMAND_STATUS_OK : COMMAND_STATUS_INVALID_VALUE;
+    case COMMAND_SET_FILTER: {
+        adc_filter_config_t config = filter_config_from_bytes(v);
+        adc_filter_t probe;
+        return v[0] < ADC_SAMPLER_NUM_CHANNELS && adc_filter_init(&probe, &config) ?
+               COMMAND_STATUS_OK : COMMAND_STATUS_INVALID_VALUE;
+    }
+    default:
+        return COMMAND_STATUS_OK;
+    }
+}
+
+// Validate every entry, queue the sampler settings as one unit, then apply the rest at
+// once. Nothing is applied if that queueing fails. Entries apply in order, so "enable,
+// set DAC 255, disable" ends disabled, and a claim at the front of a batch covers the
+// entries after it.
+static command_status_t command_apply(uint8_t conn, const command_batch_t *batch, uint8_t *bad_index)
+{
+    dac_request_t req = {.enable = -1};
+    bool dac_changed = false;
+    adc_sampler_changes_t sampler = {0};
+    int sampler_index = -1;
+    int telemetry_ms = -1;
+    const command_tlv_t *start_session = NULL;
+    bool stop_session = false;
+    bool controller = controller_conn == conn;
+
+    for (int i = 0; i < batch->count; i++) {
+        const command_tlv_t *tlv = &batch->tlv[i];
+        command_status_t status = command_check(tlv);
+        if (tlv->type == COMMAND_CLAIM_CONTROL) {
+            if (controller_conn != NO_CONTROLLER && controller_conn != conn) {
+                status = COMMAND_STATUS_NOT_CONTROLLER;
+            }
+            controller = true;
+        } else if (tlv->type == COMMAND_RELEASE_CONTROL) {
+            controller = false;
+        } else if (!controller) {
+            status = COMMAND_STATUS_NOT_CONTROLLER;
+        } else if ((tlv->type == COMMAND_ENABLE || tlv->type == COMMAND_START_SESSION) &&
+                   ota_update_in_progress()) {
+            // No stimulation while flash writes stall the tasks watching the current
+            status = COMMAND_STATUS_BUSY;
+        }
+        if (status != COMMAND_STATUS_OK) {
+            *bad_index = i;
+            return status;
+        }
+    }
+
+    for (int i = 0; i < batch->count; i++) {
+        const command_tlv_t *tlv = &batch->tlv[i];
+        const uint8_t *v = tlv->value;
+        switch (tlv->type) {
+        case COMMAND_ENABLE:
+        case COMMAND_DISABLE:
+            req.enable = tlv->type == COMMAND_ENABLE;
+            dac_changed = true;
+            break;
+        case COMMAND_SET_DAC:
+            req.set_target = true;
+            req.set_current = false;
+            req.set_wave = false;
+            req.target = v[0];
+            dac_changed = true;
+            break;
+        case COMMAND_SET_RAMP:
+            req.set_ramp = true;
+            req.ramp_ms = (v[0] << 8) | v[1];
+            dac_changed = true;
+            break;
+        case COMMAND_SET_CURRENT:
+            // Whichever of code and current comes last in the batch sets the mode
+            req.set_current = true;
+            req.set_target = false;
+            req.set_wave = false;
+            req.current_ua = (v[0] << 8) | v[1];
+            dac_changed = true;
+            break;
+        case COMMAND_SET_WAVEFORM:
+            req.set_wave = true;
+            req.wave = (dac_wave_t){
+                .shape = v[0],
+                .freq_dhz = (v[1] << 8) | v[2],
+                .amplitude_ua = (v[3] << 8) | v[4],
+                .offset_ua = (v[5] << 8) | v[6],
+            };
+            if (!req.wave.shape) {
+                req.wave = (dac_wave_t){0};
+            }
+            dac_changed = true;
+            break;
+        case COMMAND_SET_DITHER:
+            req.set_dither = true;
+            req.dither = v[0];
+            dac_changed = true;
+            break;
+        case COMMAND_START_SESSION:
+            start_session = tlv;
+            stop_session = false;
+            break;
+        case COMMAND_STOP_SESSION:
+            stop_session = true;
+            start_session = NULL;
+            break;
+        case COMMAND_SET_TELEMETRY_INTERVAL:
+            telemetry_ms = (v[0] << 8) | v[1];
+            break;
+        case COMMAND_SET_SCHEDULE:
+            // Checked above, so adding cannot fail
+            adc_sampler_changes_add_schedule(&sampler, v[0], v[1], v[2], (uint16_t)v[3] << 5);
+            sampler_index = sampler_index < 0 ? i : sampler_index;
+            break;
+        case COMMAND_SET_FILTER: {
+            adc_filter_config_t config = filter_config_from_bytes(v);
+            adc_sampler_changes_add_filter(&sampler, v[0], &config);
+            sampler_index = sampler_index < 0 ? i : sampler_index;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Only a full sampler queue can fail, and it fails before anything has changed
+    if (adc_sampler_apply_changes(&sampler) != ESP_OK) {
+        *bad_index = sampler_index;
+        return COMMAND_STATUS_BUSY;
+    }
+    if (telemetry_ms >= 0) {
+        telemetry_set_interval_ms(telemetry_ms);
+    }
+
+    if (dac_changed) {
+        dac_apply_client(&req);
+    }
+    // After the batch's DAC changes, so a batch can set up and start in one write
+    if (start_session) {
+        const uint8_t *v = start_session->value;
+        session_start((v[0] << 8) | v[1], (v[2] << 8) | v[3], (v[4] << 8) | v[5]);
+    } else if (stop_session) {
+        session_stop();
+    }
+    if (controller != (controller_conn == conn)) {
+        controller_conn = controller ? conn : NO_CONTROLLER;
+        ESP_LOGI(GATTS_TAG, "Connection %u %s control", conn, controller ? "took" : "released");
+    }
+    return COMMAND_STATUS_OK;
+}
+
+static void handle_command_write(uint8_t conn, const uint8_t *value, size_t len)
+{
+    command_batch_t batch;
+    uint8_t bad_index;
+    uint8_t seq = len > 0 ? value[0] : 0;
+
+    command_status_t status = command_parse(value, len, &batch, &bad_index);
+    if (status == COMMAND_STATUS_OK) {
+        status = command_apply(conn, &batch, &bad_index);
+    }
+    if (status != COMMAND_STATUS_OK) {
+        ESP_LOGW(GATTS_TAG, "Command %u from connection %u rejected: status %d at entry %u",
+                 seq, conn, status, bad_index);
+    }
+
+    // Echo the sequence number so the client can match the status to its write
+    uint8_t *st = command_status[conn];
+    st[0] = seq;
+    st[1] = status;
+    st[2] = bad_index;
+    st[3] = (uint8_t)fault_flags;
+    if (command_notify[conn]) {
+        ble_transport_notify(conn, BLE_CHAR_COMMAND, st, COMMAND_STATUS_LEN);
+    }
+}
+
+// The session engine drives the DAC through the same requests as commands, in closed loop
+static void session_enable(uint16_t target_ua, uint16_t ramp_ms)
+{
+    dac_request_t req = {
+        .enable = 1,
+        .set_ramp = true,
+        .ramp_ms = ramp_ms,
+        .set_current = true,
+        .current_ua = target_ua,
+    };
+    dac_apply(&req);
+}
+
+static void session_set_output(uint16_t target_ua, uint16_t ramp_ms)
+{
+    dac_request_t req = {
+        .enable = -1,
+        .set_ramp = true,
+        .ramp_ms = ramp_ms,
+        .set_current = true,
+        .current_ua = target_ua,
+    };
+    dac_apply(&req);
+}
+
+static void session_disable(void)
+{
+    dac_request_t req = {.enable = 0};
+    dac_apply(&req);
+}
+
+// Progress goes to every subscriber of the command characteristic; the length tells it
+// apart from a command status
+static void session_on_status(const session_status_t *status)
+{
+    adc_frame_t frame;
+    int32_t measured_ua = adc_sampler_get_filtered(&frame) || adc_sampler_get_latest(&frame) ?
+                          frame_current_ua(&frame) : 0;
+    uint8_t out[SESSION_STATUS_LEN];
+    size_t len = session_status_encode(status, measured_ua, out);
+    for (uint8_t conn = 0; conn < BLE_TRANSPORT_MAX_CONNS; conn++) {
+        if (command_notify[conn]) {
+            ble_transport_notify(conn, BLE_CHAR_COMMAND, out, len);
+        }
     }
 }
 
+static const session_callbacks_t session_callbacks = {
+    .enable = session_enable,
+    .set_target = session_set_output,
+    .disable = session_disable,
+    .on_status = session_on_status,
+};
+
 static esp_err_t i2c_master_init(void)
 {
     i2c_master_bus_config_t i2c_mst_config = {
@@ -164,6 +781,7 @@ static esp_err_t i2c_master_init(void)
         .scl_io_num = I2C_MASTER_SCL_IO,
         .sda_io_num = I2C_MASTER_SDA_IO,
         .glitch_ignore_cnt = 7,
+        .trans_queue_depth = 4,  // Enables async transactions for the pipelined ADS1115 path
         .flags.enable_internal_pullup = true,
     };
 
@@ -172,154 +790,448 @@ static esp_err_t i2c_master_init(void)
 
 static esp_err_t ads1115_setup(void)
 {
-    ads1115_config_t config = {
-        .addr = ADS1115_I2C_ADDR_DEFAULT,
-        .gain = ADS1115_PGA_4_096V,
-        .data_rate = ADS1115_DR_64SPS
+    // The main front end is always fitted; extra front ends are picked up if they answer on the bus
+    static const uint8_t addrs[ADS1115_BUS_MAX_DEVICES] = {
+        ADS1115_I2C_ADDR_DEFAULT,
+        ADS1115_I2C_ADDR_VDD,
+        ADS1115_I2C_ADDR_SDA,
+        ADS1115_I2C_ADDR_SCL,
+    };
+
+    for (int i = 0; i < ADS1115_BUS_MAX_DEVICES; i++) {
+        if (i > 0 && i2c_master_probe(i2c_bus_handle, addrs[i], 50) != ESP_OK) {
+            continue;
+        }
+
+        ads1115_config_t config = {
+            .addr = addrs[i],
+            .gain = ADC_SAMPLER_SINGLE_GAIN,
+            .data_rate = ADS1115_DR_860SPS,  // Default; the sampler sets a rate per channel
+#if CONFIG_BOARD_ADS1115_ALERT_WIRED
+            .use_alert_rdy = (i == 0),  // Only the main front end can have ALERT/RDY wired
+#endif
+            .alert_gpio = ADS1115_ALERT_GPIO,
+            .scl_speed_hz = 400000,  // Fast mode
+            .async = true,
+        };
+        ads1115_handle_t *dev = &ads1115_devs[ads1115_bus.num_devices];
+        ESP_RETURN_ON_ERROR(ads1115_init(dev, &config, i2c_bus_handle), TAG, "ADS1115 0x%02x init failed", addrs[i]);
+        ESP_RETURN_ON_ERROR(ads1115_bus_add_device(&ads1115_bus, dev), TAG, "ADS1115 0x%02x add failed", addrs[i]);
+    }
+
+    // Hardware current watchdog on the main front end's shunt
+    ads1115_window_config_t window = {
+        .mux = ADS1115_MUX_DIFF_0_1,
+        .on_trip = current_window_trip,
     };
-    return ads1115_init(&ads1115_dev, &config, i2c_bus_handle);
+    return ads1115_enable_window(&ads1115_devs[0], &window, INT32_MIN,
+                                 shunt_current_to_uv(CURRENT_WINDOW_MARGIN_UA));
 }
 
-static void gatts_read_adc(esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
-    int16_t chan0_raw = 0;
-    int16_t chan1_raw = 0;
-    int16_t chan2_raw = 0;
-    int16_t chan3_raw = 0;
-    esp_err_t ret;
+static size_t read_adc_record(uint8_t *out)
+{
+    // Copy the latest filtered values (or, before the first filter output, the latest
+    // scan) from the sampler task; never touches I2C. Only device 0 is reported.
+    adc_frame_t frame;
+    if (!adc_sampler_get_filtered(&frame) && !adc_sampler_get_latest(&frame)) {
+        memset(&frame, 0, sizeof(frame));
+        frame.gain[ADC_CH_SHUNT] = ADC_SAMPLER_SHUNT_GAIN;
+    }
+    return telemetry_encode_record(&frame, out);
+}
 
-    ret = ads1115_read_single(&ads1115_dev, ADS1115_MUX_SINGLE_0, &chan0_raw);
-    if (ret != ESP_OK) {
-        ESP_LOGE(GATTS_TAG, "Failed to read ADS1115 A0: %s", esp_err_to_name(ret));
-        chan0_raw = 0;
+static void read_device_status(adv_status_t *status)
+{
+    portENTER_CRITICAL(&dac_lock);
+    bool enabled = dac_enabled;
+    bool ramping = dac_closed_loop ? dac_setpoint_ua != dac_target_ua : dac_out_val != dac_target_val;
+    int64_t enabled_us = dac_enabled_us;
+    uint32_t faults = fault_flags;
+    portEXIT_CRITICAL(&dac_lock);
+
+    if (faults) {
+        status->state = ADV_STATUS_FAULT;
+    } else if (!enabled) {
+        status->state = ADV_STATUS_IDLE;
+    } else {
+        status->state = ramping ? ADV_STATUS_RAMPING : ADV_STATUS_STIMULATING;
     }
+    status->elapsed_s = enabled ? (esp_timer_get_time() - enabled_us) / 1000000 : 0;
+    status->faults = (uint8_t)faults;
+    status->connections = ble_connections;
 
-    ret = ads1115_read_single(&ads1115_dev, ADS1115_MUX_SINGLE_1, &chan1_raw);
-    if (ret != ESP_OK) {
-        ESP_LOGE(GATTS_TAG, "Failed to read ADS1115 A1: %s", esp_err_to_name(ret));
-        chan1_raw = 0;
+    // Filtered values, so the advertised current does not jump with sample noise
+    adc_frame_t frame;
+    if (!adc_sampler_get_filtered(&frame) && !adc_sampler_get_latest(&frame)) {
+        status->current_ua = 0;
+        status->battery_mv = 0;
+        return;
     }
+    int32_t uv[ADC_SAMPLER_MAX_CHANNELS];
+    adc_sampler_frame_to_uv(&frame, uv);
+    status->current_ua = uv[ADC_CH_SHUNT] / SHUNT_R_OHMS;
+    status->battery_mv = uv[ADC_CH_A3] / 1000;
+}
 
-    ret = ads1115_read_single(&ads1115_dev, ADS1115_MUX_SINGLE_2, &chan2_raw);
-    if (ret != ESP_OK) {
-        ESP_LOGE(GATTS_TAG, "Failed to read ADS1115 A2: %s", esp_err_to_name(ret));
-        chan2_raw = 0;
+static void ble_on_connect(uint8_t conn)
+{
+    command_notify[conn] = false;
+    memset(command_status[conn], 0, COMMAND_STATUS_LEN);
+    if (controller_conn == NO_CONTROLLER) {
+        controller_conn = conn;
     }
+    ESP_LOGI(GATTS_TAG, "Connection %u joined as %s", conn,
+             controller_conn == conn ? "controller" : "observer");
+    telemetry_connect(conn);
+    log_transfer_connect(conn);
+    conn_profile_connected(conn);
+    ble_connections++;
+    adv_status_changed();
+}
 
-    ret = ads1115_read_single(&ads1115_dev, ADS1115_MUX_SINGLE_3, &chan3_raw);
-    if (ret != ESP_OK) {
-        ESP_LOGE(GATTS_TAG, "Failed to read ADS1115 A3: %s", esp_err_to_name(ret));
-        chan3_raw = 0;
-    }
-
-    esp_gatt_rsp_t rsp;
-    memset(&rsp, 0, sizeof(esp_gatt_rsp_t));
-    rsp.attr_value.handle = param->read.handle;
-    rsp.attr_value.len = 8;
-    rsp.attr_value.value[0] = (chan0_raw >> 8) & 0xFF;
-    rsp.attr_value.value[1] = chan0_raw & 0xFF;
-    rsp.attr_value.value[2] = (chan1_raw >> 8) & 0xFF;
-    rsp.attr_value.value[3] = chan1_raw & 0xFF;
-    rsp.attr_value.value[4] = (chan2_raw >> 8) & 0xFF;
-    rsp.attr_value.value[5] = chan2_raw & 0xFF;
-    rsp.attr_value.value[6] = (chan3_raw >> 8) & 0xFF;
-    rsp.attr_value.value[7] = chan3_raw & 0xFF;
-    
-    esp_ble_gatts_send_response(gatts_if, param->read.conn_id, param->read.trans_id,
-                                ESP_GATT_OK, &rsp);
-}
-
-static void gatts_profile_a_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param) {
-    switch (event) {
-    case ESP_GATTS_REG_EVT:
-        gl_profile_tab[PROFILE_A_APP_ID].service_id.is_primary = true;
-        gl_profile_tab[PROFILE_A_APP_ID].service_id.id.inst_id = 0x00;
-        gl_profile_tab[PROFILE_A_APP_ID].service_id.id.uuid.len = ESP_UUID_LEN_16;
-        gl_profile_tab[PROFILE_A_APP_ID].service_id.id.uuid.uuid.uuid16 = GATTS_SERVICE_UUID_TEST_A;
-
-        esp_ble_gap_set_device_name(DEVICE_NAME);
-        esp_ble_gap_config_adv_data(&adv_data);
-        esp_ble_gatts_create_service(gatts_if, &gl_profile_tab[PROFILE_A_APP_ID].service_id, GATTS_NUM_HANDLE_TEST_A);
-        break;
-    case ESP_GATTS_READ_EVT:
-        gatts_read_adc(gatts_if, param);
-        break;
-    case ESP_GATTS_WRITE_EVT:
-        if (param->write.len == 1) {
-            handle_dac_write(param->write.value[0]);
-        }
-        if (param->write.need_rsp) {
-            esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, ESP_GATT_OK, NULL);
-        }
-        break;
-    case ESP_GATTS_CREATE_EVT:
-        gl_profile_tab[PROFILE_A_APP_ID].service_handle = param->create.service_handle;
-        gl_profile_tab[PROFILE_A_APP_ID].char_uuid.len = ESP_UUID_LEN_16;
-        gl_profile_tab[PROFILE_A_APP_ID].char_uuid.uuid.uuid16 = GATTS_CHAR_UUID_TEST_A;
-        esp_ble_gatts_start_service(gl_profile_tab[PROFILE_A_APP_ID].service_handle);
-        a_property = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE;
-        esp_ble_gatts_add_char(gl_profile_tab[PROFILE_A_APP_ID].service_handle,
-                              &gl_profile_tab[PROFILE_A_APP_ID].char_uuid,
-                              ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE,
-                              a_property,
-                              &gatts_demo_char1_val, NULL);
-        break;
-    case ESP_GATTS_ADD_CHAR_EVT:
-        gl_profile_tab[PROFILE_A_APP_ID].char_handle = param->add_char.attr_handle;
-        break;
-    case ESP_GATTS_CONNECT_EVT:
-        gl_profile_tab[PROFILE_A_APP_ID].conn_id = param->connect.conn_id;
-        break;
-    case ESP_GATTS_DISCONNECT_EVT:
-        esp_ble_gap_start_advertising(&adv_params);
-        break;
-    default:
-        break;
+static void ble_on_disconnect(uint8_t conn)
+{
+    command_notify[conn] = false;
+    if (controller_conn == conn) {
+        // Stimulation carries on as set; any remaining connection can claim control
+        controller_conn = NO_CONTROLLER;
     }
+    telemetry_disconnect(conn);
+    log_transfer_disconnect(conn);
+    ota_update_disconnect(conn);
+    conn_profile_disconnected(conn);
+    ble_connections--;
+    adv_status_changed();
 }
 
-static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+static void ble_on_mtu(uint8_t conn, uint16_t mtu)
 {
-    if (event == ESP_GATTS_REG_EVT) {
-        if (param->reg.status == ESP_GATT_OK) {
-            gl_profile_tab[param->reg.app_id].gatts_if = gatts_if;
-        } else {
-            return;
-        }
+    telemetry_set_mtu(conn, mtu);
+    log_transfer_set_mtu(conn, mtu);
+}
+
+static void ble_on_congest(uint8_t conn, bool congested)
+{
+    telemetry_set_congested(conn, congested);
+    log_transfer_set_congested(conn, congested);
+}
+
+static void ble_on_subscribe(uint8_t conn, ble_char_t ch, bool notify)
+{
+    if (ch == BLE_CHAR_TELEMETRY) {
+        telemetry_set_notify(conn, notify);
+    } else if (ch == BLE_CHAR_COMMAND) {
+        command_notify[conn] = notify;
+    } else if (ch == BLE_CHAR_LOG) {
+        log_transfer_set_notify(conn, notify);
+    } else if (ch == BLE_CHAR_OTA) {
+        ota_update_set_notify(conn, notify);
     }
+}
 
-    for (int idx = 0; idx < PROFILE_NUM; idx++) {
-        if (gatts_if == ESP_GATT_IF_NONE || gatts_if == gl_profile_tab[idx].gatts_if) {
-            if (gl_profile_tab[idx].gatts_cb) {
-                gl_profile_tab[idx].gatts_cb(event, gatts_if, param);
-            }
-        }
+static size_t ble_on_read(uint8_t conn, ble_char_t ch, uint8_t *out, size_t cap)
+{
+    if (ch == BLE_CHAR_CONTROL && cap >= TELEMETRY_RECORD_LEN) {
+        return read_adc_record(out);
+    } else if (ch == BLE_CHAR_COMMAND && cap >= COMMAND_STATUS_LEN) {
+        // Last command status for this connection
+        memcpy(out, command_status[conn], COMMAND_STATUS_LEN);
+        return COMMAND_STATUS_LEN;
     }
+    return 0;
 }
 
+static esp_err_t ble_on_write(uint8_t conn, ble_char_t ch, const uint8_t *value, size_t len)
+{
+    if (ch == BLE_CHAR_COMMAND) {
+        // Observers may write here to claim control; the batch reports NOT_CONTROLLER otherwise
+        handle_command_write(conn, value, len);
+        return ESP_OK;
+    } else if (ch == BLE_CHAR_LOG) {
+        // Any connection may download; only the controller may erase
+        return log_transfer_write(conn, value, len, controller_conn == conn);
+    } else if (ch == BLE_CHAR_OTA) {
+        // Only the bonded controller may update, and only with stimulation off
+        return ota_update_write(conn, value, len,
+                                controller_conn == conn && !dac_enabled && ble_transport_is_bonded(conn));
+    } else if (ch != BLE_CHAR_CONTROL) {
+        return ESP_OK;
+    } else if (controller_conn != conn) {
+        ESP_LOGW(GATTS_TAG, "Control write from observer %u rejected", conn);
+        return ESP_ERR_NOT_ALLOWED;
+    }
+
+    if (len == 1) {
+        handle_dac_write(value[0]);
+    } else if (len == 2) {
+        // Telemetry notification interval in ms, big endian
+        telemetry_set_interval_ms((value[0] << 8) | value[1]);
+    } else if (len == 4) {
+        handle_schedule_write(value);
+    } else if (len == 6) {
+        handle_filter_write(value);
+    }
+    return ESP_OK;
+}
+
+static const ble_transport_callbacks_t ble_callbacks = {
+    .on_connect = ble_on_connect,
+    .on_disconnect = ble_on_disconnect,
+    .on_mtu = ble_on_mtu,
+    .on_congest = ble_on_congest,
+    .on_subscribe = ble_on_subscribe,
+    .on_read = ble_on_read,
+    .on_write = ble_on_write,
+};
+
 #define DAC_AMPLITUDE 255
 _Static_assert(DAC_AMPLITUDE < 256, "DAC is 8-bit");
+// Command-to-output latency over one enabled period, logged when the DAC is disabled
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+} dac_latency_t;
+
+static void dac_latency_record(dac_latency_t *stats, int64_t command_us, int64_t written_us)
+{
+    uint32_t latency_us = (uint32_t)(written_us - command_us);
+    ESP_LOGD(TAG, "DAC command at %" PRId64 " us, written at %" PRId64 " us (+%" PRIu32 " us)",
+             command_us, written_us, latency_us);
+    stats->count++;
+    stats->total_us += latency_us;
+    if (latency_us > stats->max_us) {
+        stats->max_us = latency_us;
+    }
+}
+
+// Hand the DAC to the DMA with a freshly built waveform (or the dithered level when
+// `wave` is NULL), from the oneshot driver or from whatever the DMA played before. The
+// oneshot channel is released first: the drivers cannot share it, and the pad is
+// undriven for the few microseconds in between.
+static esp_err_t dac_dma_play(dac_oneshot_handle_t *oneshot, const dac_wave_t *wave, uint32_t gain_q16, int32_t level_q8)
+{
+    if (*oneshot) {
+        ESP_ERROR_CHECK(dac_oneshot_del_channel(*oneshot));
+        *oneshot = NULL;
+    }
+    waveform_dac_stop();
+    waveform_config_t config = {
+        .shape = WAVEFORM_LEVEL,
+        .sample_rate_hz = DAC_DITHER_RATE_HZ,
+        .sigma_delta = true,
+    };
+    if (wave) {
+        config = (waveform_config_t){
+            .shape = wave->shape,
+            .freq_dhz = wave->freq_dhz,
+            .amplitude_ua = wave->amplitude_ua,
+            .offset_ua = wave->offset_ua,
+            .sample_rate_hz = DAC_WAVE_SAMPLE_RATE_HZ,
+            .drive_offset_q8 = dac_ctrl_config.ff_offset_q8,
+            .drive_gain_q16 = dac_ctrl_config.ff_gain_q16,
+        };
+    }
+    if (!waveform_init(&dac_waveform, &config)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    waveform_set_gain(&dac_waveform, gain_q16);
+    waveform_set_level(&dac_waveform, level_q8);
+    return waveform_dac_start(DAC_CHAN_0, config.sample_rate_hz, 255, &dac_waveform);
+}
+
 static void dac_output_task(void *args)
 {
     dac_oneshot_handle_t handle = (dac_oneshot_handle_t)args;
+    const dac_oneshot_config_t chan_cfg = {.chan_id = DAC_CHAN_0};
+    uint32_t reported_faults = 0;
+    bool was_enabled = false;
+    bool ctrl_running = false;
+    uint32_t ctrl_seq = 0;      // Next sampler frame the loop has not looked at
+    dac_dma_mode_t dma_playing = DAC_DMA_OFF;
+    uint32_t wave_playing_gen = 0;
+    int32_t drive_q8 = 0;       // Dithered level: the PI output, or the open-loop code
+    dac_latency_t latency = {0};
+    const esp_timer_create_args_t timer_args = {
+        .callback = dac_ctrl_timer_cb,
+        .name = "dac_ctrl",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &dac_ctrl_timer));
+    // The tuning is fixed at build time; a bad one must not get as far as a session
+    ESP_ERROR_CHECK(current_ctrl_init(&dac_ctrl, &dac_ctrl_config) ? ESP_OK : ESP_ERR_INVALID_ARG);
     while (1) {
-        if (dac_enabled) {
+        portENTER_CRITICAL(&dac_lock);
+        int64_t now = esp_timer_get_time();
+        bool wave = dac_enabled && dac_wave.shape;
+        bool closed_loop = dac_enabled && dac_closed_loop && !wave;
+        uint32_t wave_gain = wave ? dac_wave_gain_value(now) : 0;
+        if (closed_loop) {
+            dac_setpoint_ua = dac_setpoint_value(now);
+        } else if (dac_enabled && !wave) {
+            dac_out_val = dac_ramp_value(now);
+        }
+        bool ramping = wave ? wave_gain < WAVEFORM_GAIN_ONE :
+                       dac_enabled && !closed_loop && dac_out_val != dac_target_val;
+        dac_wave_t wave_cfg = dac_wave;
+        uint32_t wave_gen = dac_wave_gen;
+        dac_dma_mode_t dma = wave ? DAC_DMA_WAVE : dac_enabled && dac_dither ? DAC_DMA_DITHER : DAC_DMA_OFF;
+        bool tick = dac_ctrl_tick;
+        dac_ctrl_tick = false;
+        uint16_t setpoint_ua = dac_setpoint_ua;
+        uint8_t out_val = dac_out_val;
+        int64_t command_us = dac_command_us;
+        dac_command_us = 0;
+        portEXIT_CRITICAL(&dac_lock);
+
+        if (closed_loop && !ctrl_running) {
+            // Bumpless: carry on from the code the output holds now
+            drive_q8 = (int32_t)(255 - out_val) << 8;
+            current_ctrl_hold(&dac_ctrl, drive_q8);
+            adc_frame_t latest;
+            ctrl_seq = adc_sampler_get_latest(&latest) ? latest.seq + 1 : 0;
+            ESP_ERROR_CHECK(esp_timer_start_periodic(dac_ctrl_timer, DAC_CTRL_PERIOD_US));
+            ctrl_running = true;
+        } else if (!closed_loop && ctrl_running) {
+            esp_timer_stop(dac_ctrl_timer);
+            current_ctrl_reset(&dac_ctrl);
+            ctrl_running = false;
+        }
+        if (closed_loop && tick) {
+            // Only timer ticks step the loop, so the PI gains see a fixed period. Only a
+            // shunt reading taken since the last tick counts: a failed read leaves the
+            // channel's bit clear in its frame, and a stalled bus adds no frames at all.
+            adc_frame_t frame, latest;
+            bool fresh = false;
+            while (adc_sampler_read_next(&ctrl_seq, &frame, NULL)) {
+                if (frame.updated_mask & (1u << ADC_CH_SHUNT)) {
+                    latest = frame;
+                    fresh = true;
+                }
+            }
+            drive_q8 = fresh ? current_ctrl_step(&dac_ctrl, setpoint_ua, frame_current_ua(&latest)) :
+                               current_ctrl_step_missing(&dac_ctrl, setpoint_ua);
+            if (current_ctrl_sensor_lost(&dac_ctrl)) {
+                ESP_LOGE(TAG, "No shunt reading for %d ms, DAC forced safe",
+                         DAC_CTRL_MAX_MISSED * DAC_CTRL_PERIOD_US / 1000);
+                force_dac_safe(FAULT_SENSOR);
+                continue;
+            }
+            uint8_t code = dac_drive_to_code(drive_q8);
+            portENTER_CRITICAL(&dac_lock);
+            if (dac_enabled) {
+                dac_out_val = code;
+            }
+            portEXIT_CRITICAL(&dac_lock);
+        }
+
+        if (!closed_loop) {
+            drive_q8 = (int32_t)(255 - out_val) << 8;
+        }
+        dac_wave_gain_q16 = wave_gain;
+
+        // Widen the watchdog window before the output goes up; narrow it once it is down
+        current_window_t window = current_window_for(drive_q8);
+        current_window_widen(&window);
+        if (dma != DAC_DMA_OFF && (dma != dma_playing || !waveform_dac_running() ||
+                                   (dma == DAC_DMA_WAVE && wave_gen != wave_playing_gen))) {
+            esp_err_t ret = dac_dma_play(&handle, dma == DAC_DMA_WAVE ? &wave_cfg : NULL, wave_gain, drive_q8);
+            dma_playing = dma;
+            wave_playing_gen = wave_gen;
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "DAC DMA output failed (%s), DAC disabled", esp_err_to_name(ret));
+                dac_request_t off = {.enable = 0};
+                dac_apply(&off);
+            }
+        }
+        if ((dma == DAC_DMA_OFF || !waveform_dac_running()) && !handle) {
+            // Back to the oneshot: the DMA lets go of the pad at 255 before it takes over
+            waveform_dac_stop();
+            dma_playing = DAC_DMA_OFF;
+            ESP_ERROR_CHECK(dac_oneshot_new_channel(&chan_cfg, &handle));
+        }
+
+        bool enabled = dac_enabled;
+        if (waveform_dac_running()) {
+            waveform_set_gain(&dac_waveform, wave_gain);
+            waveform_set_level(&dac_waveform, drive_q8);
+        } else if (enabled) {
             ESP_ERROR_CHECK(dac_oneshot_output_voltage(handle, dac_out_val));
+            // The watchdog may have tripped between the check and the write
+            if (!dac_enabled) {
+                ESP_ERROR_CHECK(dac_oneshot_output_voltage(handle, 255));
+            }
         } else {
             ESP_ERROR_CHECK(dac_oneshot_output_voltage(handle, 255));
         }
-        vTaskDelay(pdMS_TO_TICKS(500));
+        if (command_us) {
+            dac_latency_record(&latency, command_us, esp_timer_get_time());
+        }
+        current_window_set(&window);
+        // Fast link while the DAC is driving current (also drops back after a watchdog trip)
+        conn_profile_set(dac_enabled ? CONN_PROFILE_ACTIVE : CONN_PROFILE_IDLE);
+
+        if (fault_flags != reported_faults) {
+            reported_faults = fault_flags;
+            ESP_LOGW(TAG, "Fault, DAC forced safe (faults=0x%" PRIx32 ")", reported_faults);
+            adv_status_changed();
+            if (reported_faults) {
+                uint8_t faults = (uint8_t)reported_faults;
+                datalog_event(DATALOG_EVENT_FAULT, &faults, 1);
+                session_end(SESSION_END_FAULT);
+            }
+        }
+        if (was_enabled && !dac_enabled && latency.count) {
+            ESP_LOGI(TAG, "Command to DAC write: %" PRIu32 " commands, mean %" PRIu32 " us, max %" PRIu32 " us",
+                     latency.count, (uint32_t)(latency.total_us / latency.count), latency.max_us);
+            latency = (dac_latency_t){0};
+        }
+        was_enabled = enabled && dac_enabled;
+
+        // Commands, watchdog trips and control ticks wake the task; open-loop ramps step
+        // every DAC_RAMP_STEP_MS
+        ulTaskNotifyTake(pdTRUE, ramping ? pdMS_TO_TICKS(DAC_RAMP_STEP_MS) : portMAX_DELAY);
     }
 }
 
 void app_main(void)
 {
+    // Before the DAC task, which ends the session on a fault
+    ESP_ERROR_CHECK(session_init(&session_callbacks));
+
     dac_oneshot_handle_t chan0_handle;
     dac_oneshot_config_t chan0_cfg = {.chan_id = DAC_CHAN_0};
     ESP_ERROR_CHECK(dac_oneshot_new_channel(&chan0_cfg, &chan0_handle));
-    xTaskCreate(dac_output_task, "dac_output_task", 4096, chan0_handle, 5, NULL);
 
     ESP_ERROR_CHECK(i2c_master_init());
     ESP_ERROR_CHECK(ads1115_setup());
+    // After the ADS1115s are up: its first pass sets the current window on device 0
+    xTaskCreate(dac_output_task, "dac_output_task", 4096, chan0_handle, 5, &dac_task_handle);
+    ESP_ERROR_CHECK(adc_sampler_start(&ads1115_bus));
+    ESP_ERROR_CHECK(telemetry_start());
+    // Recording is optional: stimulation and streaming carry on without the log partition
+    if (datalog_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Session log unavailable");
+    }
+    uint8_t reset_reason = esp_reset_reason();
+    datalog_event(DATALOG_EVENT_BOOT, &reset_reason, 1);
+    ESP_ERROR_CHECK(log_transfer_start());
+    ESP_ERROR_CHECK(ota_update_start());
+    ESP_ERROR_CHECK(adv_status_start(read_device_status));
+
+#if CONFIG_FAULT_ADC_ENABLE
+    fault_adc_config_t fault_adc_cfg = {
+        .pos_channel = FAULT_ADC_POS_CHANNEL,
+        .neg_channel = FAULT_ADC_NEG_CHANNEL,
+        .sample_freq_hz = CONFIG_FAULT_ADC_SAMPLE_FREQ_HZ,
+        .frame_pairs = CONFIG_FAULT_ADC_FRAME_PAIRS,
+        .debounce_pairs = FAULT_ADC_DEBOUNCE,
+        .on_trip = fast_adc_trip,
+    };
+    // The ADS1115 window stays the primary watchdog, so run without the fast path on error
+    if (fault_adc_start(&fault_adc_cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "Fast fault ADC unavailable");
+    }
+#endif
 
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -328,34 +1240,11 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
-    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
-
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    ret = esp_bt_controller_init(&bt_cfg);
-    if (ret) {
-        ESP_LOGE(GATTS_TAG, "%s initialize controller failed: %s", __func__, esp_err_to_name(ret));
-        return;
-    }
-
-    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
-    if (ret) {
-        ESP_LOGE(GATTS_TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
-        return;
-    }
-
-    ret = esp_bluedroid_init();
-    if (ret) {
-        ESP_LOGE(GATTS_TAG, "%s init bluetooth failed: %s", __func__, esp_err_to_name(ret));
-        return;
-    }
-    ret = esp_bluedroid_enable();
-    if (ret) {
-        ESP_LOGE(GATTS_TAG, "%s enable bluetooth failed: %s", __func__, esp_err_to_name(ret));
-        return;
+    // The DAC task and current watchdog keep running without BLE
+    esp_err_t ble_ret = ble_transport_start(&ble_callbacks);
+    if (ble_ret != ESP_OK) {
+        ESP_LOGE(TAG, "BLE unavailable");
     }
-
-    ESP_ERROR_CHECK(esp_ble_gatts_register_callback(gatts_event_handler));
-    ESP_ERROR_CHECK(esp_ble_gap_register_callback(gap_event_handler));
-    ESP_ERROR_CHECK(esp_ble_gatts_app_register(PROFILE_A_APP_ID));
-    esp_ble_gatt_set_local_mtu(500);
+    // A freshly updated image that cannot bring up BLE could never be replaced, so roll back
+    ota_update_confirm(ble_ret == ESP_OK);
 }
@@ -0,0 +1,477 @@
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "ota_update.h"
+#include "ota_patch.h"
+#include "conn_profile.h"
+#include "ble_transport.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "miniz.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/stream_buffer.h"
+
+static const char *TAG = "OTA_UPDATE";
+
+#define OTA_UPDATE_DATA_HEADER      5
+#define OTA_UPDATE_CHUNK            1024
+#define OTA_UPDATE_ACK_BYTES        (OTA_UPDATE_WINDOW / 4)
+#define OTA_UPDATE_POLL_MS          100
+#define OTA_UPDATE_TIMEOUT_US       (10 * 1000 * 1000)
+#define OTA_UPDATE_REBOOT_DELAY_MS  1000    // Lets the result notification go out
+
+typedef enum {
+    OTA_STATE_IDLE,
+    OTA_STATE_STARTING,         // BEGIN accepted, the task is preparing the slot
+    OTA_STATE_RECEIVING,
+} ota_state_t;
+
+// Shared between the host task (writes) and the update task
+static struct {
+    portMUX_TYPE lock;
+    TaskHandle_t task;
+    StreamBufferHandle_t stream;    // Payload bytes on their way to the update task
+    bool notify[BLE_TRANSPORT_MAX_CONNS];
+    ota_state_t state;
+    uint8_t conn;
+    uint8_t header[OTA_UPDATE_HEADER_LEN];
+    uint32_t expected;          // Next payload offset from the client
+    bool resync_sent;
+    bool end_requested;
+    bool abort_requested;
+    bool overrun;
+    int64_t rx_us;
+} ota = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+// Update task only
+static struct {
+    ota_update_type_t type;
+    uint32_t image_size;
+    uint32_t payload_size;
+    const esp_partition_t *running;
+    const esp_partition_t *target;
+    esp_ota_handle_t handle;
+    tinfl_decompressor *inflator;
+    uint8_t *dict;
+    size_t dict_pos;
+    bool inflate_done;
+    ota_patch_t patch;
+    uint32_t written;
+    bool write_failed;
+} img;
+
+static uint32_t ota_be32(const uint8_t *in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+static void ota_put_be32(uint8_t *out, uint32_t v)
+{
+    out[0] = v >> 24;
+    out[1] = v >> 16;
+    out[2] = v >> 8;
+    out[3] = v;
+}
+
+static void ota_notify(uint8_t conn, const uint8_t *buf, size_t len)
+{
+    if (ota.notify[conn]) {
+        ble_transport_notify(conn, BLE_CHAR_OTA, buf, len);
+    }
+}
+
+static void ota_notify_offset(uint8_t conn, uint8_t op, uint32_t offset)
+{
+    uint8_t buf[5] = { op };
+    ota_put_be32(&buf[1], offset);
+    ota_notify(conn, buf, sizeof(buf));
+}
+
+static bool ota_write_image(void *ctx, const void *buf, size_t len)
+{
+    if (len > img.image_size - img.written) {
+        return false;               // Longer than the header said
+    }
+    if (esp_ota_write(img.handle, buf, len) != ESP_OK) {
+        img.write_failed = true;
+        return false;
+    }
+    img.written += len;
+    return true;
+}
+
+static bool ota_read_base(void *ctx, uint32_t offset, void *buf, size_t len)
+{
+    return esp_partition_read(img.running, offset, buf, len) == ESP_OK;
+}
+
+// Inflated bytes: the image itself, or delta ops
+static bool ota_emit(const uint8_t *buf, size_t len)
+{
+    if (img.type == OTA_UPDATE_TYPE_ZLIB_DELTA) {
+        return ota_patch_feed(&img.patch, buf, len);
+    }
+    return ota_write_image(NULL, buf, len);
+}
+
+static ota_update_status_t ota_inflate(const uint8_t *in, size_t len)
+{
+    if (img.inflate_done) {
+        return len ? OTA_UPDATE_ERR_DECODE : OTA_UPDATE_OK;   // Bytes after the end of the stream
+    }
+    while (1) {
+        size_t in_bytes = len;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - img.dict_pos;
+        tinfl_status st = tinfl_decompress(img.inflator, in, &in_bytes, img.dict, img.dict + img.dict_pos,
+                                           &out_bytes, TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        in += in_bytes;
+        len -= in_bytes;
+        if (out_bytes > 0) {
+            if (!ota_emit(img.dict + img.dict_pos, out_bytes)) {
+                return img.write_failed ? OTA_UPDATE_ERR_FLASH : OTA_UPDATE_ERR_DECODE;
+            }
+            // The dictionary is a ring; tinfl wraps its output position with it
+            img.dict_pos = (img.dict_pos + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+        if (st == TINFL_STATUS_DONE) {
+            img.inflate_done = true;
+            return len ? OTA_UPDATE_ERR_DECODE : OTA_UPDATE_OK;
+        }
+        if (st < 0) {
+            return OTA_UPDATE_ERR_DECODE;
+        }
+        if (st == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+            return OTA_UPDATE_OK;
+        }
+    }
+}
+
+static ota_update_status_t ota_process(const uint8_t *buf, size_t len)
+{
+    if (img.type == OTA_UPDATE_TYPE_RAW) {
+        if (!ota_write_image(NULL, buf, len)) {
+            return img.write_failed ? OTA_UPDATE_ERR_FLASH : OTA_UPDATE_ERR_DECODE;
+        }
+        return OTA_UPDATE_OK;
+    }
+    return ota_inflate(buf, len);
+}
+
+static void ota_free(void)
+{
+    free(img.inflator);
+    free(img.dict);
+    img.inflator = NULL;
+    img.dict = NULL;
+}
+
+static ota_update_status_t ota_begin_image(const uint8_t *header)
+{
+    memset(&img, 0, sizeof(img));
+    img.type = header[5];
+    img.image_size = ota_be32(&header[8]);
+    img.payload_size = ota_be32(&header[12]);
+    img.running = esp_ota_get_running_partition();
+    img.target = esp_ota_get_next_update_partition(NULL);
+    if (!img.target) {
+        ESP_LOGE(TAG, "No OTA slot in the partition table");
+        return OTA_UPDATE_ERR_FLASH;
+    }
+    if (img.image_size > img.target->size) {
+        return OTA_UPDATE_ERR_TOO_LARGE;
+    }
+
+    if (img.type == OTA_UPDATE_TYPE_ZLIB_DELTA) {
+        uint8_t digest[32];
+        if (esp_partition_get_sha256(img.running, digest) != ESP_OK || memcmp(digest, &header[16], sizeof(digest)) != 0) {
+            return OTA_UPDATE_ERR_WRONG_BASE;
+        }
+        ota_patch_io_t io = {
+            .read_base = ota_read_base,
+            .write = ota_write_image,
+            .base_size = img.running->size,
+        };
+        ota_patch_init(&img.patch, &io);
+    }
+    if (img.type != OTA_UPDATE_TYPE_RAW) {
+        // About 43 KB, only for the length of the update
+        img.inflator = malloc(sizeof(tinfl_decompressor));
+        img.dict = malloc(TINFL_LZ_DICT_SIZE);
+        if (!img.inflator || !img.dict) {
+            return OTA_UPDATE_ERR_TOO_LARGE;
+        }
+        tinfl_init(img.inflator);
+    }
+
+    // Sequential writes erase sector by sector as the image arrives instead of all up front
+    if (esp_ota_begin(img.target, OTA_WITH_SEQUENTIAL_WRITES, &img.handle) != ESP_OK) {
+        return OTA_UPDATE_ERR_FLASH;
+    }
+    ESP_LOGI(TAG, "Updating %s: type %d, %" PRIu32 " byte payload, %" PRIu32 " byte image",
+             img.target->label, img.type, img.payload_size, img.image_size);
+    return OTA_UPDATE_OK;
+}
+
+static ota_update_status_t ota_finish_image(uint32_t received)
+{
+    bool complete = received == img.payload_size && img.written == img.image_size &&
+                    (img.type == OTA_UPDATE_TYPE_RAW || img.inflate_done) &&
+                    (img.type != OTA_UPDATE_TYPE_ZLIB_DELTA || ota_patch_complete(&img.patch));
+    if (!complete) {
+        return OTA_UPDATE_ERR_DECODE;
+    }
+    // Checks the image header, segments and appended SHA-256
+    esp_err_t ret = esp_ota_end(img.handle);
+    img.handle = 0;
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Image rejected: %s", esp_err_to_name(ret));
+        return OTA_UPDATE_ERR_VERIFY;
+    }
+    if (esp_ota_set_boot_partition(img.target) != ESP_OK) {
+        return OTA_UPDATE_ERR_FLASH;
+    }
+    return OTA_UPDATE_OK;
+}
+
+// Feed payload to flash until it is all there, the client gives up or something fails
+static ota_update_status_t ota_receive(uint8_t conn, uint32_t *received)
+{
+    static uint8_t buf[OTA_UPDATE_CHUNK];
+    uint32_t acked = 0;
+
+    while (1) {
+        size_t n = xStreamBufferReceive(ota.stream, buf, sizeof(buf), pdMS_TO_TICKS(OTA_UPDATE_POLL_MS));
+        if (n > 0) {
+            ota_update_status_t status = ota_process(buf, n);
+            if (status != OTA_UPDATE_OK) {
+                return status;
+            }
+            *received += n;
+            if (*received - acked >= OTA_UPDATE_ACK_BYTES) {
+                acked = *received;
+                ota_notify_offset(conn, OTA_UPDATE_ACK, acked);
+            }
+            continue;
+        }
+
+        portENTER_CRITICAL(&ota.lock);
+        bool aborted = ota.abort_requested;
+        bool overrun = ota.overrun;
+        bool done = ota.end_requested && ota.expected == *received;
+        bool idle = esp_timer_get_time() - ota.rx_us > OTA_UPDATE_TIMEOUT_US;
+        portEXIT_CRITICAL(&ota.lock);
+        if (aborted) {
+            return OTA_UPDATE_ERR_ABORTED;
+        } else if (overrun) {
+            return OTA_UPDATE_ERR_MALFORMED;   // Sent beyond the window
+        } else if (done) {
+            return ota_finish_image(*received);
+        } else if (idle) {
+            return OTA_UPDATE_ERR_TIMEOUT;
+        }
+    }
+}
+
+static void ota_update_task(void *args)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        portENTER_CRITICAL(&ota.lock);
+        bool starting = ota.state == OTA_STATE_STARTING;
+        uint8_t conn = ota.conn;
+        uint8_t header[OTA_UPDATE_HEADER_LEN];
+        memcpy(header, ota.header, sizeof(header));
+        portEXIT_CRITICAL(&ota.lock);
+        if (!starting) {
+            continue;
+        }
+
+        // A fast link for the transfer; every write below stalls code running from flash
+        conn_profile_hold_active(CONN_PROFILE_HOLD_OTA, true);
+        int64_t start_us = esp_timer_get_time();
+        uint32_t received = 0;
+        ota_update_status_t status = ota_begin_image(header);
+        if (status == OTA_UPDATE_OK) {
+            xStreamBufferReset(ota.stream);
+            portENTER_CRITICAL(&ota.lock);
+            ota.state = OTA_STATE_RECEIVING;
+            ota.rx_us = esp_timer_get_time();
+            portEXIT_CRITICAL(&ota.lock);
+            uint8_t ready[5] = { OTA_UPDATE_READY };
+            ota_put_be32(&ready[1], OTA_UPDATE_WINDOW);
+            ota_notify(conn, ready, sizeof(ready));
+            start_us = esp_timer_get_time();
+            status = ota_receive(conn, &received);
+        }
+
+        if (status != OTA_UPDATE_OK && img.handle) {
+            esp_ota_abort(img.handle);
+        }
+        ota_free();
+        uint32_t elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+        uint8_t result[6] = { OTA_UPDATE_RESULT, status };
+        ota_put_be32(&result[2], elapsed_ms);
+        ota_notify(conn, result, sizeof(result));
+
+        portENTER_CRITICAL(&ota.lock);
+        ota.state = OTA_STATE_IDLE;
+        portEXIT_CRITICAL(&ota.lock);
+        conn_profile_hold_active(CONN_PROFILE_HOLD_OTA, false);
+
+        if (status != OTA_UPDATE_OK) {
+            ESP_LOGW(TAG, "Update failed: status %d after %" PRIu32 " of %" PRIu32 " payload bytes",
+                     status, received, img.payload_size);
+            continue;
+        }
+        uint32_t ms = elapsed_ms ? elapsed_ms : 1;
+        ESP_LOGI(TAG, "Update written: %" PRIu32 " payload bytes in %" PRIu32 " ms (%" PRIu32 " B/s, "
+                 "%" PRIu32 " B/s of image); rebooting", received, elapsed_ms,
+                 (uint32_t)((uint64_t)received * 1000 / ms), (uint32_t)((uint64_t)img.image_size * 1000 / ms));
+        vTaskDelay(pdMS_TO_TICKS(OTA_UPDATE_REBOOT_DELAY_MS));
+        esp_restart();
+    }
+}
+
+esp_err_t ota_update_start(void)
+{
+    ota.stream = xStreamBufferCreate(OTA_UPDATE_WINDOW, 1);
+    if (!ota.stream) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Below telemetry: the update yields to live data and the sampler
+    if (xTaskCreate(ota_update_task, "ota_update_task", 4096, NULL, 2, &ota.task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void ota_update_confirm(bool healthy)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+        return;
+    }
+    if (healthy) {
+        ESP_LOGI(TAG, "First boot of %s, image confirmed", running->label);
+        esp_ota_mark_app_valid_cancel_rollback();
+    } else {
+        ESP_LOGE(TAG, "First boot of %s failed its checks, rolling back", running->label);
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+}
+
+bool ota_update_in_progress(void)
+{
+    portENTER_CRITICAL(&ota.lock);
+    bool active = ota.state != OTA_STATE_IDLE;
+    portEXIT_CRITICAL(&ota.lock);
+    return active;
+}
+
+void ota_update_disconnect(uint8_t conn)
+{
+    ota.notify[conn] = false;
+    portENTER_CRITICAL(&ota.lock);
+    if (ota.state != OTA_STATE_IDLE && ota.conn == conn) {
+        ota.abort_requested = true;
+    }
+    portEXIT_CRITICAL(&ota.lock);
+}
+
+void ota_update_set_notify(uint8_t conn, bool enabled)
+{
+    ota.notify[conn] = enabled;
+}
+
+static esp_err_t ota_update_begin(uint8_t conn, const uint8_t *header, size_t len, bool allowed)
+{
+    if (len != OTA_UPDATE_HEADER_LEN || ota_be32(header) != OTA_UPDATE_MAGIC ||
+        header[4] != OTA_UPDATE_VERSION || header[5] > OTA_UPDATE_TYPE_ZLIB_DELTA) {
+        uint8_t result[6] = { OTA_UPDATE_RESULT, OTA_UPDATE_ERR_MALFORMED };
+        ota_notify(conn, result, sizeof(result));
+        return ESP_OK;
+    }
+
+    portENTER_CRITICAL(&ota.lock);
+    bool busy = ota.state != OTA_STATE_IDLE;
+    if (allowed && !busy) {
+        ota.state = OTA_STATE_STARTING;
+        ota.conn = conn;
+        memcpy(ota.header, header, OTA_UPDATE_HEADER_LEN);
+        ota.expected = 0;
+        ota.resync_sent = false;
+        ota.end_requested = false;
+        ota.abort_requested = false;
+        ota.overrun = false;
+    }
+    portEXIT_CRITICAL(&ota.lock);
+
+    if (!allowed || busy) {
+        ESP_LOGW(TAG, "Update from connection %u rejected (%s)", conn, busy ? "busy" : "not allowed");
+        uint8_t result[6] = { OTA_UPDATE_RESULT, OTA_UPDATE_ERR_NOT_ALLOWED };
+        ota_notify(conn, result, sizeof(result));
+        return ESP_ERR_NOT_ALLOWED;
+    }
+    xTaskNotifyGive(ota.task);
+    return ESP_OK;
+}
+
+static void ota_update_data(uint8_t conn, const uint8_t *data, size_t len)
+{
+    uint32_t offset = ota_be32(data);
+
+    portENTER_CRITICAL(&ota.lock);
+    bool receiving = ota.state == OTA_STATE_RECEIVING && ota.conn == conn;
+    bool in_order = offset == ota.expected;
+    bool resync = receiving && !in_order && !ota.resync_sent;
+    uint32_t expected = ota.expected;
+    if (resync) {
+        ota.resync_sent = true;
+    }
+    portEXIT_CRITICAL(&ota.lock);
+
+    if (resync) {
+        // Once per gap; later writes of the same burst are dropped quietly
+        ota_notify_offset(conn, OTA_UPDATE_RESYNC, expected);
+    }
+    if (!receiving || !in_order) {
+        return;
+    }
+
+    // The window keeps the client within the buffer; a short send means it did not
+    size_t n = len - OTA_UPDATE_DATA_HEADER;
+    size_t sent = xStreamBufferSend(ota.stream, data + 4, n, 0);
+    portENTER_CRITICAL(&ota.lock);
+    ota.expected += sent;
+    ota.resync_sent = false;
+    ota.overrun |= sent != n;
+    ota.rx_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&ota.lock);
+}
+
+esp_err_t ota_update_write(uint8_t conn, const uint8_t *data, size_t len, bool allowed)
+{
+    uint8_t op = len > 0 ? data[0] : 0;
+
+    if (op == OTA_UPDATE_BEGIN) {
+        return ota_update_begin(conn, data + 1, len - 1, allowed);
+    } else if (op == OTA_UPDATE_DATA && len > OTA_UPDATE_DATA_HEADER) {
+        ota_update_data(conn, data + 1, len);
+    } else if (op == OTA_UPDATE_END || op == OTA_UPDATE_ABORT) {
+        portENTER_CRITICAL(&ota.lock);
+        if (ota.state != OTA_STATE_IDLE && ota.conn == conn) {
+            ota.end_requested |= op == OTA_UPDATE_END;
+            ota.abort_requested |= op == OTA_UPDATE_ABORT;
+        }
+        portEXIT_CRITICAL(&ota.lock);
+    }
+    return ESP_OK;
+}
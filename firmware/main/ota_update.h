@@ -0,0 +1,76 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Firmware update on the OTA characteristic (protocol in README). The image is written
+// to the inactive OTA slot as it arrives, optionally zlib-compressed and optionally a
+// delta against the running image (ota_patch). Images come from tools/ota_image.py.
+// A new image must confirm itself after boot or the bootloader rolls back.
+
+#define OTA_UPDATE_MAGIC            0x544F5441  // "TOTA"
+#define OTA_UPDATE_VERSION          1
+#define OTA_UPDATE_HEADER_LEN       48
+#define OTA_UPDATE_WINDOW           16384       // Unacknowledged payload bytes a client may send
+
+// Image header, big endian: magic, version, type, 2 reserved, image size u32, payload
+// size u32, base image SHA-256 (delta only; the digest esptool appends to the image)
+typedef enum {
+    OTA_UPDATE_TYPE_RAW = 0,
+    OTA_UPDATE_TYPE_ZLIB,
+    OTA_UPDATE_TYPE_ZLIB_DELTA,
+} ota_update_type_t;
+
+// Requests, written by the client
+#define OTA_UPDATE_BEGIN            0x01    // [image header]
+#define OTA_UPDATE_DATA             0x02    // [payload offset u32][payload bytes]
+#define OTA_UPDATE_END              0x03
+#define OTA_UPDATE_ABORT            0x04
+
+// Notifications
+#define OTA_UPDATE_READY            0x81    // [window u32]
+#define OTA_UPDATE_ACK              0x82    // [payload offset u32]: everything before it is on flash
+#define OTA_UPDATE_RESYNC           0x83    // [payload offset u32]: out of order, send again from here
+#define OTA_UPDATE_RESULT           0x84    // [ota_update_status_t][elapsed ms u32]
+
+typedef enum {
+    OTA_UPDATE_OK = 0,                  // Rebooting into the new image
+    OTA_UPDATE_ERR_MALFORMED,
+    OTA_UPDATE_ERR_NOT_ALLOWED,         // Not the controller, DAC enabled, or another update running
+    OTA_UPDATE_ERR_WRONG_BASE,          // Delta made against a different image than the running one
+    OTA_UPDATE_ERR_TOO_LARGE,
+    OTA_UPDATE_ERR_DECODE,              // Bad compressed stream or delta
+    OTA_UPDATE_ERR_FLASH,
+    OTA_UPDATE_ERR_VERIFY,              // Image checks failed after the last byte
+    OTA_UPDATE_ERR_TIMEOUT,
+    OTA_UPDATE_ERR_ABORTED,
+} ota_update_status_t;
+
+esp_err_t ota_update_start(void);
+
+// Call once the app has come up. A first boot of a new image is marked good when
+// `healthy`, otherwise the previous image is restored and the device reboots.
+void ota_update_confirm(bool healthy);
+
+// True from BEGIN until the update finishes or fails
+bool ota_update_in_progress(void);
+
+// From the BLE transport callbacks
+void ota_update_disconnect(uint8_t conn);
+void ota_update_set_notify(uint8_t conn, bool enabled);
+// `allowed`: the connection may start an update (bonded controller, DAC disabled). BEGIN
+// is rejected with ESP_ERR_NOT_ALLOWED otherwise.
+esp_err_t ota_update_write(uint8_t conn, const uint8_t *data, size_t len, bool allowed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_UPDATE_H
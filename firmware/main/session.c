@@ -0,0 +1,238 @@
+#include <inttypes.h>
+#include "session.h"
+#include "datalog.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "SESSION";
+
+#define SESSION_PROGRESS_US     (1000 * 1000)
+
+static const session_callbacks_t *callbacks;
+static esp_timer_handle_t phase_timer;      // Fires at the next phase boundary
+static esp_timer_handle_t progress_timer;
+// Timer callbacks, the host task and the DAC task all end up here; a mutex rather than a
+// critical section so the timers can be rearmed while holding it
+static SemaphoreHandle_t session_lock;
+
+// Under session_lock
+static session_phase_t phase;
+static session_end_t last_end;
+static session_end_t pending_end;           // Reported when the ramp down finishes
+static int64_t start_us;
+static int64_t end_us;                      // Ramp down complete; the timer is set to this
+static uint32_t duration_ms;
+static uint16_t target_ua;
+static uint16_t ramp_ms;
+
+static uint16_t session_u16(int64_t v)
+{
+    return v < 0 ? 0 : v > UINT16_MAX ? UINT16_MAX : (uint16_t)v;
+}
+
+size_t session_status_encode(const session_status_t *status, int32_t measured_ua, uint8_t *out)
+{
+    uint16_t elapsed = session_u16(status->elapsed_ms / 1000);
+    uint16_t duration = session_u16(status->duration_ms / 1000);
+    uint16_t measured = session_u16(measured_ua);
+    out[0] = status->phase;
+    out[1] = status->last_end;
+    out[2] = elapsed >> 8;
+    out[3] = elapsed & 0xFF;
+    out[4] = duration >> 8;
+    out[5] = duration & 0xFF;
+    out[6] = status->target_ua >> 8;
+    out[7] = status->target_ua & 0xFF;
+    out[8] = measured >> 8;
+    out[9] = measured & 0xFF;
+    return SESSION_STATUS_LEN;
+}
+
+static void session_status_locked(session_status_t *status, int64_t now_us)
+{
+    int64_t until = phase == SESSION_IDLE ? end_us : now_us;
+    status->phase = phase;
+    status->last_end = last_end;
+    status->elapsed_ms = until > start_us ? (until - start_us) / 1000 : 0;
+    status->duration_ms = duration_ms;
+    status->target_ua = target_ua;
+}
+
+static void session_report(void)
+{
+    session_status_t status;
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    session_status_locked(&status, esp_timer_get_time());
+    xSemaphoreGive(session_lock);
+    callbacks->on_status(&status);
+}
+
+// Enter the ramp down with the timer set for its end; call with session_lock held
+static void session_begin_ramp_down_locked(int64_t now_us, session_end_t end)
+{
+    phase = SESSION_RAMP_DOWN;
+    pending_end = end;
+    end_us = now_us + (int64_t)ramp_ms * 1000;
+    esp_timer_stop(phase_timer);
+    esp_timer_start_once(phase_timer, end_us - now_us);
+}
+
+static void session_phase_cb(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+    bool ramp_down = false;
+    bool finished = false;
+    bool changed = true;
+
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    if (phase == SESSION_RAMP_UP) {
+        phase = SESSION_HOLD;
+        int64_t hold_end_us = end_us - (int64_t)ramp_ms * 1000;
+        esp_timer_start_once(phase_timer, hold_end_us > now ? hold_end_us - now : 0);
+    } else if (phase == SESSION_HOLD) {
+        session_begin_ramp_down_locked(now, SESSION_END_COMPLETE);
+        ramp_down = true;
+    } else if (phase == SESSION_RAMP_DOWN) {
+        phase = SESSION_IDLE;
+        last_end = pending_end;
+        end_us = now;
+        esp_timer_stop(progress_timer);
+        finished = true;
+    } else {
+        changed = false;    // Ended by session_end() while this callback was waiting
+    }
+    uint16_t ramp = ramp_ms;
+    session_end_t end = last_end;
+    xSemaphoreGive(session_lock);
+
+    if (ramp_down) {
+        callbacks->set_target(0, ramp);
+    } else if (finished) {
+        callbacks->disable();
+        uint8_t reason = end;
+        datalog_event(DATALOG_EVENT_SESSION_END, &reason, 1);
+        ESP_LOGI(TAG, "Session ended (%d)", end);
+    }
+    if (changed) {
+        session_report();
+    }
+}
+
+static void session_progress_cb(void *arg)
+{
+    session_report();
+}
+
+esp_err_t session_init(const session_callbacks_t *cbs)
+{
+    callbacks = cbs;
+    session_lock = xSemaphoreCreateMutex();
+    if (!session_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    const esp_timer_create_args_t phase_args = {
+        .callback = session_phase_cb,
+        .name = "session_phase",
+    };
+    const esp_timer_create_args_t progress_args = {
+        .callback = session_progress_cb,
+        .name = "session_progress",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&phase_args, &phase_timer), TAG, "phase timer");
+    return esp_timer_create(&progress_args, &progress_timer);
+}
+
+esp_err_t session_start(uint16_t target, uint16_t ramp, uint16_t duration_s)
+{
+    uint32_t duration = (uint32_t)duration_s * 1000;
+    if (duration == 0 || 2 * (uint32_t)ramp > duration) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    phase = SESSION_RAMP_UP;
+    last_end = SESSION_END_NONE;
+    start_us = now;
+    end_us = now + (int64_t)duration * 1000;
+    duration_ms = duration;
+    target_ua = target;
+    ramp_ms = ramp;
+    esp_timer_stop(phase_timer);
+    esp_timer_stop(progress_timer);
+    // A zero-length ramp goes straight through to the hold
+    esp_timer_start_once(phase_timer, (uint64_t)ramp * 1000);
+    esp_timer_start_periodic(progress_timer, SESSION_PROGRESS_US);
+    xSemaphoreGive(session_lock);
+
+    ESP_LOGI(TAG, "Session: %u uA, %u ms ramps, %u s", target, ramp, duration_s);
+    uint8_t args[6] = { target >> 8, target & 0xFF, ramp >> 8, ramp & 0xFF, duration_s >> 8, duration_s & 0xFF };
+    datalog_event(DATALOG_EVENT_SESSION, args, sizeof(args));
+    callbacks->enable(target, ramp);
+    session_report();
+    return ESP_OK;
+}
+
+void session_stop(void)
+{
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    bool ramp_down = phase == SESSION_RAMP_UP || phase == SESSION_HOLD;
+    if (ramp_down) {
+        session_begin_ramp_down_locked(esp_timer_get_time(), SESSION_END_STOPPED);
+    }
+    uint16_t ramp = ramp_ms;
+    xSemaphoreGive(session_lock);
+
+    if (ramp_down) {
+        callbacks->set_target(0, ramp);
+        session_report();
+    }
+}
+
+void session_end(session_end_t reason)
+{
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    bool ended = phase != SESSION_IDLE;
+    if (ended) {
+        phase = SESSION_IDLE;
+        last_end = reason;
+        end_us = esp_timer_get_time();
+        esp_timer_stop(phase_timer);
+        esp_timer_stop(progress_timer);
+    }
+    xSemaphoreGive(session_lock);
+
+    if (ended) {
+        uint8_t arg = reason;
+        datalog_event(DATALOG_EVENT_SESSION_END, &arg, 1);
+        ESP_LOGW(TAG, "Session ended early (%d)", reason);
+        session_report();
+    }
+}
+
+void session_set_target(uint16_t target)
+{
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    if (phase == SESSION_RAMP_UP || phase == SESSION_HOLD) {
+        target_ua = target;
+    }
+    xSemaphoreGive(session_lock);
+}
+
+bool session_active(void)
+{
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    bool active = phase != SESSION_IDLE;
+    xSemaphoreGive(session_lock);
+    return active;
+}
+
+void session_get_status(session_status_t *status)
+{
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    session_status_locked(status, esp_timer_get_time());
+    xSemaphoreGive(session_lock);
+}
@@ -0,0 +1,74 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stimulation session run by the device from one command: ramp up to a closed-loop
+// current target, hold, ramp down and disable, timed by esp_timer so the phone and the
+// link are not needed once it has started. The output itself goes through callbacks.
+
+#define SESSION_STATUS_LEN      10      // Progress notification on the command characteristic
+
+typedef enum {
+    SESSION_IDLE = 0,
+    SESSION_RAMP_UP,
+    SESSION_HOLD,
+    SESSION_RAMP_DOWN,
+} session_phase_t;
+
+typedef enum {
+    SESSION_END_NONE = 0,       // Running, or no session since boot
+    SESSION_END_COMPLETE,
+    SESSION_END_STOPPED,        // Stop command: ramped down early
+    SESSION_END_OVERRIDDEN,     // A command disabled the DAC or set a DAC code
+    SESSION_END_FAULT,          // Current watchdog
+} session_end_t;
+
+typedef struct {
+    session_phase_t phase;
+    session_end_t last_end;     // How the last session ended
+    uint32_t elapsed_ms;        // Since the start, ramps included; frozen at the end
+    uint32_t duration_ms;
+    uint16_t target_ua;
+} session_status_t;
+
+typedef struct {
+    // From session_start(), in the caller's task: enable and ramp up from minimum current
+    void (*enable)(uint16_t target_ua, uint16_t ramp_ms);
+    // From the session timer: change the target without enabling
+    void (*set_target)(uint16_t target_ua, uint16_t ramp_ms);
+    void (*disable)(void);
+    // Every second while running, and on every phase change
+    void (*on_status)(const session_status_t *status);
+} session_callbacks_t;
+
+esp_err_t session_init(const session_callbacks_t *callbacks);
+
+// [phase, last end, elapsed s (2), duration s (2), target uA (2), measured uA (2)], big
+// endian; returns SESSION_STATUS_LEN
+size_t session_status_encode(const session_status_t *status, int32_t measured_ua, uint8_t *out);
+
+// Ramps take ramp_ms each and count toward duration_s. ESP_ERR_INVALID_ARG if both ramps
+// do not fit; a running session is replaced.
+esp_err_t session_start(uint16_t target_ua, uint16_t ramp_ms, uint16_t duration_s);
+// Ramp down now and end as stopped; nothing if idle or already ramping down
+void session_stop(void);
+// The output was changed from outside: end at once without touching it
+void session_end(session_end_t reason);
+// New hold target from a client; applied by the caller, recorded for the ramp down
+void session_set_target(uint16_t target_ua);
+bool session_active(void);
+void session_get_status(session_status_t *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SESSION_H
@@ -0,0 +1,338 @@
+#include <string.h>
+#include <inttypes.h>
+#include "telemetry.h"
+#include "ble_transport.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "TELEMETRY";
+
+_Static_assert(ADC_SAMPLER_NUM_CHANNELS <= 5, "Frame flags carry at most 5 channels");
+
+#define TELEMETRY_MTU_DEFAULT       23
+#define TELEMETRY_MAX_PAYLOAD       BLE_TRANSPORT_MAX_VALUE_LEN
+#define TELEMETRY_STATS_INTERVAL_US (10 * 1000 * 1000)
+#define TELEMETRY_CHANNEL_MASK      ((1u << ADC_SAMPLER_NUM_CHANNELS) - 1)
+
+typedef struct {
+    volatile bool connected;
+    volatile bool notify;
+    volatile bool congested;
+    volatile uint16_t mtu;
+} telemetry_link_t;
+
+typedef struct {
+    telemetry_link_t link[BLE_TRANSPORT_MAX_CONNS];
+    volatile uint16_t interval_ms;
+    // Telemetry task only
+    uint32_t notifications;
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t skipped;           // Notifications not sent to a congested connection
+    uint32_t send_errors;
+} telemetry_t;
+
+static telemetry_t telemetry = {
+    .interval_ms = TELEMETRY_INTERVAL_MS_DEFAULT,
+};
+
+size_t telemetry_encode_record(const adc_frame_t *frame, uint8_t *out)
+{
+    for (int ch = ADC_CH_A0; ch <= ADC_CH_SHUNT; ch++) {
+        out[ch * 2] = (frame->raw[ch] >> 8) & 0xFF;
+        out[ch * 2 + 1] = frame->raw[ch] & 0xFF;
+    }
+    // PGA index of the shunt reading (0 = +/-6.144 V ... 5 = +/-0.256 V)
+    out[10] = frame->gain[ADC_CH_SHUNT] >> 9;
+    return TELEMETRY_RECORD_LEN;
+}
+
+// Channel value as carried on the wire: A0-A3 raw codes at their fixed PGA, the
+// auto-ranged shunt in units of the +/-0.256 V LSB so PGA switches do not break deltas
+static int32_t telemetry_channel_value(const adc_frame_t *frame, int ch)
+{
+    if (ch != ADC_CH_SHUNT) {
+        return frame->raw[ch];
+    }
+    // The Q16 scale of each range over that of the narrowest one, by PGA index
+    static const int8_t lsb_ratio[ADS1115_PGA_INDEX_MAX + 1] = {24, 16, 8, 4, 2, 1};
+    return frame->raw[ch] * lsb_ratio[ads1115_pga_index(frame->gain[ch])];
+}
+
+static size_t telemetry_put_varint(uint8_t *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static size_t telemetry_put_svarint(uint8_t *out, int64_t v)
+{
+    // Zigzag so small negative deltas stay one byte
+    return telemetry_put_varint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static void telemetry_put_be(uint8_t *out, uint64_t v, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        out[i] = v & 0xFF;
+        v >>= 8;
+    }
+}
+
+void telemetry_encoder_begin(telemetry_encoder_t *enc, uint8_t *buf, size_t cap, uint8_t mask)
+{
+    memset(enc, 0, sizeof(*enc));
+    enc->buf = buf;
+    enc->cap = cap;
+    enc->mask = mask;
+    enc->len = TELEMETRY_HEADER_LEN;
+}
+
+bool telemetry_encoder_add(telemetry_encoder_t *enc, const adc_frame_t *frame)
+{
+    // Worst case: flags, gap, timestamp and 5 channel varints
+    uint8_t tmp[1 + 5 + 10 + ADC_SAMPLER_NUM_CHANNELS * 5];
+    size_t n = 0;
+
+    if (enc->count == TELEMETRY_MAX_FRAMES) {
+        return false;
+    }
+
+    if (enc->count == 0) {
+        // First frame: header carries seq and timestamp, values are absolute
+        for (int ch = 0; ch < ADC_SAMPLER_NUM_CHANNELS; ch++) {
+            if (enc->mask & (1u << ch)) {
+                enc->last[ch] = telemetry_channel_value(frame, ch);
+                n += telemetry_put_svarint(&tmp[n], enc->last[ch]);
+            }
+        }
+    } else {
+        uint32_t gap = frame->seq - enc->last_seq;
+        uint8_t updated = frame->updated_mask & enc->mask;
+        uint8_t gap_field = gap - 1 < TELEMETRY_SEQ_GAP_ESCAPE ? gap - 1 : TELEMETRY_SEQ_GAP_ESCAPE;
+        tmp[n++] = updated | (gap_field << 5);
+        if (gap_field == TELEMETRY_SEQ_GAP_ESCAPE) {
+            n += telemetry_put_varint(&tmp[n], gap);
+        }
+
+        // Scan periods are regular, so code the change in period rather than the period
+        int64_t dt = frame->timestamp_us - enc->last_ts;
+        n += telemetry_put_svarint(&tmp[n], dt - enc->last_dt);
+        enc->last_dt = dt;
+
+        for (int ch = 0; ch < ADC_SAMPLER_NUM_CHANNELS; ch++) {
+            if (updated & (1u << ch)) {
+                int32_t v = telemetry_channel_value(frame, ch);
+                n += telemetry_put_svarint(&tmp[n], (int64_t)v - enc->last[ch]);
+                enc->last[ch] = v;
+            }
+        }
+    }
+
+    if (enc->len + n > enc->cap) {
+        return false;
+    }
+    if (enc->count == 0) {
+        enc->buf[0] = TELEMETRY_VERSION;
+        enc->buf[1] = enc->mask;
+        telemetry_put_be(&enc->buf[2], frame->seq, 4);
+        telemetry_put_be(&enc->buf[6], (uint64_t)frame->timestamp_us, 8);
+    }
+    memcpy(&enc->buf[enc->len], tmp, n);
+    enc->len += n;
+    enc->count++;
+    enc->last_seq = frame->seq;
+    enc->last_ts = frame->timestamp_us;
+    return true;
+}
+
+size_t telemetry_encoder_finish(telemetry_encoder_t *enc)
+{
+    if (enc->count == 0) {
+        return 0;
+    }
+    enc->buf[14] = enc->count;
+    return enc->len;
+}
+
+// Subscribed connections, and the payload that fits the smallest MTU among them
+static uint32_t telemetry_subscribers(size_t *payload)
+{
+    uint32_t mask = 0;
+    size_t min_payload = TELEMETRY_MAX_PAYLOAD;
+    for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+        telemetry_link_t *link = &telemetry.link[i];
+        if (link->connected && link->notify) {
+            mask |= 1u << i;
+            size_t p = link->mtu - BLE_TRANSPORT_ATT_HEADER_LEN;
+            min_payload = p < min_payload ? p : min_payload;
+        }
+    }
+    *payload = min_payload;
+    return mask;
+}
+
+// True while at least one subscriber can take more notifications
+static bool telemetry_any_ready(uint32_t subscribers)
+{
+    for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+        if ((subscribers & (1u << i)) && !telemetry.link[i].congested) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void telemetry_send(uint32_t subscribers, const uint8_t *buf, size_t len)
+{
+    // One encoded packet fans out to every subscriber; a congested connection misses
+    // it and sees the gap in sequence numbers as dropped frames
+    for (int i = 0; i < BLE_TRANSPORT_MAX_CONNS; i++) {
+        if (!(subscribers & (1u << i)) || !telemetry.link[i].notify) {
+            continue;
+        }
+        if (telemetry.link[i].congested) {
+            telemetry.skipped++;
+            continue;
+        }
+        esp_err_t ret = ble_transport_notify(i, BLE_CHAR_TELEMETRY, buf, len);
+        if (ret == ESP_OK) {
+            telemetry.notifications++;
+        } else {
+            telemetry.send_errors++;
+        }
+    }
+}
+
+static void telemetry_log_stats(void)
+{
+    if (telemetry.notifications == 0 && telemetry.dropped == 0 && telemetry.send_errors == 0) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "%" PRIu32 " notifications, %" PRIu32 " frames, %" PRIu32 " dropped, "
+             "%" PRIu32 " skipped (congested), %" PRIu32 " send errors",
+             telemetry.notifications, telemetry.frames, telemetry.dropped,
+             telemetry.skipped, telemetry.send_errors);
+    telemetry.notifications = 0;
+    telemetry.frames = 0;
+    telemetry.dropped = 0;
+    telemetry.skipped = 0;
+    telemetry.send_errors = 0;
+}
+
+static void telemetry_task(void *args)
+{
+    uint8_t buf[TELEMETRY_MAX_PAYLOAD];
+    uint32_t seq = 0;
+    bool synced = false;
+    int64_t last_stats_us = esp_timer_get_time();
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(telemetry.interval_ms));
+
+        size_t payload;
+        uint32_t subscribers = telemetry_subscribers(&payload);
+        if (!subscribers) {
+            synced = false;
+            continue;
+        }
+
+        adc_frame_t frame;
+        if (!synced) {
+            // Start streaming from now rather than replaying the ring
+            if (adc_sampler_get_latest(&frame)) {
+                seq = frame.seq + 1;
+                synced = true;
+            }
+            continue;
+        }
+
+        // The host stack queues notifications internally; stop adding while every link is
+        // congested and let the sampler ring absorb the backlog (counted as dropped if it laps)
+        if (!telemetry_any_ready(subscribers)) {
+            continue;
+        }
+
+        telemetry_encoder_t enc;
+        telemetry_encoder_begin(&enc, buf, payload, TELEMETRY_CHANNEL_MASK);
+
+        while (adc_sampler_read_next(&seq, &frame, &telemetry.dropped)) {
+            if (!telemetry_encoder_add(&enc, &frame)) {
+                telemetry_send(subscribers, buf, telemetry_encoder_finish(&enc));
+                telemetry_encoder_begin(&enc, buf, payload, TELEMETRY_CHANNEL_MASK);
+                if (!telemetry_encoder_add(&enc, &frame)) {
+                    telemetry.dropped++;  // MTU too small for even one frame
+                    continue;
+                }
+            }
+            telemetry.frames++;
+            if (!telemetry_any_ready(subscribers)) {
+                break;
+            }
+        }
+        size_t len = telemetry_encoder_finish(&enc);
+        if (len > 0) {
+            telemetry_send(subscribers, buf, len);
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - last_stats_us >= TELEMETRY_STATS_INTERVAL_US) {
+            telemetry_log_stats();
+            last_stats_us = now;
+        }
+    }
+}
+
+esp_err_t telemetry_start(void)
+{
+    // Below the sampler: streaming must never delay acquisition
+    if (xTaskCreate(telemetry_task, "telemetry_task", 4096, NULL, 3, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void telemetry_connect(uint8_t conn)
+{
+    telemetry_link_t *link = &telemetry.link[conn];
+    link->mtu = TELEMETRY_MTU_DEFAULT;
+    link->notify = false;
+    link->congested = false;
+    link->connected = true;
+}
+
+void telemetry_disconnect(uint8_t conn)
+{
+    telemetry.link[conn].connected = false;
+    telemetry.link[conn].notify = false;
+}
+
+void telemetry_set_mtu(uint8_t conn, uint16_t mtu)
+{
+    telemetry.link[conn].mtu = mtu < TELEMETRY_MTU_DEFAULT ? TELEMETRY_MTU_DEFAULT : mtu;
+}
+
+void telemetry_set_notify(uint8_t conn, bool enabled)
+{
+    telemetry.link[conn].notify = enabled;
+    ESP_LOGI(TAG, "Notifications %s on connection %u (MTU %u)", enabled ? "on" : "off",
+             conn, telemetry.link[conn].mtu);
+}
+
+void telemetry_set_congested(uint8_t conn, bool congested)
+{
+    telemetry.link[conn].congested = congested;
+}
+
+void telemetry_set_interval_ms(uint16_t interval_ms)
+{
+    telemetry.interval_ms = interval_ms < TELEMETRY_INTERVAL_MS_MIN ? TELEMETRY_INTERVAL_MS_MIN : interval_ms;
+}
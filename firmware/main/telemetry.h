@@ -0,0 +1,60 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "adc_sampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One scan of device 0: A0-A3 and the shunt as big-endian raw codes, then the shunt PGA index
+#define TELEMETRY_RECORD_LEN            11
+
+// Framed notification format (see README): header, one absolute frame, then delta frames
+#define TELEMETRY_VERSION               1
+#define TELEMETRY_HEADER_LEN            15
+#define TELEMETRY_MAX_FRAMES            255
+#define TELEMETRY_SEQ_GAP_ESCAPE        7   // Flags value meaning "gap follows as a varint"
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    uint8_t count;
+    uint8_t mask;               // Channels carried, bit n = ADC_CH_n of device 0
+    uint32_t last_seq;
+    int64_t last_ts;
+    int64_t last_dt;
+    int32_t last[ADC_SAMPLER_NUM_CHANNELS];
+} telemetry_encoder_t;
+#define TELEMETRY_INTERVAL_MS_DEFAULT   100
+#define TELEMETRY_INTERVAL_MS_MIN       10
+
+// Batches sampler frames into notifications on the telemetry characteristic
+esp_err_t telemetry_start(void);
+size_t telemetry_encode_record(const adc_frame_t *frame, uint8_t *out);
+
+void telemetry_encoder_begin(telemetry_encoder_t *enc, uint8_t *buf, size_t cap, uint8_t mask);
+// False (and nothing written) if the frame does not fit; finish and start a new notification
+bool telemetry_encoder_add(telemetry_encoder_t *enc, const adc_frame_t *frame);
+// Returns the notification length, 0 if no frames were added
+size_t telemetry_encoder_finish(telemetry_encoder_t *enc);
+
+// Per-connection link state, driven from the BLE transport callbacks. Every subscribed
+// connection gets the same notifications, encoded once from the sampler ring.
+void telemetry_connect(uint8_t conn);
+void telemetry_disconnect(uint8_t conn);
+void telemetry_set_mtu(uint8_t conn, uint16_t mtu);
+void telemetry_set_notify(uint8_t conn, bool enabled);
+void telemetry_set_congested(uint8_t conn, bool congested);
+void telemetry_set_interval_ms(uint16_t interval_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Build and upload opentDCS firmware update images (see "Firmware Update" in README.md).
+
+    ota_image.py pack build/firmware.bin -o update.tota
+    ota_image.py pack build/firmware.bin --base old/firmware.bin -o update.tota
+    ota_image.py upload update.tota --address AA:BB:CC:DD:EE:FF
+
+A delta (--base) only applies to a device running exactly that base image. Uploading
+needs the bleak package (pip install bleak); packing needs nothing beyond Python 3.
+"""
+
+import argparse
+import asyncio
+import hashlib
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = 0x544F5441          # "TOTA"
+VERSION = 1
+TYPE_RAW, TYPE_ZLIB, TYPE_ZLIB_DELTA = 0, 1, 2
+HEADER = struct.Struct(">IBBxxII32s")
+
+OP_COPY = 0x01
+OP_INSERT = 0x02
+MIN_MATCH = 32              # Shorter matches cost more as ops than as literals
+BLOCK_STRIDE = 16
+
+OTA_UUID = "0000ff05-0000-1000-8000-00805f9b34fb"
+COMMAND_UUID = "0000ff03-0000-1000-8000-00805f9b34fb"
+
+STATUS = [
+    "ok", "malformed", "not allowed (bond, claim control and disable the DAC first)",
+    "delta base is not the running image", "image too large", "decode error",
+    "flash error", "image verification failed", "timeout", "aborted",
+]
+
+
+def image_digest(image):
+    # esptool appends the SHA-256 of the image when header byte 23 is set; the device
+    # reports that digest for the running partition. It follows the segments and the
+    # checksum, padded to 16 bytes; a signature block, if any, comes after it.
+    if len(image) < 24 + 32 or image[0] != 0xE9 or not image[23]:
+        sys.exit("base is not an ESP32 app image with an appended SHA-256")
+    pos = 24
+    for _ in range(image[1]):
+        (length,) = struct.unpack_from("<I", image, pos + 4)
+        pos += 8 + length
+    pos = (pos | 15) + 1
+    if pos + 32 > len(image):
+        sys.exit("base image is truncated")
+    return image[pos:pos + 32]
+
+
+def make_delta(new, base):
+    index = {}
+    for j in range(0, len(base) - MIN_MATCH + 1, BLOCK_STRIDE):
+        index.setdefault(base[j:j + MIN_MATCH], j)
+
+    ops = []
+    literal_start = 0
+    i = 0
+    while i <= len(new) - MIN_MATCH:
+        j = index.get(new[i:i + MIN_MATCH])
+        if j is None:
+            i += 1
+            continue
+        # Grow the match both ways, backwards only into pending literals
+        start, src = i, j
+        while start > literal_start and src > 0 and new[start - 1] == base[src - 1]:
+            start -= 1
+            src -= 1
+        end = i + MIN_MATCH
+        while end < len(new) and src + (end - start) < len(base) and new[end] == base[src + (end - start)]:
+            end += 1
+        if start > literal_start:
+            ops.append(struct.pack(">BI", OP_INSERT, start - literal_start) + new[literal_start:start])
+        ops.append(struct.pack(">BII", OP_COPY, src, end - start))
+        literal_start = i = end
+    if literal_start < len(new):
+        ops.append(struct.pack(">BI", OP_INSERT, len(new) - literal_start) + new[literal_start:])
+    return b"".join(ops)
+
+
+def apply_delta(patch, base):
+    out = bytearray()
+    pos = 0
+    while pos < len(patch):
+        op = patch[pos]
+        if op == OP_COPY:
+            src, length = struct.unpack_from(">II", patch, pos + 1)
+            out += base[src:src + length]
+            pos += 9
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from(">I", patch, pos + 1)
+            out += patch[pos + 5:pos + 5 + length]
+            pos += 5 + length
+        else:
+            raise ValueError("bad op at %d" % pos)
+    return bytes(out)
+
+
+def pack(args):
+    new = open(args.image, "rb").read()
+    if args.raw:
+        kind, payload, digest = TYPE_RAW, new, bytes(32)
+    elif args.base:
+        base = open(args.base, "rb").read()
+        digest = image_digest(base)
+        delta = make_delta(new, base)
+        if apply_delta(delta, base) != new:
+            sys.exit("internal error: delta does not rebuild the image")
+        kind, payload = TYPE_ZLIB_DELTA, zlib.compress(delta, 9)
+        print("delta: %d bytes before compression" % len(delta))
+    else:
+        kind, payload, digest = TYPE_ZLIB, zlib.compress(new, 9), bytes(32)
+
+    header = HEADER.pack(MAGIC, VERSION, kind, len(new), len(payload), digest)
+    with open(args.output, "wb") as f:
+        f.write(header + payload)
+    print("image %d bytes, payload %d bytes (%.1f%%), %s" %
+          (len(new), len(payload), 100.0 * len(payload) / len(new), ["raw", "zlib", "zlib delta"][kind]))
+
+
+async def upload(args):
+    try:
+        from bleak import BleakClient
+    except ImportError:
+        sys.exit("upload needs bleak: pip install bleak")
+
+    data = open(args.image, "rb").read()
+    header, payload = data[:HEADER.size], data[HEADER.size:]
+    if len(payload) != HEADER.unpack(header)[4]:
+        sys.exit("payload size does not match the header")
+
+    events = asyncio.Queue()
+
+    def on_notify(_, value):
+        events.put_nowait(bytes(value))
+
+    async with BleakClient(args.address) as client:
+        # Updates need a bonded link. macOS has no pairing call; it pairs when the claim
+        # below is refused for want of encryption, then retries it.
+        try:
+            await client.pair()
+        except NotImplementedError:
+            pass
+        await client.start_notify(OTA_UUID, on_notify)
+        # Claim control; the device also refuses while the DAC is enabled
+        await client.write_gatt_char(COMMAND_UUID, bytes([0, 0x08, 0]), response=True)
+        await client.write_gatt_char(OTA_UUID, bytes([0x01]) + header, response=True)
+
+        window = None
+        while window is None:
+            msg = await asyncio.wait_for(events.get(), 30)
+            if msg[0] == 0x81:
+                (window,) = struct.unpack_from(">I", msg, 1)
+            elif msg[0] == 0x84:
+                sys.exit("rejected: %s" % STATUS[msg[1]])
+
+        chunk = min(client.mtu_size - 3, 500) - 5
+        start = time.monotonic()
+        sent = acked = 0
+        while True:
+            while sent < len(payload) and sent - acked < window:
+                piece = payload[sent:sent + min(chunk, window - (sent - acked))]
+                await client.write_gatt_char(OTA_UUID, struct.pack(">BI", 0x02, sent) + piece, response=False)
+                sent += len(piece)
+            if sent == len(payload) and acked < sent:
+                await client.write_gatt_char(OTA_UUID, bytes([0x03]), response=True)
+                acked = sent    # Only the result is left to wait for
+            try:
+                msg = await asyncio.wait_for(events.get(), 15)
+            except asyncio.TimeoutError:
+                sys.exit("no response from the device")
+            if msg[0] == 0x82:
+                (acked,) = struct.unpack_from(">I", msg, 1)
+                print("\r%d / %d bytes" % (acked, len(payload)), end="", flush=True)
+            elif msg[0] == 0x83:
+                (acked,) = struct.unpack_from(">I", msg, 1)
+                sent = acked
+            elif msg[0] == 0x84:
+                status, elapsed_ms = msg[1], struct.unpack_from(">I", msg, 2)[0]
+                break
+
+        seconds = time.monotonic() - start
+        print()
+        if status != 0:
+            sys.exit("update failed: %s" % STATUS[status])
+        print("done: %d payload bytes in %.1f s (%.1f KB/s; device %.1f s), %d byte image, rebooting" %
+              (len(payload), seconds, len(payload) / seconds / 1024, elapsed_ms / 1000.0,
+               HEADER.unpack(header)[3]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    p = sub.add_parser("pack", help="build an update image from an app .bin")
+    p.add_argument("image", help="new app image (build/<project>.bin)")
+    p.add_argument("--base", help="app image the device is running, for a delta")
+    p.add_argument("--raw", action="store_true", help="no compression")
+    p.add_argument("-o", "--output", required=True)
+    u = sub.add_parser("upload", help="send an update image over BLE")
+    u.add_argument("image")
+    u.add_argument("--address", required=True, help="device address (UUID on macOS)")
+    args = parser.parse_args()
+
+    if args.command == "pack":
+        pack(args)
+    else:
+        asyncio.run(upload(args))
+
+
+if __name__ == "__main__":
+    main()
@@ -28,6 +28,7 @@ class ADCReading {
   final double adc2Voltage; // ADC2 in volts
   final double adc3Voltage; // ADC3 in volts
   final double adc4Voltage; // ADC4 in volts
+  final double? shuntVoltage; // Differential A0-A1 in volts (null on older firmware)
   final DateTime timestamp;
 
   ADCReading({
@@ -35,11 +36,16 @@ class ADCReading {
     required this.adc2Voltage,
     required this.adc3Voltage,
     required this.adc4Voltage,
+    this.shuntVoltage,
     required this.timestamp,
   });
 
-  /// Parse 8-byte ADC data from ESP32
+  /// ADS1115 full-scale range in volts, indexed by PGA setting
+  static const List<double> pgaFullScale = [6.144, 4.096, 2.048, 1.024, 0.512, 0.256];
+
+  /// Parse ADC data from ESP32
   /// Format: [AD1_MSB, AD1_LSB, AD2_MSB, AD2_LSB, AD3_MSB, AD3_LSB, AD4_MSB, AD4_LSB]
+  /// Newer firmware appends [SHUNT_MSB, SHUNT_LSB, SHUNT_PGA] (11 bytes)
   factory ADCReading.fromBytes(List<int> data) {
     if (data.length < 8) {
       throw ArgumentError('Invalid ADC data length: ${data.length}');
@@ -59,16 +65,520 @@ class ADCReading {
     // Convert to voltage (ADS1115: 0.125mV per LSB)
     const resolution = 0.000125; // 0.125mV in volts
 
+    // Differential shunt reading, auto-ranged on the device
+    double? shunt;
+    if (data.length >= 11) {
+      final pga = data[10].clamp(0, pgaFullScale.length - 1);
+      shunt = toSigned16(data[8], data[9]) * pgaFullScale[pga] / 32768;
+    }
+
     return ADCReading(
       adc1Voltage: adc1 * resolution,
       adc2Voltage: adc2 * resolution,
       adc3Voltage: adc3 * resolution,
       adc4Voltage: adc4 * resolution,
+      shuntVoltage: shunt,
       timestamp: DateTime.now(),
     );
   }
 }
 
+/// One scan decoded from a telemetry notification
+class TelemetryFrame {
+  final int seq; // Sampler frame counter; gaps mean dropped frames
+  final int timestampUs; // Device esp_timer time when the scan completed
+  final int updatedMask; // Channels converted in this scan (bit n = channel n)
+  final ADCReading reading;
+
+  const TelemetryFrame({
+    required this.seq,
+    required this.timestampUs,
+    required this.updatedMask,
+    required this.reading,
+  });
+}
+
+/// Framed telemetry notification (format version 1, see firmware/README.md)
+///
+/// Header: version, channel mask, first seq (u32 BE), first timestamp in us
+/// (u64 BE), frame count. The first frame carries absolute values; each later
+/// frame has a flags byte (updated channels, seq gap), the change in scan
+/// period, and deltas for the updated channels. Signed values are zigzag
+/// varints. The shunt is in units of the +/-0.256 V LSB.
+class TelemetryPacket {
+  static const int version = 1;
+  static const int headerLength = 15;
+  static const int numChannels = 5;
+  static const int shuntChannel = 4;
+  static const int _seqGapEscape = 7;
+
+  final int channelMask;
+  final List<TelemetryFrame> frames;
+
+  const TelemetryPacket({required this.channelMask, required this.frames});
+
+  int get firstSeq => frames.first.seq;
+  int get lastSeq => frames.last.seq;
+
+  /// Decode a notification. [clock] maps device microseconds to wall time;
+  /// without it readings are stamped with the arrival time.
+  factory TelemetryPacket.decode(List<int> data,
+      {DateTime Function(int deviceUs)? clock}) {
+    if (data.length < headerLength) {
+      throw ArgumentError('Telemetry packet too short: ${data.length}');
+    }
+    if (data[0] != version) {
+      throw ArgumentError('Unsupported telemetry version: ${data[0]}');
+    }
+
+    int readBE(int offset, int bytes) {
+      var v = 0;
+      for (var i = 0; i < bytes; i++) {
+        v = (v << 8) | data[offset + i];
+      }
+      return v;
+    }
+
+    var pos = headerLength;
+    int readVarint() {
+      var result = 0;
+      var shift = 0;
+      while (true) {
+        if (pos >= data.length) {
+          throw ArgumentError('Truncated telemetry packet');
+        }
+        final b = data[pos++];
+        result |= (b & 0x7F) << shift;
+        if (b & 0x80 == 0) return result;
+        shift += 7;
+      }
+    }
+
+    int readSigned() {
+      final v = readVarint();
+      return (v >> 1) ^ -(v & 1);
+    }
+
+    final mask = data[1];
+    var seq = readBE(2, 4);
+    var timestampUs = readBE(6, 8);
+    final count = data[14];
+    final values = List<int>.filled(numChannels, 0);
+    var lastDt = 0;
+    final arrival = DateTime.now();
+    final frames = <TelemetryFrame>[];
+
+    for (var n = 0; n < count; n++) {
+      var updated = mask;
+      if (n == 0) {
+        for (var ch = 0; ch < numChannels; ch++) {
+          if (mask & (1 << ch) != 0) values[ch] = readSigned();
+        }
+      } else {
+        final flags = data[pos++];
+        updated = flags & 0x1F & mask;
+        final gapField = flags >> 5;
+        seq += gapField == _seqGapEscape ? readVarint() : gapField + 1;
+        lastDt += readSigned();
+        timestampUs += lastDt;
+        for (var ch = 0; ch < numChannels; ch++) {
+          if (updated & (1 << ch) != 0) values[ch] += readSigned();
+        }
+      }
+
+      frames.add(TelemetryFrame(
+        seq: seq & 0xFFFFFFFF,
+        timestampUs: timestampUs,
+        updatedMask: updated,
+        reading: ADCReading(
+          adc1Voltage: values[0] * 0.000125,
+          adc2Voltage: values[1] * 0.000125,
+          adc3Voltage: values[2] * 0.000125,
+          adc4Voltage: values[3] * 0.000125,
+          shuntVoltage: mask & (1 << shuntChannel) != 0
+              ? values[shuntChannel] * 0.256 / 32768
+              : null,
+          timestamp: clock != null ? clock(timestampUs) : arrival,
+        ),
+      ));
+    }
+
+    if (frames.isEmpty) {
+      throw ArgumentError('Telemetry packet has no frames');
+    }
+    return TelemetryPacket(channelMask: mask, frames: frames);
+  }
+}
+
+/// One entry of a command batch (see firmware/README.md)
+class CommandEntry {
+  static const int typeEnable = 0x01;
+  static const int typeDisable = 0x02;
+  static const int typeSetDac = 0x03;
+  static const int typeSetRamp = 0x04;
+  static const int typeSetTelemetryInterval = 0x05;
+  static const int typeSetSchedule = 0x06;
+  static const int typeSetFilter = 0x07;
+  static const int typeClaimControl = 0x08;
+  static const int typeReleaseControl = 0x09;
+  static const int typeSetCurrent = 0x0A;
+  static const int typeStartSession = 0x0B;
+  static const int typeStopSession = 0x0C;
+  static const int typeSetWaveform = 0x0D;
+  static const int typeSetDither = 0x0E;
+
+  static const int waveformDc = 0;
+  static const int waveformSine = 1; // tACS
+  static const int waveformNoise = 2; // tRNS, frequency is the bandwidth
+
+  final int type;
+  final List<int> value;
+
+  const CommandEntry(this.type, [this.value = const []]);
+
+  const CommandEntry.enable() : this(typeEnable);
+  const CommandEntry.disable() : this(typeDisable);
+  const CommandEntry.claimControl() : this(typeClaimControl);
+  const CommandEntry.releaseControl() : this(typeReleaseControl);
+  const CommandEntry.stopSession() : this(typeStopSession);
+  CommandEntry.dac(int code) : this(typeSetDac, [code]);
+
+  /// Closed-loop target: the device regulates the measured current to it
+  CommandEntry.current(int microamps)
+      : this(typeSetCurrent, [(microamps >> 8) & 0xFF, microamps & 0xFF]);
+  /// Device-timed session: ramp up, hold and ramp down within [durationS]
+  CommandEntry.startSession(int microamps, int rampMs, int durationS)
+      : this(typeStartSession, [
+          (microamps >> 8) & 0xFF,
+          microamps & 0xFF,
+          (rampMs >> 8) & 0xFF,
+          rampMs & 0xFF,
+          (durationS >> 8) & 0xFF,
+          durationS & 0xFF,
+        ]);
+  /// Waveform around a DC offset; amplitude may not exceed the offset
+  CommandEntry.waveform(int shape, double frequencyHz, int amplitudeMicroamps, int offsetMicroamps)
+      : this(typeSetWaveform, [
+          shape,
+          ((frequencyHz * 10).round() >> 8) & 0xFF,
+          (frequencyHz * 10).round() & 0xFF,
+          (amplitudeMicroamps >> 8) & 0xFF,
+          amplitudeMicroamps & 0xFF,
+          (offsetMicroamps >> 8) & 0xFF,
+          offsetMicroamps & 0xFF,
+        ]);
+  /// Sigma-delta dithering of the DC output, for finer closed-loop current steps
+  CommandEntry.dither(bool on) : this(typeSetDither, [on ? 1 : 0]);
+  CommandEntry.ramp(int ms) : this(typeSetRamp, [(ms >> 8) & 0xFF, ms & 0xFF]);
+  CommandEntry.telemetryInterval(int ms)
+      : this(typeSetTelemetryInterval, [(ms >> 8) & 0xFF, ms & 0xFF]);
+
+  /// Encode a batch: sequence number, then type, length and value per entry
+  static List<int> encodeBatch(int seq, List<CommandEntry> entries) {
+    final out = <int>[seq & 0xFF];
+    for (final e in entries) {
+      out
+        ..add(e.type)
+        ..add(e.value.length)
+        ..addAll(e.value);
+    }
+    return out;
+  }
+}
+
+/// Status the firmware returns for each command batch
+class CommandStatus {
+  static const int ok = 0;
+  static const int malformed = 1;
+  static const int unknownType = 2;
+  static const int badLength = 3;
+  static const int invalidValue = 4;
+  static const int busy = 5;
+  static const int notController = 6; // Another client holds control
+
+  final int seq; // Echo of the batch sequence number
+  final int status;
+  final int? entryIndex; // Failing entry, null if none
+  final int faultFlags; // Latched current faults after the batch
+
+  const CommandStatus({
+    required this.seq,
+    required this.status,
+    this.entryIndex,
+    required this.faultFlags,
+  });
+
+  bool get isOk => status == ok;
+  bool get isNotController => status == notController;
+
+  factory CommandStatus.fromBytes(List<int> data) {
+    if (data.length < 4) {
+      throw ArgumentError('Invalid command status length: ${data.length}');
+    }
+    return CommandStatus(
+      seq: data[0],
+      status: data[1],
+      entryIndex: data[2] == 0xFF ? null : data[2],
+      faultFlags: data[3],
+    );
+  }
+}
+
+/// Session progress the firmware notifies on the command characteristic
+class SessionProgress {
+  static const int length = 10; // Command statuses are 4 bytes
+
+  static const int idle = 0;
+  static const int rampUp = 1;
+  static const int hold = 2;
+  static const int rampDown = 3;
+
+  static const int endNone = 0;
+  static const int endComplete = 1;
+  static const int endStopped = 2;
+  static const int endOverridden = 3; // A DAC command took over
+  static const int endFault = 4;
+
+  final int phase;
+  final int lastEnd; // How the last session ended
+  final Duration elapsed;
+  final Duration duration;
+  final int targetMicroamps;
+  final int measuredMicroamps;
+
+  const SessionProgress({
+    required this.phase,
+    required this.lastEnd,
+    required this.elapsed,
+    required this.duration,
+    required this.targetMicroamps,
+    required this.measuredMicroamps,
+  });
+
+  bool get isRunning => phase != idle;
+
+  factory SessionProgress.fromBytes(List<int> data) {
+    if (data.length < length) {
+      throw ArgumentError('Invalid session progress length: ${data.length}');
+    }
+    int u16(int i) => (data[i] << 8) | data[i + 1];
+    return SessionProgress(
+      phase: data[0],
+      lastEnd: data[1],
+      elapsed: Duration(seconds: u16(2)),
+      duration: Duration(seconds: u16(4)),
+      targetMicroamps: u16(6),
+      measuredMicroamps: u16(8),
+    );
+  }
+}
+
+/// Device state from the manufacturer data in advertisements (see firmware/README.md)
+class AdvertisedStatus {
+  static const int companyId = 0xFFFF;
+  static const int version = 1;
+  static const int length = 10; // After the company ID
+
+  static const int idle = 0;
+  static const int ramping = 1;
+  static const int stimulating = 2;
+  static const int fault = 3;
+
+  final int state;
+  final int elapsedSeconds; // Since the DAC was enabled
+  final double currentMA;
+  final double batteryVoltage;
+  final int faultFlags;
+  final int connections; // Clients already connected
+
+  const AdvertisedStatus({
+    required this.state,
+    required this.elapsedSeconds,
+    required this.currentMA,
+    required this.batteryVoltage,
+    required this.faultFlags,
+    required this.connections,
+  });
+
+  bool get isActive => state == ramping || state == stimulating;
+
+  String get stateLabel {
+    switch (state) {
+      case idle:
+        return 'Idle';
+      case ramping:
+        return 'Ramping';
+      case stimulating:
+        return 'Stimulating';
+      case fault:
+        return 'Fault';
+      default:
+        return 'Unknown';
+    }
+  }
+
+  /// Parse from scan results' manufacturer data (company ID to payload).
+  /// Null for other devices, older firmware or unknown formats.
+  static AdvertisedStatus? fromManufacturerData(Map<int, List<int>> data) {
+    final bytes = data[companyId];
+    if (bytes == null || bytes.length < length || bytes[0] != version) {
+      return null;
+    }
+    int u16(int i) => (bytes[i] << 8) | bytes[i + 1];
+    return AdvertisedStatus(
+      state: bytes[1],
+      elapsedSeconds: u16(2),
+      currentMA: u16(4) / 1000.0,
+      batteryVoltage: u16(6) / 1000.0,
+      faultFlags: bytes[8],
+      connections: bytes[9],
+    );
+  }
+}
+
+/// Session log event (record type 0x02, see firmware/README.md)
+class SessionLogEvent {
+  static const int boot = 1; // Timestamps restart here
+  static const int enabled = 2; // [target code, ramp ms (2)]
+  static const int disabled = 3;
+  static const int target = 4; // [target code]
+  static const int fault = 5; // [fault flags]
+  static const int erased = 6;
+  static const int targetCurrent = 7; // [target uA (2)], closed loop
+  static const int sessionStarted = 8; // [target uA (2), ramp ms (2), duration s (2)]
+  static const int sessionEnded = 9; // [SessionProgress end reason]
+  static const int waveform = 10; // [shape, frequency 0.1 Hz (2), amplitude uA (2), offset uA (2)]
+
+  final int code;
+  final int timestampUs; // Device esp_timer time, since the last boot event
+  final List<int> args;
+
+  const SessionLogEvent({
+    required this.code,
+    required this.timestampUs,
+    required this.args,
+  });
+}
+
+/// One record of the device's session log
+class SessionLogRecord {
+  static const int typeFrames = 0x01;
+  static const int typeEvent = 0x02;
+
+  final int offset; // Log offset, stable across reboots
+  final int type;
+  final List<int> payload;
+
+  const SessionLogRecord({
+    required this.offset,
+    required this.type,
+    required this.payload,
+  });
+
+  /// Recorded frames, in the telemetry notification format
+  TelemetryPacket? get frames =>
+      type == typeFrames ? TelemetryPacket.decode(payload) : null;
+
+  SessionLogEvent? get event {
+    if (type != typeEvent || payload.length < 9) return null;
+    var timestampUs = 0;
+    for (var i = 1; i < 9; i++) {
+      timestampUs = (timestampUs << 8) | payload[i];
+    }
+    return SessionLogEvent(
+      code: payload[0],
+      timestampUs: timestampUs,
+      args: payload.sublist(9),
+    );
+  }
+}
+
+/// Rebuilds log records from downloaded chunks. The log is a run of 4088-byte
+/// sectors; each holds whole records, and a 0xFF type or a bad CRC ends it.
+class SessionLogReader {
+  static const int sectorData = 4088;
+  static const int recordHeader = 5;
+
+  final List<int> _buffer = [];
+  int _bufferStart;
+
+  SessionLogReader(int offset) : _bufferStart = offset;
+
+  /// Where to resume a download: the start of the first incomplete record
+  int get resumeOffset => _bufferStart;
+
+  /// Add the bytes of one data notification; returns the records completed by it
+  List<SessionLogRecord> add(int offset, List<int> bytes) {
+    final bufferEnd = _bufferStart + _buffer.length;
+    if (offset > bufferEnd) {
+      // Older data was overwritten on the device before it was sent
+      _buffer.clear();
+      _bufferStart = offset;
+    } else if (offset < bufferEnd) {
+      // Already have (part of) it, e.g. after restarting a read
+      final have = bufferEnd - offset;
+      if (have >= bytes.length) return const [];
+      bytes = bytes.sublist(have);
+    }
+    _buffer.addAll(bytes);
+    return _parse();
+  }
+
+  List<SessionLogRecord> _parse() {
+    final records = <SessionLogRecord>[];
+    var pos = 0;
+    while (pos < _buffer.length) {
+      final offset = _bufferStart + pos;
+      final sectorLeft = sectorData - offset % sectorData;
+      final available = _buffer.length - pos;
+
+      var endOfSector = sectorLeft < recordHeader || _buffer[pos] == 0xFF;
+      if (!endOfSector) {
+        if (available < recordHeader) break;
+        final len = (_buffer[pos + 1] << 8) | _buffer[pos + 2];
+        if (recordHeader + len > sectorLeft) {
+          endOfSector = true;
+        } else {
+          if (available < recordHeader + len) break;
+          final payload = _buffer.sublist(pos + recordHeader, pos + recordHeader + len);
+          final crc = crc16([..._buffer.sublist(pos, pos + 3), ...payload]);
+          if (crc != (_buffer[pos + 3] << 8 | _buffer[pos + 4])) {
+            endOfSector = true;
+          } else {
+            records.add(SessionLogRecord(
+                offset: offset, type: _buffer[pos], payload: payload));
+            pos += recordHeader + len;
+          }
+        }
+      }
+      if (endOfSector) {
+        // Skip to the next sector, even past what has arrived so far
+        pos += sectorLeft;
+        if (pos >= _buffer.length) {
+          _bufferStart += pos;
+          _buffer.clear();
+          return records;
+        }
+      }
+    }
+    _buffer.removeRange(0, pos);
+    _bufferStart += pos;
+    return records;
+  }
+
+  /// CRC-16/CCITT-FALSE, as used by the firmware's session log
+  static int crc16(List<int> data) {
+    var crc = 0xFFFF;
+    for (final b in data) {
+      crc ^= b << 8;
+      for (var i = 0; i < 8; i++) {
+        crc = crc & 0x8000 != 0 ? ((crc << 1) ^ 0x1021) & 0xFFFF : (crc << 1) & 0xFFFF;
+      }
+    }
+    return crc;
+  }
+}
+
 /// Connection quality levels
 enum ConnectionQuality {
   unknown,
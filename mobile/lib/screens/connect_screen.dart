@@ -129,6 +129,7 @@ class _ConnectScreenState extends State<ConnectScreen> {
 
                           return _DeviceTile(
                             device: device,
+                            status: bleService.advertisedStatus(device),
                             isConnecting: isConnecting,
                             onTap: () async {
                               final success = await bleService.connect(device);
@@ -218,11 +219,13 @@ class _ConnectScreenState extends State<ConnectScreen> {
 
 class _DeviceTile extends StatelessWidget {
   final BluetoothDevice device;
+  final AdvertisedStatus? status;
   final bool isConnecting;
   final VoidCallback onTap;
 
   const _DeviceTile({
     required this.device,
+    this.status,
     required this.isConnecting,
     required this.onTap,
   });
@@ -253,8 +256,13 @@ class _DeviceTile extends StatelessWidget {
           style: const TextStyle(fontWeight: FontWeight.bold),
         ),
         subtitle: Text(
-          device.remoteId.toString(),
-          style: TextStyle(fontSize: 12, color: colorScheme.onSurfaceVariant),
+          status != null ? _statusLine(status!) : device.remoteId.toString(),
+          style: TextStyle(
+            fontSize: 12,
+            color: status?.state == AdvertisedStatus.fault
+                ? colorScheme.error
+                : colorScheme.onSurfaceVariant,
+          ),
         ),
         trailing: isConnecting
             ? const SizedBox(
@@ -269,6 +277,22 @@ class _DeviceTile extends StatelessWidget {
   }
 }
 
+String _statusLine(AdvertisedStatus status) {
+  final parts = <String>[status.stateLabel];
+  if (status.isActive) {
+    final minutes = status.elapsedSeconds ~/ 60;
+    final seconds = (status.elapsedSeconds % 60).toString().padLeft(2, '0');
+    parts
+      ..add('$minutes:$seconds')
+      ..add('${status.currentMA.toStringAsFixed(2)} mA');
+  }
+  parts.add('${status.batteryVoltage.toStringAsFixed(1)} V');
+  if (status.connections > 0) {
+    parts.add('${status.connections} connected');
+  }
+  return parts.join(' · ');
+}
+
 class _ErrorBanner extends StatelessWidget {
   final String message;
   final VoidCallback onClear;
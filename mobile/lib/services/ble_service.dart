@@ -10,11 +10,30 @@ import '../models/models.dart';
 class BLEService extends ChangeNotifier {
   // Persistence keys
   static const String _lastDeviceKey = 'last_connected_device_id';
+  static const String _logOffsetKeyPrefix = 'session_log_offset_';
 
   // BLE Configuration
   static const String _serviceUuid = '000000ff-0000-1000-8000-00805f9b34fb';
   static const String _characteristicUuid =
       '0000ff01-0000-1000-8000-00805f9b34fb';
+  static const String _telemetryUuid = '0000ff02-0000-1000-8000-00805f9b34fb';
+  static const String _commandUuid = '0000ff03-0000-1000-8000-00805f9b34fb';
+  static const String _logUuid = '0000ff04-0000-1000-8000-00805f9b34fb';
+  static const Duration _commandTimeout = Duration(seconds: 2);
+
+  // Reconnect after a dropped link: the firmware advertises directly to a bonded phone
+  // for about a second, so a few short attempts beat falling back to a scan
+  static const int _reconnectAttempts = 3;
+  static const Duration _reconnectTimeout = Duration(seconds: 4);
+
+  // Session log download: the device sends up to a window beyond the last
+  // acknowledged offset; acknowledging every quarter window keeps it streaming
+  static const int _logWindowBytes = 64 * 1024;
+  static const int _logAckBytes = 16 * 1024;
+  static const Duration _logIdleTimeout = Duration(seconds: 10);
+
+  // Link: the firmware's local MTU is 500; 2M PHY where the platform allows it
+  static const int _requestedMtu = 500;
 
   // Safety constants
   static const double maxCurrentMA = 2.0;
@@ -22,13 +41,28 @@ class BLEService extends ChangeNotifier {
   static const int dacEnableCommand = 254;
   static const int dacDisableCommand = 253;
   static const int dacOffValue = 255;
+  static const int sessionRampMs = 10000; // Soft start and intensity changes
 
   // State
   BluetoothDevice? _device;
   BluetoothCharacteristic? _characteristic;
+  StreamSubscription<List<int>>? _telemetrySubscription;
+  BluetoothCharacteristic? _commandCharacteristic;
+  StreamSubscription<List<int>>? _commandSubscription;
+  BluetoothCharacteristic? _logCharacteristic;
+  StreamSubscription<List<int>>? _logSubscription;
+  void Function(List<int> data)? _onLogNotification; // Set while downloading
+  StreamSubscription<BluetoothConnectionState>? _linkSubscription;
+  StreamSubscription<void>? _servicesResetSubscription;
+  final Map<int, Completer<CommandStatus>> _pendingCommands = {};
+  int _nextCommandSeq = 0;
+  int? _nextTelemetrySeq;
+  int _droppedFrames = 0;
+  int? _deviceClockOffsetUs; // Wall clock minus device esp_timer time
   BLEConnectionState _connectionState = BLEConnectionState.disconnected;
   String? _errorMessage;
   List<BluetoothDevice> _discoveredDevices = [];
+  final Map<DeviceIdentifier, AdvertisedStatus> _advertisedStatus = {};
   Timer? _adcPollTimer;
   ADCReading? _lastReading;
 
@@ -43,9 +77,14 @@ class BLEService extends ChangeNotifier {
   BLEConnectionState get connectionState => _connectionState;
   String? get errorMessage => _errorMessage;
   List<BluetoothDevice> get discoveredDevices => _discoveredDevices;
+  AdvertisedStatus? advertisedStatus(BluetoothDevice device) =>
+      _advertisedStatus[device.remoteId];
   BluetoothDevice? get connectedDevice => _device;
   ADCReading? get lastReading => _lastReading;
   bool get isConnected => _connectionState == BLEConnectionState.connected;
+  bool get isStreaming => _telemetrySubscription != null;
+  bool get hasSessionLog => _logCharacteristic != null;
+  int get droppedFrames => _droppedFrames;
   
   SessionState get sessionState => _sessionState;
   int get elapsedSeconds => _elapsedSeconds;
@@ -74,6 +113,7 @@ class BLEService extends ChangeNotifier {
     try {
       _setConnectionState(BLEConnectionState.scanning);
       _discoveredDevices.clear();
+      _advertisedStatus.clear();
       _errorMessage = null;
 
       // Check Bluetooth adapter
@@ -90,12 +130,20 @@ class BLEService extends ChangeNotifier {
 
       // Listen for scan results
       final subscription = FlutterBluePlus.scanResults.listen((results) {
-        _discoveredDevices = results
+        final matches = results
             .where((r) =>
                 r.device.platformName.toLowerCase().contains('opentdcs') ||
                 r.device.platformName.toLowerCase().contains('tdcs'))
-            .map((r) => r.device)
             .toList();
+        _discoveredDevices = matches.map((r) => r.device).toList();
+        // State rides in the advertisement, so each device shows it without connecting
+        for (final r in matches) {
+          final status = AdvertisedStatus.fromManufacturerData(
+              r.advertisementData.manufacturerData);
+          if (status != null) {
+            _advertisedStatus[r.device.remoteId] = status;
+          }
+        }
         notifyListeners();
       });
 
@@ -117,31 +165,7 @@ class BLEService extends ChangeNotifier {
       _errorMessage = null;
       _device = device;
 
-      // Connect with timeout
-      await device.connect(
-        license: License.free,
-        timeout: const Duration(seconds: 15),
-        mtu: null,
-      );
-
-      // Discover services
-      final services = await device.discoverServices();
-      final service = services.firstWhere(
-        (s) => s.uuid.toString().toLowerCase() == _serviceUuid.toLowerCase(),
-        orElse: () => throw Exception('Service not found'),
-      );
-
-      // Find characteristic
-      _characteristic = service.characteristics.firstWhere(
-        (c) =>
-            c.uuid.toString().toLowerCase() == _characteristicUuid.toLowerCase(),
-        orElse: () => throw Exception('Characteristic not found'),
-      );
-
-      // Enable notifications if supported
-      if (_characteristic!.properties.notify) {
-        await _characteristic!.setNotifyValue(true);
-      }
+      await _connectLink(device, const Duration(seconds: 15));
 
       // Save device ID for auto-reconnect
       final prefs = await SharedPreferences.getInstance();
@@ -159,11 +183,145 @@ class BLEService extends ChangeNotifier {
     }
   }
 
+  /// Connect, discover and subscribe, then watch the link for drops and GATT changes
+  Future<void> _connectLink(BluetoothDevice device, Duration timeout) async {
+    await device.connect(
+      license: License.free,
+      timeout: timeout,
+      mtu: _requestedMtu, // Android only; iOS negotiates the maximum itself
+    );
+    await _bond(device);
+    await _requestPreferredPhy(device);
+    await _setupServices(device);
+
+    await _linkSubscription?.cancel();
+    _linkSubscription = device.connectionState.listen((state) {
+      if (state == BluetoothConnectionState.disconnected &&
+          _connectionState == BLEConnectionState.connected) {
+        _onLinkLost(device);
+      }
+    });
+    await _servicesResetSubscription?.cancel();
+    _servicesResetSubscription =
+        device.onServicesReset.listen((_) => _onServicesReset(device));
+  }
+
+  /// Discover the service and subscribe to its characteristics. The firmware bonds, so
+  /// after the first connection discovery is answered from the OS attribute cache.
+  Future<void> _setupServices(BluetoothDevice device) async {
+    final services = await device.discoverServices();
+    final service = services.firstWhere(
+      (s) => s.uuid.toString().toLowerCase() == _serviceUuid.toLowerCase(),
+      orElse: () => throw Exception('Service not found'),
+    );
+
+    // Find characteristic
+    _characteristic = service.characteristics.firstWhere(
+      (c) =>
+          c.uuid.toString().toLowerCase() == _characteristicUuid.toLowerCase(),
+      orElse: () => throw Exception('Characteristic not found'),
+    );
+
+    // Enable notifications if supported
+    if (_characteristic!.properties.notify) {
+      await _characteristic!.setNotifyValue(true);
+    }
+
+    // Newer firmware streams every scan on a separate notify characteristic
+    final telemetry = service.characteristics.where((c) =>
+        c.uuid.toString().toLowerCase() == _telemetryUuid.toLowerCase() &&
+        c.properties.notify);
+    if (telemetry.isNotEmpty) {
+      await _startTelemetry(telemetry.first);
+    }
+
+    // ...and takes batched commands, acknowledged by a status notification
+    final command = service.characteristics.where((c) =>
+        c.uuid.toString().toLowerCase() == _commandUuid.toLowerCase() &&
+        c.properties.notify);
+    if (command.isNotEmpty) {
+      await _startCommands(command.first);
+    }
+
+    // ...and records sessions to flash for download
+    final log = service.characteristics.where((c) =>
+        c.uuid.toString().toLowerCase() == _logUuid.toLowerCase() &&
+        c.properties.notify);
+    if (log.isNotEmpty) {
+      _logSubscription = log.first.onValueReceived
+          .listen((data) => _onLogNotification?.call(data));
+      await log.first.setNotifyValue(true);
+      _logCharacteristic = log.first;
+    }
+  }
+
+  /// Drop per-link state: subscriptions, pending commands and stream position
+  Future<void> _teardownLink() async {
+    await _telemetrySubscription?.cancel();
+    _telemetrySubscription = null;
+    await _commandSubscription?.cancel();
+    _commandSubscription = null;
+    _commandCharacteristic = null;
+    await _logSubscription?.cancel();
+    _logSubscription = null;
+    _logCharacteristic = null;
+    _onLogNotification?.call(const []); // Fails a running download
+    _failPendingCommands('Disconnected');
+    _nextTelemetrySeq = null;
+    _deviceClockOffsetUs = null;
+  }
+
+  /// The link dropped without disconnect(). The device keeps stimulating as set, so
+  /// keep the session and reconnect straight away.
+  Future<void> _onLinkLost(BluetoothDevice device) async {
+    debugPrint('Link lost, reconnecting');
+    await _linkSubscription?.cancel();
+    _linkSubscription = null;
+    _stopADCPolling();
+    await _teardownLink();
+    _setConnectionState(BLEConnectionState.connecting);
+
+    for (var attempt = 1; attempt <= _reconnectAttempts; attempt++) {
+      if (_device != device) return; // disconnect() or another device in the meantime
+      try {
+        await _connectLink(device, _reconnectTimeout);
+        _setConnectionState(BLEConnectionState.connected);
+        _startADCPolling(isSessionRunning
+            ? const Duration(seconds: 1)
+            : const Duration(seconds: 5));
+        return;
+      } catch (e) {
+        debugPrint('Reconnect attempt $attempt failed: $e');
+      }
+    }
+    _setError('Connection lost');
+    await disconnect();
+  }
+
+  /// Service Changed from the firmware (new attribute table after an update): the
+  /// cached handles are stale, so discover again
+  Future<void> _onServicesReset(BluetoothDevice device) async {
+    debugPrint('Services changed, rediscovering');
+    try {
+      await _teardownLink();
+      await _setupServices(device);
+    } catch (e) {
+      _setError('Service discovery failed: $e');
+    }
+  }
+
   /// Disconnect from device
   Future<void> disconnect() async {
     try {
       await stopSession();
       _stopADCPolling();
+      // Before disconnecting, so the drop is not taken for a lost link
+      await _linkSubscription?.cancel();
+      _linkSubscription = null;
+      await _servicesResetSubscription?.cancel();
+      _servicesResetSubscription = null;
+      await _teardownLink();
+      _droppedFrames = 0;
       await _device?.disconnect();
       _device = null;
       _characteristic = null;
@@ -178,19 +336,41 @@ class BLEService extends ChangeNotifier {
   Future<bool> startSession(double intensityMA, int durationMinutes) async {
     if (!isConnected) return false;
 
-    // 1. Enable DAC
-    final enabled = await enableDAC();
-    if (!enabled) {
-      HapticFeedback.vibrate();
-      return false;
-    }
+    if (_commandCharacteristic != null) {
+      // 1-2. Ramp, enable and intensity in one packet, applied together
+      if (intensityMA < 0.0 || intensityMA > maxCurrentMA) {
+        _setError('Invalid intensity: $intensityMA mA (max: $maxCurrentMA mA)');
+        return false;
+      }
+      try {
+        // Claim control first; fails if another client (e.g. a clinician station) holds it.
+        // The device times the ramps and the duration itself, so the session does not
+        // depend on the link and progress arrives as notifications.
+        await _sendCommands([
+          const CommandEntry.claimControl(),
+          CommandEntry.startSession(
+              _currentToMicroamps(intensityMA), sessionRampMs, durationMinutes * 60),
+        ]);
+      } catch (e) {
+        _setError('Failed to start session: $e');
+        HapticFeedback.vibrate();
+        return false;
+      }
+    } else {
+      // 1. Enable DAC
+      final enabled = await enableDAC();
+      if (!enabled) {
+        HapticFeedback.vibrate();
+        return false;
+      }
 
-    // 2. Set intensity
-    final setIntensitySuccess = await setIntensity(intensityMA);
-    if (!setIntensitySuccess) {
-      await disableDAC();
-      HapticFeedback.vibrate();
-      return false;
+      // 2. Set intensity
+      final setIntensitySuccess = await setIntensity(intensityMA);
+      if (!setIntensitySuccess) {
+        await disableDAC();
+        HapticFeedback.vibrate();
+        return false;
+      }
     }
 
     // 3. Initialize state
@@ -202,16 +382,18 @@ class BLEService extends ChangeNotifier {
     // 4. Update polling frequency to 1s for safety during stimulation
     _startADCPolling(const Duration(seconds: 1));
 
-    // 5. Start session timer
+    // 5. Without the command characteristic the app times the session
     _sessionTimer?.cancel();
-    _sessionTimer = Timer.periodic(const Duration(seconds: 1), (timer) {
-      _elapsedSeconds++;
-      
-      if (_elapsedSeconds >= _sessionDurationSeconds) {
-        stopSession();
-      }
-      notifyListeners();
-    });
+    if (_commandCharacteristic == null) {
+      _sessionTimer = Timer.periodic(const Duration(seconds: 1), (timer) {
+        _elapsedSeconds++;
+
+        if (_elapsedSeconds >= _sessionDurationSeconds) {
+          stopSession();
+        }
+        notifyListeners();
+      });
+    }
 
     HapticFeedback.heavyImpact();
     notifyListeners();
@@ -224,8 +406,21 @@ class BLEService extends ChangeNotifier {
     _sessionTimer = null;
 
     if (isConnected) {
-      await setIntensity(0.0);
-      await disableDAC();
+      if (_commandCharacteristic != null) {
+        try {
+          // The device ramps down over the session's ramp time
+          await _sendCommands([
+            const CommandEntry.claimControl(),
+            const CommandEntry.stopSession(),
+          ]);
+        } catch (e) {
+          debugPrint('Stop command failed: $e');
+          await disableDAC(); // Fall back to the single-byte write
+        }
+      } else {
+        await setIntensity(0.0);
+        await disableDAC();
+      }
       // Revert to slower polling when idle
       _startADCPolling(const Duration(seconds: 5));
     }
@@ -254,8 +449,12 @@ class BLEService extends ChangeNotifier {
     }
 
     try {
-      final dacValue = _currentToDAC(currentMA);
-      await _writeDAC(dacValue);
+      if (_commandCharacteristic != null) {
+        // The device regulates to the target, so load and battery do not shift it
+        await _sendCommands([CommandEntry.current(_currentToMicroamps(currentMA))]);
+      } else {
+        await _writeDAC(_currentToDAC(currentMA));
+      }
       _currentIntensityMA = currentMA;
       HapticFeedback.selectionClick();
       notifyListeners();
@@ -313,9 +512,270 @@ class BLEService extends ChangeNotifier {
     }
   }
 
+  /// Pair before the first write: the firmware only takes control and command writes
+  /// over an encrypted link, and a write without response on an unencrypted one is
+  /// dropped silently. iOS has no call for this; it pairs on the firmware's request.
+  Future<void> _bond(BluetoothDevice device) async {
+    if (defaultTargetPlatform != TargetPlatform.android) return;
+    try {
+      await device.createBond();
+    } catch (e) {
+      debugPrint('Bonding failed: $e');
+    }
+  }
+
+  /// Ask for 2M PHY; connection intervals are driven by the firmware's profiles.
+  /// Only Android exposes PHY selection, and older controllers stay on 1M.
+  Future<void> _requestPreferredPhy(BluetoothDevice device) async {
+    if (defaultTargetPlatform != TargetPlatform.android) return;
+    try {
+      await device.setPreferredPhy(
+        txPhy: Phy.le2m.mask,
+        rxPhy: Phy.le2m.mask,
+        option: PhyCoding.noPreferred,
+      );
+    } catch (e) {
+      debugPrint('PHY request failed: $e');
+    }
+  }
+
+  /// Download the device's session log from where the last download of this
+  /// device stopped (or from [fromOffset]). Progress is saved as records arrive,
+  /// so a download cut short by a disconnect resumes on the next call.
+  Future<List<SessionLogRecord>> downloadSessionLog({int? fromOffset}) async {
+    final characteristic = _logCharacteristic;
+    final device = _device;
+    if (characteristic == null || device == null) {
+      throw Exception('Session log not available');
+    }
+    if (_onLogNotification != null) {
+      throw Exception('Session log download already running');
+    }
+
+    final prefs = await SharedPreferences.getInstance();
+    final offsetKey = '$_logOffsetKeyPrefix${device.remoteId.str}';
+    final range = Completer<List<int>>();
+    final done = Completer<void>();
+    final records = <SessionLogRecord>[];
+    SessionLogReader? reader;
+    var acked = 0;
+    Timer? idle;
+
+    Future<void> write(List<int> request) =>
+        characteristic.write(request, withoutResponse: true);
+
+    List<int> be32(int v) =>
+        [(v >> 24) & 0xFF, (v >> 16) & 0xFF, (v >> 8) & 0xFF, v & 0xFF];
+
+    int readBE32(List<int> data, int offset) =>
+        (data[offset] << 24) |
+        (data[offset + 1] << 16) |
+        (data[offset + 2] << 8) |
+        data[offset + 3];
+
+    void fail(Object error) {
+      if (!range.isCompleted) range.completeError(error);
+      if (!done.isCompleted) done.completeError(error);
+    }
+
+    void restartIdleTimer() {
+      idle?.cancel();
+      idle = Timer(_logIdleTimeout, () => fail(Exception('Session log download timed out')));
+    }
+
+    _onLogNotification = (data) {
+      if (data.isEmpty) {
+        fail(Exception('Disconnected'));
+        return;
+      }
+      restartIdleTimer();
+      switch (data[0]) {
+        case 0x81: // Range
+          if (data.length >= 9 && !range.isCompleted) {
+            range.complete([readBE32(data, 1), readBE32(data, 5)]);
+          }
+          break;
+        case 0x82: // Data
+          final log = reader;
+          if (data.length < 5 || log == null) return;
+          final offset = readBE32(data, 1);
+          records.addAll(log.add(offset, data.sublist(5)));
+          final received = offset + data.length - 5;
+          if (received - acked >= _logAckBytes) {
+            acked = received;
+            write([0x03, ...be32(received)]).catchError((e) => fail(e));
+            prefs.setInt(offsetKey, log.resumeOffset);
+          }
+          break;
+        case 0x83: // Caught up
+          if (!done.isCompleted) done.complete();
+          break;
+        case 0x84:
+          fail(Exception(data.length > 1 && data[1] == 2
+              ? 'Another device is downloading the session log'
+              : 'Session log error ${data.length > 1 ? data[1] : 0}'));
+          break;
+      }
+    };
+
+    try {
+      restartIdleTimer();
+      await write([0x01]);
+      final bounds = await range.future;
+      // Past the end means the log was reset (e.g. a reflashed device): start over
+      var offset = fromOffset ?? prefs.getInt(offsetKey) ?? 0;
+      if (offset > bounds[1]) offset = 0;
+      reader = SessionLogReader(offset);
+      acked = offset;
+
+      await write([0x02, ...be32(offset), ...be32(_logWindowBytes)]);
+      await done.future;
+      return records;
+    } catch (e) {
+      if (_logCharacteristic == characteristic) {
+        write([0x04]).catchError((_) {});
+      }
+      rethrow;
+    } finally {
+      idle?.cancel();
+      _onLogNotification = null;
+      final log = reader;
+      if (log != null) await prefs.setInt(offsetKey, log.resumeOffset);
+    }
+  }
+
+  /// Subscribe to batched telemetry notifications
+  Future<void> _startTelemetry(BluetoothCharacteristic characteristic) async {
+    _telemetrySubscription =
+        characteristic.onValueReceived.listen(_onTelemetry);
+    await characteristic.setNotifyValue(true);
+  }
+
+  /// Subscribe to command status and session progress notifications
+  Future<void> _startCommands(BluetoothCharacteristic characteristic) async {
+    _commandSubscription = characteristic.onValueReceived.listen((data) {
+      if (data.length == SessionProgress.length) {
+        _onSessionProgress(SessionProgress.fromBytes(data));
+        return;
+      }
+      final CommandStatus status;
+      try {
+        status = CommandStatus.fromBytes(data);
+      } catch (e) {
+        debugPrint('Command status decode error: $e');
+        return;
+      }
+      _pendingCommands.remove(status.seq)?.complete(status);
+    });
+    await characteristic.setNotifyValue(true);
+    _commandCharacteristic = characteristic;
+  }
+
+  /// Follow the device's session clock; also picks up a session that kept running
+  /// while the app was away
+  void _onSessionProgress(SessionProgress progress) {
+    if (progress.phase == SessionProgress.idle) {
+      if (_sessionState == SessionState.running) {
+        if (progress.lastEnd != SessionProgress.endComplete &&
+            progress.lastEnd != SessionProgress.endStopped) {
+          _setError('Session ended early (reason ${progress.lastEnd})');
+        }
+        HapticFeedback.mediumImpact();
+        _startADCPolling(const Duration(seconds: 5));
+      }
+      _sessionState = SessionState.idle;
+      _elapsedSeconds = 0;
+      _currentIntensityMA = 0.0;
+    } else {
+      // A ramp down after stopSession() does not bring the session back
+      if (progress.phase != SessionProgress.rampDown &&
+          _sessionState != SessionState.running) {
+        _sessionState = SessionState.running;
+        _startADCPolling(const Duration(seconds: 1));
+      }
+      if (_sessionState == SessionState.running) {
+        _elapsedSeconds = progress.elapsed.inSeconds;
+        _sessionDurationSeconds = progress.duration.inSeconds;
+        _currentIntensityMA = progress.targetMicroamps / 1000.0;
+      }
+    }
+    notifyListeners();
+  }
+
+  /// Send one command batch and wait for its status; throws if rejected
+  Future<CommandStatus> _sendCommands(List<CommandEntry> entries) async {
+    final characteristic = _commandCharacteristic;
+    if (characteristic == null) {
+      throw Exception('Command characteristic not available');
+    }
+
+    final seq = _nextCommandSeq;
+    _nextCommandSeq = (_nextCommandSeq + 1) & 0xFF;
+    final completer = Completer<CommandStatus>();
+    completer.future.ignore(); // Errors are surfaced by the await below
+    _pendingCommands[seq]?.completeError(Exception('Superseded'));
+    _pendingCommands[seq] = completer;
+
+    try {
+      await characteristic.write(
+        CommandEntry.encodeBatch(seq, entries),
+        withoutResponse: characteristic.properties.writeWithoutResponse,
+      );
+      final status = await completer.future.timeout(_commandTimeout);
+      if (status.isNotController) {
+        throw Exception('Another device is controlling stimulation');
+      }
+      if (!status.isOk) {
+        throw Exception('Command rejected: status ${status.status}'
+            '${status.entryIndex != null ? ' at entry ${status.entryIndex}' : ''}');
+      }
+      return status;
+    } finally {
+      if (identical(_pendingCommands[seq], completer)) {
+        _pendingCommands.remove(seq);
+      }
+    }
+  }
+
+  void _failPendingCommands(String reason) {
+    for (final completer in _pendingCommands.values) {
+      completer.completeError(Exception(reason));
+    }
+    _pendingCommands.clear();
+  }
+
+  void _onTelemetry(List<int> data) {
+    final TelemetryPacket packet;
+    try {
+      packet = TelemetryPacket.decode(data, clock: _deviceTime);
+    } catch (e) {
+      debugPrint('Telemetry decode error: $e');
+      return;
+    }
+
+    // Gaps across and within notifications are frames the device dropped
+    var expected = _nextTelemetrySeq ?? packet.firstSeq;
+    for (final frame in packet.frames) {
+      _droppedFrames += (frame.seq - expected) & 0xFFFFFFFF;
+      expected = (frame.seq + 1) & 0xFFFFFFFF;
+    }
+    _nextTelemetrySeq = expected;
+
+    _lastReading = packet.frames.last.reading;
+    notifyListeners();
+  }
+
+  /// Map device esp_timer time to wall time, anchored on the first notification
+  DateTime _deviceTime(int deviceUs) {
+    _deviceClockOffsetUs ??= DateTime.now().microsecondsSinceEpoch - deviceUs;
+    return DateTime.fromMicrosecondsSinceEpoch(_deviceClockOffsetUs! + deviceUs);
+  }
+
   /// Start automatic ADC polling with specific interval
+  /// (no-op while telemetry notifications are streaming)
   void _startADCPolling(Duration interval) {
     _stopADCPolling();
+    if (isStreaming) return;
     _adcPollTimer = Timer.periodic(interval, (_) {
       readADC();
     });
@@ -327,7 +787,11 @@ class BLEService extends ChangeNotifier {
     _adcPollTimer = null;
   }
 
-  /// Convert current (mA) to DAC value (0-255)
+  /// Closed-loop target in uA (the firmware accepts up to 2480)
+  int _currentToMicroamps(double currentMA) => (currentMA * 1000).round().clamp(0, 2480);
+
+  /// Open-loop fallback for firmware without the command characteristic:
+  /// convert current (mA) to DAC value (0-255)
   /// Circuit characteristic: Higher DAC voltage = Lower current
   /// DAC 0V (value 0) = Max current (~2.48 mA)
   /// DAC 3.3V (value 255) = Min current (~0 mA)
@@ -40,8 +40,10 @@ class ElectricalCalculator {
 
   /// 6. Current through load (mA)
   /// I_Rpct = (V_actual_A0 - V_actual_A1) / R_shunt
+  /// Uses the single differential shunt conversion when the firmware provides it
   double get loadCurrentMA {
-    final vShunt = actualV0 - actualV1;
+    final diff = reading.shuntVoltage;
+    final vShunt = diff != null ? diff / divRatioADC : actualV0 - actualV1;
     // (V / R) * 1000 = mA
     final current = (vShunt / rShunt) * 1000.0;
 
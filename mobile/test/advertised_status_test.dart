@@ -0,0 +1,20 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:opentdcs_mobile/models/models.dart';
+
+void main() {
+  group('AdvertisedStatus', () {
+    test('Parses advertised device status from manufacturer data', () {
+      final status = AdvertisedStatus.fromManufacturerData({
+        AdvertisedStatus.companyId: [1, AdvertisedStatus.stimulating, 0x02, 0x58, 0x03, 0xE8, 0x0F, 0xA0, 0, 2],
+      });
+      expect(status, isNotNull);
+      expect(status!.isActive, isTrue);
+      expect(status.elapsedSeconds, 600);
+      expect(status.currentMA, closeTo(1.0, 1e-9));
+      expect(status.batteryVoltage, closeTo(4.0, 1e-9));
+      expect(status.connections, 2);
+
+      expect(AdvertisedStatus.fromManufacturerData({0x004C: [1, 2, 3]}), isNull);
+    });
+  });
+}
@@ -0,0 +1,87 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:opentdcs_mobile/models/models.dart';
+
+void main() {
+  group('CommandEntry', () {
+    test('Encodes a command batch as sequence plus TLV entries', () {
+      final packet = CommandEntry.encodeBatch(0x2A, [
+        CommandEntry.ramp(10000),
+        CommandEntry.dac(128),
+        const CommandEntry.enable(),
+      ]);
+      expect(packet, [0x2A, 0x04, 2, 0x27, 0x10, 0x03, 1, 128, 0x01, 0]);
+    });
+
+    test('Encodes a closed-loop current target in microamps', () {
+      final packet = CommandEntry.encodeBatch(5, [
+        CommandEntry.ramp(10000),
+        CommandEntry.current(1500),
+        const CommandEntry.enable(),
+      ]);
+      expect(packet, [5, 0x04, 2, 0x27, 0x10, 0x0A, 2, 0x05, 0xDC, 0x01, 0]);
+    });
+
+    test('Encodes device-timed session start and stop', () {
+      final packet = CommandEntry.encodeBatch(6, [
+        const CommandEntry.claimControl(),
+        CommandEntry.startSession(1500, 30000, 1200),
+      ]);
+      expect(packet, [6, 0x08, 0, 0x0B, 6, 0x05, 0xDC, 0x75, 0x30, 0x04, 0xB0]);
+      expect(CommandEntry.encodeBatch(7, [const CommandEntry.stopSession()]), [7, 0x0C, 0]);
+    });
+
+    test('Encodes a waveform in tenths of a hertz', () {
+      final packet = CommandEntry.encodeBatch(8, [
+        CommandEntry.waveform(CommandEntry.waveformSine, 10.5, 500, 1000),
+      ]);
+      expect(packet, [8, 0x0D, 7, 1, 0x00, 0x69, 0x01, 0xF4, 0x03, 0xE8]);
+      expect(CommandEntry.encodeBatch(9, [CommandEntry.dither(true)]), [9, 0x0E, 1, 1]);
+    });
+
+    test('Encodes control claims', () {
+      final packet = CommandEntry.encodeBatch(3, [
+        const CommandEntry.claimControl(),
+        const CommandEntry.disable(),
+        const CommandEntry.releaseControl(),
+      ]);
+      expect(packet, [3, 0x08, 0, 0x02, 0, 0x09, 0]);
+    });
+  });
+
+  group('CommandStatus', () {
+    test('Parses command status with echoed sequence', () {
+      final ok = CommandStatus.fromBytes([0x2A, 0, 0xFF, 0]);
+      expect(ok.seq, 0x2A);
+      expect(ok.isOk, isTrue);
+      expect(ok.entryIndex, isNull);
+
+      final rejected = CommandStatus.fromBytes([7, CommandStatus.invalidValue, 1, 0x01]);
+      expect(rejected.isOk, isFalse);
+      expect(rejected.entryIndex, 1);
+      expect(rejected.faultFlags, 0x01);
+    });
+
+    test('Reports observer rejections', () {
+      final status = CommandStatus.fromBytes([3, CommandStatus.notController, 0, 0]);
+      expect(status.isOk, isFalse);
+      expect(status.isNotController, isTrue);
+      expect(status.entryIndex, 0);
+    });
+  });
+
+  group('SessionProgress', () {
+    test('Parses session progress and how the last session ended', () {
+      final progress = SessionProgress.fromBytes([2, 0, 0x01, 0x2C, 0x04, 0xB0, 0x05, 0xDC, 0x05, 0xD7]);
+      expect(progress.phase, SessionProgress.hold);
+      expect(progress.isRunning, isTrue);
+      expect(progress.elapsed, const Duration(seconds: 300));
+      expect(progress.duration, const Duration(minutes: 20));
+      expect(progress.targetMicroamps, 1500);
+      expect(progress.measuredMicroamps, 1495);
+
+      final ended = SessionProgress.fromBytes([0, SessionProgress.endFault, 0, 42, 0x04, 0xB0, 0, 0, 0, 0]);
+      expect(ended.isRunning, isFalse);
+      expect(ended.lastEnd, SessionProgress.endFault);
+    });
+  });
+}
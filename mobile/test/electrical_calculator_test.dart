@@ -65,5 +65,26 @@ void main() {
       expect(calculator.loadResistanceKOhms, 0.0);
       expect(calculator.getQuality(), ConnectionQuality.unknown);
     });
+
+    test('Prefers the differential shunt reading when present', () {
+      const double ratio = 10 / 49;
+
+      // Single-ended readings disagree slightly; the differential one wins
+      final reading = ADCReading(
+        adc1Voltage: 14.4 * ratio,
+        adc2Voltage: 14.0 * ratio,
+        adc3Voltage: 2.5 * ratio,
+        adc4Voltage: 4.2 * 0.5,
+        shuntVoltage: 0.327 * ratio, // 1 mA through 327 ohm
+        timestamp: DateTime.now(),
+      );
+
+      final calculator = ElectricalCalculator(
+        reading: reading,
+        targetCurrentMA: 1.0,
+      );
+
+      expect(calculator.loadCurrentMA, closeTo(1.0, 0.001));
+    });
   });
 }
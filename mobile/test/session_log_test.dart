@@ -0,0 +1,61 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:opentdcs_mobile/models/models.dart';
+
+void main() {
+  group('SessionLogReader', () {
+    test('Rebuilds session log records across chunks and sectors', () {
+      List<int> record(int type, List<int> payload) {
+        final header = [type, payload.length >> 8, payload.length & 0xFF];
+        final crc = SessionLogReader.crc16([...header, ...payload]);
+        return [...header, crc >> 8, crc & 0xFF, ...payload];
+      }
+
+      const packet = [
+        0x01, 0x1F, 0x00, 0x00, 0x03, 0xE8, 0x00, 0x00, 0x00, 0x00, 0x00, //
+        0x4C, 0x4B, 0x40, 0x03, 0xC0, 0xBB, 0x01, 0xF0, 0xAB, 0x01, 0xE8, //
+        0x07, 0xC0, 0x86, 0x02, 0x80, 0x7D, 0x13, 0xD8, 0x36, 0x06, 0x03, //
+        0x08, 0x48, 0x14, 0x01,
+      ];
+      // Log from offset 4000: an enable event and a frames record, the rest of
+      // the first sector unused, then a disable event at the next sector (4088)
+      final enable = record(SessionLogRecord.typeEvent,
+          [SessionLogEvent.enabled, 0, 0, 0, 0, 0, 0x4C, 0x4B, 0x40, 0x80, 0x27, 0x10]);
+      final frames = record(SessionLogRecord.typeFrames, packet);
+      final used = enable.length + frames.length;
+      final log = [
+        ...enable,
+        ...frames,
+        ...List.filled(SessionLogReader.sectorData - 4000 - used, 0xFF),
+        ...record(SessionLogRecord.typeEvent, [SessionLogEvent.disabled, 0, 0, 0, 0, 0, 0x98, 0x96, 0x80]),
+      ];
+
+      List<SessionLogRecord> readInChunks(List<int> bytes) {
+        final reader = SessionLogReader(4000);
+        final records = <SessionLogRecord>[];
+        for (var i = 0; i < bytes.length; i += 7) {
+          final end = i + 7 < bytes.length ? i + 7 : bytes.length;
+          records.addAll(reader.add(4000 + i, bytes.sublist(i, end)));
+        }
+        expect(reader.resumeOffset, 4000 + bytes.length);
+        return records;
+      }
+
+      final records = readInChunks(log);
+      expect(records.map((r) => r.offset), [4000, 4000 + enable.length, 4088]);
+      expect(records[0].event!.code, SessionLogEvent.enabled);
+      expect(records[0].event!.timestampUs, 5000000);
+      expect(records[0].event!.args, [0x80, 0x27, 0x10]);
+      expect(records[1].frames!.frames.map((f) => f.seq), [1000, 1001, 1004]);
+      expect(records[2].event!.code, SessionLogEvent.disabled);
+
+      // A damaged record ends its sector; the next sector still reads
+      final damaged = [...log]..[enable.length + 10] ^= 0x01;
+      expect(readInChunks(damaged).map((r) => r.offset), [4000, 4088]);
+
+      // Data overwritten before it was sent: the reader restarts at the new offset
+      final reader = SessionLogReader(0);
+      expect(reader.add(4000, enable), hasLength(1));
+      expect(reader.resumeOffset, 4000 + enable.length);
+    });
+  });
+}
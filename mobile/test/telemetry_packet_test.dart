@@ -0,0 +1,53 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:opentdcs_mobile/models/models.dart';
+
+void main() {
+  group('ADCReading', () {
+    test('Parses the appended shunt field with its PGA range', () {
+      // A0..A3 = 0, shunt raw 0x4000 at PGA index 5 (+/-0.256 V) = 0.128 V
+      final reading = ADCReading.fromBytes(
+        [0, 0, 0, 0, 0, 0, 0, 0, 0x40, 0x00, 5],
+      );
+      expect(reading.shuntVoltage, closeTo(0.128, 1e-9));
+
+      final legacy = ADCReading.fromBytes([0, 0, 0, 0, 0, 0, 0, 0]);
+      expect(legacy.shuntVoltage, isNull);
+    });
+  });
+
+  group('TelemetryPacket', () {
+    test('Decodes a framed delta-encoded telemetry packet', () {
+      // Produced by the firmware encoder: 3 frames, second switches the shunt
+      // PGA, third follows a gap of 3 (two dropped frames)
+      final packet = TelemetryPacket.decode([
+        0x01, 0x1F, 0x00, 0x00, 0x03, 0xE8, 0x00, 0x00, 0x00, 0x00, 0x00, //
+        0x4C, 0x4B, 0x40, 0x03, 0xC0, 0xBB, 0x01, 0xF0, 0xAB, 0x01, 0xE8, //
+        0x07, 0xC0, 0x86, 0x02, 0x80, 0x7D, 0x13, 0xD8, 0x36, 0x06, 0x03, //
+        0x08, 0x48, 0x14, 0x01,
+      ]);
+
+      expect(packet.frames, hasLength(3));
+      expect(packet.frames.map((f) => f.seq), [1000, 1001, 1004]);
+      expect(packet.frames.map((f) => f.timestampUs),
+          [5000000, 5003500, 5007010]);
+
+      final first = packet.frames[0].reading;
+      expect(first.adc1Voltage, closeTo(12000 * 0.000125, 1e-9));
+      expect(first.shuntVoltage, closeTo(8000 * 0.256 / 32768, 1e-9));
+
+      final second = packet.frames[1].reading;
+      expect(second.adc1Voltage, closeTo(12003 * 0.000125, 1e-9));
+      expect(second.adc2Voltage, closeTo(10998 * 0.000125, 1e-9));
+      expect(second.shuntVoltage, closeTo(8004 * 0.256 / 32768, 1e-9));
+
+      final third = packet.frames[2];
+      expect(third.updatedMask, 0x08);
+      expect(third.reading.adc4Voltage, closeTo(16799 * 0.000125, 1e-9));
+    });
+
+    test('Rejects unknown telemetry versions', () {
+      expect(() => TelemetryPacket.decode(List.filled(15, 0)..[0] = 2),
+          throwsArgumentError);
+    });
+  });
+}